@@ -12,7 +12,8 @@ end
 function discord.import()
     discord.includes()
     
-    filter "platforms:x64"
+    -- only the windows sdk library is vendored, discord_rpc.cpp is a no-op elsewhere
+    filter { "platforms:x64", "system:windows" }
         libdirs {
             path.join(discord.source, "lib/x86_64")
         }
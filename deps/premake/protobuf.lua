@@ -25,7 +25,7 @@ end
 function protobuf.links()
     libdirs { protobuf.libPath }  -- Set library path for protobuf
 
-    filter "configurations:Debug"
+    filter { "configurations:Debug", "system:windows" }
         libdirs { path.join(protobuf.libPath, "debug") }
         links {
             "libprotobufd.lib",
@@ -82,36 +82,47 @@ function protobuf.generate()
             protoCompiler, outputDir, protoSourceDir, protoFileAbsolute
         )
 
-        -- Batch file configuration
-        local batchDir = path.getabsolute("build")
-        os.mkdir(batchDir)
-        local batchFile = path.join(batchDir, "run_protobuf.bat")
-
-        -- Write the batch file
-        local file = io.open(batchFile, "w")
-        if file then
-            file:write("@echo off\n")
-            file:write("echo Running Protobuf command...\n")
-            file:write(command .. "\n")
-            file:write("echo Completed with exit code %errorlevel%.\n")
-            file:write("exit /b %errorlevel%\n")
-            file:close()
-            print("Batch file created at: " .. batchFile)
+        if os.host() ~= "windows" then
+            -- no bundled protoc here, use the one on PATH
+            command = string.format(
+                'protoc --cpp_out="%s" --proto_path="%s" "%s"',
+                outputDir, protoSourceDir, protoFileAbsolute
+            )
+            if not os.execute(command) then
+                error("Protobuf generation failed for " .. protoFile)
+            end
         else
-            error("Failed to create batch file at " .. batchFile)
-        end
+            -- Batch file configuration
+            local batchDir = path.getabsolute("build")
+            os.mkdir(batchDir)
+            local batchFile = path.join(batchDir, "run_protobuf.bat")
+
+            -- Write the batch file
+            local file = io.open(batchFile, "w")
+            if file then
+                file:write("@echo off\n")
+                file:write("echo Running Protobuf command...\n")
+                file:write(command .. "\n")
+                file:write("echo Completed with exit code %errorlevel%.\n")
+                file:write("exit /b %errorlevel%\n")
+                file:close()
+                print("Batch file created at: " .. batchFile)
+            else
+                error("Failed to create batch file at " .. batchFile)
+            end
 
-        -- Execute the batch file
-        local handle = io.popen('cmd /c "' .. batchFile .. '"')
-        local output = handle:read("*a")
-        local result = handle:close()
+            -- Execute the batch file
+            local handle = io.popen('cmd /c "' .. batchFile .. '"')
+            local output = handle:read("*a")
+            local result = handle:close()
 
-        -- Debug output
-        print("Batch file output:\n" .. output)
+            -- Debug output
+            print("Batch file output:\n" .. output)
 
-        -- Check result
-        if not result then
-            error("Protobuf generation failed for " .. protoFile .. "\nOutput:\n" .. output)
+            -- Check result
+            if not result then
+                error("Protobuf generation failed for " .. protoFile .. "\nOutput:\n" .. output)
+            end
         end
 
         -- Add `std_include.hpp` to the generated `.cc` file
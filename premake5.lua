@@ -76,15 +76,16 @@ workspace "simpsons_server_bodnjenie"
 
     flags { "NoIncrementalLink", "NoMinimalRebuild", "MultiProcessorCompile", "No64BitChecks" }
 
-	filter "platforms:x64"
+	filter { "platforms:x64", "system:windows" }
 		defines {"_WINDOWS", "WIN32"}
 	filter {}
 
 	filter "configurations:Release"
 		optimize "Size"
+		defines {"NDEBUG"}
+	filter { "configurations:Release", "toolset:msc*" }
 		buildoptions {"/GL", "/Zc:__cplusplus"}
 		linkoptions { "/IGNORE:4702", "/LTCG" }
-		defines {"NDEBUG"}
 	filter {}
 
 	filter "configurations:Debug"
@@ -92,8 +93,15 @@ workspace "simpsons_server_bodnjenie"
 		--defines {"DEBUG", "_DEBUG"}
                 runtime "Debug"
 		defines { "_DEBUG" }
-                buildoptions { "/Zc:__cplusplus" }
    	        symbols "On"
+	filter { "configurations:Debug", "toolset:msc*" }
+                buildoptions { "/Zc:__cplusplus" }
+	filter {}
+
+	-- linux builds use the system libevent (epoll backend), glog, gflags and protobuf
+	filter "system:linux"
+		buildoptions { "-pthread" }
+		linkoptions { "-pthread" }
 	filter {}
 
 -- Define the evpp project (now in source/evpp)
@@ -130,6 +138,66 @@ project "evpp"
         optimize "On"
 
 
+
+-- memcached client (source/evpp/apps/evmc), backs the optional shared town cache
+project "evmc"
+    kind "StaticLib"
+    language "C++"
+    staticruntime "off"
+
+    includedirs {
+        "source/evpp",
+        "source/evpp/apps",
+        "source/evpp/3rdparty"
+    }
+
+    files {
+        "source/evpp/apps/evmc/*.h",
+        "source/evpp/apps/evmc/*.cc",
+        "source/evpp/3rdparty/libhashkit/*.h",
+        "source/evpp/3rdparty/libhashkit/*.c"
+    }
+
+    rapidjson.includes()
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+    filter {}
+
+
+-- nsq producer (source/evpp/apps/evnsq), ships client telemetry when TelemetryNsqd is set
+project "evnsq"
+    kind "StaticLib"
+    language "C++"
+    staticruntime "off"
+
+    includedirs {
+        "source/evpp",
+        "source/evpp/apps",
+        "source/evpp/3rdparty"
+    }
+
+    files {
+        "source/evpp/apps/evnsq/*.h",
+        "source/evpp/apps/evnsq/*.cc"
+    }
+
+    rapidjson.includes()
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+    filter {}
+
 		
 -- Define the utlis project
 project "utilities"
@@ -138,10 +206,36 @@ project "utilities"
 
 	files {"./source/utilities/**.hpp", "./source/utilities/**.cpp"}
 
+	-- win32 only helpers, nothing the server needs on linux
+	filter "system:not windows"
+		removefiles {
+			"./source/utilities/binary_resource.*",
+			"./source/utilities/com.*",
+			"./source/utilities/hardware_breakpoint.*",
+			"./source/utilities/minidump.*",
+			"./source/utilities/nt.*",
+			"./source/utilities/signature.*",
+			"./source/utilities/smbios.*",
+			"./source/utilities/thread.*",
+			"./source/utilities/StackWalker.*",
+		}
+	filter {}
+
 	includedirs {"./source/utilities", "%{prj.location}/source"}
 
 	dependencies.imports()
 
+
+-- Packs webpanel/ (gzip variants, etags) into build/src/webpanel/webpanel_assets.cpp before the server builds
+project "webpanel_packer"
+	kind "ConsoleApp"
+	language "C++"
+
+	files {"./source/webpanel_packer/**.cpp"}
+
+	zlib.import()
+	xxhash.includes()
+
 	
 -- Define the server project
 project "server"
@@ -159,13 +253,25 @@ project "server"
 	"./source/server/**.proto",
         "./source/server/resources/**.*",
 	"build/src/**.h",
-	"build/src/**.cc"
+	"build/src/**.cc",
+	"build/src/webpanel/webpanel_assets.cpp"
+    }
+
+    dependson { "webpanel_packer" }
+    prebuildcommands {
+        '"%{cfg.targetdir}/webpanel_packer" "%{wks.location}/../webpanel" "%{wks.location}/src/webpanel/webpanel_assets.cpp"'
     }
 
+    filter "files:build/src/webpanel/**.cpp"
+        flags { "NoPCH" }
+    filter {}
+
     includedirs {
         "./source/server", 
         "./source/utilities", 
         "./source/evpp",  -- evpp 
+        "./source/evpp/apps",  -- evmc, evnsq
+        "./source/evpp/3rdparty",  -- libhashkit (town router)
         "./deps/google/protobuf/include",
 	"./build/src/protobuf/generated/", 
         "%{prj.location}/source"
@@ -175,14 +281,35 @@ project "server"
     links {
         "utilities",  -- Links with utilities
         "evpp",       -- Links with evpp
-        "./source/evpp/3rdparty/libevent/lib/event.lib", -- Links with eventlib [EVENT]
-        "./source/evpp/3rdparty/libevent/lib/event_core.lib", -- Links with eventlib [CORE]
-        "./source/evpp/3rdparty/libevent/lib/event_extra.lib", --Links with eventlib [EVENT EXTRA]
-        "./source/evpp/3rdparty/glog/lib/glog.lib", -- Links with glog 
-        "./source/evpp/3rdparty/gflags/lib/gflags.lib", -- Links with gflags
-
+        "evmc",       -- Links with evmc (shared cache)
+        "evnsq",      -- Links with evnsq (telemetry export)
     }
 
+    filter "system:windows"
+        links {
+            "./source/evpp/3rdparty/libevent/lib/event.lib", -- Links with eventlib [EVENT]
+            "./source/evpp/3rdparty/libevent/lib/event_core.lib", -- Links with eventlib [CORE]
+            "./source/evpp/3rdparty/libevent/lib/event_extra.lib", --Links with eventlib [EVENT EXTRA]
+            "./source/evpp/3rdparty/glog/lib/glog.lib", -- Links with glog 
+            "./source/evpp/3rdparty/gflags/lib/gflags.lib", -- Links with gflags
+        }
+
+    filter "system:linux"
+        links {
+            "event",
+            "event_core",
+            "event_extra",
+            "event_pthreads",
+            "glog",
+            "gflags",
+            "protobuf",
+            "sqlite3",
+            "pthread",
+            "dl",
+        }
+        removefiles { "./source/server/**.rc" }
+    filter {}
+
 	
     -- Apply precompiled headers to moc files
     filter "files:src/server/protobuf/generated/**.cc"
@@ -195,6 +322,59 @@ project "server"
 
 
 	
+    dependencies.imports()
+
+-- unit tests for the server pieces that build on their own (gtest from evpp), e.g. the town router
+project "server_tests"
+    kind "ConsoleApp"
+    language "C++"
+
+    files {
+        "./source/server/test/**.cc",
+        "./source/server/dispatcher/town_router.cpp",
+        "./source/server/async/task.cpp",
+        "./source/evpp/3rdparty/gtest/src/gtest-all.cc",
+        "./source/evpp/3rdparty/gtest/src/gtest_main.cc",
+    }
+
+    includedirs {
+        "./source/server",
+        "./source/utilities",
+        "./source/evpp",
+        "./source/evpp/apps",
+        "./source/evpp/3rdparty",
+        "./source/evpp/3rdparty/gtest",
+        "./source/evpp/test",  -- test_common.h
+        "%{prj.location}/source"
+    }
+
+    links {
+        "utilities",
+        "evpp",
+        "evmc",  -- libhashkit
+    }
+
+    filter "system:windows"
+        links {
+            "./source/evpp/3rdparty/libevent/lib/event.lib",
+            "./source/evpp/3rdparty/libevent/lib/event_core.lib",
+            "./source/evpp/3rdparty/libevent/lib/event_extra.lib",
+            "./source/evpp/3rdparty/glog/lib/glog.lib",
+            "./source/evpp/3rdparty/gflags/lib/gflags.lib",
+            "Ws2_32",
+        }
+
+    filter "system:linux"
+        links {
+            "event",
+            "event_core",
+            "event_pthreads",
+            "glog",
+            "gflags",
+            "pthread",
+        }
+    filter {}
+
     dependencies.imports()
 
 group "Dependencies"
@@ -14,7 +14,8 @@ MemcacheClientBase::~MemcacheClientBase() {
 }
 
 void MemcacheClientBase::Stop() {
-    if (load_loop_) {
+    // The reload loop only runs when there is a load thread
+    if (load_loop_ && load_thread_) {
         load_loop_->Stop();
     }
     if (load_thread_) {
@@ -193,8 +193,10 @@ namespace evmc {
     }
 
     void MemcacheClientPool::LaunchCommand(CommandPtr& command) {
-        //const int thread = next_thread_++;
-        auto loop = loop_pool_.GetNextLoopWithHash(rand());
+        // Every command for a key goes out on the same loop and so the same connection, which
+        // keeps a set followed by a set of the same key in order on the server. Multi-key
+        // commands carry their server id here.
+        auto loop = loop_pool_.GetNextLoopWithHash(command->vbucket_id());
         loop->RunInLoop(
             std::bind(&MemcacheClientPool::DoLaunchCommand, this, loop, command));
     }
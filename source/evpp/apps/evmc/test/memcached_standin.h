@@ -0,0 +1,136 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <memcached/protocol_binary.h>
+
+#include "evpp/buffer.h"
+#include "evpp/event_loop.h"
+#include "evpp/tcp_conn.h"
+#include "evpp/tcp_server.h"
+
+namespace evmc {
+
+// An in-process memcached speaking the subset of the binary protocol evmc
+// sends : GET, GETK, GETKQ, SET, DELETE and NOOP. Items never expire.
+// Meant for tests, so that they don't need a memcached daemon.
+class MemcachedStandin {
+public:
+    MemcachedStandin(evpp::EventLoop* loop, const std::string& listen_addr)
+        : server_(loop, listen_addr, "MemcachedStandin", 0) {
+        server_.SetMessageCallback(std::bind(&MemcachedStandin::OnMessage, this,
+                                             std::placeholders::_1, std::placeholders::_2));
+    }
+
+    bool Start() {
+        return server_.Init() && server_.Start();
+    }
+
+    void Stop() {
+        server_.Stop();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return items_.size();
+    }
+
+    // Drops every item, like a memcached restart
+    void Flush() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        items_.clear();
+    }
+
+private:
+    enum { kHeaderLen = sizeof(protocol_binary_request_header) };
+
+    void OnMessage(const evpp::TCPConnPtr& conn, evpp::Buffer* buf) {
+        while (buf->size() >= kHeaderLen) {
+            protocol_binary_request_header req;
+            memcpy(&req, buf->data(), kHeaderLen);
+            const uint32_t bodylen = ntohl(req.request.bodylen);
+            if (buf->size() < kHeaderLen + bodylen) {
+                return;
+            }
+
+            const uint16_t keylen = ntohs(req.request.keylen);
+            const char* body = buf->data() + kHeaderLen;
+            std::string key(body + req.request.extlen, keylen);
+            std::string value(body + req.request.extlen + keylen, bodylen - req.request.extlen - keylen);
+            buf->Skip(kHeaderLen + bodylen);
+
+            OnRequest(conn, req, key, value);
+        }
+    }
+
+    void OnRequest(const evpp::TCPConnPtr& conn, const protocol_binary_request_header& req,
+                   const std::string& key, const std::string& value) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        switch (req.request.opcode) {
+        case PROTOCOL_BINARY_CMD_SET:
+            items_[key] = value;
+            Reply(conn, req, PROTOCOL_BINARY_RESPONSE_SUCCESS, std::string(), std::string());
+            break;
+
+        case PROTOCOL_BINARY_CMD_DELETE:
+            Reply(conn, req, items_.erase(key) ? PROTOCOL_BINARY_RESPONSE_SUCCESS : PROTOCOL_BINARY_RESPONSE_KEY_ENOENT,
+                  std::string(), std::string());
+            break;
+
+        case PROTOCOL_BINARY_CMD_GET:
+        case PROTOCOL_BINARY_CMD_GETK:
+        case PROTOCOL_BINARY_CMD_GETKQ: {
+            auto it = items_.find(key);
+            const bool with_key = req.request.opcode != PROTOCOL_BINARY_CMD_GET;
+            if (it != items_.end()) {
+                Reply(conn, req, PROTOCOL_BINARY_RESPONSE_SUCCESS, with_key ? key : std::string(), it->second);
+            } else if (req.request.opcode != PROTOCOL_BINARY_CMD_GETKQ) {
+                Reply(conn, req, PROTOCOL_BINARY_RESPONSE_KEY_ENOENT, with_key ? key : std::string(), std::string());
+            }
+            break;
+        }
+
+        case PROTOCOL_BINARY_CMD_NOOP:
+            Reply(conn, req, PROTOCOL_BINARY_RESPONSE_SUCCESS, std::string(), std::string());
+            break;
+
+        default:
+            Reply(conn, req, PROTOCOL_BINARY_RESPONSE_UNKNOWN_COMMAND, std::string(), std::string());
+            break;
+        }
+    }
+
+    // Values carry the 4 byte flags extras like memcached does
+    static void Reply(const evpp::TCPConnPtr& conn, const protocol_binary_request_header& req,
+                      uint16_t status, const std::string& key, const std::string& value) {
+        protocol_binary_response_header resp;
+        memset(&resp, 0, sizeof(resp));
+        const uint8_t extlen = value.empty() ? 0 : 4;
+        resp.response.magic = PROTOCOL_BINARY_RES;
+        resp.response.opcode = req.request.opcode;
+        resp.response.keylen = htons(uint16_t(key.size()));
+        resp.response.extlen = extlen;
+        resp.response.datatype = PROTOCOL_BINARY_RAW_BYTES;
+        resp.response.status = htons(status);
+        resp.response.bodylen = htonl(uint32_t(extlen + key.size() + value.size()));
+        resp.response.opaque = req.request.opaque; // echoed back untouched
+
+        evpp::Buffer out;
+        out.Append(&resp, sizeof(resp));
+        if (extlen) {
+            out.AppendInt32(0);
+        }
+        out.Append(key);
+        out.Append(value);
+        conn->Send(&out);
+    }
+
+private:
+    evpp::TCPServer server_;
+    std::mutex mutex_;
+    std::map<std::string, std::string> items_;
+};
+
+}
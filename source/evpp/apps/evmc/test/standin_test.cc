@@ -0,0 +1,76 @@
+#include "../../../test/test_common.h"
+
+#include <evmc/memcache_client_pool.h>
+
+#include <evpp/event_loop_thread.h>
+
+#include "memcached_standin.h"
+
+#include <future>
+
+// Runs MemcacheClientPool against MemcachedStandin, so it needs no memcached
+// daemon and can run as part of ctest.
+
+namespace {
+
+// The callbacks run on the pool's own threads when caller_loop is nullptr
+static int SyncSet(evmc::MemcacheClientPool& pool, const std::string& key, const std::string& value) {
+    std::promise<int> done;
+    pool.Set(nullptr, key, value, [&done](const std::string&, int code) {
+        done.set_value(code);
+    });
+    return done.get_future().get();
+}
+
+static evmc::GetResult SyncGet(evmc::MemcacheClientPool& pool, const std::string& key) {
+    std::promise<evmc::GetResult> done;
+    pool.Get(nullptr, key, [&done](const std::string&, const evmc::GetResult& result) {
+        done.set_value(result);
+    });
+    return done.get_future().get();
+}
+
+static int SyncRemove(evmc::MemcacheClientPool& pool, const std::string& key) {
+    std::promise<int> done;
+    pool.Remove(nullptr, key, [&done](const std::string&, int code) {
+        done.set_value(code);
+    });
+    return done.get_future().get();
+}
+}
+
+TEST_UNIT(testMemcacheClientPoolStandin) {
+    const std::string addr = "127.0.0.1:21211";
+    evpp::EventLoopThread server_thread;
+    server_thread.Start(true);
+    evmc::MemcachedStandin standin(server_thread.loop(), addr);
+    H_TEST_ASSERT(standin.Start());
+
+    evmc::MemcacheClientPool pool(addr.c_str(), 2, 500);
+    H_TEST_ASSERT(pool.Start());
+
+    H_TEST_ASSERT(SyncGet(pool, "missing").code == evmc::NOT_FIND_RET);
+
+    H_TEST_ASSERT(SyncSet(pool, "town:a", "payload-a") == evmc::SUC_RET);
+    evmc::GetResult r = SyncGet(pool, "town:a");
+    H_TEST_ASSERT(r.code == evmc::SUC_RET);
+    H_TEST_ASSERT(r.value == "payload-a");
+
+    // Binary values survive the round trip
+    std::string binary("\0\x01\xff\r\n", 5);
+    binary += std::string(64 * 1024, 'x');
+    H_TEST_ASSERT(SyncSet(pool, "town:b", binary) == evmc::SUC_RET);
+    r = SyncGet(pool, "town:b");
+    H_TEST_ASSERT(r.code == evmc::SUC_RET);
+    H_TEST_ASSERT(r.value == binary);
+
+    H_TEST_ASSERT(SyncRemove(pool, "town:a") == evmc::SUC_RET);
+    H_TEST_ASSERT(SyncGet(pool, "town:a").code == evmc::NOT_FIND_RET);
+    H_TEST_ASSERT(SyncRemove(pool, "town:a") == evmc::NOT_FIND_RET);
+    H_TEST_ASSERT(standin.size() == 1);
+
+    pool.Stop(true);
+    server_thread.loop()->RunInLoop([&standin]() { standin.Stop(); });
+    usleep(100 * 1000);
+    server_thread.Stop(true);
+}
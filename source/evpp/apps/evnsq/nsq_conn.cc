@@ -55,11 +55,7 @@ void NSQConn::Reconnect() {
     LOG_WARN << "NSQConn::Close() this=" << this << " status=" << StatusToString() << " remote_nsq_addr=" << remote_addr();
 
     // Discards all the messages which were cached by the broken tcp connection.
-    if (!wait_ack_.empty()) {
-        LOG_WARN << "Discards " << wait_ack_.size() << " NSQ messages. nsq_message_missing";
-        published_failed_count_ += wait_ack_.size();
-        wait_ack_.clear();
-    }
+    DiscardWaitACKCommands();
 
     tcp_client_->Disconnect();
     Connect(tcp_client_->remote_addr());
@@ -80,6 +76,10 @@ void NSQConn::OnTCPConnectionEvent(const evpp::TCPConnPtr& conn) {
             assert(status_ == kDisconnecting);
         }
     } else {
+        // Nothing will answer the commands sent on the lost connection, and a
+        // new connection must not match its responses against them.
+        DiscardWaitACKCommands();
+
         if (tcp_client_->auto_reconnect()) {
             // tcp_client_ will reconnect to remote NSQD again automatically
             status_ = kConnecting;
@@ -99,7 +99,8 @@ void NSQConn::OnRecv(const evpp::TCPConnPtr& conn, evpp::Buffer* buf) {
     while (buf->size() > 4) {
         size_t size = buf->PeekInt32();
 
-        if (buf->size() < size) {
+        // size doesn't count the 4 bytes of the size field itself
+        if (buf->size() < size + 4) {
             // need to read more data
             return;
         }
@@ -382,6 +383,23 @@ void NSQConn::PushWaitACKCommand(const CommandPtr& cmd) {
     published_count_++;
 }
 
+void NSQConn::DiscardWaitACKCommands() {
+    if (wait_ack_.empty()) {
+        return;
+    }
+
+    LOG_WARN << "Discards " << wait_ack_.size() << " NSQ messages. nsq_message_missing";
+    published_failed_count_ += wait_ack_.size();
+
+    std::list<CommandPtr> discarded;
+    discarded.swap(wait_ack_);
+    if (publish_response_cb_) {
+        for (auto& c : discarded) {
+            publish_response_cb_(c, false);
+        }
+    }
+}
+
 void NSQConn::OnPublishResponse(const char* d, size_t len) {
     CommandPtr cmd = PopWaitACKCommand();
     if (len == 2 && d[0] == 'O' && d[1] == 'K') {
@@ -404,7 +422,10 @@ void NSQConn::OnPublishResponse(const char* d, size_t len) {
 
     cmd->IncRetriedTime();
     LOG_ERROR << "Publish command " << cmd.get() << " failed : [" << std::string(d, len) << "]. Try again.";
-    WritePublishCommand(cmd); // TODO This code will serialize Command more than twice. We need to cache the first serialization result to fix this performance problem
+    // TODO This code will serialize Command more than twice. We need to cache the first serialization result to fix this performance problem
+    if (!WritePublishCommand(cmd)) {
+        publish_response_cb_(cmd, false);
+    }
 }
 
 }
@@ -102,6 +102,7 @@ private:
     void OnPublishResponse(const char* d, size_t len);
     void PushWaitACKCommand(const CommandPtr& cmd);
     CommandPtr PopWaitACKCommand();
+    void DiscardWaitACKCommands();
 private:
     Client* nsq_client_;
     evpp::EventLoop* loop_;
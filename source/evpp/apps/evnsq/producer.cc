@@ -118,6 +118,10 @@ void Producer::OnPublishResponse(NSQConn* conn, const CommandPtr& cmd, bool succ
     } else {
         published_failed_count_ += count;
     }
+
+    if (publish_result_fn_ && cmd.get()) {
+        publish_result_fn_(cmd, successfull);
+    }
 }
 
 NSQConnPtr Producer::GetNextConn() {
@@ -14,6 +14,11 @@ public:
     typedef std::function<void()> ReadyCallback;
     typedef std::function<void(Producer*, size_t)> HighWaterMarkCallback;
 
+    // Called in the loop thread with the final result of a PUB/MPUB: NSQD
+    // accepted it, refused it after the retries, or the connection broke
+    // before NSQD answered. The messages are in cmd->body().
+    typedef std::function<void(const CommandPtr& cmd, bool successfull)> PublishResultCallback;
+
     Producer(evpp::EventLoop* loop, const Option& ops);
     ~Producer();
 
@@ -28,6 +33,9 @@ public:
         ready_fn_ = cb;
     }
     void SetHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t mark);
+    void SetPublishResultCallback(const PublishResultCallback& cb) {
+        publish_result_fn_ = cb;
+    }
 
 public:
     size_t published_count() const {
@@ -61,6 +69,7 @@ private:
     enum { kDefaultHighWaterMark = 1024 };
     bool hwm_triggered_; // The flag of high water mark
     HighWaterMarkCallback high_water_mark_fn_;
+    PublishResultCallback publish_result_fn_;
     size_t high_water_mark_; // The high water mark for message count. default value is kDefaultHighWaterMark
 };
 
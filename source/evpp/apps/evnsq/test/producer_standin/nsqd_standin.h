@@ -0,0 +1,156 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "evpp/buffer.h"
+#include "evpp/event_loop.h"
+#include "evpp/tcp_conn.h"
+#include "evpp/tcp_server.h"
+
+namespace evnsq {
+
+// An in-process nsqd speaking the part of the TCP protocol V2 a Producer
+// uses : the magic, IDENTIFY, PUB, MPUB and NOP. Published messages are kept
+// per topic. Meant for tests, so that they don't need a nsqd daemon.
+class NSQDStandin {
+public:
+    NSQDStandin(evpp::EventLoop* loop, const std::string& listen_addr)
+        : server_(loop, listen_addr, "NSQDStandin", 0), fail_publishes_(0), drop_publishes_(0) {
+        server_.SetMessageCallback(std::bind(&NSQDStandin::OnMessage, this,
+                                             std::placeholders::_1, std::placeholders::_2));
+    }
+
+    bool Start() {
+        return server_.Init() && server_.Start();
+    }
+
+    void Stop() {
+        server_.Stop();
+    }
+
+    std::vector<std::string> messages(const std::string& topic) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return topics_[topic];
+    }
+
+    // The next n PUB/MPUB are answered with E_PUB_FAILED
+    void FailPublishes(int n) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        fail_publishes_ = n;
+    }
+
+    // The connection is closed instead of answering the next n PUB/MPUB
+    void DropPublishes(int n) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        drop_publishes_ = n;
+    }
+
+private:
+    enum FrameType {
+        kFrameTypeResponse = 0,
+        kFrameTypeError = 1,
+    };
+
+    void OnMessage(const evpp::TCPConnPtr& conn, evpp::Buffer* buf) {
+        if (conn->context().IsEmpty()) {
+            if (buf->size() < 4) {
+                return;
+            }
+            buf->Skip(4); // "  V2"
+            conn->set_context(evpp::Any(true));
+        }
+
+        while (buf->size() > 0) {
+            const char* eol = buf->FindEOL();
+            if (!eol) {
+                return;
+            }
+
+            std::string line(buf->data(), eol);
+            std::string name = line.substr(0, line.find(' '));
+            std::string topic = line.size() > name.size() ? line.substr(name.size() + 1) : std::string();
+            const size_t line_len = line.size() + 1;
+
+            if (name == "NOP") {
+                buf->Skip(line_len);
+                continue;
+            }
+
+            // Every other command carries a body : int32 size + data
+            if (buf->size() < line_len + 4) {
+                return;
+            }
+            uint32_t body_len = 0;
+            memcpy(&body_len, buf->data() + line_len, 4);
+            body_len = ntohl(body_len);
+            if (buf->size() < line_len + 4 + body_len) {
+                return;
+            }
+            std::string body(buf->data() + line_len + 4, body_len);
+            buf->Skip(line_len + 4 + body_len);
+
+            if (name == "IDENTIFY") {
+                Reply(conn, kFrameTypeResponse, "{\"max_rdy_count\":2500,\"version\":\"standin\",\"auth_required\":false}");
+            } else if (name == "PUB" || name == "MPUB") {
+                if (!OnPublish(conn, name, topic, body)) {
+                    return;
+                }
+            } else {
+                Reply(conn, kFrameTypeError, "E_INVALID unsupported command " + name);
+            }
+        }
+    }
+
+    // @return false if the connection has been closed
+    bool OnPublish(const evpp::TCPConnPtr& conn, const std::string& name, const std::string& topic, const std::string& body) {
+        std::vector<std::string> msgs;
+        if (name == "PUB") {
+            msgs.push_back(body);
+        } else {
+            evpp::Buffer b;
+            b.Append(body);
+            int32_t count = b.ReadInt32();
+            for (int32_t i = 0; i < count; ++i) {
+                int32_t len = b.ReadInt32();
+                msgs.push_back(b.NextString(len));
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (drop_publishes_ > 0) {
+            --drop_publishes_;
+            conn->Close();
+            return false;
+        }
+
+        if (fail_publishes_ > 0) {
+            --fail_publishes_;
+            Reply(conn, kFrameTypeError, "E_PUB_FAILED standin refused the messages");
+            return true;
+        }
+
+        auto& stored = topics_[topic];
+        stored.insert(stored.end(), msgs.begin(), msgs.end());
+        Reply(conn, kFrameTypeResponse, "OK");
+        return true;
+    }
+
+    void Reply(const evpp::TCPConnPtr& conn, int32_t frame_type, const std::string& data) {
+        evpp::Buffer out;
+        out.AppendInt32(static_cast<int32_t>(sizeof(frame_type) + data.size()));
+        out.AppendInt32(frame_type);
+        out.Append(data);
+        conn->Send(&out);
+    }
+
+private:
+    evpp::TCPServer server_;
+    std::mutex mutex_;
+    std::map<std::string, std::vector<std::string>> topics_;
+    int fail_publishes_;
+    int drop_publishes_;
+};
+}
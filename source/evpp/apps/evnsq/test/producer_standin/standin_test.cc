@@ -0,0 +1,122 @@
+#include "../../../../test/test_common.h"
+
+#include <evnsq/producer.h>
+
+#include <evpp/event_loop_thread.h>
+
+#include "nsqd_standin.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+// Runs a Producer against NSQDStandin, so it needs no nsqd daemon and can run
+// as part of ctest. Checks that every PUB/MPUB reports its final result,
+// also when NSQD refuses it or the connection breaks before NSQD answers.
+
+namespace {
+
+static std::atomic<size_t> g_ok(0);
+static std::atomic<size_t> g_failed(0);
+
+static void OnPublishResult(const evnsq::CommandPtr& cmd, bool successfull) {
+    if (successfull) {
+        g_ok += cmd->body().size();
+    } else {
+        g_failed += cmd->body().size();
+    }
+}
+
+// Waits for the result of everything published so far
+static bool WaitResults(size_t expected) {
+    for (int i = 0; i < 500; ++i) {
+        if (g_ok + g_failed >= expected) {
+            return g_ok + g_failed == expected;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static bool WaitReady(evnsq::Producer& producer) {
+    for (int i = 0; i < 500; ++i) {
+        std::promise<bool> ready;
+        producer.loop()->RunInLoop([&producer, &ready]() {
+            ready.set_value(producer.IsReady());
+        });
+        if (ready.get_future().get()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static bool SyncMultiPublish(evnsq::Producer& producer, const std::string& topic, size_t count) {
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < count; ++i) {
+        messages.push_back("message " + std::to_string(i));
+    }
+
+    std::promise<bool> done;
+    producer.loop()->RunInLoop([&]() {
+        done.set_value(producer.MultiPublish(topic, messages));
+    });
+    return done.get_future().get();
+}
+}
+
+TEST_UNIT(testProducerStandin) {
+    const std::string addr = "127.0.0.1:24150";
+    const std::string topic = "standin_test";
+    evpp::EventLoopThread server_thread;
+    server_thread.Start(true);
+    evnsq::NSQDStandin standin(server_thread.loop(), addr);
+    H_TEST_ASSERT(standin.Start());
+
+    evpp::EventLoopThread client_thread;
+    client_thread.Start(true);
+    evnsq::Option op;
+    evnsq::Producer producer(client_thread.loop(), op);
+    producer.SetPublishResultCallback(&OnPublishResult);
+    client_thread.loop()->RunInLoop([&producer, &addr]() {
+        producer.ConnectToNSQDs(addr);
+    });
+    H_TEST_ASSERT(WaitReady(producer));
+
+    // Accepted : a PUB and a MPUB
+    H_TEST_ASSERT(SyncMultiPublish(producer, topic, 1));
+    H_TEST_ASSERT(SyncMultiPublish(producer, topic, 10));
+    H_TEST_ASSERT(WaitResults(11));
+    H_TEST_ASSERT(g_ok == 11);
+    H_TEST_ASSERT(standin.messages(topic).size() == 11);
+
+    // Refused : nsqd answers with an error frame, the producer reconnects
+    standin.FailPublishes(1);
+    H_TEST_ASSERT(SyncMultiPublish(producer, topic, 5));
+    H_TEST_ASSERT(WaitResults(16));
+    H_TEST_ASSERT(g_failed == 5);
+    H_TEST_ASSERT(WaitReady(producer));
+
+    // Lost : the connection breaks before nsqd answers
+    standin.DropPublishes(1);
+    H_TEST_ASSERT(SyncMultiPublish(producer, topic, 3));
+    H_TEST_ASSERT(WaitResults(19));
+    H_TEST_ASSERT(g_failed == 8);
+
+    // The new connection must work and match responses to new commands only
+    H_TEST_ASSERT(WaitReady(producer));
+    H_TEST_ASSERT(SyncMultiPublish(producer, topic, 4));
+    H_TEST_ASSERT(WaitResults(23));
+    H_TEST_ASSERT(g_ok == 15);
+    H_TEST_ASSERT(standin.messages(topic).size() == 15);
+
+    client_thread.loop()->RunInLoop([&producer]() {
+        producer.Close();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    client_thread.Stop(true);
+    standin.Stop();
+    server_thread.Stop(true);
+}
@@ -8,6 +8,11 @@ for thread in 1 2 4 6 8 12 16 20; do
     ../../build-release/bin/benchmark_post_task6 $thread $count
     ../../build-release/bin/benchmark_post_task_boost_lockfree_queue_queue6 $thread $count
     ../../build-release/bin/benchmark_post_task_concurrentqueue6 $thread $count
+    for mode in function task; do
+        ../../build-release/bin/benchmark_post_task7 $thread $count $mode
+        ../../build-release/bin/benchmark_post_task_boost_lockfree_queue7 $thread $count $mode
+        ../../build-release/bin/benchmark_post_task_concurrentqueue7 $thread $count $mode
+    done
 done
     ../../build-release/bin/benchmark_post_task3 $count
     ../../build-release/bin/benchmark_post_task_boost_lockfree_queue_queue3 $count
@@ -0,0 +1,136 @@
+#include <evpp/event_loop.h>
+#include <evpp/event_loop_thread_pool.h>
+
+#include "examples/winmain-inl.h"
+
+#include <new>
+
+// Like posttask6, but every task carries what an HTTP response hop carries :
+// a request context, a completion callback and the response body. In
+// "function" mode each task is wrapped in an EventLoop::Functor before it is
+// posted, the way callers did before EventLoop took a Task; in "task" mode
+// the lambda is posted as is and stays inline in the queue.
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+uint64_t clock_us() {
+    return std::chrono::steady_clock::now().time_since_epoch().count() / 1000;
+}
+
+class PostTask {
+public:
+    PostTask(int thread_count, uint64_t post_count, bool wrap)
+        : thread_count_(thread_count)
+            , total_post_count_(post_count)
+            , wrap_(wrap)
+            , context_(std::make_shared<std::string>("context"))
+            , pool_(NULL, thread_count) {
+        }
+
+        void Start() {
+            pool_.Start(true);
+            loop_.Start(true);
+            start_allocations_ = g_allocations.load();
+            start_time_ = clock_us();
+            post();
+        }
+
+        void Wait() {
+            while (!loop_.IsStopped() && !pool_.IsStopped()) {
+                usleep(1000);
+            }
+        }
+
+        double use_time() const {
+            return double(stop_time_ - start_time_)/1000000.0;
+        }
+
+        double allocations_per_post() const {
+            return double(stop_allocations_ - start_allocations_) / double(total_post_count_ * pool_.thread_num());
+        }
+
+private:
+    void post() {
+        auto p = [this]() {
+            std::function<void(const std::string&)> done = [this](const std::string& body) {
+                count_ += body.size() > 0 ? 1 : 0;
+                if (count_ == total_post_count_ * pool_.thread_num()) {
+                    Stop();
+                }
+            };
+
+            for (uint64_t i = 0; i < total_post_count_; i++) {
+                // Short enough for the small string buffer, so only the task itself may allocate
+                std::string body("{\"ok\":1}");
+                std::shared_ptr<std::string> ctx = context_;
+                auto task = [ctx, done, body]() {
+                    done(body);
+                };
+
+                if (wrap_) {
+                    loop_.loop()->RunInLoop(evpp::EventLoop::Functor(std::move(task)));
+                } else {
+                    loop_.loop()->RunInLoop(std::move(task));
+                }
+            }
+        };
+
+        for (uint32_t i = 0; i < pool_.thread_num(); i++) {
+            pool_.GetNextLoopWithHash(i)->RunInLoop(p);
+        }
+    }
+
+    void Stop() {
+        stop_time_ = clock_us();
+        stop_allocations_ = g_allocations.load();
+        pool_.Stop();
+        loop_.Stop();
+    }
+private:
+    const int thread_count_;
+    const uint64_t total_post_count_;
+    const bool wrap_;
+    std::shared_ptr<std::string> context_;
+    uint64_t count_ = 0;
+    evpp::EventLoopThread loop_;
+    evpp::EventLoopThreadPool pool_;
+    uint64_t start_time_ = 0;
+    uint64_t stop_time_ = 0;
+    uint64_t start_allocations_ = 0;
+    uint64_t stop_allocations_ = 0;
+};
+
+int main(int argc, char* argv[]) {
+    int thread_count = 2;
+    long long post_count = 10000;
+    std::string mode = "task";
+
+    if (argc == 4) {
+        thread_count = std::atoi(argv[1]);
+        post_count = std::atoll(argv[2]);
+        mode = argv[3];
+    } else {
+        printf("Usage : %s <thread-count> <post-count> <function|task>\n", argv[0]);
+        return 0;
+    }
+
+    PostTask p(thread_count, post_count, mode == "function");
+    p.Start();
+    p.Wait();
+    LOG_WARN << argv[0] << " mode=" << mode << " thread_count=" << thread_count << " post_count=" << post_count << " use time: " << p.use_time() << " seconds"
+             << " allocations per post: " << p.allocations_per_post() << "\n";
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <evpp/buffer.h>
+#include <evpp/chain_buffer.h>
+#include <evpp/libevent.h>
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <sys/socket.h>
+#include <poll.h>
+
+// Pushes the same stream of messages through a TCPConn style output queue,
+// once backed by evpp::Buffer and once by evpp::ChainBuffer, over a
+// socketpair whose other end is drained by a reader thread. The queue only
+// fills up while the socket is busy, like a loaded connection.
+//
+//   small : many pipelined <msg-size> byte responses, copied into the queue
+//   large : <msg-size> byte responses handed over as std::string&&
+//
+// Each queue runs <rounds> times, alternating which one goes first, since the
+// first run of a pair is consistently faster on a loaded or single CPU box.
+// The median throughput is printed with the CPU time of the writing thread.
+
+static uint64_t clock_us() {
+    return std::chrono::steady_clock::now().time_since_epoch().count() / 1000;
+}
+
+struct Reader {
+    explicit Reader(int fd, size_t total) : fd_(fd), total_(total), th_([this]() { Run(); }) {}
+    ~Reader() {
+        th_.join();
+    }
+    void Run() {
+        std::vector<char> buf(256 * 1024);
+        size_t got = 0;
+        while (got < total_) {
+            ssize_t n = ::read(fd_, buf.data(), buf.size());
+            if (n <= 0) {
+                break;
+            }
+            got += n;
+        }
+    }
+    int fd_;
+    size_t total_;
+    std::thread th_;
+};
+
+class BufferQueue {
+public:
+    void Send(std::string&& msg, int fd) {
+        if (buf_.length() == 0) {
+            ssize_t n = ::send(fd, msg.data(), msg.size(), MSG_NOSIGNAL);
+            n = n < 0 ? 0 : n;
+            if (size_t(n) == msg.size()) {
+                return;
+            }
+            buf_.Append(msg.data() + n, msg.size() - n);
+        } else {
+            buf_.Append(msg.data(), msg.size());
+        }
+    }
+    void Flush(int fd) {
+        ssize_t n = ::send(fd, buf_.data(), buf_.length(), MSG_NOSIGNAL);
+        if (n > 0) {
+            buf_.Next(n);
+        }
+    }
+    size_t length() const {
+        return buf_.length();
+    }
+private:
+    evpp::Buffer buf_;
+};
+
+class ChainQueue {
+public:
+    void Send(std::string&& msg, int fd) {
+        if (buf_.length() == 0) {
+            ssize_t n = ::send(fd, msg.data(), msg.size(), MSG_NOSIGNAL);
+            n = n < 0 ? 0 : n;
+            if (size_t(n) == msg.size()) {
+                return;
+            }
+            if (n == 0) {
+                buf_.Append(std::move(msg));
+            } else {
+                buf_.Append(msg.data() + n, msg.size() - n);
+            }
+        } else {
+            buf_.Append(std::move(msg));
+        }
+    }
+    void Flush(int fd) {
+        int serrno = 0;
+        buf_.WriteToFD(fd, &serrno);
+    }
+    size_t length() const {
+        return buf_.length();
+    }
+private:
+    evpp::ChainBuffer buf_;
+};
+
+// What the event loop does : only write when the socket says it is writable
+static bool Writable(int fd, int timeout_ms) {
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLOUT;
+    p.revents = 0;
+    return ::poll(&p, 1, timeout_ms) == 1;
+}
+
+static double thread_cpu_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+struct Result {
+    double mbps;
+    double cpu_ms;
+};
+
+template<typename Queue>
+static Result Run(size_t msg_size, size_t count) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return Result{0, 0};
+    }
+    evutil_make_socket_nonblocking(fds[0]);
+
+    std::string payload(msg_size, 'x');
+    uint64_t begin = clock_us();
+    double cpu_begin = thread_cpu_ms();
+    {
+        Reader reader(fds[1], msg_size * count);
+        Queue queue;
+        for (size_t i = 0; i < count; ++i) {
+            std::string msg(payload);
+            queue.Send(std::move(msg), fds[0]);
+            // A loop gets to write every so often, not after every message
+            if (i % 16 == 15 && queue.length() > 0 && Writable(fds[0], 0)) {
+                queue.Flush(fds[0]);
+            }
+        }
+        while (queue.length() > 0) {
+            if (Writable(fds[0], -1)) {
+                queue.Flush(fds[0]);
+            }
+        }
+    }
+    uint64_t cost = clock_us() - begin;
+    double cpu = thread_cpu_ms() - cpu_begin;
+
+    close(fds[0]);
+    close(fds[1]);
+    return Result{double(msg_size * count) / 1024 / 1024 / (double(cost) / 1000000), cpu};
+}
+
+static Result Median(std::vector<Result> results) {
+    std::sort(results.begin(), results.end(), [](const Result& a, const Result& b) { return a.mbps < b.mbps; });
+    return results[results.size() / 2];
+}
+
+static void Compare(const char* name, size_t msg_size, size_t count, int rounds) {
+    std::vector<Result> buffer, chain;
+    for (int i = 0; i < rounds; ++i) {
+        if (i % 2 == 0) {
+            buffer.push_back(Run<BufferQueue>(msg_size, count));
+            chain.push_back(Run<ChainQueue>(msg_size, count));
+        } else {
+            chain.push_back(Run<ChainQueue>(msg_size, count));
+            buffer.push_back(Run<BufferQueue>(msg_size, count));
+        }
+    }
+
+    Result b = Median(buffer);
+    Result c = Median(chain);
+    printf("%s %zu bytes : Buffer %.1f MB/s (writer cpu %.0f ms), ChainBuffer %.1f MB/s (writer cpu %.0f ms)\n",
+           name, msg_size, b.mbps, b.cpu_ms, c.mbps, c.cpu_ms);
+}
+
+int main(int argc, char* argv[]) {
+    size_t small_size = 64;
+    size_t large_size = 256 * 1024;
+    size_t total_mb = 512;
+    int rounds = 5;
+
+    if (argc == 4 || argc == 5) {
+        small_size = std::atoi(argv[1]);
+        large_size = std::atoi(argv[2]);
+        total_mb = std::atoi(argv[3]);
+        if (argc == 5) {
+            rounds = std::max(1, std::atoi(argv[4]));
+        }
+    } else {
+        printf("Usage : %s <small-size> <large-size> <total-MB> [rounds]\n", argv[0]);
+        return 0;
+    }
+
+    size_t total = total_mb * 1024 * 1024;
+    Compare("small", small_size, total / small_size, rounds);
+    Compare("large", large_size, total / large_size, rounds);
+    return 0;
+}
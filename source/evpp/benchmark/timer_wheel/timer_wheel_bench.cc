@@ -0,0 +1,114 @@
+#include <evpp/event_loop.h>
+#include <evpp/timer_wheel.h>
+
+#include "examples/winmain-inl.h"
+
+// Schedules <timer-count> timers, cancels every other one and lets the rest
+// expire, once with EventLoop::RunAfter (one libevent timer each) and once
+// with the loop's TimerWheel. Mimics idle timeouts : lots of timers, most of
+// them cancelled or pushed back before they fire.
+
+uint64_t clock_us() {
+    return std::chrono::steady_clock::now().time_since_epoch().count() / 1000;
+}
+
+struct Result {
+    uint64_t add_us;
+    uint64_t cancel_us;
+    uint64_t expire_us; // first to last expiry
+    uint64_t fired;
+};
+
+static void Print(const char* name, int count, const Result& r) {
+    LOG_WARN << name << " timer_count=" << count
+             << " add=" << r.add_us << "us (" << double(r.add_us) * 1000 / count << " ns/timer)"
+             << " cancel=" << r.cancel_us << "us (" << double(r.cancel_us) * 2000 / count << " ns/timer)"
+             << " expire=" << r.expire_us << "us fired=" << r.fired;
+}
+
+static Result RunInvokeTimer(int count, evpp::Duration delay) {
+    evpp::EventLoop loop;
+    Result r = {};
+    uint64_t first = 0;
+    uint64_t last = 0;
+    std::vector<evpp::InvokeTimerPtr> timers;
+    timers.reserve(count);
+
+    loop.RunInLoop([&]() {
+        uint64_t begin = clock_us();
+        for (int i = 0; i < count; ++i) {
+            timers.push_back(loop.RunAfter(delay, [&]() {
+                last = clock_us();
+                if (r.fired++ == 0) {
+                    first = last;
+                }
+                if (r.fired == uint64_t(count / 2)) {
+                    loop.Stop();
+                }
+            }));
+        }
+        r.add_us = clock_us() - begin;
+
+        begin = clock_us();
+        for (int i = 0; i < count; i += 2) {
+            timers[i]->Cancel();
+        }
+        r.cancel_us = clock_us() - begin;
+    });
+    loop.Run();
+    r.expire_us = last - first;
+    return r;
+}
+
+static Result RunTimerWheel(int count, evpp::Duration delay) {
+    evpp::EventLoop loop;
+    Result r = {};
+    uint64_t first = 0;
+    uint64_t last = 0;
+    std::vector<evpp::TimerWheel::TimerId> timers;
+    timers.reserve(count);
+
+    loop.RunInLoop([&]() {
+        evpp::TimerWheel* wheel = loop.timer_wheel();
+        uint64_t begin = clock_us();
+        for (int i = 0; i < count; ++i) {
+            timers.push_back(wheel->Add(delay, [&]() {
+                last = clock_us();
+                if (r.fired++ == 0) {
+                    first = last;
+                }
+                if (r.fired == uint64_t(count / 2)) {
+                    loop.Stop();
+                }
+            }));
+        }
+        r.add_us = clock_us() - begin;
+
+        begin = clock_us();
+        for (int i = 0; i < count; i += 2) {
+            wheel->Cancel(timers[i]);
+        }
+        r.cancel_us = clock_us() - begin;
+    });
+    loop.Run();
+    r.expire_us = last - first;
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    int timer_count = 100000;
+    double delay_ms = 500;
+
+    if (argc == 3) {
+        timer_count = std::atoi(argv[1]);
+        delay_ms = std::atof(argv[2]);
+    } else {
+        printf("Usage : %s <timer-count> <delay-ms>\n", argv[0]);
+        return 0;
+    }
+
+    evpp::Duration delay(delay_ms / 1000.0);
+    Print("InvokeTimer", timer_count, RunInvokeTimer(timer_count, delay));
+    Print("TimerWheel", timer_count, RunTimerWheel(timer_count, delay));
+    return 0;
+}
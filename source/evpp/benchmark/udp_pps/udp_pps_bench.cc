@@ -0,0 +1,170 @@
+#include <evpp/udp/udp_server.h>
+
+#include <atomic>
+#include <thread>
+
+// Datagrams per second one evpp::udp::Server receive thread takes in, with
+// one recvfrom per datagram (batch_size=1) and with recvmmsg batches.
+// Two sender threads flood 127.0.0.1 with small datagrams through sendmmsg,
+// the way a fleet of clients sends telemetry and heartbeats. The kernel
+// drops what the server can't keep up with, so only received datagrams
+// are counted, together with the receive thread's CPU time per datagram,
+// which is the number to look at when the senders share the same cores.
+// With "echo" every datagram is also sent back, one sendto
+// each in the per-message mode and one sendmmsg per batch otherwise.
+//
+// Usage : benchmark_udp_pps [seconds] [echo|drop] [batch_timeout_us] [batch_size...]
+// Linux only.
+
+static const int kSenderThreads = 2;
+
+static uint64_t clock_us() {
+    return std::chrono::steady_clock::now().time_since_epoch().count() / 1000;
+}
+
+static void Flood(int port, size_t msg_size, const std::atomic<bool>& stop, std::atomic<uint64_t>* sent) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(uint16_t(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const int kBatch = 64;
+    std::string payload(msg_size, 'x');
+    struct mmsghdr hdrs[kBatch];
+    struct iovec iov;
+    iov.iov_base = &payload[0];
+    iov.iov_len = payload.size();
+    memset(hdrs, 0, sizeof hdrs);
+    for (int i = 0; i < kBatch; ++i) {
+        hdrs[i].msg_hdr.msg_name = &addr;
+        hdrs[i].msg_hdr.msg_namelen = sizeof addr;
+        hdrs[i].msg_hdr.msg_iov = &iov;
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        int n = ::sendmmsg(fd, hdrs, kBatch, 0);
+        if (n > 0) {
+            sent->fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+    ::close(fd);
+}
+
+// CPU time of the calling thread
+static uint64_t thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Called by the handler on the receive thread, samples its CPU time once
+// every 1024 datagrams so that the measurement stays cheap
+struct CpuMeter {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> cpu_ns;
+    uint64_t next_sample;
+
+    CpuMeter() : count(0), calls(0), cpu_ns(0), next_sample(0) {}
+
+    void Add(size_t n) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        uint64_t c = count.load(std::memory_order_relaxed) + n;
+        if (c >= next_sample) {
+            cpu_ns.store(thread_cpu_ns(), std::memory_order_relaxed);
+            next_sample = c + 1024;
+        }
+        count.store(c, std::memory_order_release);
+    }
+};
+
+static void Run(int port, size_t batch_size, int timeout_us, bool echo, int seconds) {
+    CpuMeter received;
+    evpp::udp::Server server;
+    if (batch_size > 1) {
+        server.set_batch_size(batch_size);
+        server.set_batch_timeout(evpp::Duration(timeout_us * evpp::Duration::kMicrosecond));
+        server.SetBatchMessageHandler([&](evpp::EventLoop*, evpp::udp::MessageBatch& msgs) {
+            received.Add(msgs.size());
+            if (echo) {
+                evpp::udp::SendMessages(msgs);
+            }
+        });
+    } else {
+        server.SetMessageHandler([&](evpp::EventLoop*, evpp::udp::MessagePtr& msg) {
+            received.Add(1);
+            if (echo) {
+                evpp::udp::SendMessage(msg);
+            }
+        });
+    }
+
+    if (!server.Init(port) || !server.Start()) {
+        LOG_ERROR << "cannot start the udp server at port " << port;
+        return;
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> sent(0);
+    std::vector<std::thread> senders;
+    for (int i = 0; i < kSenderThreads; ++i) {
+        senders.emplace_back(std::bind(&Flood, port, size_t(64), std::cref(stop), &sent));
+    }
+
+    // Let the socket buffer fill up before measuring
+    usleep(200 * 1000);
+    uint64_t begin_count = received.count.load(std::memory_order_acquire);
+    uint64_t begin_cpu = received.cpu_ns.load();
+    uint64_t begin_calls = received.calls.load();
+    uint64_t begin_sent = sent.load();
+    uint64_t begin = clock_us();
+    usleep(seconds * 1000 * 1000);
+    uint64_t count = received.count.load(std::memory_order_acquire) - begin_count;
+    uint64_t cpu = received.cpu_ns.load() - begin_cpu;
+    uint64_t calls = received.calls.load() - begin_calls;
+    uint64_t sent_count = sent.load() - begin_sent;
+    uint64_t elapsed = clock_us() - begin;
+
+    stop = true;
+    for (auto& t : senders) {
+        t.join();
+    }
+    server.Stop(true);
+
+    LOG_WARN << "batch_size=" << batch_size << " batch_timeout=" << timeout_us << "us echo=" << echo
+             << " sent=" << sent_count << " received=" << count
+             << " pps=" << uint64_t(double(count) * 1000000 / elapsed)
+             << " cpu=" << (count ? cpu / count : 0) << "ns/datagram"
+             << " datagrams/handler_call=" << (calls ? double(count) / calls : 0);
+}
+
+int main(int argc, char* argv[]) {
+    int seconds = 3;
+    bool echo = false;
+    int timeout_us = 0;
+    std::vector<size_t> sizes;
+    if (argc > 1) {
+        seconds = std::atoi(argv[1]);
+    }
+    if (argc > 2) {
+        echo = std::string(argv[2]) == "echo";
+    }
+    if (argc > 3) {
+        timeout_us = std::atoi(argv[3]);
+    }
+    for (int i = 4; i < argc; ++i) {
+        sizes.push_back(size_t(std::atoi(argv[i])));
+    }
+    if (sizes.empty()) {
+        sizes = {1, 8, 32, 64};
+    }
+
+    int port = 29099;
+    for (size_t s : sizes) {
+        Run(port++, s, timeout_us, echo, seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include "evpp/inner_pre.h"
+
+#include "evpp/chain_buffer.h"
+
+namespace evpp {
+
+namespace {
+// Blocks a thread keeps for reuse, 512KB with 16KB blocks
+const uint32_t kPoolLimit = 32;
+
+struct BlockPool {
+    char* head;         // the first bytes of a free block point to the next one
+    uint32_t count;
+};
+
+// Plain data so it also works with __declspec(thread)
+thread_local BlockPool tls_block_pool;
+
+const int kReadBlocks = 4;
+}
+
+char* ChainBuffer::AllocateBlock() {
+    BlockPool& pool = tls_block_pool;
+    if (pool.head == nullptr) {
+        return new char[kBlockSize];
+    }
+
+    char* block = pool.head;
+    memcpy(&pool.head, block, sizeof(char*));
+    --pool.count;
+    return block;
+}
+
+void ChainBuffer::FreeBlock(char* block) {
+    BlockPool& pool = tls_block_pool;
+    if (pool.count >= kPoolLimit) {
+        delete[] block;
+        return;
+    }
+
+    memcpy(block, &pool.head, sizeof(char*));
+    pool.head = block;
+    ++pool.count;
+}
+
+ChainBuffer::~ChainBuffer() {
+    Reset();
+}
+
+size_t ChainBuffer::TailRoom() const {
+    if (segments_.empty()) {
+        return 0;
+    }
+
+    const Segment& tail = segments_.back();
+    if (tail.block == nullptr) {
+        return 0;
+    }
+
+    return kBlockSize - (tail.data + tail.size - tail.block);
+}
+
+void ChainBuffer::Append(const void* d, size_t len) {
+    if (segments_.empty() && len < kMinRefSize) {
+        head_.Append(d, len);
+        length_ += len;
+        return;
+    }
+
+    const char* p = static_cast<const char*>(d);
+    while (len > 0) {
+        size_t room = TailRoom();
+        if (room == 0) {
+            char* block = AllocateBlock();
+            Segment s;
+            s.data = block;
+            s.size = 0;
+            s.block = block;
+            segments_.push_back(std::move(s));
+            room = kBlockSize;
+        }
+
+        Segment& tail = segments_.back();
+        size_t n = std::min(room, len);
+        memcpy(const_cast<char*>(tail.data) + tail.size, p, n);
+        tail.size += n;
+        length_ += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::AppendRef(const Slice& s, const std::shared_ptr<void>& owner) {
+    if (s.size() == 0) {
+        return;
+    }
+
+    Segment seg;
+    seg.data = s.data();
+    seg.size = s.size();
+    seg.block = nullptr;
+    seg.owner = owner;
+    segments_.push_back(std::move(seg));
+    length_ += s.size();
+}
+
+void ChainBuffer::Append(std::string&& s) {
+    if (s.size() < kMinRefSize) {
+        Append(s.data(), s.size());
+        return;
+    }
+
+    std::shared_ptr<std::string> owner = std::make_shared<std::string>(std::move(s));
+    AppendRef(Slice(owner->data(), owner->size()), owner);
+}
+
+void ChainBuffer::PopFront() {
+    Segment& front = segments_.front();
+    length_ -= front.size;
+    if (front.block) {
+        FreeBlock(front.block);
+    }
+    segments_.pop_front();
+}
+
+void ChainBuffer::Skip(size_t len) {
+    if (head_.length() > 0) {
+        size_t n = std::min(len, head_.length());
+        head_.Next(n);
+        length_ -= n;
+        len -= n;
+    }
+
+    while (len > 0 && !segments_.empty()) {
+        Segment& front = segments_.front();
+        if (len < front.size) {
+            front.data += len;
+            front.size -= len;
+            length_ -= len;
+            return;
+        }
+
+        len -= front.size;
+        PopFront();
+    }
+}
+
+void ChainBuffer::Reset() {
+    length_ -= head_.length();
+    head_.Reset();
+    while (!segments_.empty()) {
+        PopFront();
+    }
+    assert(length_ == 0);
+}
+
+int ChainBuffer::PeekIovec(struct iovec* vec, int max) const {
+    int n = 0;
+    if (head_.length() > 0 && max > 0) {
+        vec[n].iov_base = const_cast<char*>(head_.data());
+        vec[n].iov_len = head_.length();
+        ++n;
+    }
+    for (auto it = segments_.begin(); it != segments_.end() && n < max; ++it) {
+        if (it->size == 0) {
+            continue;
+        }
+        vec[n].iov_base = const_cast<char*>(it->data);
+        vec[n].iov_len = it->size;
+        ++n;
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::WriteToFD(evpp_socket_t fd, int* saved_errno) {
+    if (segments_.empty()) {
+        if (head_.length() == 0) {
+            return 0;
+        }
+
+        ssize_t n = ::send(fd, head_.data(), head_.length(), MSG_NOSIGNAL);
+        if (n < 0) {
+            *saved_errno = errno;
+        } else {
+            Skip(static_cast<size_t>(n));
+        }
+        return n;
+    }
+
+    struct iovec vec[kMaxIovec];
+    int count = PeekIovec(vec, kMaxIovec);
+    if (count == 0) {
+        return 0;
+    }
+
+#ifdef H_OS_WINDOWS
+    ssize_t n = ::writev(fd, vec, count);
+#else
+    // sendmsg rather than writev for MSG_NOSIGNAL, like the plain send() path
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = count;
+    ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+#endif
+
+    if (n < 0) {
+        *saved_errno = errno;
+    } else {
+        Skip(static_cast<size_t>(n));
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::ReadFromFD(evpp_socket_t fd, int* saved_errno) {
+    struct iovec vec[kReadBlocks + 1];
+    char* blocks[kReadBlocks];
+    int count = 0;
+
+    size_t room = TailRoom();
+    if (room > 0) {
+        const Segment& tail = segments_.back();
+        vec[count].iov_base = const_cast<char*>(tail.data) + tail.size;
+        vec[count].iov_len = room;
+        ++count;
+    }
+
+    for (int i = 0; i < kReadBlocks; ++i) {
+        blocks[i] = AllocateBlock();
+        vec[count].iov_base = blocks[i];
+        vec[count].iov_len = kBlockSize;
+        ++count;
+    }
+
+    ssize_t n = ::readv(fd, vec, count);
+    if (n < 0) {
+        *saved_errno = errno;
+    }
+
+    size_t left = n > 0 ? static_cast<size_t>(n) : 0;
+    length_ += left;
+    if (room > 0) {
+        size_t used = std::min(room, left);
+        segments_.back().size += used;
+        left -= used;
+    }
+
+    for (int i = 0; i < kReadBlocks; ++i) {
+        if (left == 0) {
+            FreeBlock(blocks[i]);
+            continue;
+        }
+
+        Segment s;
+        s.data = blocks[i];
+        s.size = std::min(left, size_t(kBlockSize));
+        s.block = blocks[i];
+        left -= s.size;
+        segments_.push_back(std::move(s));
+    }
+
+    return n;
+}
+
+std::string ChainBuffer::ToString() const {
+    std::string result;
+    result.reserve(length_);
+    result.append(head_.data(), head_.length());
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        result.append(it->data, it->size);
+    }
+    return result;
+}
+}
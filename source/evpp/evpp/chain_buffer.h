@@ -0,0 +1,118 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include "evpp/inner_pre.h"
+#include "evpp/buffer.h"
+#include "evpp/slice.h"
+#include "evpp/sockets.h"
+
+namespace evpp {
+
+// A byte queue made of a chain of segments instead of one contiguous array.
+// A segment is either a fixed size block taken from a per-thread pool, or a
+// slice of memory owned by somebody else (a response body the caller gave
+// away) that is kept alive until it has been consumed.
+//
+// Appending never moves bytes that are already queued, and the whole chain
+// goes to the kernel in one writev/WSASend call. TCPConn uses it for its
+// output queue, where Buffer had to grow and memmove under large responses
+// or many small pipelined ones.
+//
+// Copies smaller than kMinRefSize made while no segment is queued go to a
+// contiguous head Buffer instead, written with a plain send() as the old
+// Buffer output queue did, so small pipelined messages keep that path.
+//
+// Not thread safe.
+class EVPP_EXPORT ChainBuffer {
+public:
+    enum {
+        kBlockSize = 16 * 1024,
+        // Strings at least this large are queued by reference, not copied
+        kMinRefSize = 4 * 1024,
+        // iovecs handed to the kernel per writev call
+        kMaxIovec = 64,
+    };
+
+    ChainBuffer() : length_(0) {}
+    ~ChainBuffer();
+
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+    // Copies the data into the head when it is small and no segment is
+    // queued, into pooled blocks otherwise, filling up the last block first
+    void Append(const void* d, size_t len);
+    void Append(const Slice& s) {
+        Append(s.data(), s.size());
+    }
+
+    // Queues s without copying. owner keeps the memory alive and is released
+    // once every byte of s has been consumed.
+    void AppendRef(const Slice& s, const std::shared_ptr<void>& owner);
+
+    // Takes the string over, by reference when it is large, by copy otherwise
+    void Append(std::string&& s);
+
+    // Consumes len bytes from the front, giving drained blocks back to the pool
+    void Skip(size_t len);
+    void Reset();
+
+    // Fills vec with the readable segments, at most max of them.
+    // @return the number of iovecs filled
+    int PeekIovec(struct iovec* vec, int max) const;
+
+    // Writes as much as possible with a single writev.
+    // @return the result of writev/WSASend, errno is saved into saved_errno
+    ssize_t WriteToFD(evpp_socket_t fd, int* saved_errno);
+
+    // Reads with readv into the free room of the last block and fresh pooled
+    // blocks, up to 4 * kBlockSize bytes per call.
+    // @return the result of readv, errno is saved into saved_errno
+    ssize_t ReadFromFD(evpp_socket_t fd, int* saved_errno);
+
+    // Copies everything out, mostly for tests and debugging
+    std::string ToString() const;
+
+    size_t length() const {
+        return length_;
+    }
+    size_t size() const {
+        return length_;
+    }
+    bool empty() const {
+        return length_ == 0;
+    }
+
+    // Segments currently queued, not counting the head
+    size_t segment_count() const {
+        return segments_.size();
+    }
+
+    // Bytes queued in the contiguous head
+    size_t head_length() const {
+        return head_.length();
+    }
+
+private:
+    struct Segment {
+        const char* data;               // first unread byte
+        size_t size;                    // unread bytes
+        char* block;                    // the pooled block, nullptr for a slice
+        std::shared_ptr<void> owner;    // keeps a slice alive
+    };
+
+    // Free room at the end of the last segment, if it is a block
+    size_t TailRoom() const;
+    void PopFront();
+
+    static char* AllocateBlock();
+    static void FreeBlock(char* block);
+
+private:
+    Buffer head_;                       // comes before every segment
+    std::deque<Segment> segments_;
+    size_t length_;
+};
+}
@@ -4,6 +4,7 @@
 #include "evpp/event_watcher.h"
 #include "evpp/event_loop.h"
 #include "evpp/invoke_timer.h"
+#include "evpp/timer_wheel.h"
 
 namespace evpp {
 EventLoop::EventLoop()
@@ -41,6 +42,7 @@ EventLoop::EventLoop(struct event_base* base)
 
 EventLoop::~EventLoop() {
     DLOG_TRACE;
+    timer_wheel_.reset();
     watcher_.reset();
 
     if (evbase_ != nullptr && create_evbase_myself_) {
@@ -57,11 +59,11 @@ void EventLoop::Init() {
     status_.store(kInitializing);
 #ifdef H_HAVE_BOOST
     const size_t kPendingFunctorCount = 1024 * 16;
-    this->pending_functors_ = new boost::lockfree::queue<Functor*>(kPendingFunctorCount);
+    this->pending_functors_ = new boost::lockfree::queue<Task*>(kPendingFunctorCount);
 #elif defined(H_HAVE_CAMERON314_CONCURRENTQUEUE)
-    this->pending_functors_ = new moodycamel::ConcurrentQueue<Functor>();
+    this->pending_functors_ = new moodycamel::ConcurrentQueue<Task>();
 #else
-    this->pending_functors_ = new std::vector<Functor>();
+    this->pending_functors_ = new std::vector<Task>();
 #endif
 
     tid_ = std::this_thread::get_id(); // The default thread id
@@ -104,6 +106,7 @@ void EventLoop::Run() {
     }
 
     // Make sure watcher_ does construct, initialize and destruct in the same thread.
+    timer_wheel_.reset();
     watcher_.reset();
     DLOG_TRACE << "EventLoop stopped, tid=" << std::this_thread::get_id();
 
@@ -207,37 +210,36 @@ evpp::InvokeTimerPtr EventLoop::RunEvery(Duration interval, Functor&& f) {
     return t;
 }
 
-void EventLoop::RunInLoop(const Functor& functor) {
-    DLOG_TRACE;
-    if (IsRunning() && IsInLoopThread()) {
-        functor();
-    } else {
-        QueueInLoop(functor);
+TimerWheel* EventLoop::timer_wheel() {
+    assert(IsInLoopThread());
+    if (!timer_wheel_) {
+        timer_wheel_.reset(new TimerWheel(this));
     }
+    return timer_wheel_.get();
 }
 
-void EventLoop::RunInLoop(Functor&& functor) {
+void EventLoop::RunInLoop(Task&& task) {
     DLOG_TRACE;
     if (IsRunning() && IsInLoopThread()) {
-        functor();
+        task();
     } else {
-        QueueInLoop(std::move(functor));
+        QueueInLoop(std::move(task));
     }
 }
 
-void EventLoop::QueueInLoop(const Functor& cb) {
+void EventLoop::QueueInLoop(Task&& task) {
     DLOG_TRACE << "pending_functor_count_=" << pending_functor_count_ << " PendingQueueSize=" << GetPendingQueueSize() << " notified_=" << notified_.load();
     {
 #ifdef H_HAVE_BOOST
-        auto f = new Functor(cb);
-        while (!pending_functors_->push(f)) {
+        Task* t = new (TaskPool::Allocate(sizeof(Task))) Task(std::move(task));
+        while (!pending_functors_->push(t)) {
         }
 #elif defined(H_HAVE_CAMERON314_CONCURRENTQUEUE)
-        while (!pending_functors_->enqueue(cb)) {
+        while (!pending_functors_->enqueue(std::move(task))) {
         }
 #else
         std::lock_guard<std::mutex> lock(mutex_);
-        pending_functors_->emplace_back(cb);
+        pending_functors_->emplace_back(std::move(task));
 #endif
     }
     ++pending_functor_count_;
@@ -257,37 +259,6 @@ void EventLoop::QueueInLoop(const Functor& cb) {
         // thread is invoking EventLoop::Stop() to stop this loop. At this moment
         // this loop maybe is stopping and the watcher_ object maybe has been
         // released already.
-        if (watcher_) {
-            watcher_->Notify();
-        } else {
-            DLOG_TRACE << "status=" << StatusToString();
-            assert(!IsRunning());
-        }
-    } else {
-         DLOG_TRACE << "No need to call watcher_->Nofity()";
-    }
-}
-
-void EventLoop::QueueInLoop(Functor&& cb) {
-    DLOG_TRACE << "pending_functor_count_=" << pending_functor_count_ << " PendingQueueSize=" << GetPendingQueueSize() << " notified_=" << notified_.load();
-    {
-#ifdef H_HAVE_BOOST
-        auto f = new Functor(std::move(cb)); // TODO Add test code for it
-        while (!pending_functors_->push(f)) {
-        }
-#elif defined(H_HAVE_CAMERON314_CONCURRENTQUEUE)
-        while (!pending_functors_->enqueue(std::move(cb))) {
-        }
-#else
-        std::lock_guard<std::mutex> lock(mutex_);
-        pending_functors_->emplace_back(std::move(cb));
-#endif
-    }
-    ++pending_functor_count_;
-    DLOG_TRACE << "queued a new Functor. pending_functor_count_=" << pending_functor_count_ << " PendingQueueSize=" << GetPendingQueueSize() << " notified_=" << notified_.load();
-    if (!notified_.load()) {
-        DLOG_TRACE << "call watcher_->Nofity() notified_.store(true)";
-        notified_.store(true);
         if (watcher_) {
             watcher_->Notify();
         } else {
@@ -304,21 +275,22 @@ void EventLoop::DoPendingFunctors() {
 
 #ifdef H_HAVE_BOOST
     notified_.store(false);
-    Functor* f = nullptr;
-    while (pending_functors_->pop(f)) {
-        (*f)();
-        delete f;
+    Task* t = nullptr;
+    while (pending_functors_->pop(t)) {
+        (*t)();
+        t->~Task();
+        TaskPool::Free(t, sizeof(Task));
         --pending_functor_count_;
     }
 #elif defined(H_HAVE_CAMERON314_CONCURRENTQUEUE)
     notified_.store(false);
-    Functor f;
+    Task f;
     while (pending_functors_->try_dequeue(f)) {
         f();
         --pending_functor_count_;
     }
 #else
-    std::vector<Functor> functors;
+    std::vector<Task> functors;
     {
         std::lock_guard<std::mutex> lock(mutex_);
         notified_.store(false);
@@ -10,6 +10,7 @@
 #include "evpp/duration.h"
 #include "evpp/any.h"
 #include "evpp/invoke_timer.h"
+#include "evpp/task.h"
 #include "evpp/server_status.h"
 
 #ifdef H_HAVE_BOOST
@@ -28,6 +29,7 @@
 #endif
 
 namespace evpp {
+class TimerWheel;
 
 // This is the IO Event driving kernel. Reactor model.
 // This class is a wrapper of event_base but not only a wrapper.
@@ -61,8 +63,10 @@ public:
     // RunEvery executes Functor f every period interval time.
     InvokeTimerPtr RunEvery(Duration interval, const Functor& f);
 
-    void RunInLoop(const Functor& handler);
-    void QueueInLoop(const Functor& handler);
+    // Any void() callable converts to a Task. Captures up to
+    // Task::kInlineSize bytes are queued without a heap allocation.
+    void RunInLoop(Task&& task);
+    void QueueInLoop(Task&& task);
 
 public:
 
@@ -72,8 +76,10 @@ public:
     // RunEvery executes Functor f every period interval time.
     InvokeTimerPtr RunEvery(Duration interval, Functor&& f);
 
-    void RunInLoop(Functor&& handler);
-    void QueueInLoop(Functor&& handler);
+    // The loop's timer wheel, created on first use. Prefer it over RunAfter
+    // for large numbers of coarse timers such as idle timeouts.
+    // @note It must be called in the IO Event thread
+    TimerWheel* timer_wheel();
 
     // Getter and Setter
 public:
@@ -124,13 +130,15 @@ private:
     // we need to notify the thread to execute it. But we don't want to notify repeatedly.
     std::atomic<bool> notified_;
 #ifdef H_HAVE_BOOST
-    boost::lockfree::queue<Functor*>* pending_functors_;
+    boost::lockfree::queue<Task*>* pending_functors_; // Tasks live in TaskPool blocks
 #elif defined(H_HAVE_CAMERON314_CONCURRENTQUEUE)
-    moodycamel::ConcurrentQueue<Functor>* pending_functors_;
+    moodycamel::ConcurrentQueue<Task>* pending_functors_;
 #else
-    std::vector<Functor>* pending_functors_; // @Guarded By mutex_
+    std::vector<Task>* pending_functors_; // @Guarded By mutex_
 #endif
 
     std::atomic<int> pending_functor_count_;
+
+    std::unique_ptr<TimerWheel> timer_wheel_;
 };
 }
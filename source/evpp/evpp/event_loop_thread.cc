@@ -12,7 +12,7 @@ EventLoopThread::EventLoopThread()
 
 EventLoopThread::~EventLoopThread() {
     DLOG_TRACE << "loop=" << event_loop_;
-    assert(IsStopped());
+    assert(IsStopped() || !IsStarted());
     Join();
 }
 
@@ -6,26 +6,19 @@
 namespace evpp {
 namespace http {
 Context::Context(struct evhttp_request* r)
-    : req_(r) {
+    : receive_time_(Timestamp::Now()), req_(r) {
 }
 
 Context::~Context() {
 }
 
 bool Context::Init() {
-    if (req_->type == EVHTTP_REQ_POST) {
-#if LIBEVENT_VERSION_NUMBER >= 0x02001500
-        struct evbuffer* evbuf = evhttp_request_get_input_buffer(req_);
-        size_t buffer_size = evbuffer_get_length(evbuf);
-        if (buffer_size > 0) {
-            this->body_ = Slice((char*)evbuffer_pullup(evbuf, -1), buffer_size);
-        }
-#else
-        if (req_->input_buffer->off > 0) {
-            this->body_ = Slice((char*)req_->input_buffer->buffer, req_->input_buffer->off);
-        }
-#endif
+#if LIBEVENT_VERSION_NUMBER < 0x02001500
+    if (req_->type == EVHTTP_REQ_POST && req_->input_buffer->off > 0) {
+        this->body_ = Slice((char*)req_->input_buffer->buffer, req_->input_buffer->off);
     }
+    body_pulled_up_ = true;
+#endif
 
 #if LIBEVENT_VERSION_NUMBER >= 0x02001500
     uri_ = evhttp_uri_get_path(req_->uri_elems);
@@ -47,10 +40,83 @@ bool Context::Init() {
     return true;
 }
 
+const Slice& Context::body() const {
+#if LIBEVENT_VERSION_NUMBER >= 0x02001500
+    // Linearize lazily so handlers reading body_segments() never pay for it
+    if (!body_pulled_up_) {
+        body_pulled_up_ = true;
+        size_t buffer_size = body_size();
+        if (buffer_size > 0) {
+            struct evbuffer* evbuf = evhttp_request_get_input_buffer(req_);
+            body_ = Slice((char*)evbuffer_pullup(evbuf, -1), buffer_size);
+        }
+    }
+#endif
+    return body_;
+}
+
+size_t Context::body_size() const {
+#if LIBEVENT_VERSION_NUMBER >= 0x02001500
+    if (req_->type != EVHTTP_REQ_POST) {
+        return 0;
+    }
+    return evbuffer_get_length(evhttp_request_get_input_buffer(req_));
+#else
+    return body_.size();
+#endif
+}
+
+std::vector<Slice> Context::body_segments() const {
+    std::vector<Slice> segments;
+#if LIBEVENT_VERSION_NUMBER >= 0x02001500
+    if (body_pulled_up_ || body_size() == 0) {
+        if (!body_.empty()) {
+            segments.push_back(body_);
+        }
+        return segments;
+    }
+
+    struct evbuffer* evbuf = evhttp_request_get_input_buffer(req_);
+    int n = evbuffer_peek(evbuf, -1, nullptr, nullptr, 0);
+    if (n <= 0) {
+        return segments;
+    }
+
+    std::vector<struct evbuffer_iovec> vec(n);
+    n = evbuffer_peek(evbuf, -1, nullptr, vec.data(), n);
+    segments.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        if (vec[i].iov_len > 0) {
+            segments.push_back(Slice(static_cast<const char*>(vec[i].iov_base), vec[i].iov_len));
+        }
+    }
+#else
+    if (!body_.empty()) {
+        segments.push_back(body_);
+    }
+#endif
+    return segments;
+}
+
 const char* Context::original_uri() const {
     return req_->uri;
 }
 
+void Context::SendReplyStart() {
+    assert(service_);
+    service_->SendReplyStart(shared_from_this());
+}
+
+void Context::SendReplyChunk(std::string data) {
+    assert(service_);
+    service_->SendReplyChunk(shared_from_this(), std::move(data));
+}
+
+void Context::SendReplyEnd() {
+    assert(service_);
+    service_->SendReplyEnd(shared_from_this());
+}
+
 void Context::AddResponseHeader(const std::string& key, const std::string& value) {
     evhttp_add_header(req_->output_headers, key.data(), value.data());
 }
@@ -4,7 +4,9 @@
 #include "evpp/slice.h"
 #include "evpp/timestamp.h"
 
+#include <atomic>
 #include <map>
+#include <vector>
 
 struct evhttp_request;
 
@@ -17,7 +19,7 @@ namespace http {
 
 class Service;
 
-struct EVPP_EXPORT Context {
+struct EVPP_EXPORT Context : public std::enable_shared_from_this<Context> {
 public:
     Context(struct evhttp_request* r);
     ~Context();
@@ -46,14 +48,29 @@ public:
         return remote_ip_;
     }
 
-    const Slice& body() const {
-        return body_;
-    }
+    // The whole request body as one block. libevent keeps the body in a
+    // chain of buffers, the first call copies them together, so large
+    // bodies are better read with body_segments() instead.
+    const Slice& body() const;
+
+    // The request body size, without touching the data
+    size_t body_size() const;
+
+    // The request body as the segments libevent received it in, in order.
+    // No data is copied, the slices are valid until the reply is sent.
+    // Calling body() afterwards invalidates them.
+    std::vector<Slice> body_segments() const;
 
     struct evhttp_request* req() const {
         return req_;
     }
 
+    // When the listening thread received the full request. The time until a
+    // worker thread runs the handler is the request's queueing delay.
+    const Timestamp& receive_time() const {
+        return receive_time_;
+    }
+
     void set_response_http_code(int code) {
         response_http_code_ = code;
     }
@@ -62,6 +79,21 @@ public:
         return response_http_code_;
     }
 
+    // Whether the reply was handed to the HTTPSendResponseCallback or
+    // SendReplyStart already. A request must be answered exactly once.
+    bool replied() const {
+        return replied_.load(std::memory_order_acquire);
+    }
+
+    // Chunked replies (Transfer-Encoding: chunked) for responses that are
+    // produced incrementally. They can be called from any thread and are
+    // forwarded to the HTTP listening thread in order.
+    // Once SendReplyStart is called the HTTPSendResponseCallback must not be
+    // used, the reply is finished by SendReplyEnd instead.
+    void SendReplyStart();
+    void SendReplyChunk(std::string data);
+    void SendReplyEnd();
+
     // Get the first value associated with the given key from the URI.
     std::string GetQuery(const char* query_key, size_t key_len) {
         const char* u = original_uri();
@@ -89,6 +121,11 @@ public:
     static std::string FindQueryFromURI(const std::string& uri, const std::string& key);
 
 private:
+    friend class Service;
+
+    // The service which received this request, used to send chunked replies
+    Service* service_ = nullptr;
+
     // The URI without any parameters : e.g. /status.html
     std::string uri_;
 
@@ -100,8 +137,13 @@ private:
 
     int response_http_code_ = 200;
 
-    // The HTTP request body data
-    Slice body_;
+    std::atomic<bool> replied_{false};
+
+    // The HTTP request body data, filled by the first body() call
+    mutable Slice body_;
+    mutable bool body_pulled_up_ = false;
+
+    Timestamp receive_time_;
 
     struct evhttp_request* req_;
 };
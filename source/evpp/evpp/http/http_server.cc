@@ -28,7 +28,7 @@ Server::~Server() {
     }
 
     if (tpool_) {
-        assert(tpool_->IsStopped());
+        assert(tpool_->IsStopped() || !tpool_->IsStarted());
         tpool_->Join();
         tpool_.reset();
     }
@@ -41,6 +41,10 @@ bool Server::Init(int listen_port) {
     lt.thread->set_name(std::string("StandaloneHTTPServer-Main-") + std::to_string(listen_port));
 
     lt.hservice = std::make_shared<Service>(lt.thread->loop());
+    if (max_body_size_ > 0) {
+        lt.hservice->SetMaxBodySize(max_body_size_);
+    }
+    lt.hservice->SetReusePort(reuse_port_);
     if (!lt.hservice->Listen(listen_port)) {
         int serrno = errno;
         LOG_ERROR << "this=" << this << " http server listen at port " << listen_port << " failed. errno=" << serrno << " " << strerror(serrno);
@@ -239,6 +243,14 @@ void Server::RegisterDefaultHandler(HTTPRequestCallback callback) {
     default_callback_ = callback;
 }
 
+void Server::SetMaxBodySize(size_t len) {
+    assert(!IsRunning());
+    max_body_size_ = len;
+    for (auto& lt : listen_threads_) {
+        lt.hservice->SetMaxBodySize(len);
+    }
+}
+
 void Server::Dispatch(EventLoop* listening_loop,
                       const ContextPtr& ctx,
                       const HTTPSendResponseCallback& response_callback,
@@ -57,6 +57,14 @@ public:
                          HTTPRequestCallback callback);
 
     void RegisterDefaultHandler(HTTPRequestCallback callback);
+
+    // @see Service::SetMaxBodySize, applies to every listening port
+    void SetMaxBodySize(size_t len);
+
+    // @see Service::SetReusePort, must be called before Init
+    void SetReusePort(bool on) {
+        reuse_port_ = on;
+    }
 public:
 
     std::shared_ptr<EventLoopThreadPool> pool() const {
@@ -88,6 +96,8 @@ private:
 
     HTTPRequestCallbackMap callbacks_;
     HTTPRequestCallback default_callback_;
+    size_t max_body_size_ = 0;
+    bool reuse_port_ = false;
 };
 }
 
@@ -3,6 +3,7 @@
 #include "evpp/libevent.h"
 #include "evpp/event_watcher.h"
 #include "evpp/event_loop.h"
+#include "evpp/sockets.h"
 
 namespace evpp {
 namespace http {
@@ -25,6 +26,9 @@ static void InitHTTPCodeString() {
 
     g_http_code_string[400] = "Bad Request";
     g_http_code_string[404] = "Not Found";
+    g_http_code_string[429] = "Too Many Requests";
+
+    g_http_code_string[503] = "Service Unavailable";
 
     //TODO Add more http code string : https://www.w3.org/Protocols/rfc2616/rfc2616-sec10.html
 }
@@ -45,13 +49,45 @@ Service::~Service() {
     assert(!evhttp_bound_socket_);
 }
 
+#if !defined(H_OS_WINDOWS) && LIBEVENT_VERSION_NUMBER >= 0x02001500
+// Binds the socket ourselves so it gets SO_REUSEPORT, evhttp_bind_socket only sets SO_REUSEADDR
+static struct evhttp_bound_socket* BindReusePort(struct evhttp* evhttp, int listen_port) {
+    evpp_socket_t fd = sock::CreateNonblockingSocket();
+    if (fd == INVALID_SOCKET) {
+        return nullptr;
+    }
+
+    std::string addr = std::string("0.0.0.0:") + std::to_string(listen_port);
+    struct sockaddr_storage local = sock::ParseFromIPPort(addr.c_str());
+    if (::bind(fd, sock::sockaddr_cast(&local), sizeof(struct sockaddr_in)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        int serrno = errno;
+        LOG_ERROR << "http listen on port " << listen_port << " failed, errno=" << serrno << " " << strerror(serrno);
+        EVUTIL_CLOSESOCKET(fd);
+        return nullptr;
+    }
+
+    struct evhttp_bound_socket* bound = evhttp_accept_socket_with_handle(evhttp, fd);
+    if (!bound) {
+        EVUTIL_CLOSESOCKET(fd);
+    }
+    return bound;
+}
+#endif
+
 bool Service::Listen(int listen_port) {
     assert(evhttp_);
     assert(listen_loop_->IsInLoopThread());
     port_ = listen_port;
 
 #if LIBEVENT_VERSION_NUMBER >= 0x02001500
-    evhttp_bound_socket_ = evhttp_bind_socket_with_handle(evhttp_, "0.0.0.0", listen_port);
+#if !defined(H_OS_WINDOWS)
+    if (reuse_port_) {
+        evhttp_bound_socket_ = BindReusePort(evhttp_, listen_port);
+    } else
+#endif
+    {
+        evhttp_bound_socket_ = evhttp_bind_socket_with_handle(evhttp_, "0.0.0.0", listen_port);
+    }
     if (!evhttp_bound_socket_) {
         return false;
     }
@@ -65,6 +101,11 @@ bool Service::Listen(int listen_port) {
     return true;
 }
 
+void Service::SetMaxBodySize(size_t len) {
+    assert(evhttp_);
+    evhttp_set_max_body_size(evhttp_, len == 0 ? -1 : static_cast<ev_ssize_t>(len));
+}
+
 void Service::Stop() {
     DLOG_TRACE << "http service is stopping";
     assert(listen_loop_->IsInLoopThread());
@@ -128,6 +169,7 @@ void Service::HandleRequest(struct evhttp_request* req) {
 
     ContextPtr ctx(new Context(req));
     ctx->Init();
+    ctx->service_ = this;
 
     if (callbacks_.empty()) {
         DefaultHandleRequest(ctx);
@@ -183,6 +225,8 @@ void Service::SendReply(const ContextPtr& ctx, const std::string& response_data)
     // In the worker thread
     DLOG_TRACE << "send reply in working thread";
 
+    ctx->replied_.store(true, std::memory_order_release);
+
     // Build the response package in the worker thread
     std::shared_ptr<Response> response(new Response(ctx, response_data));
 
@@ -200,8 +244,13 @@ void Service::SendReply(const ContextPtr& ctx, const std::string& response_data)
         }
 
         if (!response->buffer) {
-            evhttp_send_reply(x->req(), HTTP_NOTFOUND,
-                              g_http_code_string[HTTP_NOTFOUND], nullptr);
+            // 204 and 304 never carry a body, send them as they are.
+            // Any other empty reply is still answered with 404.
+            int code = x->response_http_code();
+            if (code != HTTP_NOCONTENT && code != HTTP_NOTMODIFIED) {
+                code = HTTP_NOTFOUND;
+            }
+            evhttp_send_reply(x->req(), code, g_http_code_string[code], nullptr);
             return;
         }
 
@@ -213,13 +262,67 @@ void Service::SendReply(const ContextPtr& ctx, const std::string& response_data)
     };
 
     // Forward this response sending task to HTTP listening thread
+    RunInListenLoop(f);
+}
+
+void Service::RunInListenLoop(std::function<void()> f) {
     if (listen_loop_->IsRunning()) {
-        DLOG_TRACE << "dispatch this SendReply to listening thread";
-        listen_loop_->RunInLoop(f);
+        DLOG_TRACE << "dispatch this reply to listening thread";
+        listen_loop_->RunInLoop(std::move(f));
     } else {
         LOG_WARN << "this=" << this << " listening thread is going to stop. we discards this request.";
         // TODO do we need do some resource recycling about the evhttp_request?
     }
 }
+
+void Service::SendReplyStart(const ContextPtr& ctx) {
+    ctx->replied_.store(true, std::memory_order_release);
+    auto f = [this, ctx]() {
+        assert(listen_loop_->IsInLoopThread());
+        if (!evhttp_) {
+            LOG_WARN << "this=" << this << " Service has been stopped.";
+            return;
+        }
+
+        assert(ctx->response_http_code() <= kMaxHTTPCode);
+        assert(ctx->response_http_code() >= 100);
+        evhttp_send_reply_start(ctx->req(), ctx->response_http_code(),
+                                g_http_code_string[ctx->response_http_code()]);
+    };
+    RunInListenLoop(f);
+}
+
+void Service::SendReplyChunk(const ContextPtr& ctx, std::string data) {
+    if (data.empty()) {
+        // An empty chunk would terminate the chunked body
+        return;
+    }
+
+    auto chunk = std::make_shared<std::string>(std::move(data));
+    auto f = [this, ctx, chunk]() {
+        assert(listen_loop_->IsInLoopThread());
+        if (!evhttp_) {
+            return;
+        }
+
+        struct evbuffer* buffer = evbuffer_new();
+        evbuffer_add(buffer, chunk->data(), chunk->size());
+        evhttp_send_reply_chunk(ctx->req(), buffer);
+        evbuffer_free(buffer);
+    };
+    RunInListenLoop(f);
+}
+
+void Service::SendReplyEnd(const ContextPtr& ctx) {
+    auto f = [this, ctx]() {
+        assert(listen_loop_->IsInLoopThread());
+        if (!evhttp_) {
+            return;
+        }
+
+        evhttp_send_reply_end(ctx->req());
+    };
+    RunInListenLoop(f);
+}
 }
 }
@@ -28,6 +28,17 @@ public:
 
     void RegisterDefaultHandler(HTTPRequestCallback callback);
 
+    // Requests with a larger body, also a chunked one, are answered 413 by
+    // libevent before any handler runs. 0 means no limit.
+    void SetMaxBodySize(size_t len);
+
+    // Bind the listener with SO_REUSEPORT so a restarted server can take
+    // over the port while the old one drains. Off by default : with it on a
+    // second server on the same port starts without an error. Call before Listen.
+    void SetReusePort(bool on) {
+        reuse_port_ = on;
+    }
+
     EventLoop* loop() const {
         return listen_loop_;
     }
@@ -40,8 +51,16 @@ private:
     void HandleRequest(struct evhttp_request* req);
     void DefaultHandleRequest(const ContextPtr& ctx);
     void SendReply(const ContextPtr& ctx, const std::string& response);
+
+    // Used by Context to stream a chunked reply
+    friend struct Context;
+    void SendReplyStart(const ContextPtr& ctx);
+    void SendReplyChunk(const ContextPtr& ctx, std::string data);
+    void SendReplyEnd(const ContextPtr& ctx);
+    void RunInListenLoop(std::function<void()> f);
 private:
     int port_ = 0;
+    bool reuse_port_ = false;
     struct evhttp* evhttp_;
     struct evhttp_bound_socket* evhttp_bound_socket_;
     EventLoop* listen_loop_;
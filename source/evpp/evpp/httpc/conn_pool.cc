@@ -13,31 +13,32 @@ ConnPool::~ConnPool() {
 
 ConnPtr ConnPool::Get(EventLoop* loop) {
     assert(loop->IsInLoopThread());
-    auto it = pool_.find(loop);
-    if (it == pool_.end()) {
-        std::lock_guard<std::mutex> guard(mutex_);
-        pool_[loop] = std::vector<ConnPtr>();
-    }
 
-    it = pool_.find(loop);
-    assert(it != pool_.end());
+    // Another EventLoop may be inserting its own entry, so even the lookup
+    // is guarded. The vector itself is only touched by its own loop.
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<ConnPtr>& conns = pool_[loop];
 
     ConnPtr c;
-    if (it->second.empty()) {
+    if (conns.empty()) {
         c.reset(new Conn(this, loop));
         return c;
     }
 
-    c = it->second.back();
-    it->second.pop_back();
+    c = conns.back();
+    conns.pop_back();
     return c;
 }
 
 void ConnPool::Put(const ConnPtr& c) {
     EventLoop* loop = c->loop();
     assert(loop->IsInLoopThread());
+    std::lock_guard<std::mutex> guard(mutex_);
     auto it = pool_.find(loop);
-    assert(it != pool_.end());
+    if (it == pool_.end()) {
+        // Cleared while the request was in flight
+        return;
+    }
     if (it->second.size() >= max_pool_size_) {
         return;
     }
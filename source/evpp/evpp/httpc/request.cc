@@ -9,6 +9,32 @@ namespace evpp {
 namespace httpc {
 const std::string Request::empty_ = "";
 
+namespace {
+bool ToCmdType(const std::string& method, evhttp_cmd_type* t) {
+    static const struct {
+        const char* name;
+        evhttp_cmd_type type;
+    } methods[] = {
+        { "GET", EVHTTP_REQ_GET },
+        { "POST", EVHTTP_REQ_POST },
+        { "PUT", EVHTTP_REQ_PUT },
+        { "DELETE", EVHTTP_REQ_DELETE },
+        { "HEAD", EVHTTP_REQ_HEAD },
+        { "OPTIONS", EVHTTP_REQ_OPTIONS },
+        { "PATCH", EVHTTP_REQ_PATCH },
+    };
+
+    // Methods are case sensitive (RFC 7231), evpp::http::Context reports them in upper case
+    for (auto& m : methods) {
+        if (method == m.name) {
+            *t = m.type;
+            return true;
+        }
+    }
+    return false;
+}
+}
+
 Request::Request(ConnPool* pool, EventLoop* loop, const std::string& http_uri, const std::string& body)
     : pool_(pool), loop_(loop), host_(pool->host()), uri_(http_uri), body_(body) {
 }
@@ -90,8 +116,25 @@ void Request::ExecuteInLoop() {
         goto failed;
     }
 
-    if (!body_.empty()) {
+    for (auto& h : headers_) {
+        if (evhttp_add_header(req->output_headers, h.first.c_str(), h.second.c_str())) {
+            evhttp_request_free(req);
+            errmsg = "evhttp_add_header failed";
+            goto failed;
+        }
+    }
+
+    if (!method_.empty()) {
+        if (!ToCmdType(method_, &req_type)) {
+            evhttp_request_free(req);
+            errmsg = "unsupported method " + method_;
+            goto failed;
+        }
+    } else if (!body_.empty()) {
         req_type = EVHTTP_REQ_POST;
+    }
+
+    if (!body_.empty()) {
         if (evbuffer_add(req->output_buffer, body_.c_str(), body_.size())) {
             evhttp_request_free(req);
             errmsg = "evbuffer_add fail";
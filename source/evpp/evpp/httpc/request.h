@@ -55,6 +55,21 @@ public:
     void set_retry_interval(Duration d) {
         retry_interval_ = d;
     }
+
+    // @brief Overrides the method picked from the body (GET when empty, POST otherwise)
+    // @param[in] m - "GET", "POST", "PUT", "DELETE", "HEAD", "OPTIONS" or "PATCH"
+    void set_method(const std::string& m) {
+        method_ = m;
+    }
+    const std::string& method() const {
+        return method_;
+    }
+
+    // @brief Adds a header to the request, it is sent again on every retry.
+    //  The "host" header is always set from the connection.
+    void AddHeader(const std::string& key, const std::string& value) {
+        headers_.push_back(std::make_pair(key, value));
+    }
 private:
     static void HandleResponse(struct evhttp_request* r, void* v);
     void HandleResponse(struct evhttp_request* r);
@@ -68,6 +83,8 @@ private:
     std::string host_;
     std::string uri_; // The URI of the HTTP request with parameters
     std::string body_;
+    std::string method_; // Empty means GET or POST depending on body_
+    std::vector<std::pair<std::string, std::string>> headers_;
     std::shared_ptr<Conn> conn_;
     Handler handler_;
 
@@ -37,6 +37,20 @@ const char* Response::FindHeader(const char* key) {
     return nullptr;
 }
 
+Response::HeaderList Response::headers() const {
+    HeaderList result;
+    if (http_code_ <= 0) {
+        return result;
+    }
+
+    assert(this->evreq_);
+    struct evkeyvalq* h = evhttp_request_get_input_headers(this->evreq_);
+    for (struct evkeyval* kv = h->tqh_first; kv; kv = kv->next.tqe_next) {
+        result.push_back(std::make_pair(std::string(kv->key), std::string(kv->value)));
+    }
+    return result;
+}
+
 }
 }
 
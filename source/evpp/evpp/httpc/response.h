@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "evpp/inner_pre.h"
 #include "evpp/event_loop.h"
@@ -13,6 +14,7 @@ class Request;
 class EVPP_EXPORT Response {
 public:
     typedef std::map<evpp::Slice, evpp::Slice> Headers;
+    typedef std::vector<std::pair<std::string, std::string>> HeaderList;
     Response(Request* r, struct evhttp_request* evreq);
     ~Response();
 
@@ -26,6 +28,9 @@ public:
         return request_;
     }
     const char* FindHeader(const char* key);
+
+    // @return every response header in the order received, repeated ones included
+    HeaderList headers() const;
 private:
     Request* request_;
     struct evhttp_request* evreq_;
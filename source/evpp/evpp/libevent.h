@@ -27,7 +27,7 @@
 #include <3rdparty/libevent/include/evutil.h>
 #include <3rdparty/libevent/include/evdns.h>
 
-#else
+#elif defined(_WIN32)
 #include <3rdparty/libevent/include/event2/event.h>
 #include <3rdparty/libevent/include/event2/event_struct.h>
 #include <3rdparty/libevent/include/event2/buffer.h>
@@ -40,6 +40,22 @@
 #include <3rdparty/libevent/include/event2/dns_compat.h>
 #include <3rdparty/libevent/include/event2/dns_struct.h>
 #include <3rdparty/libevent/include/event2/listener.h>
+#else
+// linux builds use the system libevent
+#include <event2/event.h>
+#include <event2/event_struct.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/http.h>
+#include <event2/http_compat.h>
+#include <event2/http_struct.h>
+#include <event2/event_compat.h>
+#include <event2/dns.h>
+#include <event2/dns_compat.h>
+#include <event2/dns_struct.h>
+#include <event2/listener.h>
+#endif
+#if !defined(H_LIBEVENT_VERSION_14)
 
 
 
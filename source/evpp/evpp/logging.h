@@ -6,8 +6,11 @@
 #define GOOGLE_GLOG_DLL_DECL           // ʹþ̬glogʱ붨
 #define GLOG_NO_ABBREVIATED_SEVERITIES // û,˵ΪWindows.hͻ
 
-//#include <glog/logging.h>
+#ifdef _WIN32
 #include <3rdparty/glog/include/logging.h>
+#else
+#include <glog/logging.h>
+#endif
 
 #ifdef GOOGLE_STRIP_LOG
 
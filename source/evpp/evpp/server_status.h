@@ -46,6 +46,11 @@ public:
         return status_.load() == kStopping;
     }
 
+    // False until Start is called, e.g. for a server whose Init failed
+    bool IsStarted() const {
+        return status_.load() >= kStarting;
+    }
+
 protected:
     std::atomic<Status> status_ = { kNull };
     std::atomic<SubStatus> substatus_ = { kSubStatusNull };
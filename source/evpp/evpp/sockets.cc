@@ -322,4 +322,14 @@ int readv(evpp_socket_t sockfd, struct iovec* iov, int iovcnt) {
 
     return -1;
 }
+
+int writev(evpp_socket_t sockfd, const struct iovec* iov, int iovcnt) {
+    DWORD sent = 0;
+
+    if (::WSASend(sockfd, const_cast<struct iovec*>(iov), iovcnt, &sent, 0, nullptr, nullptr) == 0) {
+        return sent;
+    }
+
+    return -1;
+}
 #endif
@@ -119,4 +119,5 @@ inline const struct sockaddr_storage* sockaddr_storage_cast(const struct sockadd
 
 #ifdef H_OS_WINDOWS
 EVPP_EXPORT int readv(evpp_socket_t sockfd, struct iovec* iov, int iovcnt);
+EVPP_EXPORT int writev(evpp_socket_t sockfd, const struct iovec* iov, int iovcnt);
 #endif
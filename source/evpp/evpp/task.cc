@@ -0,0 +1,125 @@
+#include "evpp/inner_pre.h"
+
+#include "evpp/task.h"
+
+#include <mutex>
+#include <vector>
+
+namespace evpp {
+
+namespace {
+// Size classes 128, 256, 512 and 1024 bytes
+enum {
+    kMinBlockShift = 7,
+    kClassCount = 4,
+    kCacheLimit = 32,       // blocks a thread keeps per class
+    kBatch = 16,            // blocks moved to or from the depot at once
+    kDepotLimit = 64,       // batches the depot keeps per class
+};
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// Plain data so it also works with __declspec(thread). A thread's cache is
+// not given back when the thread exits; evpp threads live as long as their
+// EventLoop and the cache is bounded by kCacheLimit.
+struct ThreadCache {
+    FreeBlock* head[kClassCount];
+    uint32_t count[kClassCount];
+};
+
+thread_local ThreadCache tls_cache;
+
+// Chains of exactly kBatch blocks
+struct Depot {
+    std::mutex mutex;
+    std::vector<FreeBlock*> batches[kClassCount];
+};
+
+Depot& GetDepot() {
+    // Never destroyed, tasks may still be freed during static destruction
+    static Depot* depot = new Depot;
+    return *depot;
+}
+
+int ClassOf(size_t size) {
+    int c = 0;
+    while ((size_t(1) << (kMinBlockShift + c)) < size) {
+        ++c;
+    }
+    return c;
+}
+
+size_t BlockSize(int c) {
+    return size_t(1) << (kMinBlockShift + c);
+}
+}
+
+void* TaskPool::Allocate(size_t size) {
+    if (size > kMaxBlockSize) {
+        return ::operator new(size);
+    }
+
+    int c = ClassOf(size);
+    ThreadCache& cache = tls_cache;
+    if (cache.head[c] == nullptr) {
+        Depot& depot = GetDepot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        if (!depot.batches[c].empty()) {
+            cache.head[c] = depot.batches[c].back();
+            cache.count[c] = kBatch;
+            depot.batches[c].pop_back();
+        }
+    }
+
+    FreeBlock* block = cache.head[c];
+    if (block == nullptr) {
+        return ::operator new(BlockSize(c));
+    }
+    cache.head[c] = block->next;
+    --cache.count[c];
+    return block;
+}
+
+void TaskPool::Free(void* p, size_t size) {
+    if (size > kMaxBlockSize) {
+        ::operator delete(p);
+        return;
+    }
+
+    int c = ClassOf(size);
+    ThreadCache& cache = tls_cache;
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = cache.head[c];
+    cache.head[c] = block;
+    if (++cache.count[c] <= kCacheLimit) {
+        return;
+    }
+
+    // Hand a batch over to the threads that allocate
+    FreeBlock* batch = cache.head[c];
+    FreeBlock* last = batch;
+    for (int i = 1; i < kBatch; ++i) {
+        last = last->next;
+    }
+    cache.head[c] = last->next;
+    cache.count[c] -= kBatch;
+    last->next = nullptr;
+
+    {
+        Depot& depot = GetDepot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        if (depot.batches[c].size() < kDepotLimit) {
+            depot.batches[c].push_back(batch);
+            return;
+        }
+    }
+
+    while (batch) {
+        FreeBlock* next = batch->next;
+        ::operator delete(batch);
+        batch = next;
+    }
+}
+}
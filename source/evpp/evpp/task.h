@@ -0,0 +1,165 @@
+#pragma once
+
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "evpp/inner_pre.h"
+
+namespace evpp {
+
+// Recycles the memory of tasks whose captures do not fit inline.
+// Blocks come in a few size classes and are cached per thread; a thread that
+// frees more than it allocates (the loop running the tasks) hands them back
+// in batches through a shared depot, so producers find them again.
+class EVPP_EXPORT TaskPool {
+public:
+    enum { kMaxBlockSize = 1024 };
+
+    // Sizes above kMaxBlockSize go straight to operator new/delete.
+    // Free() must be given the same size as Allocate().
+    static void* Allocate(size_t size);
+    static void Free(void* p, size_t size);
+};
+
+// A move-only void() callable, the unit of work of EventLoop's pending queue.
+//
+// std::function allocates as soon as its captures outgrow its small buffer
+// (16 bytes with libstdc++), which a ContextPtr plus a response callback
+// already does, and the boost::lockfree queue needs one more allocation to
+// hold it by pointer. Task keeps up to kInlineSize bytes of captures in place
+// and moves larger ones to a TaskPool block, so posting work to another loop
+// normally does not reach the allocator.
+class Task {
+public:
+    enum {
+        kAlign = 16,
+        kInlineSize = 128 - sizeof(void*),
+    };
+
+    Task() : ops_(nullptr) {}
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) : ops_(nullptr) {
+        typedef typename std::decay<F>::type Fn;
+        static_assert(alignof(Fn) <= kAlign, "over-aligned captures are not supported");
+        Emplace<Fn>(std::forward<F>(f), std::integral_constant<bool, FitsInline<Fn>::value>());
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            if (other.ops_) {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~Task() {
+        Reset();
+    }
+
+    void operator()() {
+        assert(ops_);
+        ops_->invoke(storage_);
+    }
+
+    explicit operator bool() const {
+        return ops_ != nullptr;
+    }
+
+    void Reset() {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        // Move-constructs into dst and destroys what is left in src
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template<typename Fn>
+    struct FitsInline {
+        enum { value = sizeof(Fn) <= kInlineSize && std::is_nothrow_move_constructible<Fn>::value };
+    };
+
+    template<typename Fn>
+    struct InlineOps {
+        static void Invoke(void* s) {
+            (*static_cast<Fn*>(s))();
+        }
+        static void Move(void* dst, void* src) {
+            Fn* f = static_cast<Fn*>(src);
+            new (dst) Fn(std::move(*f));
+            f->~Fn();
+        }
+        static void Destroy(void* s) {
+            static_cast<Fn*>(s)->~Fn();
+        }
+        static const Ops ops;
+    };
+
+    // The storage holds a pointer to a TaskPool block
+    template<typename Fn>
+    struct PooledOps {
+        static void Invoke(void* s) {
+            (**static_cast<Fn**>(s))();
+        }
+        static void Move(void* dst, void* src) {
+            *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+        }
+        static void Destroy(void* s) {
+            Fn* f = *static_cast<Fn**>(s);
+            f->~Fn();
+            TaskPool::Free(f, sizeof(Fn));
+        }
+        static const Ops ops;
+    };
+
+    template<typename Fn, typename F>
+    void Emplace(F&& f, std::true_type /*inline*/) {
+        new (storage_) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::ops;
+    }
+
+    template<typename Fn, typename F>
+    void Emplace(F&& f, std::false_type /*inline*/) {
+        void* block = TaskPool::Allocate(sizeof(Fn));
+        try {
+            *reinterpret_cast<Fn**>(storage_) = new (block) Fn(std::forward<F>(f));
+        } catch (...) {
+            TaskPool::Free(block, sizeof(Fn));
+            throw;
+        }
+        ops_ = &PooledOps<Fn>::ops;
+    }
+
+private:
+    alignas(kAlign) unsigned char storage_[kInlineSize];
+    const Ops* ops_;
+};
+
+template<typename Fn>
+const Task::Ops Task::InlineOps<Fn>::ops = { &Task::InlineOps<Fn>::Invoke, &Task::InlineOps<Fn>::Move, &Task::InlineOps<Fn>::Destroy };
+
+template<typename Fn>
+const Task::Ops Task::PooledOps<Fn>::ops = { &Task::PooledOps<Fn>::Invoke, &Task::PooledOps<Fn>::Move, &Task::PooledOps<Fn>::Destroy };
+}
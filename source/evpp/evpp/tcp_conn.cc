@@ -75,6 +75,18 @@ void TCPConn::Send(const std::string& d) {
     }
 }
 
+void TCPConn::Send(std::string&& d) {
+    if (status_ != kConnected) {
+        return;
+    }
+
+    if (loop_->IsInLoopThread()) {
+        SendOwnedStringInLoop(d);
+    } else {
+        loop_->RunInLoop(std::bind(&TCPConn::SendOwnedStringInLoop, shared_from_this(), std::move(d)));
+    }
+}
+
 void TCPConn::Send(const Slice& message) {
     if (status_ != kConnected) {
         return;
@@ -83,7 +95,7 @@ void TCPConn::Send(const Slice& message) {
     if (loop_->IsInLoopThread()) {
         SendInLoop(message);
     } else {
-        loop_->RunInLoop(std::bind(&TCPConn::SendStringInLoop, shared_from_this(), message.ToString()));
+        loop_->RunInLoop(std::bind(&TCPConn::SendOwnedStringInLoop, shared_from_this(), message.ToString()));
     }
 }
 
@@ -104,7 +116,7 @@ void TCPConn::Send(Buffer* buf) {
         SendInLoop(buf->data(), buf->length());
         buf->Reset();
     } else {
-        loop_->RunInLoop(std::bind(&TCPConn::SendStringInLoop, shared_from_this(), buf->NextAllString()));
+        loop_->RunInLoop(std::bind(&TCPConn::SendOwnedStringInLoop, shared_from_this(), buf->NextAllString()));
     }
 }
 
@@ -116,24 +128,59 @@ void TCPConn::SendStringInLoop(const std::string& message) {
     SendInLoop(message.data(), message.size());
 }
 
+void TCPConn::SendOwnedStringInLoop(std::string& message) {
+    assert(loop_->IsInLoopThread());
+    ssize_t nwritten = WriteDirectly(message.data(), message.size());
+    if (nwritten < 0) {
+        return;
+    }
+
+    size_t remaining = message.size() - nwritten;
+    if (remaining == 0) {
+        return;
+    }
+
+    WillQueue(remaining);
+    if (nwritten == 0) {
+        output_buffer_.Append(std::move(message));
+    } else if (remaining >= ChainBuffer::kMinRefSize) {
+        std::shared_ptr<std::string> owner = std::make_shared<std::string>(std::move(message));
+        output_buffer_.AppendRef(Slice(owner->data() + nwritten, remaining), owner);
+    } else {
+        output_buffer_.Append(message.data() + nwritten, remaining);
+    }
+}
+
 void TCPConn::SendInLoop(const void* data, size_t len) {
     assert(loop_->IsInLoopThread());
+    ssize_t nwritten = WriteDirectly(data, len);
+    if (nwritten < 0) {
+        return;
+    }
+
+    size_t remaining = len - nwritten;
+    if (remaining > 0) {
+        WillQueue(remaining);
+        output_buffer_.Append(static_cast<const char*>(data) + nwritten, remaining);
+    }
+}
 
+// Writes to the socket right away if nothing is queued before this data.
+// @return the number of bytes written, or -1 if the connection has failed and was closed
+ssize_t TCPConn::WriteDirectly(const void* data, size_t len) {
     if (status_ == kDisconnected) {
         LOG_WARN << "disconnected, give up writing";
-        return;
+        return -1;
     }
 
     ssize_t nwritten = 0;
-    size_t remaining = len;
     bool write_error = false;
 
     // if no data in output queue, writing directly
     if (!chan_->IsWritable() && output_buffer_.length() == 0) {
         nwritten = ::send(chan_->fd(), static_cast<const char*>(data), len, MSG_NOSIGNAL);
         if (nwritten >= 0) {
-            remaining = len - nwritten;
-            if (remaining == 0 && write_complete_fn_) {
+            if (size_t(nwritten) == len && write_complete_fn_) {
                 loop_->QueueInLoop(std::bind(write_complete_fn_, shared_from_this()));
             }
         } else {
@@ -150,25 +197,24 @@ void TCPConn::SendInLoop(const void* data, size_t len) {
 
     if (write_error) {
         HandleError();
-        return;
+        return -1;
     }
 
-    assert(!write_error);
-    assert(remaining <= len);
-
-    if (remaining > 0) {
-        size_t old_len = output_buffer_.length();
-        if (old_len + remaining >= high_water_mark_
-                && old_len < high_water_mark_
-                && high_water_mark_fn_) {
-            loop_->QueueInLoop(std::bind(high_water_mark_fn_, shared_from_this(), old_len + remaining));
-        }
+    assert(size_t(nwritten) <= len);
+    return nwritten;
+}
 
-        output_buffer_.Append(static_cast<const char*>(data) + nwritten, remaining);
+// Called before len more bytes go to the output queue
+void TCPConn::WillQueue(size_t len) {
+    size_t old_len = output_buffer_.length();
+    if (old_len + len >= high_water_mark_
+            && old_len < high_water_mark_
+            && high_water_mark_fn_) {
+        loop_->QueueInLoop(std::bind(high_water_mark_fn_, shared_from_this(), old_len + len));
+    }
 
-        if (!chan_->IsWritable()) {
-            chan_->EnableWriteEvent();
-        }
+    if (!chan_->IsWritable()) {
+        chan_->EnableWriteEvent();
     }
 }
 
@@ -213,10 +259,9 @@ void TCPConn::HandleWrite() {
     assert(loop_->IsInLoopThread());
     assert(!chan_->attached() || chan_->IsWritable());
 
-    ssize_t n = ::send(fd_, output_buffer_.data(), output_buffer_.length(), MSG_NOSIGNAL);
+    int serrno = 0;
+    ssize_t n = output_buffer_.WriteToFD(fd_, &serrno);
     if (n > 0) {
-        output_buffer_.Next(n);
-
         if (output_buffer_.length() == 0) {
             chan_->DisableWriteEvent();
 
@@ -225,8 +270,6 @@ void TCPConn::HandleWrite() {
             }
         }
     } else {
-        int serrno = errno;
-
         if (EVUTIL_ERR_RW_RETRIABLE(serrno)) {
             LOG_WARN << "this=" << this << " TCPConn::HandleWrite errno=" << serrno << " " << strerror(serrno);
         } else {
@@ -4,6 +4,7 @@
 
 #include "evpp/inner_pre.h"
 #include "evpp/buffer.h"
+#include "evpp/chain_buffer.h"
 #include "evpp/tcp_callbacks.h"
 #include "evpp/slice.h"
 #include "evpp/any.h"
@@ -44,6 +45,9 @@ public:
     }
     void Send(const void* d, size_t dlen);
     void Send(const std::string& d);
+    // Takes the string over, a large one is queued without being copied
+    // when the socket can't take it all at once.
+    void Send(std::string&& d);
     void Send(const Slice& message);
     void Send(Buffer* buf);
 public:
@@ -124,7 +128,8 @@ public:
     // TODO Add : SetLinger();
 
     void ReserveInputBuffer(size_t len) { input_buffer_.Reserve(len); }
-    void ReserveOutputBuffer(size_t len) { output_buffer_.Reserve(len); }
+    // The output queue is a chain of pooled blocks, there is nothing to reserve
+    void ReserveOutputBuffer(size_t /*len*/) {}
 
     void SetHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t mark);
 protected:
@@ -156,6 +161,9 @@ private:
     void SendInLoop(const Slice& message);
     void SendInLoop(const void* data, size_t len);
     void SendStringInLoop(const std::string& message);
+    void SendOwnedStringInLoop(std::string& message);
+    ssize_t WriteDirectly(const void* data, size_t len);
+    void WillQueue(size_t len);
 
 private:
     EventLoop* loop_;
@@ -166,7 +174,7 @@ private:
     std::string remote_addr_; // the remote address with form : "ip:port"
     std::unique_ptr<FdChannel> chan_;
     Buffer input_buffer_;
-    Buffer output_buffer_; // TODO use a list<Slice> ??
+    ChainBuffer output_buffer_;
 
     enum { kContextCount = 16, };
     Any context_[kContextCount];
@@ -0,0 +1,254 @@
+#include "evpp/inner_pre.h"
+
+#include "evpp/timer_wheel.h"
+#include "evpp/event_loop.h"
+#include "evpp/event_watcher.h"
+
+namespace evpp {
+
+namespace {
+// Marks the nodes of the slot that is being run, they are off the wheel but still cancellable.
+const uint32_t kExpiringSlot = 0xFFFFFFFE;
+}
+
+TimerWheel::TimerWheel(EventLoop* loop, Duration tick)
+    : loop_(loop), tick_(tick), origin_(Timestamp::Now()), current_(0), active_(0), armed_(false),
+      free_head_(kNil), expiring_head_(kNil) {
+    assert(tick_.Nanoseconds() > 0);
+    for (int i = 0; i < kSlotCount; ++i) {
+        heads_[i] = kNil;
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    if (watcher_) {
+        watcher_->ClearHandler();
+        watcher_.reset();
+    }
+}
+
+uint64_t TimerWheel::ToTicks(Timestamp t) const {
+    int64_t ns = (t - origin_).Nanoseconds();
+    return ns <= 0 ? 0 : static_cast<uint64_t>(ns / tick_.Nanoseconds());
+}
+
+uint64_t TimerWheel::DelayToTicks(Duration delay) const {
+    // Rounded up so a timer never fires before its delay has passed
+    int64_t ns = (Timestamp::Now() - origin_).Nanoseconds() + delay.Nanoseconds();
+    if (ns <= 0) {
+        return current_;
+    }
+    uint64_t expire = static_cast<uint64_t>((ns + tick_.Nanoseconds() - 1) / tick_.Nanoseconds());
+    return expire < current_ ? current_ : expire;
+}
+
+uint32_t TimerWheel::SlotFor(uint64_t expire) const {
+    uint64_t delta = expire - current_;
+    if (delta < kRootSize) {
+        return static_cast<uint32_t>(expire & (kRootSize - 1));
+    }
+
+    for (int level = 1; level < kLevels; ++level) {
+        int shift = kRootBits + level * kLevelBits;
+        if (delta < (uint64_t(1) << shift) || level == kLevels - 1) {
+            if (delta >= (uint64_t(1) << shift)) {
+                // Further out than the wheel spans, park it in the last slot
+                // of the top level, it is re-filed when that slot cascades.
+                expire = current_ + (uint64_t(1) << shift) - 1;
+            }
+            int low = shift - kLevelBits;
+            return kRootSize + (level - 1) * kLevelSize + static_cast<uint32_t>((expire >> low) & (kLevelSize - 1));
+        }
+    }
+
+    assert(false);
+    return 0;
+}
+
+void TimerWheel::Link(uint32_t index) {
+    Node& node = nodes_[index];
+    node.slot = SlotFor(node.expire);
+    node.prev = kNil;
+    node.next = heads_[node.slot];
+    if (node.next != kNil) {
+        nodes_[node.next].prev = index;
+    }
+    heads_[node.slot] = index;
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Node& node = nodes_[index];
+    uint32_t& head = node.slot == kExpiringSlot ? expiring_head_ : heads_[node.slot];
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        head = node.next;
+    }
+    if (node.next != kNil) {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = node.next = kNil;
+}
+
+void TimerWheel::Release(uint32_t index) {
+    Node& node = nodes_[index];
+    node.slot = kNil;
+    ++node.generation;
+    node.next = free_head_;
+    free_head_ = index;
+    --active_;
+}
+
+uint32_t TimerWheel::Lookup(TimerId id) const {
+    uint64_t index = (id & 0xFFFFFFFF);
+    if (index == 0 || index > nodes_.size()) {
+        return kNil;
+    }
+    const Node& node = nodes_[index - 1];
+    if (node.slot == kNil || node.generation != static_cast<uint32_t>(id >> 32)) {
+        return kNil;
+    }
+    return static_cast<uint32_t>(index - 1);
+}
+
+TimerWheel::TimerId TimerWheel::Add(Duration delay, const Functor& f) {
+    Functor copy(f);
+    return Insert(delay, copy);
+}
+
+TimerWheel::TimerId TimerWheel::Add(Duration delay, Functor&& f) {
+    return Insert(delay, f);
+}
+
+TimerWheel::TimerId TimerWheel::Insert(Duration delay, Functor& f) {
+    assert(loop_->IsInLoopThread());
+
+    if (active_ == 0) {
+        // Nothing is filed, skip straight to now instead of walking the idle ticks
+        uint64_t now = ToTicks(Timestamp::Now());
+        if (now > current_) {
+            current_ = now;
+        }
+    }
+
+    uint32_t index;
+    if (free_head_ != kNil) {
+        index = free_head_;
+        free_head_ = nodes_[index].next;
+    } else {
+        index = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(Node());
+        nodes_.back().generation = 1;
+    }
+
+    Node& node = nodes_[index];
+    node.expire = DelayToTicks(delay);
+    node.functor = std::move(f);
+    Link(index);
+    ++active_;
+
+    Arm();
+    return (uint64_t(node.generation) << 32) | (index + 1);
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    assert(loop_->IsInLoopThread());
+    uint32_t index = Lookup(id);
+    if (index == kNil) {
+        return false;
+    }
+
+    Unlink(index);
+    nodes_[index].functor = Functor();
+    Release(index);
+    return true;
+}
+
+bool TimerWheel::Reschedule(TimerId id, Duration delay) {
+    assert(loop_->IsInLoopThread());
+    uint32_t index = Lookup(id);
+    if (index == kNil) {
+        return false;
+    }
+
+    Unlink(index);
+    nodes_[index].expire = DelayToTicks(delay);
+    Link(index);
+    return true;
+}
+
+void TimerWheel::Cascade(int level) {
+    int low = kRootBits + (level - 1) * kLevelBits;
+    uint32_t slot = kRootSize + (level - 1) * kLevelSize + static_cast<uint32_t>((current_ >> low) & (kLevelSize - 1));
+
+    uint32_t index = heads_[slot];
+    heads_[slot] = kNil;
+    while (index != kNil) {
+        uint32_t next = nodes_[index].next;
+        Link(index);
+        index = next;
+    }
+}
+
+void TimerWheel::Expire(uint32_t slot) {
+    // Take the whole slot off the wheel first, callbacks may add, cancel or
+    // reschedule timers, including the ones still waiting in this batch.
+    expiring_head_ = heads_[slot];
+    heads_[slot] = kNil;
+    for (uint32_t index = expiring_head_; index != kNil; index = nodes_[index].next) {
+        nodes_[index].slot = kExpiringSlot;
+    }
+
+    while (expiring_head_ != kNil) {
+        uint32_t index = expiring_head_;
+        Unlink(index);
+
+        Functor f;
+        f.swap(nodes_[index].functor);
+        Release(index);
+        f();
+    }
+}
+
+void TimerWheel::Advance(Timestamp now) {
+    uint64_t target = ToTicks(now);
+    while (current_ <= target && active_ > 0) {
+        uint32_t root = static_cast<uint32_t>(current_ & (kRootSize - 1));
+        if (root == 0) {
+            for (int level = 1; level < kLevels; ++level) {
+                Cascade(level);
+                int low = kRootBits + (level - 1) * kLevelBits;
+                if (((current_ >> low) & (kLevelSize - 1)) != 0) {
+                    break;
+                }
+            }
+        }
+
+        ++current_;
+        Expire(root);
+    }
+
+    if (active_ == 0 && current_ <= target) {
+        current_ = target + 1;
+    }
+}
+
+void TimerWheel::OnTick() {
+    armed_ = false;
+    Advance(Timestamp::Now());
+    Arm();
+}
+
+void TimerWheel::Arm() {
+    if (armed_ || active_ == 0) {
+        return;
+    }
+
+    if (!watcher_) {
+        watcher_.reset(new TimerEventWatcher(loop_, std::bind(&TimerWheel::OnTick, this), tick_));
+        watcher_->Init();
+    }
+
+    armed_ = watcher_->AsyncWait();
+}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+
+#include "evpp/inner_pre.h"
+#include "evpp/duration.h"
+#include "evpp/timestamp.h"
+
+namespace evpp {
+class EventLoop;
+class TimerEventWatcher;
+
+// A hierarchical timing wheel bound to one EventLoop, for the many coarse
+// timers a server keeps around : session idle timeouts, token expiry,
+// flush deadlines. InvokeTimer costs a shared_ptr, a TimerEventWatcher and
+// a libevent event per timer; here a timer is a slot in a reused node pool
+// and the whole wheel runs off a single libevent timer that is only armed
+// while something is pending.
+//
+// Add/Cancel/Reschedule are O(1). Expired timers are collected and run a
+// slot at a time. Resolution is one tick (default 10ms) and a timer never
+// fires early. Not thread safe : use it from its EventLoop thread, e.g.
+// through EventLoop::RunInLoop.
+class EVPP_EXPORT TimerWheel {
+public:
+    typedef std::function<void()> Functor;
+
+    // 0 is never a valid id. Ids of fired or cancelled timers are never reused.
+    typedef uint64_t TimerId;
+
+    explicit TimerWheel(EventLoop* loop, Duration tick = Duration(0.01));
+    ~TimerWheel();
+
+    TimerId Add(Duration delay, const Functor& f);
+    TimerId Add(Duration delay, Functor&& f);
+
+    // @return false if the timer already fired or was cancelled
+    bool Cancel(TimerId id);
+
+    // Moves a pending timer to now + delay, e.g. an idle timeout on activity.
+    // @return false if the timer already fired or was cancelled
+    bool Reschedule(TimerId id, Duration delay);
+
+    size_t size() const {
+        return active_;
+    }
+
+    Duration tick() const {
+        return tick_;
+    }
+
+    // Runs every timer that is due at the given time. Called by the wheel's
+    // own timer event, public so tests can drive the wheel without sleeping.
+    void Advance(Timestamp now);
+
+private:
+    enum {
+        kRootBits = 8,
+        kLevelBits = 6,
+        kRootSize = 1 << kRootBits,
+        kLevelSize = 1 << kLevelBits,
+        kLevels = 4,
+        kSlotCount = kRootSize + (kLevels - 1) * kLevelSize,
+    };
+    static const uint32_t kNil = 0xFFFFFFFF;
+
+    struct Node {
+        uint64_t expire;        // in ticks
+        uint32_t prev;
+        uint32_t next;
+        uint32_t slot;          // kNil when the node is free
+        uint32_t generation;
+        Functor functor;
+    };
+
+    TimerId Insert(Duration delay, Functor& f);
+    uint64_t ToTicks(Timestamp t) const;
+    uint64_t DelayToTicks(Duration delay) const;
+    uint32_t SlotFor(uint64_t expire) const;
+    void Link(uint32_t index);
+    void Unlink(uint32_t index);
+    void Release(uint32_t index);
+    uint32_t Lookup(TimerId id) const;
+    void Cascade(int level);
+    void Expire(uint32_t slot);
+    void OnTick();
+    void Arm();
+
+private:
+    EventLoop* loop_;
+    Duration tick_;
+    Timestamp origin_;
+    uint64_t current_;          // next tick to process
+    size_t active_;
+    bool armed_;
+
+    std::vector<Node> nodes_;
+    uint32_t free_head_;
+    uint32_t expiring_head_;    // the slot Expire() is running
+    uint32_t heads_[kSlotCount];
+    std::unique_ptr<TimerEventWatcher> watcher_;
+};
+}
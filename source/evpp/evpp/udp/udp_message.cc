@@ -0,0 +1,73 @@
+#include "evpp/inner_pre.h"
+
+#include "udp_message.h"
+
+namespace evpp {
+namespace udp {
+
+#ifdef __linux__
+namespace {
+const size_t kMaxSendBatch = 64;
+
+// Sends msgs[begin, end), which all share one socket, with sendmmsg
+size_t SendRun(const MessageBatch& msgs, size_t begin, size_t end) {
+    struct mmsghdr hdrs[kMaxSendBatch];
+    struct iovec iovs[kMaxSendBatch];
+    size_t sent = 0;
+    while (begin < end) {
+        size_t count = std::min(end - begin, kMaxSendBatch);
+        for (size_t i = 0; i < count; ++i) {
+            const MessagePtr& msg = msgs[begin + i];
+            iovs[i].iov_base = const_cast<char*>(msg->data());
+            iovs[i].iov_len = msg->size();
+            memset(&hdrs[i], 0, sizeof(hdrs[i]));
+            hdrs[i].msg_hdr.msg_name = const_cast<struct sockaddr*>(msg->remote_addr());
+            hdrs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            hdrs[i].msg_hdr.msg_iov = &iovs[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = ::sendmmsg(msgs[begin]->sockfd(), hdrs, unsigned(count), 0);
+        if (n < 0) {
+            int eno = errno;
+            LOG_ERROR << "sendmmsg failed errno=" << eno << " " << strerror(eno);
+            // Skip the datagram that failed, like a failed sendto would
+            n = 0;
+        } else {
+            sent += n;
+        }
+
+        // sendmmsg stops at the first datagram that fails
+        begin += (size_t(n) < count ? n + 1 : n);
+    }
+    return sent;
+}
+}
+
+size_t SendMessages(const MessageBatch& msgs) {
+    size_t sent = 0;
+    size_t begin = 0;
+    while (begin < msgs.size()) {
+        size_t end = begin + 1;
+        while (end < msgs.size() && msgs[end]->sockfd() == msgs[begin]->sockfd()) {
+            ++end;
+        }
+        sent += SendRun(msgs, begin, end);
+        begin = end;
+    }
+    return sent;
+}
+#else
+size_t SendMessages(const MessageBatch& msgs) {
+    size_t sent = 0;
+    for (auto& msg : msgs) {
+        if (SendMessage(msg)) {
+            ++sent;
+        }
+    }
+    return sent;
+}
+#endif
+
+}
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "evpp/buffer.h"
 #include "evpp/sys_sockets.h"
 #include "evpp/sockets.h"
@@ -28,6 +30,7 @@ private:
     int sockfd_;
 };
 typedef std::shared_ptr<Message> MessagePtr;
+typedef std::vector<MessagePtr> MessageBatch;
 
 inline void Message::set_remote_addr(const struct sockaddr& raddr) {
     memcpy(&remote_addr_, &raddr, sizeof raddr);
@@ -72,5 +75,10 @@ inline bool SendMessage(const MessagePtr& msg) {
     return SendMessage(msg->sockfd(), msg->remote_addr(), msg->data(), msg->size());
 }
 
+// Sends every message to its remote_addr() through its sockfd(), with one
+// sendmmsg call per run of messages on the same socket on Linux.
+// @return the number of messages sent
+EVPP_EXPORT size_t SendMessages(const MessageBatch& msgs);
+
 }
 }
\ No newline at end of file
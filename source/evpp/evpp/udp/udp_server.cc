@@ -46,6 +46,12 @@ public:
     }
 
     bool Run() {
+#ifdef __linux__
+        if (server_->batch_size_ > 1) {
+            this->thread_.reset(new std::thread(std::bind(&Server::RecvingBatchLoop, this->server_, this)));
+            return true;
+        }
+#endif
         this->thread_.reset(new std::thread(std::bind(&Server::RecvingLoop, this->server_, this)));
         return true;
     }
@@ -100,7 +106,7 @@ private:
     Status status_;
 };
 
-Server::Server() : recv_buf_size_(1472) {}
+Server::Server() : recv_buf_size_(1472), batch_size_(1) {}
 
 Server::~Server() {
 }
@@ -145,7 +151,7 @@ void Server::AfterFork() {
 }
 
 bool Server::Start() {
-    if (!message_handler_) {
+    if (!message_handler_ && !batch_message_handler_) {
         LOG_ERROR << "MessageHandler DO NOT set!";
         return false;
     }
@@ -217,8 +223,6 @@ void Server::RecvingLoop(RecvThread* thread) {
             break;
         }
 
-        // TODO use recvmmsg to improve performance
-
         MessagePtr recv_msg(new Message(thread->fd(), recv_buf_size_));
         socklen_t addr_len = sizeof(struct sockaddr);
         int readn = ::recvfrom(thread->fd(), (char*)recv_msg->WriteBegin(), recv_buf_size_, 0, recv_msg->mutable_remote_addr(), &addr_len);
@@ -227,30 +231,164 @@ void Server::RecvingLoop(RecvThread* thread) {
                       << " recv len=" << readn << " from " << sock::ToIPPort(recv_msg->remote_addr());
 
             recv_msg->WriteBytes(readn);
-            if (tpool_) {
-                EventLoop* loop = nullptr;
-                if (IsRoundRobin()) {
-                    loop = tpool_->GetNextLoop();
-                } else {
-                    loop = tpool_->GetNextLoopWithHash(sock::sockaddr_in_cast(recv_msg->remote_addr())->sin_addr.s_addr);
-                }
-                loop->RunInLoop(std::bind(this->message_handler_, loop, recv_msg));
+            Dispatch(recv_msg);
+        } else {
+            int eno = errno;
+            if (EVUTIL_ERR_RW_RETRIABLE(eno)) {
+                continue;
+            }
+
+            LOG_ERROR << "errno=" << eno << " " << strerror(eno);
+        }
+    }
+
+    LOG_INFO << "fd=" << thread->fd() << " port=" << thread->port() << " UDP server existed.";
+    thread->SetStatus(kStopped);
+}
+
+#ifdef __linux__
+void Server::RecvingBatchLoop(RecvThread* thread) {
+    LOG_INFO << "UDPServer is running at 0.0.0.0:" << thread->port() << " batch_size=" << batch_size_;
+
+    // The slab of messages recvmmsg writes into. A slot is handed to the
+    // handler and reused for a later batch once the handler has dropped it.
+    const size_t batch_size = batch_size_;
+    std::vector<MessagePtr> slots(batch_size);
+    std::vector<struct mmsghdr> hdrs(batch_size);
+    std::vector<struct iovec> iovs(batch_size);
+    MessageBatch batch;
+    batch.reserve(batch_size);
+    size_t used = batch_size; // slots filled by the last call, to be refreshed
+
+    thread->SetStatus(kRunning);
+    while (true) {
+        if (thread->IsPaused()) {
+            usleep(1);
+            continue;
+        }
+
+        if (!thread->IsRunning()) {
+            break;
+        }
+
+        for (size_t i = 0; i < used; ++i) {
+            MessagePtr& slot = slots[i];
+            if (slot && slot.use_count() == 1) {
+                // Pairs with the release of the handler's last reference
+                std::atomic_thread_fence(std::memory_order_acquire);
+                slot->Reset();
             } else {
-                this->message_handler_(nullptr, recv_msg);
+                slot.reset(new Message(thread->fd(), recv_buf_size_));
             }
-        } else {
+
+            iovs[i].iov_base = slot->WriteBegin();
+            iovs[i].iov_len = recv_buf_size_;
+            memset(&hdrs[i], 0, sizeof(hdrs[i]));
+            hdrs[i].msg_hdr.msg_name = slot->mutable_remote_addr();
+            hdrs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            hdrs[i].msg_hdr.msg_iov = &iovs[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // Blocks for the first datagram (up to SO_RCVTIMEO), then takes what is queued
+        int n = ::recvmmsg(thread->fd(), &hdrs[0], unsigned(batch_size), MSG_WAITFORONE, nullptr);
+        used = 0;
+        if (n < 0) {
             int eno = errno;
             if (EVUTIL_ERR_RW_RETRIABLE(eno)) {
                 continue;
             }
 
             LOG_ERROR << "errno=" << eno << " " << strerror(eno);
+            continue;
+        }
+
+        // A partial batch waits once for more datagrams. Sleeping rather than
+        // polling keeps a trickle of datagrams from waking us up one by one,
+        // and recvmmsg's own timeout is only checked after a datagram arrives.
+        if (size_t(n) < batch_size && batch_timeout_.Nanoseconds() > 0) {
+            usleep(useconds_t(batch_timeout_.Microseconds()));
+            int m = ::recvmmsg(thread->fd(), &hdrs[n], unsigned(batch_size - n), MSG_DONTWAIT, nullptr);
+            if (m > 0) {
+                n += m;
+            }
+        }
+
+        LOG_TRACE << "fd=" << thread->fd() << " port=" << thread->port() << " recv " << n << " datagrams";
+        used = size_t(n);
+
+        if (batch_message_handler_) {
+            for (int i = 0; i < n; ++i) {
+                slots[i]->WriteBytes(hdrs[i].msg_len);
+                batch.push_back(slots[i]);
+            }
+            Dispatch(batch);
+            batch.clear();
+        } else {
+            for (int i = 0; i < n; ++i) {
+                slots[i]->WriteBytes(hdrs[i].msg_len);
+                MessagePtr msg = slots[i];
+                Dispatch(msg);
+            }
         }
     }
 
     LOG_INFO << "fd=" << thread->fd() << " port=" << thread->port() << " UDP server existed.";
     thread->SetStatus(kStopped);
 }
+#endif
+
+void Server::Dispatch(MessagePtr& msg) {
+    if (!message_handler_) {
+        MessageBatch batch(1, msg);
+        Dispatch(batch);
+        return;
+    }
+
+    if (tpool_) {
+        EventLoop* loop = nullptr;
+        if (IsRoundRobin()) {
+            loop = tpool_->GetNextLoop();
+        } else {
+            loop = tpool_->GetNextLoopWithHash(sock::sockaddr_in_cast(msg->remote_addr())->sin_addr.s_addr);
+        }
+        loop->RunInLoop(std::bind(this->message_handler_, loop, msg));
+    } else {
+        this->message_handler_(nullptr, msg);
+    }
+}
+
+void Server::Dispatch(MessageBatch& msgs) {
+    if (!tpool_) {
+        this->batch_message_handler_(nullptr, msgs);
+        return;
+    }
+
+    if (IsRoundRobin()) {
+        EventLoop* loop = tpool_->GetNextLoop();
+        loop->RunInLoop(std::bind(this->batch_message_handler_, loop, msgs));
+        return;
+    }
+
+    // Keep the per client ordering of IP address hashing
+    std::vector<std::pair<EventLoop*, MessageBatch>> parts;
+    for (auto& msg : msgs) {
+        EventLoop* loop = tpool_->GetNextLoopWithHash(sock::sockaddr_in_cast(msg->remote_addr())->sin_addr.s_addr);
+        auto it = parts.begin();
+        while (it != parts.end() && it->first != loop) {
+            ++it;
+        }
+        if (it == parts.end()) {
+            parts.push_back(std::make_pair(loop, MessageBatch()));
+            it = parts.end() - 1;
+        }
+        it->second.push_back(msg);
+    }
+
+    for (auto& p : parts) {
+        p.first->RunInLoop(std::bind(this->batch_message_handler_, p.first, std::move(p.second)));
+    }
+}
 
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "evpp/inner_pre.h"
+#include "evpp/duration.h"
 #include "evpp/thread_dispatch_policy.h"
 
 #include "udp_message.h"
@@ -17,6 +18,10 @@ namespace udp {
 class EVPP_EXPORT Server : public ThreadDispatchPolicy {
 public:
     typedef std::function<void(EventLoop*, MessagePtr& msg)> MessageHandler;
+
+    // Called with all the datagrams one recvmmsg call returned. With a
+    // thread pool and IP address hashing the batch is split per EventLoop.
+    typedef std::function<void(EventLoop*, MessageBatch& msgs)> BatchMessageHandler;
 public:
     Server();
     ~Server();
@@ -40,6 +45,11 @@ public:
         message_handler_ = handler;
     }
 
+    // Takes precedence over the MessageHandler if both are set
+    void SetBatchMessageHandler(BatchMessageHandler handler) {
+        batch_message_handler_ = handler;
+    }
+
     void SetEventLoopThreadPool(const std::shared_ptr<EventLoopThreadPool>& pool) {
         tpool_ = pool;
     }
@@ -48,12 +58,25 @@ public:
         recv_buf_size_ = v;
     }
 
+    // Datagrams received per recvmmsg call (Linux only, elsewhere it stays 1).
+    // Default : 1, one recvfrom per datagram
+    void set_batch_size(size_t v) {
+        batch_size_ = v;
+    }
+
+    // How long a partial batch waits for more datagrams before it is handled.
+    // Default : 0, take whatever is already queued in the socket
+    void set_batch_timeout(Duration d) {
+        batch_timeout_ = d;
+    }
+
 private:
     class RecvThread;
     typedef std::shared_ptr<RecvThread> RecvThreadPtr;
     std::vector<RecvThreadPtr> recv_threads_;
 
     MessageHandler   message_handler_;
+    BatchMessageHandler batch_message_handler_;
 
     // The worker thread pool, used to process UDP package
     std::shared_ptr<EventLoopThreadPool> tpool_;
@@ -62,8 +85,16 @@ private:
     // The minimum size is 1472, maximum size is 65535. Default : 1472
     // We can increase this size to receive a larger UDP package
     size_t recv_buf_size_;
+
+    size_t batch_size_;
+    Duration batch_timeout_;
 private:
     void RecvingLoop(RecvThread* th);
+#ifdef __linux__
+    void RecvingBatchLoop(RecvThread* th);
+#endif
+    void Dispatch(MessagePtr& msg);
+    void Dispatch(MessageBatch& msgs);
 };
 
 }
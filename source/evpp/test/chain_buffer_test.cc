@@ -0,0 +1,116 @@
+#include "test_common.h"
+
+#include <evpp/chain_buffer.h>
+#include <evpp/sockets.h>
+
+using evpp::ChainBuffer;
+using std::string;
+
+TEST_UNIT(testChainBufferAppendSkip) {
+    ChainBuffer buf;
+    H_TEST_EQUAL(buf.length(), 0);
+
+    // Small copies go to the contiguous head
+    buf.Append("abc", 3);
+    H_TEST_EQUAL(buf.head_length(), 3);
+    H_TEST_EQUAL(buf.segment_count(), 0);
+
+    // A large copy spans blocks, nothing already queued may move
+    const string str(ChainBuffer::kBlockSize * 2 + 100, 'x');
+    buf.Append(str.data(), str.size());
+    H_TEST_EQUAL(buf.length(), str.size() + 3);
+    H_TEST_EQUAL(buf.segment_count(), 3);
+
+    // Behind a queued segment even small copies go to the last block
+    buf.Append(string("def"));
+    H_TEST_EQUAL(buf.head_length(), 3);
+    H_TEST_EQUAL(buf.segment_count(), 3);
+    H_TEST_EQUAL(buf.ToString(), "abc" + str + "def");
+
+    buf.Skip(3 + ChainBuffer::kBlockSize + 1);
+    H_TEST_EQUAL(buf.head_length(), 0);
+    H_TEST_EQUAL(buf.segment_count(), 2);
+    H_TEST_EQUAL(buf.length(), str.size() + 3 - ChainBuffer::kBlockSize - 1);
+
+    buf.Reset();
+    H_TEST_EQUAL(buf.length(), 0);
+    H_TEST_EQUAL(buf.segment_count(), 0);
+
+    // With nothing queued the head takes copies again
+    buf.Append("ghi", 3);
+    H_TEST_EQUAL(buf.head_length(), 3);
+}
+
+TEST_UNIT(testChainBufferAppendRef) {
+    ChainBuffer buf;
+    buf.Append("head", 4);
+
+    std::shared_ptr<string> body = std::make_shared<string>(ChainBuffer::kMinRefSize, 'b');
+    std::weak_ptr<string> watch = body;
+    buf.AppendRef(evpp::Slice(body->data(), body->size()), body);
+    body.reset();
+    H_TEST_ASSERT(!watch.expired());
+
+    // A large string is taken over, a small one is copied into a block behind it
+    buf.Append(string(ChainBuffer::kMinRefSize, 'c'));
+    buf.Append(string("tail"));
+    H_TEST_EQUAL(buf.head_length(), 4);
+    H_TEST_EQUAL(buf.segment_count(), 3);
+
+    struct iovec vec[8];
+    H_TEST_EQUAL(buf.PeekIovec(vec, 8), 4);
+    H_TEST_EQUAL(vec[0].iov_len, 4);
+    H_TEST_EQUAL(vec[1].iov_len, ChainBuffer::kMinRefSize);
+
+    buf.Skip(4 + ChainBuffer::kMinRefSize - 1);
+    H_TEST_ASSERT(!watch.expired());
+    buf.Skip(1);
+    H_TEST_ASSERT(watch.expired());
+    H_TEST_EQUAL(buf.ToString(), string(ChainBuffer::kMinRefSize, 'c') + "tail");
+}
+
+#ifndef H_OS_WINDOWS
+TEST_UNIT(testChainBufferReadWriteFD) {
+    int fds[2];
+    H_TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    ChainBuffer out;
+    string expected;
+    for (int i = 0; i < 200; ++i) {
+        string line = std::to_string(i) + string(i * 10, 'z') + "\n";
+        expected += line;
+        out.Append(line.data(), line.size());
+    }
+    H_TEST_EQUAL(out.segment_count(), 0);
+
+    // The head alone goes out with a plain send
+    int serrno = 0;
+    ssize_t n = out.WriteToFD(fds[0], &serrno);
+    H_TEST_ASSERT(n > 0);
+    string got(expected.size(), '\0');
+    size_t read = 0;
+    while (read < size_t(n)) {
+        ssize_t r = ::read(fds[1], &got[read], size_t(n) - read);
+        H_TEST_ASSERT(r > 0);
+        read += size_t(r);
+    }
+    H_TEST_ASSERT(got.compare(0, read, expected, 0, read) == 0);
+    expected.erase(0, read);
+
+    out.Append(string(ChainBuffer::kMinRefSize * 2, 'r'));
+    expected += string(ChainBuffer::kMinRefSize * 2, 'r');
+
+    while (out.length() > 0) {
+        H_TEST_ASSERT(out.WriteToFD(fds[0], &serrno) > 0);
+    }
+
+    ChainBuffer in;
+    while (in.length() < expected.size()) {
+        H_TEST_ASSERT(in.ReadFromFD(fds[1], &serrno) > 0);
+    }
+    H_TEST_EQUAL(in.ToString(), expected);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif
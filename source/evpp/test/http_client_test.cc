@@ -11,6 +11,7 @@
 
 #include <evpp/httpc/request.h>
 #include <evpp/httpc/conn.h>
+#include <evpp/httpc/conn_pool.h>
 #include <evpp/httpc/response.h>
 
 #include "evpp/http/service.h"
@@ -163,3 +164,58 @@ TEST_UNIT(testHTTPClientRetryFailed) {
         usleep(1000 * 1000); // sleep a while to release the listening address and port
     }
 }
+
+namespace {
+    static void RequestHandlerEchoMethod(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        const char* v = ctx->FindRequestHeader("X-Test");
+        ctx->AddResponseHeader("X-Method", ctx->GetMethod());
+        ctx->AddResponseHeader("X-Echo", v ? v : "");
+        ctx->set_response_http_code(201);
+        cb(ctx->GetMethod() + ":" + ctx->body().ToString());
+    }
+}
+
+TEST_UNIT(testHTTPClientMethodAndHeaders) {
+    const int port = 49002;
+    evpp::http::Server ph(1);
+    ph.RegisterHandler("/echo", &RequestHandlerEchoMethod);
+    bool r = ph.Init(port) && ph.Start();
+    H_TEST_ASSERT(r);
+
+    evpp::EventLoopThread t;
+    t.Start(true);
+    evpp::httpc::ConnPool pool("127.0.0.1", port, evpp::Duration(2.0));
+    std::atomic<int> finished(0);
+
+    auto run = [&](const std::string& method, const std::string& body) {
+        auto req = new evpp::httpc::Request(&pool, t.loop(), "/echo?a=1", body);
+        req->set_method(method);
+        req->set_retry_number(0);
+        req->AddHeader("X-Test", method + "-header");
+        req->Execute([req, method, body, &finished](const std::shared_ptr<evpp::httpc::Response>& response) {
+            H_TEST_ASSERT(response->http_code() == 201);
+            H_TEST_ASSERT(response->body().ToString() == method + ":" + body);
+            bool saw_method = false;
+            bool saw_echo = false;
+            for (auto& h : response->headers()) {
+                saw_method |= (h.first == "X-Method" && h.second == method);
+                saw_echo |= (h.first == "X-Echo" && h.second == method + "-header");
+            }
+            H_TEST_ASSERT(saw_method && saw_echo);
+            delete req;
+            finished++;
+        });
+    };
+
+    run("PUT", "");
+    run("DELETE", "");
+    run("POST", "town");
+    while (finished.load() != 3) {
+        usleep(10);
+    }
+
+    t.loop()->RunInLoop([&pool]() { pool.Clear(); });
+    t.Stop(true);
+    ph.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
@@ -0,0 +1,153 @@
+#include "test_common.h"
+
+#include <evpp/libevent.h>
+#include <evpp/event_loop_thread.h>
+
+#include <evpp/httpc/request.h>
+#include <evpp/httpc/response.h>
+
+#include "evpp/http/context.h"
+#include "evpp/http/http_server.h"
+
+#include <atomic>
+
+// Three servers on localhost: the front node forwards every request to the node
+// named by the first uri segment, the way a node forwards a player's requests to
+// the node owning their town. The owner answers, the third node is configured
+// but down.
+namespace {
+
+    const int kFrontPort = 49020;
+    const int kOwnerPort = 49021;
+    const int kDownPort = 49022;
+
+    std::string NodeAddress(int port) {
+        return "127.0.0.1:" + std::to_string(port);
+    }
+
+    static void OwnerHandler(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        const char* by = ctx->FindRequestHeader("X-Tsto-Forwarded-By");
+        const char* town = ctx->FindRequestHeader("X-Tsto-Town");
+        if (!by || std::string(by) != NodeAddress(kFrontPort) || !town) {
+            ctx->set_response_http_code(403);
+            cb("not forwarded");
+            return;
+        }
+
+        const char* if_none_match = ctx->FindRequestHeader("If-None-Match");
+        ctx->AddResponseHeader("ETag", "\"v1\"");
+        if (if_none_match && std::string(if_none_match) == "\"v1\"") {
+            ctx->set_response_http_code(304);
+            cb("");
+            return;
+        }
+
+        cb(ctx->GetMethod() + " " + ctx->uri() + " town=" + town + " body=" + ctx->body().ToString());
+    }
+
+    static void FrontHandler(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        // "/<port>/rest" goes to 127.0.0.1:<port> as "/rest"
+        const std::string& uri = ctx->uri();
+        const size_t slash = uri.find('/', 1);
+        const int port = std::atoi(uri.substr(1, slash - 1).c_str());
+        const std::string url = "http://" + NodeAddress(port) + uri.substr(slash);
+
+        auto request = new evpp::httpc::Request(loop, url, ctx->body().ToString(), evpp::Duration(2.0));
+        request->set_method(ctx->GetMethod());
+        request->set_retry_number(0);
+        if (const char* v = ctx->FindRequestHeader("If-None-Match")) {
+            request->AddHeader("If-None-Match", v);
+        }
+        request->AddHeader("X-Tsto-Forwarded-By", NodeAddress(kFrontPort));
+        request->AddHeader("X-Tsto-Town", "player@example.com.pb");
+
+        request->Execute([request, ctx, cb](const std::shared_ptr<evpp::httpc::Response>& response) {
+            if (response->http_code() <= 0) {
+                ctx->set_response_http_code(502);
+                cb("Bad Gateway");
+                delete request;
+                return;
+            }
+
+            ctx->set_response_http_code(response->http_code());
+            for (const auto& h : response->headers()) {
+                if (h.first == "ETag") {
+                    ctx->AddResponseHeader(h.first, h.second);
+                }
+            }
+            cb(response->body().ToString());
+            delete request;
+        });
+    }
+
+    std::string ResponseHeader(const std::shared_ptr<evpp::httpc::Response>& response, const std::string& name) {
+        for (const auto& h : response->headers()) {
+            if (h.first == name) {
+                return h.second;
+            }
+        }
+        return "";
+    }
+}
+
+TEST_UNIT(testHTTPForwardThreeNodes) {
+    evpp::http::Server owner(1);
+    owner.RegisterDefaultHandler(&OwnerHandler);
+    evpp::http::Server front(1);
+    front.RegisterDefaultHandler(&FrontHandler);
+    bool r = owner.Init(kOwnerPort) && owner.Start() && front.Init(kFrontPort) && front.Start();
+    H_TEST_ASSERT(r);
+
+    evpp::EventLoopThread t;
+    t.Start(true);
+    std::atomic<int> finished(0);
+
+    auto run = [&](const std::string& method, int port, const std::string& body, const std::string& if_none_match,
+                   const std::function<void(const std::shared_ptr<evpp::httpc::Response>&)>& check) {
+        const std::string url = "http://" + NodeAddress(kFrontPort) + "/" + std::to_string(port) + "/protoland/123/";
+        auto req = new evpp::httpc::Request(t.loop(), url, body, evpp::Duration(5.0));
+        req->set_method(method);
+        req->set_retry_number(0);
+        if (!if_none_match.empty()) {
+            req->AddHeader("If-None-Match", if_none_match);
+        }
+        req->Execute([req, check, &finished](const std::shared_ptr<evpp::httpc::Response>& response) {
+            check(response);
+            delete req;
+            finished++;
+        });
+    };
+
+    // the owner answers with the town the front node named
+    run("GET", kOwnerPort, "", "", [](const std::shared_ptr<evpp::httpc::Response>& response) {
+        H_TEST_ASSERT(response->http_code() == 200);
+        H_TEST_ASSERT(response->body().ToString() == "GET /protoland/123/ town=player@example.com.pb body=");
+        H_TEST_ASSERT(ResponseHeader(response, "ETag") == "\"v1\"");
+    });
+
+    // method and body make it across the hop
+    run("POST", kOwnerPort, "town", "", [](const std::shared_ptr<evpp::httpc::Response>& response) {
+        H_TEST_ASSERT(response->http_code() == 200);
+        H_TEST_ASSERT(response->body().ToString() == "POST /protoland/123/ town=player@example.com.pb body=town");
+    });
+
+    // a 304 from the owner reaches the client as a 304
+    run("GET", kOwnerPort, "", "\"v1\"", [](const std::shared_ptr<evpp::httpc::Response>& response) {
+        H_TEST_ASSERT(response->http_code() == 304);
+        H_TEST_ASSERT(response->body().ToString().empty());
+    });
+
+    // the third node does not answer
+    run("GET", kDownPort, "", "", [](const std::shared_ptr<evpp::httpc::Response>& response) {
+        H_TEST_ASSERT(response->http_code() == 502);
+    });
+
+    while (finished.load() != 4) {
+        usleep(10);
+    }
+
+    t.Stop(true);
+    front.Stop();
+    owner.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
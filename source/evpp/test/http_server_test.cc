@@ -37,6 +37,13 @@ static void RequestHandler201(evpp::EventLoop* loop, const evpp::http::ContextPt
     cb(oss.str());
 }
 
+// Answers like a town GET whose If-None-Match matched: a 304 with no body
+static void RequestHandler304(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+    ctx->AddResponseHeader("ETag", "\"v1\"");
+    ctx->set_response_http_code(304);
+    cb("");
+}
+
 static void RequestHandler909(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
     LOG_INFO << "RequestHandler909";
     std::stringstream oss;
@@ -48,6 +55,15 @@ static void RequestHandler909(evpp::EventLoop* loop, const evpp::http::ContextPt
     cb(oss.str());
 }
 
+static void RequestHandlerChunked(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+    ctx->SendReplyStart();
+    ctx->SendReplyChunk("func=RequestHandlerChunked");
+    ctx->SendReplyChunk(" uri=" + ctx->uri());
+    ctx->SendReplyChunk("");
+    ctx->SendReplyChunk(" done");
+    ctx->SendReplyEnd();
+}
+
 static void DefaultRequestHandler(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
     //std::cout << __func__ << " called ...\n";
     std::stringstream oss;
@@ -171,6 +187,26 @@ void testRequestHandler201(evpp::EventLoop* loop, int* finished) {
     r->Execute(f);
 }
 
+void testRequestHandler304(evpp::EventLoop* loop, int* finished) {
+    std::string uri = "/304";
+    std::string url = GetHttpServerURL() + uri;
+    auto r = new evpp::httpc::Request(loop, url, "", evpp::Duration(10.0));
+    r->AddHeader("If-None-Match", "\"v1\"");
+    auto f = [r, finished](const std::shared_ptr<evpp::httpc::Response>& response) {
+        H_TEST_ASSERT(response->http_code() == 304);
+        H_TEST_ASSERT(response->body().ToString().empty());
+        bool etag = false;
+        for (const auto& h : response->headers()) {
+            etag = etag || (h.first == "ETag" && h.second == "\"v1\"");
+        }
+        H_TEST_ASSERT(etag);
+        *finished += 1;
+        delete r;
+    };
+
+    r->Execute(f);
+}
+
 void testRequestHandler909(evpp::EventLoop* loop, int* finished) {
     std::string uri = "/909";
     std::string url = GetHttpServerURL() + uri;
@@ -208,6 +244,21 @@ void testRequestHandlerUriPathAndParam(evpp::EventLoop* loop, int* finished) {
     r->Execute(f);
 }
 
+void testRequestHandlerChunked(evpp::EventLoop* loop, int* finished) {
+    std::string uri = "/chunked";
+    std::string url = GetHttpServerURL() + uri;
+    auto r = new evpp::httpc::Request(loop, url, "", evpp::Duration(10.0));
+    auto f = [r, finished](const std::shared_ptr<evpp::httpc::Response>& response) {
+        std::string result = response->body().ToString();
+        H_TEST_ASSERT(response->http_code() == 200);
+        H_TEST_ASSERT(result == "func=RequestHandlerChunked uri=/chunked done");
+        *finished += 1;
+        delete r;
+    };
+
+    r->Execute(f);
+}
+
 void testStop(evpp::EventLoop* loop, int* finished) {
     std::string uri = "/mod/stop";
     std::string url = GetHttpServerURL() + uri;
@@ -233,13 +284,15 @@ static void TestAll() {
     testDefaultHandler3(t.loop(), &finished);
     testPushBootHandler(t.loop(), &finished);
     testRequestHandler201(t.loop(), &finished);
+    testRequestHandler304(t.loop(), &finished);
     testRequestHandler909(t.loop(), &finished);
+    testRequestHandlerChunked(t.loop(), &finished);
     testStop(t.loop(), &finished);
 
     while (true) {
         usleep(10);
 
-        if (finished == 7) {
+        if (finished == 9) {
             break;
         }
     }
@@ -275,7 +328,9 @@ TEST_UNIT(testHTTPServer) {
         ph.RegisterDefaultHandler(&DefaultRequestHandler);
         ph.RegisterHandler("/push/boot", &RequestHandler);
         ph.RegisterHandler("/201", &RequestHandler201);
+        ph.RegisterHandler("/304", &RequestHandler304);
         ph.RegisterHandler("/909", &RequestHandler909);
+        ph.RegisterHandler("/chunked", &RequestHandlerChunked);
         bool r = ph.Init(g_listening_port) && ph.Start();
         H_TEST_ASSERT(r);
         TestAll();
@@ -297,3 +352,87 @@ TEST_UNIT(testHTTPServer909) {
         usleep(1000 * 1000); // sleep a while to release the listening address and port
     }
 }
+
+TEST_UNIT(testHTTPServerMaxBodySize) {
+    evpp::http::Server ph(1);
+    ph.RegisterDefaultHandler(&DefaultRequestHandler);
+    ph.SetMaxBodySize(1024);
+    bool r = ph.Init(g_listening_port) && ph.Start();
+    H_TEST_ASSERT(r);
+
+    evpp::EventLoopThread t;
+    t.Start(true);
+    int finished = 0;
+
+    // A body over the limit is refused before the handler runs, one under it is served
+    auto post = [&t, &finished](size_t body_size, int expected_code) {
+        std::string url = GetHttpServerURL() + "/upload";
+        auto req = new evpp::httpc::Request(t.loop(), url, std::string(body_size, 'b'), evpp::Duration(10.0));
+        req->Execute([req, expected_code, &finished](const std::shared_ptr<evpp::httpc::Response>& response) {
+            H_TEST_ASSERT(response->http_code() == expected_code);
+            finished += 1;
+            delete req;
+        });
+    };
+    post(4096, 413);
+    post(512, 200);
+
+    while (finished != 2) {
+        usleep(10);
+    }
+
+    t.Stop(true);
+    ph.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
+
+TEST_UNIT(testHTTPServerPortInUse) {
+    evpp::http::Server first(1);
+    first.RegisterDefaultHandler(&DefaultRequestHandler);
+    bool r = first.Init(g_listening_port) && first.Start();
+    H_TEST_ASSERT(r);
+
+    // Without SetReusePort a second server on the same port must fail to start
+    evpp::http::Server second(1);
+    second.RegisterDefaultHandler(&DefaultRequestHandler);
+    H_TEST_ASSERT(!second.Init(g_listening_port));
+
+    first.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
+
+TEST_UNIT(testHTTPServerReplied) {
+    evpp::http::Server ph(1);
+    std::atomic<int> before(-1);
+    std::atomic<int> after(-1);
+    ph.RegisterDefaultHandler([&before, &after](evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
+                                                const evpp::http::HTTPSendResponseCallback& cb) {
+        before = ctx->replied() ? 1 : 0;
+        cb("ok");
+        after = ctx->replied() ? 1 : 0;
+    });
+    bool r = ph.Init(g_listening_port) && ph.Start();
+    H_TEST_ASSERT(r);
+
+    evpp::EventLoopThread t;
+    t.Start(true);
+    std::atomic<bool> finished(false);
+    std::string url = GetHttpServerURL() + "/replied";
+    auto req = new evpp::httpc::Request(t.loop(), url, "", evpp::Duration(10.0));
+    req->Execute([req, &finished](const std::shared_ptr<evpp::httpc::Response>& response) {
+        H_TEST_ASSERT(response->http_code() == 200);
+        finished = true;
+        delete req;
+    });
+    while (!finished) {
+        usleep(10);
+    }
+
+    // Whoever answers late, e.g. after a handler threw, can tell a reply already went out
+    H_TEST_ASSERT(before == 0);
+    H_TEST_ASSERT(after == 1);
+
+    t.Stop(true);
+    ph.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
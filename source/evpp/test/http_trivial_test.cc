@@ -2,6 +2,7 @@
 
 #include <evpp/httpc/url_parser.h>
 #include <evpp/http/context.h>
+#include <evpp/libevent.h>
 
 TEST_UNIT(testURLParser) {
     struct TestCase {
@@ -84,3 +85,36 @@ TEST_UNIT(TestFindClientIPFromURI) {
         H_TEST_ASSERT(ip == cases[i].ip);
     }
 }
+
+TEST_UNIT(TestContextBodySegments) {
+    static const char* parts[] = { "first segment|", "second|", "third" };
+    struct evhttp_request* req = evhttp_request_new(nullptr, nullptr);
+    req->type = EVHTTP_REQ_POST;
+    req->uri = strdup("/protoland?clientip=1.2.3.4");
+    req->uri_elems = evhttp_uri_parse(req->uri);
+
+    // References keep each part in its own chain, like reads from the socket
+    struct evbuffer* evbuf = evhttp_request_get_input_buffer(req);
+    for (size_t i = 0; i < H_ARRAYSIZE(parts); i++) {
+        evbuffer_add_reference(evbuf, parts[i], strlen(parts[i]), nullptr, nullptr);
+    }
+
+    evpp::http::ContextPtr ctx(new evpp::http::Context(req));
+    H_TEST_ASSERT(ctx->Init());
+    H_TEST_ASSERT(ctx->body_size() == strlen("first segment|second|third"));
+
+    std::vector<evpp::Slice> segments = ctx->body_segments();
+    H_TEST_ASSERT(segments.size() == H_ARRAYSIZE(parts));
+    for (size_t i = 0; i < segments.size(); i++) {
+        H_TEST_ASSERT(segments[i].ToString() == parts[i]);
+        H_TEST_ASSERT(segments[i].data() == parts[i]);
+    }
+
+    H_TEST_ASSERT(ctx->body().ToString() == "first segment|second|third");
+    segments = ctx->body_segments();
+    H_TEST_ASSERT(segments.size() == 1);
+    H_TEST_ASSERT(segments[0].ToString() == "first segment|second|third");
+
+    ctx.reset();
+    evhttp_request_free(req);
+}
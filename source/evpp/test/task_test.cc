@@ -0,0 +1,79 @@
+
+#include "test_common.h"
+
+#include <evpp/libevent.h>
+#include <evpp/event_loop.h>
+#include <evpp/task.h>
+
+#include <array>
+#include <thread>
+
+namespace {
+struct Counted {
+    static int alive;
+    int* calls;
+    Counted(int* c) : calls(c) { alive++; }
+    Counted(const Counted& o) : calls(o.calls) { alive++; }
+    Counted(Counted&& o) noexcept : calls(o.calls) { alive++; }
+    ~Counted() { alive--; }
+    void operator()() { (*calls)++; }
+};
+int Counted::alive = 0;
+
+// Too big to be kept inline
+struct Big : public Counted {
+    char payload[512]{};
+    Big(int* c) : Counted(c) {}
+};
+}
+
+TEST_UNIT(testTaskInlineAndPooled) {
+    int calls = 0;
+    {
+        evpp::Task a = Counted(&calls);
+        evpp::Task b = Big(&calls);
+        H_TEST_ASSERT(Counted::alive == 2);
+
+        evpp::Task c(std::move(a));
+        evpp::Task d;
+        d = std::move(b);
+        H_TEST_ASSERT(!a && !b && c && d);
+        H_TEST_ASSERT(Counted::alive == 2);
+
+        c();
+        d();
+        H_TEST_ASSERT(calls == 2);
+
+        c = std::move(d);
+        H_TEST_ASSERT(Counted::alive == 1);
+        c();
+        H_TEST_ASSERT(calls == 3);
+    }
+    H_TEST_ASSERT(Counted::alive == 0);
+}
+
+TEST_UNIT(testTaskQueueInLoop) {
+    std::shared_ptr<evpp::EventLoop> loop(new evpp::EventLoop);
+    std::thread th([loop]() { loop->Run(); });
+    while (!loop->IsRunning()) {
+        usleep(1000);
+    }
+
+    std::atomic<int> sum(0);
+    const int kCount = 1000;
+    for (int i = 0; i < kCount; ++i) {
+        std::string body(i % 2 ? 200 : 8, 'x');
+        std::array<char, 256> big;
+        big[0] = 1;
+        if (i % 3) {
+            loop->QueueInLoop([&sum, body]() { sum += 1; });
+        } else {
+            loop->QueueInLoop([&sum, big]() { sum += big[0]; });
+        }
+    }
+    loop->QueueInLoop([loop]() { loop->Stop(); });
+    th.join();
+    H_TEST_ASSERT(sum == kCount);
+    loop.reset();
+    H_TEST_ASSERT(evpp::GetActiveEventCount() == 0);
+}
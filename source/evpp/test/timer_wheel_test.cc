@@ -0,0 +1,131 @@
+
+#include "test_common.h"
+
+#include <evpp/libevent.h>
+#include <evpp/event_loop.h>
+#include <evpp/timer_wheel.h>
+#include <evpp/timestamp.h>
+
+#include <thread>
+
+TEST_UNIT(testTimerWheelOrder) {
+    evpp::EventLoop loop;
+    evpp::TimerWheel wheel(&loop);
+    std::vector<int> fired;
+    wheel.Add(evpp::Duration(0.03), [&fired]() { fired.push_back(3); });
+    wheel.Add(evpp::Duration(0.01), [&fired]() { fired.push_back(1); });
+    wheel.Add(evpp::Duration(0.02), [&fired]() { fired.push_back(2); });
+    H_TEST_ASSERT(wheel.size() == 3);
+
+    evpp::Timestamp now = evpp::Timestamp::Now();
+    wheel.Advance(now);
+    H_TEST_ASSERT(fired.empty());
+    wheel.Advance(now + evpp::Duration(0.1));
+    H_TEST_ASSERT(fired.size() == 3);
+    H_TEST_ASSERT(fired[0] == 1 && fired[1] == 2 && fired[2] == 3);
+    H_TEST_ASSERT(wheel.size() == 0);
+}
+
+TEST_UNIT(testTimerWheelCancelReschedule) {
+    evpp::EventLoop loop;
+    evpp::TimerWheel wheel(&loop);
+    int a = 0, b = 0;
+    evpp::TimerWheel::TimerId ida = wheel.Add(evpp::Duration(0.05), [&a]() { a++; });
+    evpp::TimerWheel::TimerId idb = wheel.Add(evpp::Duration(0.05), [&b]() { b++; });
+    H_TEST_ASSERT(ida != 0 && idb != 0 && ida != idb);
+
+    H_TEST_ASSERT(wheel.Cancel(ida));
+    H_TEST_ASSERT(!wheel.Cancel(ida));
+    H_TEST_ASSERT(wheel.Reschedule(idb, evpp::Duration(10.0)));
+
+    evpp::Timestamp now = evpp::Timestamp::Now();
+    wheel.Advance(now + evpp::Duration(1.0));
+    H_TEST_ASSERT(a == 0 && b == 0);
+    wheel.Advance(now + evpp::Duration(11.0));
+    H_TEST_ASSERT(a == 0 && b == 1);
+
+    // The node of a fired timer is reused, its old id must stay dead
+    H_TEST_ASSERT(!wheel.Reschedule(idb, evpp::Duration(1.0)));
+    evpp::TimerWheel::TimerId idc = wheel.Add(evpp::Duration(0.05), []() {});
+    H_TEST_ASSERT(idc != idb && !wheel.Cancel(idb) && wheel.Cancel(idc));
+}
+
+TEST_UNIT(testTimerWheelCascade) {
+    evpp::EventLoop loop;
+    evpp::TimerWheel wheel(&loop);
+    evpp::Timestamp start = evpp::Timestamp::Now();
+
+    // Spread over every level, including past the wheel's span
+    const double delays[] = { 0.5, 2.5, 3.0, 100.0, 1000.0, 20000.0, 800000.0 };
+    const size_t count = sizeof(delays) / sizeof(delays[0]);
+    std::vector<double> fired_at;
+    for (size_t i = 0; i < count; ++i) {
+        double d = delays[i];
+        wheel.Add(evpp::Duration(d), [&fired_at, d]() { fired_at.push_back(d); });
+    }
+
+    // Walk the clock in 7 second steps, nothing may fire early or be lost
+    for (double t = 0; t <= 800010.0; t += 7.0) {
+        size_t before = fired_at.size();
+        wheel.Advance(start + evpp::Duration(t));
+        for (size_t i = before; i < fired_at.size(); ++i) {
+            H_TEST_ASSERT(fired_at[i] <= t);
+            H_TEST_ASSERT(fired_at[i] > t - 7.1);
+        }
+    }
+    H_TEST_ASSERT(fired_at.size() == count);
+    H_TEST_ASSERT(wheel.size() == 0);
+}
+
+TEST_UNIT(testTimerWheelInCallback) {
+    evpp::EventLoop loop;
+    evpp::TimerWheel wheel(&loop);
+    int fired = 0;
+    evpp::TimerWheel::TimerId ids[2] = { 0, 0 };
+
+    // Both land in the same batch, whichever runs first cancels the other
+    // one and adds a new timer from inside the callback.
+    for (int i = 0; i < 2; ++i) {
+        ids[i] = wheel.Add(evpp::Duration(0.02), [&, i]() {
+            fired++;
+            H_TEST_ASSERT(wheel.Cancel(ids[1 - i]));
+            wheel.Add(evpp::Duration(0.02), [&fired]() { fired += 10; });
+        });
+    }
+
+    evpp::Timestamp now = evpp::Timestamp::Now();
+    wheel.Advance(now + evpp::Duration(0.1));
+    H_TEST_ASSERT(fired == 1 || fired == 11);
+    wheel.Advance(now + evpp::Duration(0.2));
+    H_TEST_ASSERT(fired == 11);
+    H_TEST_ASSERT(wheel.size() == 0);
+}
+
+TEST_UNIT(testTimerWheelEventLoop) {
+    std::shared_ptr<evpp::EventLoop> loop(new evpp::EventLoop);
+    std::thread th([loop]() { loop->Run(); });
+    while (!loop->IsRunning()) {
+        usleep(1000);
+    }
+
+    evpp::Duration delay(0.1);
+    evpp::Timestamp start = evpp::Timestamp::Now();
+    std::atomic<int> fired(0);
+    evpp::Timestamp fired_at;
+    loop->RunInLoop([&]() {
+        evpp::TimerWheel* wheel = loop->timer_wheel();
+        evpp::TimerWheel::TimerId id = wheel->Add(delay, [&fired]() { fired += 100; });
+        wheel->Add(delay, [&]() {
+            fired_at = evpp::Timestamp::Now();
+            fired++;
+            loop->Stop();
+        });
+        wheel->Cancel(id);
+    });
+    th.join();
+
+    H_TEST_ASSERT(fired == 1);
+    H_TEST_ASSERT(fired_at - start >= delay);
+    loop.reset();
+    H_TEST_ASSERT(evpp::GetActiveEventCount() == 0);
+}
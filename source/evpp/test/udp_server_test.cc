@@ -2,6 +2,10 @@
 
 #include <evpp/udp/sync_udp_client.h>
 #include <evpp/udp/udp_server.h>
+#include <evpp/event_loop_thread.h>
+#include <evpp/event_loop_thread_pool.h>
+
+#include <atomic>
 
 namespace {
 static int g_count = 0;
@@ -88,4 +92,66 @@ TEST_UNIT(testUDPServerGraceStop) {
     udpsrv->Stop(true);
     H_TEST_ASSERT(udpsrv->IsStopped());
     delete udpsrv;
-}
\ No newline at end of file
+}
+namespace {
+static std::atomic<int> g_batch_count;
+static void OnBatch(evpp::EventLoop* loop, evpp::udp::MessageBatch& msgs) {
+    g_batch_count += int(msgs.size());
+    H_TEST_ASSERT(evpp::udp::SendMessages(msgs) == msgs.size());
+}
+}
+
+TEST_UNIT(testUDPServerBatch) {
+    LOG_TRACE << __func__;
+    g_batch_count = 0;
+    int port = 53670;
+    std::unique_ptr<evpp::EventLoopThread> base(new evpp::EventLoopThread);
+    base->Start(true);
+    std::shared_ptr<evpp::EventLoopThreadPool> tpool(new evpp::EventLoopThreadPool(base->loop(), 2));
+    H_TEST_ASSERT(tpool->Start(true));
+    evpp::udp::Server* udpsrv = new evpp::udp::Server;
+    udpsrv->SetBatchMessageHandler(&OnBatch);
+    udpsrv->SetEventLoopThreadPool(tpool);
+    udpsrv->set_batch_size(16);
+    udpsrv->set_batch_timeout(evpp::Duration(0.001));
+    H_TEST_ASSERT(udpsrv->Init(port) && udpsrv->Start());
+    usleep(100);//wait udpsrv started
+
+    int loop = 10;
+    for (int i = 0; i < loop; ++i) {
+        std::string req = "data " + std::to_string(i);
+        std::string resp = evpp::udp::sync::Client::DoRequest("127.0.0.1", port, req, g_timeout_ms);
+        H_TEST_ASSERT(req == resp);
+    }
+
+    H_TEST_ASSERT(g_batch_count == loop);
+    udpsrv->Stop(true);
+    H_TEST_ASSERT(udpsrv->IsStopped());
+    delete udpsrv;
+    tpool->Stop(true);
+    base->Stop(true);
+}
+
+TEST_UNIT(testUDPServerBatchWithMessageHandler) {
+    LOG_TRACE << __func__;
+    Init();
+    int port = 53671;
+    evpp::udp::Server* udpsrv = new evpp::udp::Server;
+    udpsrv->SetMessageHandler(std::bind(&OnMessage, udpsrv, std::placeholders::_1, std::placeholders::_2));
+    udpsrv->set_batch_size(16);
+    H_TEST_ASSERT(udpsrv->Init(port) && udpsrv->Start());
+    usleep(100);//wait udpsrv started
+
+    // The slab is reused between batches, every reply must still be its own request
+    int loop = 40;
+    for (int i = 0; i < loop; ++i) {
+        std::string req = "data " + std::to_string(i);
+        std::string resp = evpp::udp::sync::Client::DoRequest("127.0.0.1", port, req, g_timeout_ms);
+        H_TEST_ASSERT(req == resp);
+    }
+
+    H_TEST_ASSERT(g_count == loop);
+    udpsrv->Stop(true);
+    H_TEST_ASSERT(udpsrv->IsStopped());
+    delete udpsrv;
+}
@@ -0,0 +1,176 @@
+#include <std_include.hpp>
+#include "task.hpp"
+#include "debugging/serverlog.hpp"
+#include <configuration.hpp>
+#include <evpp/event_loop_thread_pool.h>
+#include <new>
+
+namespace server::async {
+
+    namespace frame_pool {
+        namespace {
+            constexpr size_t class_size = 256;
+            constexpr size_t class_count = 16;     //frames above 4KB go straight to the heap
+            constexpr size_t max_free = 64;         //per class and thread
+
+            struct free_frame {
+                free_frame* next;
+            };
+
+            struct free_lists {
+                free_frame* head[class_count] = {};
+                size_t count[class_count] = {};
+
+                ~free_lists() {
+                    for (size_t i = 0; i < class_count; ++i) {
+                        while (head[i]) {
+                            free_frame* frame = head[i];
+                            head[i] = frame->next;
+                            ::operator delete(frame);
+                        }
+                    }
+                }
+            };
+
+            thread_local free_lists lists;
+
+            size_t class_of(size_t size) {
+                return (size + class_size - 1) / class_size - 1;
+            }
+        }
+
+        void* allocate(size_t size) {
+            const size_t index = class_of(size);
+            if (index >= class_count) {
+                return ::operator new(size);
+            }
+            if (free_frame* frame = lists.head[index]) {
+                lists.head[index] = frame->next;
+                --lists.count[index];
+                return frame;
+            }
+            return ::operator new((index + 1) * class_size);
+        }
+
+        void deallocate(void* frame, size_t size) noexcept {
+            //a frame freed on another thread than it was made on just joins that thread's list
+            const size_t index = class_of(size);
+            if (index >= class_count || lists.count[index] >= max_free) {
+                ::operator delete(frame);
+                return;
+            }
+            auto* free = static_cast<free_frame*>(frame);
+            free->next = lists.head[index];
+            lists.head[index] = free;
+            ++lists.count[index];
+        }
+    }
+
+    void task::promise_type::unhandled_exception() noexcept {
+        try {
+            throw;
+        }
+        catch (const std::exception& ex) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
+                "[ASYNC] Handler coroutine threw: %s", ex.what());
+        }
+        catch (...) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
+                "[ASYNC] Handler coroutine threw an unknown exception");
+        }
+
+        //the parameters are still alive here, the frame goes after final_suspend
+        const evpp::http::ContextPtr& ctx = *ctx_;
+        if (ctx->replied()) {
+            return;
+        }
+        try {
+            ctx->set_response_http_code(500);
+            (*cb_)("Internal server error");
+        }
+        catch (...) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
+                "[ASYNC] Could not answer %s after the handler threw", ctx->uri().c_str());
+        }
+    }
+
+    IoPool& IoPool::get() {
+        static IoPool instance;
+        return instance;
+    }
+
+    IoPool::IoPool()
+        : threads_(utils::configuration::ReadUnsignedInteger("ServerConfig", "IoPoolThreads", 4)) {
+    }
+
+    IoPool::~IoPool() {
+        shutdown();
+    }
+
+    void IoPool::start() {
+        if (threads_ == 0 || pool_) {
+            return;
+        }
+
+        pool_ = std::make_unique<evpp::EventLoopThreadPool>(nullptr, threads_);
+        if (!pool_->Start(true)) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER,
+                "[ASYNC] Failed to start the io pool, blocking work stays on the worker loops");
+            pool_.reset();
+            return;
+        }
+        running_ = true;
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER,
+            "[ASYNC] Io pool started with %u threads", threads_);
+    }
+
+    void IoPool::shutdown() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+
+        //work already handed to the pool finishes and its coroutines resume on their loops,
+        //anything awaited from now on runs inline
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (pending_.load() > 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (const uint32_t left = pending_.load()) {
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_SERVER_HTTP,
+                "[ASYNC] Io pool stopped with %u handlers still waiting on it", left);
+        }
+
+        //the pool object is kept, a late next() may still be reading it
+        pool_->Stop(true);
+        pool_->Join();
+    }
+
+    evpp::EventLoop* IoPool::next() {
+        if (!running_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return pool_->GetNextLoop();
+    }
+
+    evpp::EventLoop* IoPool::next(uint64_t hash) {
+        if (!running_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return pool_->GetNextLoopWithHash(hash);
+    }
+
+    evpp::EventLoop* IoPool::enter(const std::optional<uint64_t>& hash) {
+        //counted before running_ is read, so shutdown() either sees the count or we see it stopping
+        pending_.fetch_add(1);
+        if (!running_.load()) {
+            pending_.fetch_sub(1);
+            return nullptr;
+        }
+        return hash ? pool_->GetNextLoopWithHash(*hash) : pool_->GetNextLoop();
+    }
+
+    void IoPool::leave() {
+        pending_.fetch_sub(1);
+    }
+}
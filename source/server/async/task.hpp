@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <evpp/event_loop.h>
+#include <evpp/http/context.h>
+#include <io.hpp>
+
+namespace evpp {
+    class EventLoopThreadPool;
+}
+
+namespace server::async {
+
+    //coroutine frames of handlers are recycled through per-thread free lists instead of going
+    //back to the heap, one list per 256 byte size class
+    namespace frame_pool {
+        void* allocate(size_t size);
+        void deallocate(void* frame, size_t size) noexcept;
+    }
+
+    //a coroutine handler. it starts at once, runs on the calling loop up to its first co_await
+    //and frees itself when it returns. nothing waits on it, so like any handler it answers through
+    //cb on every path; ctx and cb must be taken by value, the caller's references do not outlive
+    //the first suspension. an exception that escapes it is answered with a 500 unless it replied
+    struct task {
+        struct promise_type {
+            //the handler's own loop, ctx and cb, kept in the frame with the promise
+            template <typename... Rest>
+            promise_type(evpp::EventLoop*, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb,
+                const Rest&...) noexcept
+                : ctx_(&ctx), cb_(&cb) {}
+
+            //the same for a member function handler, whose object comes first
+            template <typename Self, typename... Rest>
+            promise_type(Self&, evpp::EventLoop*, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb,
+                const Rest&...) noexcept
+                : ctx_(&ctx), cb_(&cb) {}
+
+            task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept;
+
+            static void* operator new(size_t size) { return frame_pool::allocate(size); }
+            static void operator delete(void* frame, size_t size) noexcept { frame_pool::deallocate(frame, size); }
+
+        private:
+            const evpp::http::ContextPtr* ctx_;
+            const evpp::http::HTTPSendResponseCallback* cb_;
+        };
+    };
+
+    //the dedicated threads blocking work is moved to, ServerConfig.IoPoolThreads of them
+    class IoPool {
+    public:
+        static IoPool& get();
+
+        void start();
+        void shutdown();
+
+        //null while the pool is not running, the work then runs inline on the caller
+        evpp::EventLoop* next();
+
+        //like next(), but always the same thread for the same hash
+        evpp::EventLoop* next(uint64_t hash);
+
+        //next() or next(*hash) for an io awaitable, which calls leave() once its coroutine was
+        //resumed. shutdown() waits for those, a frame left suspended would never be freed
+        evpp::EventLoop* enter(const std::optional<uint64_t>& hash);
+        void leave();
+
+        //awaitables queued on, running on or coming back from the pool
+        uint32_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+    private:
+        IoPool();
+        ~IoPool();
+        IoPool(const IoPool&) = delete;
+        IoPool& operator=(const IoPool&) = delete;
+
+        uint32_t threads_;
+        std::unique_ptr<evpp::EventLoopThreadPool> pool_;
+        std::atomic<bool> running_{ false };
+        std::atomic<uint32_t> pending_{ 0 };   //awaitables between enter() and leave()
+    };
+
+    //co_await io(loop, fn): fn runs on an io pool thread and the coroutine resumes on loop with
+    //its result. fn must not touch anything the loop may change meanwhile, copy what it needs
+    template <typename Fn>
+    class io_awaitable {
+    public:
+        using result_type = std::invoke_result_t<Fn&>;
+
+        io_awaitable(evpp::EventLoop* loop, Fn fn) : loop_(loop), fn_(std::move(fn)) {}
+        io_awaitable(evpp::EventLoop* loop, uint64_t hash, Fn fn) : loop_(loop), fn_(std::move(fn)), hash_(hash) {}
+
+        bool await_ready() {
+            pool_loop_ = loop_ ? IoPool::get().enter(hash_) : nullptr;
+            if (!pool_loop_) {
+                run();
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            pool_loop_->RunInLoop([this, handle]() {
+                run();
+                loop_->RunInLoop([handle]() {
+                    handle.resume();
+                    IoPool::get().leave();
+                });
+            });
+        }
+
+        result_type await_resume() {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            if constexpr (!std::is_void_v<result_type>) {
+                return std::move(*result_);
+            }
+        }
+
+    private:
+        void run() noexcept {
+            try {
+                if constexpr (std::is_void_v<result_type>) {
+                    fn_();
+                }
+                else {
+                    result_.emplace(fn_());
+                }
+            }
+            catch (...) {
+                error_ = std::current_exception();
+            }
+        }
+
+        struct nothing {};
+        using storage = std::conditional_t<std::is_void_v<result_type>, nothing, result_type>;
+
+        evpp::EventLoop* loop_;
+        evpp::EventLoop* pool_loop_ = nullptr;
+        Fn fn_;
+        std::optional<uint64_t> hash_;
+        std::optional<storage> result_;
+        std::exception_ptr error_;
+    };
+
+    template <typename Fn>
+    io_awaitable<Fn> io(evpp::EventLoop* loop, Fn fn) {
+        return io_awaitable<Fn>(loop, std::move(fn));
+    }
+
+    //co_await io_ordered(loop, key, fn): io() for work that has to happen in order, fn runs after
+    //everything queued before it with the same key, e.g. the loads and saves of one town
+    template <typename Fn>
+    io_awaitable<Fn> io_ordered(evpp::EventLoop* loop, const std::string& key, Fn fn) {
+        return io_awaitable<Fn>(loop, std::hash<std::string>{}(key), std::move(fn));
+    }
+
+    //whole file reads and writes on the io pool
+    inline auto read_file(evpp::EventLoop* loop, std::string path) {
+        return io(loop, [path = std::move(path)]() -> std::optional<std::string> {
+            std::string data;
+            if (!utils::io::read_file(path, &data)) {
+                return std::nullopt;
+            }
+            return data;
+        });
+    }
+
+    inline auto write_file(evpp::EventLoop* loop, std::string path, std::string data) {
+        return io(loop, [path = std::move(path), data = std::move(data)]() {
+            return utils::io::write_file(path, data);
+        });
+    }
+}
@@ -1,5 +1,7 @@
 #include <std_include.hpp>
 
+#ifdef _WIN32
+
 #include <io.hpp>
 #include <string.hpp>
 #include <thread.hpp>
@@ -246,4 +248,5 @@ namespace blackbox
 		SetUnhandledExceptionFilter(exception_filter);
 		logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER, "Initialized Exception handler");
 	}
-}
\ No newline at end of file
+}
+#endif
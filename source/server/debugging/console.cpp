@@ -1,5 +1,7 @@
 #include <std_include.hpp>
 
+#ifdef _WIN32
+
 #include <windows.h>
 #include <iostream>
 #include <cstdio>
@@ -43,3 +45,4 @@ void create_console()
 
     logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_INITIALIZER, "Bods Evpp Server Console Started");
 }
+#endif
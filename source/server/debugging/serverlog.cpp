@@ -2,6 +2,9 @@
 #include "serverlog.hpp"
 #include <string.hpp>
 #include <cstdio>
+#include <cstdarg>
+#include <ctime>
+#include "platform/platform.hpp"
 
 #define OUTPUT_DEBUG_API
 #define PREPEND_TIMESTAMP
@@ -54,7 +57,7 @@ namespace logger
         return LogLabelNames[lbl];
     }
 
-    void write(const char* file, std::string str)
+    void write(const char* file, const std::string& str)
     {
         std::ofstream stream;
         stream.open(file, std::ios_base::app);
@@ -64,74 +67,56 @@ namespace logger
 
     void write(LogLevel level, LogLabel label, const char* fmt, ...)
     {
-        // Set console output to UTF-8
-        static bool utf8_initialized = false;
-        if (!utf8_initialized) {
-            SetConsoleOutputCP(CP_UTF8);
-            utf8_initialized = true;
-        }
-
-        char va_buffer[85768] = { 0 }; // Increased from 0x1000 to 8192
+        // vsnprintf terminates it, no need to clear all of it for every line
+        char va_buffer[85768]; // Increased from 0x1000 to 8192
+        va_buffer[0] = '\0';
 
         va_list ap;
         va_start(ap, fmt);
-        vsprintf_s(va_buffer, fmt, ap);
+        vsnprintf(va_buffer, sizeof(va_buffer), fmt, ap);
         va_end(ap);
 
-        std::stringstream stream;
+        // One line buffer per thread, reused so a line costs no allocations once it has grown
+        thread_local std::string line;
+        line.clear();
 
 #ifdef PREPEND_TIMESTAMP
         time_t now = time(0);
-        std::tm* t = std::localtime(&now);
-        stream << "" << std::put_time(t, "%Y-%m-%d %H:%M:%S") << "\t";
+        char timestamp[32];
+        const size_t timestamp_length = std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+        line.append(timestamp, timestamp_length);
+        line += '\t';
 #endif // PREPEND_TIMESTAMP
 
-        stream << "[ " << get_log_level_str(level) << " ]";
+        line += "[ ";
+        line += get_log_level_str(level);
+        line += " ]";
         if (label != -1) {
-            stream << "[ " << get_log_label_str(label) << " ]";
+            line += "[ ";
+            line += get_log_label_str(label);
+            line += " ]";
         }
-        stream << " " << va_buffer;
+        line += ' ';
+        line += va_buffer;
 
-        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-        if (hConsole != INVALID_HANDLE_VALUE)
+        // colors based on log levels
+        platform::console_color color = platform::console_color::normal;
+        switch (level)
         {
-            // colors based on log levels
-            switch (level)
-            {
-            case LOG_LEVEL_ERROR:
-                SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY); // Red
-                break;
-
-            case LOG_LEVEL_WARN:
-                SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY); // Green
-                break;
-
-            case LOG_LEVEL_INCOMING:
-                SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY); // Cyan-green
-                break;
-            case LOG_LEVEL_RESPONSE:
-                SetConsoleTextAttribute(hConsole, FOREGROUND_BLUE | FOREGROUND_INTENSITY); // Blue
-                break;
-            default:
-                SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE); // Default white
-                break;
-            case LOG_LEVEL_PLAYER_ID:
-                SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY); // Yellow
-                break;
-
-            }
-
-            std::cout << stream.str() << std::endl;
-
-            // Reset color 
-            SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        case LOG_LEVEL_ERROR: color = platform::console_color::red; break;
+        case LOG_LEVEL_WARN: color = platform::console_color::green; break;
+        case LOG_LEVEL_INCOMING: color = platform::console_color::cyan; break;
+        case LOG_LEVEL_RESPONSE: color = platform::console_color::blue; break;
+        case LOG_LEVEL_PLAYER_ID: color = platform::console_color::yellow; break;
+        default: break;
         }
+        platform::write_console(line, color);
 
 #ifdef OUTPUT_DEBUG_API
-        OutputDebugStringA(stream.str().c_str());
+        platform::debug_output(line);
 #endif // OUTPUT_DEBUG_API
 
-        write("tsto_server.log", stream.str());
+        write("tsto_server.log", line);
     }
 
     void log_packet_buffer(const char* stub, const char* buffer, size_t length)
@@ -149,7 +134,7 @@ namespace logger
 #endif // PREPEND_TIMESTAMP
 
 #ifdef OUTPUT_DEBUG_API
-        OutputDebugStringA(ss.str().c_str());
+        platform::debug_output(ss.str());
 #endif // OUTPUT_DEBUG_API
 
         stream << ss.str() << std::endl;
@@ -38,7 +38,7 @@ namespace logger
 		
 	};
 
-	void write(const char* file, std::string str);
+	void write(const char* file, const std::string& str);
 	void write(LogLevel level, LogLabel label, const char* fmt, ...);
 
 	void log_packet_buffer(const char* stub, const char* buffer, size_t length);
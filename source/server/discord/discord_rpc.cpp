@@ -8,6 +8,8 @@ namespace discord {
 std::unique_ptr<::discord::Core> DiscordRPC::core_;
 bool DiscordRPC::is_initialized_ = false;
 
+#ifdef _WIN32
+
 void DiscordRPC::Initialize(const std::string& client_id) {
     if (is_initialized_) {
         return;
@@ -64,5 +66,21 @@ void DiscordRPC::RunCallbacks() {
     }
 }
 
+#else
+//the game sdk only ships the windows library here, presence is a no-op elsewhere
+void DiscordRPC::Initialize(const std::string&) {
+    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_DISCORD, "Discord RPC is not available on this platform");
+}
+
+void DiscordRPC::Shutdown() {
+}
+
+void DiscordRPC::UpdatePresence(const std::string&, const std::string&, const std::string&, const std::string&) {
+}
+
+void DiscordRPC::RunCallbacks() {
+}
+#endif
+
 } // namespace discord
 } // namespace server
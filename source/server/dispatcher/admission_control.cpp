@@ -0,0 +1,229 @@
+#include <std_include.hpp>
+#include "admission_control.hpp"
+#include "debugging/serverlog.hpp"
+#include "headers/response_headers.hpp"
+#include "async/task.hpp"
+#include <configuration.hpp>
+#include <evpp/event_loop.h>
+#include <cmath>
+
+namespace server::dispatcher::http {
+
+    namespace {
+        struct route_priority {
+            const char* uri;
+            bool prefix;
+            AdmissionControl::priority level;
+        };
+
+        //everything not listed here is normal
+        constexpr route_priority route_priorities[] = {
+            //saves and logins, a refused one costs the player progress or a session
+            { "/mh/games/bg_gameserver_plugin/protoland/", true, AdmissionControl::priority::critical },
+            { "/mh/games/bg_gameserver_plugin/extraLandUpdate/", true, AdmissionControl::priority::critical },
+            { "/mh/games/bg_gameserver_plugin/protocurrency/", true, AdmissionControl::priority::critical },
+            { "/mh/games/bg_gameserver_plugin/protoWholeLandToken/", true, AdmissionControl::priority::critical },
+            { "/mh/games/bg_gameserver_plugin/deleteToken/", true, AdmissionControl::priority::critical },
+            { "/mh/games/bg_gameserver_plugin/checkToken/", true, AdmissionControl::priority::critical },
+            { "/connect/", true, AdmissionControl::priority::critical },
+            { "/api/server/", true, AdmissionControl::priority::critical },
+
+            //fire and forget from the client, or refreshed again by the dashboard a moment later
+            { "/mh/clienttelemetry/", false, AdmissionControl::priority::low },
+            { "/mh/games/bg_gameserver_plugin/trackinglog/", false, AdmissionControl::priority::low },
+            { "/mh/games/bg_gameserver_plugin/trackingmetrics/", false, AdmissionControl::priority::low },
+            { "/tracking/api/core/logEvent", false, AdmissionControl::priority::low },
+            { "/pinEvents", false, AdmissionControl::priority::low },
+            { "/api/dashboard/data", false, AdmissionControl::priority::low },
+            { "/api/events/get_time", false, AdmissionControl::priority::low },
+            { "/api/telemetry/", true, AdmissionControl::priority::low },
+        };
+
+        constexpr const char* priority_names[] = { "critical", "normal", "low" };
+
+        int64_t now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    AdmissionControl& AdmissionControl::get() {
+        static AdmissionControl instance;
+        return instance;
+    }
+
+    AdmissionControl::AdmissionControl() {
+        enabled_ = utils::configuration::ReadBoolean("ServerConfig", "AdmissionControl", true);
+        target_ms_ = (std::max)(1u, utils::configuration::ReadUnsignedInteger("ServerConfig", "AdmissionTargetMs", 50));
+        interval_ms_ = (std::max)(1u, utils::configuration::ReadUnsignedInteger("ServerConfig", "AdmissionIntervalMs", 500));
+        max_queue_ = static_cast<int>(utils::configuration::ReadUnsignedInteger("ServerConfig", "AdmissionMaxQueue", 512));
+        max_io_pending_ = utils::configuration::ReadUnsignedInteger("ServerConfig", "AdmissionMaxIoPending", 256);
+        retry_after_seconds_ = (std::max)(1u, utils::configuration::ReadUnsignedInteger("ServerConfig", "AdmissionRetryAfterSeconds", 2));
+    }
+
+    AdmissionControl::priority AdmissionControl::classify(const std::string& uri) {
+        for (const auto& route : route_priorities) {
+            if (route.prefix ? uri.rfind(route.uri, 0) == 0 : uri == route.uri) {
+                return route.level;
+            }
+        }
+        return priority::normal;
+    }
+
+    AdmissionControl::loop_state& AdmissionControl::state_for(evpp::EventLoop* loop) {
+        //a loop never changes threads, so each worker looks its state up once
+        thread_local loop_state* cached = nullptr;
+        if (cached && cached->loop == loop) {
+            return *cached;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& state : loops_) {
+            if (state->loop == loop) {
+                cached = state.get();
+                return *cached;
+            }
+        }
+        loops_.push_back(std::make_unique<loop_state>());
+        loops_.back()->loop = loop;
+        cached = loops_.back().get();
+        return *cached;
+    }
+
+    bool AdmissionControl::should_shed(loop_state& state, priority p, int64_t sojourn_ms, int queue_depth, uint32_t io_pending, int64_t now) {
+        //the queue ahead times the loop time per handler: it rises as soon as handlers slow down,
+        //before the waits themselves do
+        const int64_t expected_ms = static_cast<int64_t>(queue_depth * state.handler_us / 1000.0);
+        const int64_t delay_ms = (std::max)(sojourn_ms, expected_ms);
+        state.expected_ms.store(expected_ms, std::memory_order_relaxed);
+
+        //coroutine handlers wait on the io pool off the loop, a backlog there does not show in the
+        //loop's queue but every new request adds to it
+        const bool io_backlog = max_io_pending_ > 0 && io_pending > max_io_pending_;
+
+        //a single slow wait is a burst, waits above target for a whole interval are a standing queue
+        if (delay_ms < target_ms_ && !io_backlog) {
+            state.first_above_ms = 0;
+        }
+        else if (state.first_above_ms == 0) {
+            state.first_above_ms = now + interval_ms_;
+        }
+        const bool overloaded = state.first_above_ms != 0 && now >= state.first_above_ms;
+
+        if (!overloaded && state.dropping) {
+            state.dropping = false;
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
+                "[ADMISSION] Worker loop recovered, requests wait %lld ms", static_cast<long long>(delay_ms));
+        }
+        else if (overloaded && !state.dropping) {
+            state.dropping = true;
+            //overloaded again soon after the last time, pick up near the old drop rate
+            state.drop_count = (state.drop_count > 2 && now - state.drop_next_ms < 16 * interval_ms_)
+                ? state.drop_count - 2 : 1;
+            state.drop_next_ms = now;
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_SERVER_HTTP,
+                "[ADMISSION] Worker loop overloaded, requests wait %lld ms with %d queued and %u on the io pool, shedding low priority requests",
+                static_cast<long long>(delay_ms), queue_depth, io_pending);
+        }
+
+        if (p == priority::critical) {
+            return false;
+        }
+
+        if (max_queue_ > 0 && queue_depth > max_queue_) {
+            shed_queue_full_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        if (!state.dropping) {
+            return false;
+        }
+
+        if (p == priority::low) {
+            return true;
+        }
+
+        //normal requests go at the CoDel rate, closer together the longer the overload lasts
+        if (now >= state.drop_next_ms) {
+            state.drop_next_ms = now + static_cast<int64_t>(interval_ms_ / std::sqrt(static_cast<double>(state.drop_count)));
+            ++state.drop_count;
+            return true;
+        }
+        return false;
+    }
+
+    bool AdmissionControl::admit(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+        const evpp::http::HTTPSendResponseCallback& cb) {
+        if (!enabled_) {
+            return true;
+        }
+
+        const priority p = classify(ctx->uri());
+        auto& state = state_for(loop);
+        const int64_t sojourn_ms = static_cast<int64_t>((evpp::Timestamp::Now() - ctx->receive_time()).Milliseconds());
+        const int queue_depth = loop->pending_functor_count();
+        state.sojourn_ms.store(sojourn_ms, std::memory_order_relaxed);
+        state.queue_depth.store(queue_depth, std::memory_order_relaxed);
+
+        auto& counters = counters_[static_cast<size_t>(p)];
+        if (!should_shed(state, p, sojourn_ms, queue_depth, server::async::IoPool::get().pending(), now_ms())) {
+            counters.admitted.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        counters.shed.fetch_add(1, std::memory_order_relaxed);
+        ctx->set_response_http_code(503);
+        ctx->AddResponseHeader("Retry-After", std::to_string(retry_after_seconds_));
+        tsto::headers::set_json_response(ctx);
+        cb(R"({"status": "error", "message": "Server busy, retry later"})");
+        return false;
+    }
+
+    void AdmissionControl::handled(evpp::EventLoop* loop, evpp::Timestamp started) {
+        if (!enabled_) {
+            return;
+        }
+
+        //weighted 1/8 like a tcp round trip estimate, a few slow handlers move it, one does not
+        auto& state = state_for(loop);
+        const double us = static_cast<double>((evpp::Timestamp::Now() - started).Microseconds());
+        state.handler_us += (us - state.handler_us) / 8.0;
+    }
+
+    void AdmissionControl::handle_metrics(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
+        const evpp::http::HTTPSendResponseCallback& cb) {
+        auto& control = get();
+        tsto::headers::set_json_response(ctx);
+
+        std::string response = R"({"status":"success","enabled":)" + std::string(control.enabled_ ? "true" : "false") +
+            R"(,"target_ms":)" + std::to_string(control.target_ms_) +
+            R"(,"interval_ms":)" + std::to_string(control.interval_ms_) +
+            R"(,"shed_queue_full":)" + std::to_string(control.shed_queue_full_.load(std::memory_order_relaxed)) +
+            R"(,"io_pending":)" + std::to_string(server::async::IoPool::get().pending()) +
+            R"(,"max_io_pending":)" + std::to_string(control.max_io_pending_) +
+            R"(,"classes":{)";
+        for (size_t i = 0; i < 3; ++i) {
+            if (i) {
+                response += ',';
+            }
+            response += std::string("\"") + priority_names[i] + R"(":{"admitted":)" +
+                std::to_string(control.counters_[i].admitted.load(std::memory_order_relaxed)) +
+                R"(,"shed":)" + std::to_string(control.counters_[i].shed.load(std::memory_order_relaxed)) + "}";
+        }
+        response += R"(},"loops":[)";
+
+        std::lock_guard<std::mutex> lock(control.mutex_);
+        for (size_t i = 0; i < control.loops_.size(); ++i) {
+            const auto& state = *control.loops_[i];
+            if (i) {
+                response += ',';
+            }
+            response += R"({"queue_depth":)" + std::to_string(state.queue_depth.load(std::memory_order_relaxed)) +
+                R"(,"sojourn_ms":)" + std::to_string(state.sojourn_ms.load(std::memory_order_relaxed)) +
+                R"(,"expected_ms":)" + std::to_string(state.expected_ms.load(std::memory_order_relaxed)) +
+                R"(,"overloaded":)" + (state.dropping.load() ? "true" : "false") + "}";
+        }
+        response += "]}";
+        cb(response);
+    }
+}
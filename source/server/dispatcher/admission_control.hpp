@@ -0,0 +1,84 @@
+#pragma once
+#include <evpp/http/context.h>
+#include <evpp/http/http_server.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace server::dispatcher::http {
+
+    //sheds requests before they reach the handlers when the worker loops fall behind. every
+    //request measures how long it waited between the listening thread and its worker loop, and
+    //how long the loop's handlers take is kept as a moving average, so the queue times that
+    //average is the wait a request queued now can expect. like CoDel, a loop whose wait stays
+    //above AdmissionTargetMs for a whole AdmissionIntervalMs is overloaded, as is one whose
+    //handlers have more than AdmissionMaxIoPending calls waiting on the io pool. low priority requests (telemetry, tracking, pin events, dashboard polling)
+    //are then all refused, normal ones at the CoDel rate (interval / sqrt(n)), and protoland,
+    //auth and token requests are always let through. a queue deeper than AdmissionMaxQueue
+    //refuses low and normal ones at once. refused requests get 503 with Retry-After.
+    class AdmissionControl {
+    public:
+        enum class priority {
+            critical,
+            normal,
+            low,
+        };
+
+        static AdmissionControl& get();
+
+        static priority classify(const std::string& uri);
+
+        //runs on the worker loop before the handler, false means a 503 was already sent
+        bool admit(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+            const evpp::http::HTTPSendResponseCallback& cb);
+
+        //runs on the worker loop after the handler returned, started is when admit() let it in
+        void handled(evpp::EventLoop* loop, evpp::Timestamp started);
+
+        // /api/server/admission
+        static void handle_metrics(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+            const evpp::http::HTTPSendResponseCallback& cb);
+
+    private:
+        //one per worker loop, written only from that loop's thread
+        struct loop_state {
+            evpp::EventLoop* loop = nullptr;
+            int64_t first_above_ms = 0;     //when the wait may first count as overload, 0 while below target
+            int64_t drop_next_ms = 0;
+            uint32_t drop_count = 0;
+            double handler_us = 0;          //moving average of the loop time per handler
+
+            std::atomic<bool> dropping{ false };
+            std::atomic<int64_t> sojourn_ms{ 0 };
+            std::atomic<int> queue_depth{ 0 };
+            std::atomic<int64_t> expected_ms{ 0 };
+        };
+
+        struct class_counters {
+            std::atomic<uint64_t> admitted{ 0 };
+            std::atomic<uint64_t> shed{ 0 };
+        };
+
+        AdmissionControl();
+        AdmissionControl(const AdmissionControl&) = delete;
+        AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+        loop_state& state_for(evpp::EventLoop* loop);
+        bool should_shed(loop_state& state, priority p, int64_t sojourn_ms, int queue_depth, uint32_t io_pending, int64_t now);
+
+        bool enabled_;
+        int64_t target_ms_;
+        int64_t interval_ms_;
+        int max_queue_;
+        uint32_t max_io_pending_;
+        uint32_t retry_after_seconds_;
+
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<loop_state>> loops_;
+
+        class_counters counters_[3];
+        std::atomic<uint64_t> shed_queue_full_{ 0 };
+    };
+}
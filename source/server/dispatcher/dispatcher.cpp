@@ -1,8 +1,13 @@
 #include <std_include.hpp>
 #include "dispatcher.hpp"
+#include "admission_control.hpp"
+#include "rate_limiter.hpp"
+#include "memory/request_arena.hpp"
+#include "memory/allocation_stats.hpp"
 #include "debugging/serverlog.hpp"
 #include "file_server/file_server.hpp"
 #include "tsto/tracking/tracking.hpp"
+#include "tsto/tracking/telemetry_store.hpp"
 #include "tsto/device/device.hpp"
 #include "tsto/game/game.hpp"
 #include "tsto/dashboard/dashboard.hpp"
@@ -10,10 +15,11 @@
 #include "tsto/user/user.hpp"
 #include "tsto/land/land.hpp"
 #include "tsto/events/events.hpp"
-#include "regex"
 #include <evpp/http/context.h>
 #include <evpp/http/http_server.h>
 #include <evpp/event_loop.h>
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <fstream>
 #include <random>
@@ -21,6 +27,68 @@
 
 namespace server::dispatcher::http {
 
+    namespace {
+        //the uri with runs of slashes collapsed to one, in the request arena
+        std::pmr::string collapse_slashes(const std::string& uri, std::pmr::memory_resource* arena) {
+            std::pmr::string result(arena);
+            result.reserve(uri.size());
+            for (char c : uri) {
+                if (c != '/' || result.empty() || result.back() != '/') {
+                    result += c;
+                }
+            }
+            return result;
+        }
+
+        //the allocation stats key: segments carrying ids (any digit, or 24+ characters) become *
+        //and the static file trees are one route each
+        std::string_view route_key(std::string_view uri, server::memory::RequestArena& arena) {
+            for (std::string_view tree : { "/static", "/dashboard/", "/images/" }) {
+                if (uri.rfind(tree, 0) == 0) {
+                    return tree;
+                }
+            }
+
+            //never longer than the uri, a segment shrinks to * or stays as it is
+            auto* key = static_cast<char*>(arena.allocate((std::max)(uri.size(), size_t(1)), 1));
+            size_t length = 0;
+            size_t start = 0;
+            while (start <= uri.size()) {
+                size_t end = uri.find('/', start);
+                if (end == std::string_view::npos) {
+                    end = uri.size();
+                }
+                const std::string_view segment = uri.substr(start, end - start);
+                const bool id = segment.size() >= 24 ||
+                    std::any_of(segment.begin(), segment.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+                if (id) {
+                    key[length++] = '*';
+                }
+                else {
+                    std::copy(segment.begin(), segment.end(), key + length);
+                    length += segment.size();
+                }
+                if (end < uri.size()) {
+                    key[length++] = '/';
+                }
+                start = end + 1;
+            }
+            return { key, length };
+        }
+
+        // /games/<number>/devices
+        bool is_games_devices(std::string_view uri) {
+            constexpr std::string_view prefix = "/games/";
+            constexpr std::string_view suffix = "/devices";
+            if (uri.size() <= prefix.size() + suffix.size() || uri.rfind(prefix, 0) != 0 ||
+                uri.compare(uri.size() - suffix.size(), suffix.size(), suffix) != 0) {
+                return false;
+            }
+            const std::string_view number = uri.substr(prefix.size(), uri.size() - prefix.size() - suffix.size());
+            return std::all_of(number.begin(), number.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+        }
+    }
+
     Dispatcher::Dispatcher(std::shared_ptr<tsto::TSTOServer> server)
         : tsto_server_(server)
         , file_server_(std::make_unique<file_server::FileServer>()) {
@@ -29,15 +97,21 @@ namespace server::dispatcher::http {
     void Dispatcher::handle(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) noexcept {
         try {
-            std::string remote_ip = std::string(ctx->remote_ip());
-            std::string uri = std::string(ctx->uri());
-            std::string original_uri = std::string(ctx->original_uri());
+            //transient strings of the request live in its arena, see ServerConfig.RequestArena*
+            const auto arena = server::memory::RequestArena::acquire();
+            server::memory::RequestArena::scope arena_scope(*arena);
 
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
                 "Received request: RemoteIP: '%s', URI: '%s', FULL URI: '%s'",
-                remote_ip.c_str(), uri.c_str(), original_uri.c_str());
+                ctx->remote_ip().c_str(), ctx->uri().c_str(), ctx->original_uri());
 
-            uri = std::regex_replace(uri, std::regex("/{2,}"), "/");
+            const std::pmr::string uri = collapse_slashes(ctx->uri(), arena.get());
+            arena_scope.set_route(route_key(uri, *arena));
+
+            //429 for a client hitting protoland or userstats faster than ServerConfig.RateLimit* allows
+            if (!RateLimiter::get().admit(uri, ctx, cb)) {
+                return;
+            }
 
             if (uri == "/") {
                 tsto_server_->handle_root(loop, ctx, cb);
@@ -122,6 +196,16 @@ namespace server::dispatcher::http {
                 return;
             }
 
+            if (uri == "/api/server/admission") {
+                AdmissionControl::handle_metrics(loop, ctx, cb);
+                return;
+            }
+
+            if (uri == "/api/server/allocations") {
+                server::memory::AllocationStats::handle_metrics(loop, ctx, cb);
+                return;
+            }
+
             if (uri == "/api/server/stop") {
                 tsto::dashboard::Dashboard::handle_server_stop(loop, ctx, cb);
                 return;
@@ -172,6 +256,16 @@ namespace server::dispatcher::http {
                 return;
             }
 
+            if (uri == "/api/telemetry/query") {
+                tsto::tracking::TelemetryStore::handle_query(loop, ctx, cb);
+                return;
+            }
+
+            if (uri == "/api/telemetry/rollups") {
+                tsto::tracking::TelemetryStore::handle_rollups(loop, ctx, cb);
+                return;
+            }
+
             if (uri == "/upload_town_file") {
                 tsto::dashboard::Dashboard::handle_upload_town_file(loop, ctx, cb);
                 return;
@@ -183,10 +277,6 @@ namespace server::dispatcher::http {
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
                     "Handling file download: %s", uri.c_str());
 
-                // **Ensure correct path resolution**
-                std::string normalized_uri = uri.substr(7); // Remove "/static" prefix
-                std::string file_path = "static" + normalized_uri;
-
                 file_server_->handle_dlc_download(loop, ctx, cb);
                 return;
             }
@@ -196,7 +286,7 @@ namespace server::dispatcher::http {
             if (uri.find("/director/api/") == 0) {
                 size_t platform_start = uri.find("/api/") + 5;
                 size_t platform_end = uri.find("/", platform_start);
-                std::string platform = uri.substr(platform_start, platform_end - platform_start);
+                std::string platform(std::string_view(uri).substr(platform_start, platform_end - platform_start));
 
                 if (uri.find("/getDirectionByPackage") != std::string::npos ||
                     uri.find("/getDirectionByBundle") != std::string::npos) {
@@ -235,8 +325,7 @@ namespace server::dispatcher::http {
                 return;
             }
 
-            std::regex games_devices_pattern(R"(/games/\d+/devices)");
-            if (std::regex_match(uri, games_devices_pattern)) {
+            if (is_games_devices(uri)) {
                 tsto::device::Device::handle_device_registration(loop, ctx, cb);
                 return;
             }
@@ -352,20 +441,20 @@ namespace server::dispatcher::http {
 
             if (uri.find("/mh/games/bg_gameserver_plugin/extraLandUpdate/") == 0) {
                 // Extract land_id from URI for extraland update
-                std::string uri = ctx->uri();
-                size_t land_start = uri.find("/extraLandUpdate/") + 16;
-                size_t land_end = uri.find("/protoland/", land_start);
-                std::string land_id = uri.substr(land_start, land_end - land_start);
+                const std::string_view path = ctx->uri();
+                size_t land_start = path.find("/extraLandUpdate/") + 16;
+                size_t land_end = path.find("/protoland/", land_start);
+                std::string_view land_id = path.substr(land_start, land_end - land_start);
 
                 // Remove any leading or trailing slashes
-                while (!land_id.empty() && land_id[0] == '/') {
-                    land_id = land_id.substr(1);
+                while (!land_id.empty() && land_id.front() == '/') {
+                    land_id.remove_prefix(1);
                 }
                 while (!land_id.empty() && land_id.back() == '/') {
-                    land_id.pop_back();
+                    land_id.remove_suffix(1);
                 }
                 
-                tsto::land::Land::handle_extraland_update(loop, ctx, cb, land_id);
+                tsto::land::Land::handle_extraland_update(loop, ctx, cb, std::string(land_id));
                 return;
             }
 
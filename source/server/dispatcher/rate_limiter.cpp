@@ -0,0 +1,259 @@
+#include <std_include.hpp>
+#include "rate_limiter.hpp"
+#include "debugging/serverlog.hpp"
+#include "headers/response_headers.hpp"
+#include <configuration.hpp>
+#include <charconv>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace server::dispatcher::http {
+
+    namespace {
+        int64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        //the top bits pick the shard, the low bits pick the slot inside it
+        size_t shard_of(size_t hash, size_t shard_count) {
+            return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> 58) % shard_count;
+        }
+    }
+
+    RateLimiter& RateLimiter::get() {
+        static const limit limits[] = {
+            read_limit("Town", 60, 20),
+            read_limit("Stats", 30, 10),
+            read_limit("Other", 0, 0),
+        };
+        static RateLimiter instance(
+            utils::configuration::ReadBoolean("ServerConfig", "RateLimit", true),
+            utils::configuration::ReadUnsignedInteger("ServerConfig", "RateLimitMaxClients", 100000),
+            limits);
+        return instance;
+    }
+
+    RateLimiter::RateLimiter(bool enabled, size_t max_clients, const limit (&limits)[static_cast<size_t>(route_class::count)])
+        : enabled_(enabled)
+        , shard_capacity_((std::max)(size_t(1), max_clients / shard_count))
+        , shards_(std::make_unique<shard[]>(shard_count)) {
+        std::copy(std::begin(limits), std::end(limits), std::begin(limits_));
+
+        //at most half full so probe runs stay short
+        size_t slot_count = 1;
+        while (slot_count < shard_capacity_ * 2) {
+            slot_count <<= 1;
+        }
+        slot_mask_ = slot_count - 1;
+
+        if (enabled_) {
+            for (size_t i = 0; i < shard_count; ++i) {
+                shards_[i].buckets.resize(shard_capacity_);
+                shards_[i].slots.resize(slot_count);
+            }
+        }
+    }
+
+    RateLimiter::limit RateLimiter::read_limit(const char* name, uint32_t per_minute, uint32_t burst) {
+        const std::string prefix = std::string("RateLimit") + name;
+        limit result;
+        per_minute = utils::configuration::ReadUnsignedInteger("ServerConfig", (prefix + "PerMinute").c_str(), per_minute);
+        burst = utils::configuration::ReadUnsignedInteger("ServerConfig", (prefix + "Burst").c_str(), burst);
+        if (per_minute > 0) {
+            result.tokens_per_ns = per_minute / 60e9;
+            result.burst = (std::max)(1u, burst);
+        }
+        return result;
+    }
+
+    RateLimiter::route_class RateLimiter::classify(std::string_view uri) {
+        if (uri.rfind("/mh/games/bg_gameserver_plugin/protoland/", 0) == 0 ||
+            uri.rfind("/mh/games/bg_gameserver_plugin/extraLandUpdate/", 0) == 0) {
+            return route_class::town;
+        }
+        if (uri == "/mh/userstats") {
+            return route_class::stats;
+        }
+        return route_class::other;
+    }
+
+    size_t RateLimiter::find_slot(const shard& s, uint64_t key) const {
+        const uint32_t tag = static_cast<uint32_t>(key);
+        size_t slot = key & slot_mask_;
+        while (s.slots[slot].index != empty_slot
+            && (s.slots[slot].tag != tag || s.buckets[s.slots[slot].index].key != key)) {
+            slot = (slot + 1) & slot_mask_;
+        }
+        return slot;
+    }
+
+    void RateLimiter::erase_slot(shard& s, size_t slot) const {
+        //backward shift: pull later entries of the probe run into the hole unless that would
+        //move them in front of their home slot
+        size_t next = slot;
+        while (true) {
+            next = (next + 1) & slot_mask_;
+            if (s.slots[next].index == empty_slot) {
+                break;
+            }
+            const size_t home = s.slots[next].tag & slot_mask_;
+            const bool stays = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+            if (!stays) {
+                s.slots[slot] = s.slots[next];
+                slot = next;
+            }
+        }
+        s.slots[slot].index = empty_slot;
+    }
+
+    uint32_t RateLimiter::evict(shard& s) const {
+        while (true) {
+            const uint32_t index = s.hand;
+            s.hand = static_cast<uint32_t>((s.hand + 1) % shard_capacity_);
+            bucket& b = s.buckets[index];
+            if (b.referenced) {
+                b.referenced = false;
+                continue;
+            }
+            erase_slot(s, find_slot(s, b.key));
+            return index;
+        }
+    }
+
+    bool RateLimiter::allow(std::string_view client, route_class cls, int64_t now, int64_t* retry_after_ms) {
+        const limit& l = limits_[static_cast<size_t>(cls)];
+        if (!enabled_ || l.tokens_per_ns <= 0) {
+            return true;
+        }
+
+        //each class has its own bucket, no key string is ever built
+        const uint64_t key = static_cast<uint64_t>(std::hash<std::string_view>()(client)) ^
+            ((static_cast<uint64_t>(cls) + 1) * 0xC2B2AE3D27D4EB4Full);
+
+        auto& s = shards_[shard_of(static_cast<size_t>(key), shard_count)];
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        bucket* b;
+        size_t slot = find_slot(s, key);
+        if (s.slots[slot].index != empty_slot) {
+            b = &s.buckets[s.slots[slot].index];
+            //another loop may have read its clock later and got here first
+            if (now > b->updated_ns) {
+                b->tokens = static_cast<float>((std::min)(l.burst, b->tokens + static_cast<double>(now - b->updated_ns) * l.tokens_per_ns));
+                b->updated_ns = now;
+            }
+            b->referenced = true;
+        }
+        else {
+            uint32_t index;
+            if (s.used < shard_capacity_) {
+                index = s.used++;
+            }
+            else {
+                //the eviction may shift the probe run, look for the free slot again
+                index = evict(s);
+                slot = find_slot(s, key);
+            }
+            s.slots[slot] = { static_cast<uint32_t>(key), index };
+            b = &s.buckets[index];
+            b->key = key;
+            b->tokens = static_cast<float>(l.burst);
+            b->updated_ns = now;
+            b->referenced = false;
+        }
+
+        if (b->tokens >= 1.0f) {
+            b->tokens -= 1.0f;
+            return true;
+        }
+
+        if (retry_after_ms) {
+            *retry_after_ms = static_cast<int64_t>(std::ceil((1.0 - b->tokens) / l.tokens_per_ns / 1e6));
+        }
+        return false;
+    }
+
+    bool RateLimiter::admit(std::string_view uri, const evpp::http::ContextPtr& ctx,
+        const evpp::http::HTTPSendResponseCallback& cb) {
+        if (!enabled_) {
+            return true;
+        }
+
+        const route_class cls = classify(uri);
+        if (limits_[static_cast<size_t>(cls)].tokens_per_ns <= 0) {
+            return true;
+        }
+
+        const char* mh_uid = ctx->FindRequestHeader("mh_uid");
+        const std::string_view client = (mh_uid && *mh_uid) ? std::string_view(mh_uid) : std::string_view(ctx->remote_ip());
+
+        int64_t retry_after_ms = 0;
+        if (allow(client, cls, now_ns(), &retry_after_ms)) {
+            return true;
+        }
+
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_SERVER_HTTP,
+            "[RATE LIMIT] Refused %.*s for %.*s", static_cast<int>(uri.size()), uri.data(),
+            static_cast<int>(client.size()), client.data());
+
+        ctx->set_response_http_code(429);
+        ctx->AddResponseHeader("Retry-After", std::to_string((std::max)(int64_t(1), (retry_after_ms + 999) / 1000)));
+        tsto::headers::set_json_response(ctx);
+        cb(R"({"status": "error", "message": "Too many requests"})");
+        return false;
+    }
+
+    void RateLimiter::benchmark() {
+        const limit limits[] = { read_limit("Town", 60, 20), read_limit("Stats", 30, 10), limit{} };
+        const unsigned cpus = std::thread::hardware_concurrency();
+
+        auto run = [&](const char* name, size_t max_clients, size_t client_count, int threads) {
+            //best of a few rounds, a noisy machine only ever makes a round slower
+            double best = 0;
+            uint64_t allowed = 0;
+            for (int round = 0; round < 5; ++round) {
+                RateLimiter limiter(true, max_clients, limits);
+
+                //ids are written on the stack and time advances 1us per call without reading the
+                //clock, so only the limiter is measured
+                constexpr size_t calls = 2000000;
+                std::atomic<uint64_t> round_allowed{ 0 };
+                const int64_t start = now_ns();
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t]() {
+                        uint64_t local = 0;
+                        int64_t now = start;
+                        char id[24];
+                        for (size_t i = 0; i < calls; ++i) {
+                            const uint64_t client = 1000000000000ull + ((i * 31 + t) % client_count) * 7919;
+                            const auto end = std::to_chars(id, id + sizeof(id), client).ptr;
+                            local += limiter.allow(std::string_view(id, end - id), route_class::town, now += 1000) ? 1 : 0;
+                        }
+                        round_allowed += local;
+                    });
+                }
+                for (auto& w : workers) {
+                    w.join();
+                }
+                const double ns = static_cast<double>(now_ns() - start) / calls;
+                if (round == 0 || ns < best) {
+                    best = ns;
+                }
+                allowed = round_allowed.load();
+            }
+
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER,
+                "[RATE LIMIT] %-28s %d thread(s): %6.1f ns per call (%llu allowed)%s",
+                name, threads, best, static_cast<unsigned long long>(allowed),
+                static_cast<unsigned>(threads) > cpus ? ", threads share a cpu" : "");
+        };
+
+        run("10k clients", 100000, 10000, 1);
+        run("10k clients", 100000, 10000, 2);
+        run("200k clients, 100k kept", 100000, 200000, 1);
+        run("200k clients, 100k kept", 100000, 200000, 2);
+    }
+}
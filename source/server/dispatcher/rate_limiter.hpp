@@ -0,0 +1,94 @@
+#pragma once
+#include <evpp/http/context.h>
+#include <evpp/http/http_server.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace server::dispatcher::http {
+
+    //token buckets per client and route class, so a client stuck in a loop on protoland or
+    //userstats is answered with 429 instead of a town serialize per hit. clients are told apart
+    //by mh_uid, or by ip when there is none. buckets live in shards picked by key hash, each
+    //shard keeps at most RateLimitMaxClients / shard_count buckets and forgets a client not
+    //seen lately when it is full. a forgotten client simply starts again with a full bucket.
+    class RateLimiter {
+    public:
+        enum class route_class {
+            town,       //protoland and extraLandUpdate: a full town parse or serialize
+            stats,      ///mh/userstats
+            other,
+            count,
+        };
+
+        static RateLimiter& get();
+
+        static route_class classify(std::string_view uri);
+
+        //false means a 429 was already sent
+        bool admit(std::string_view uri, const evpp::http::ContextPtr& ctx,
+            const evpp::http::HTTPSendResponseCallback& cb);
+
+        //takes a token from client's bucket; on refusal retry_after_ms says when one is back
+        bool allow(std::string_view client, route_class cls, int64_t now_ns, int64_t* retry_after_ms = nullptr);
+
+        //run with -bench-rate-limiter, prints the cost of allow() per call
+        static void benchmark();
+
+    private:
+        static constexpr size_t shard_count = 64;
+
+        struct limit {
+            double tokens_per_ns = 0;   //0 is unlimited
+            double burst = 0;
+        };
+
+        //a client is known by a 64 bit hash of its id and route class, two clients sharing
+        //a hash would share a bucket
+        struct bucket {
+            uint64_t key = 0;
+            int64_t updated_ns = 0;
+            float tokens = 0;
+            bool referenced = false;    //seen since the clock hand last passed
+        };
+
+        //a slot of the probing table. tag is the low half of the bucket's key, so probes and
+        //shifts read only the table and a bucket is touched once its key is likely there
+        struct slot_entry {
+            uint32_t tag = 0;
+            uint32_t index = UINT32_MAX;
+        };
+
+        //open addressing over a fixed bucket array, full shards evict with the clock
+        //(second chance) approximation of lru. aligned so two threads on neighbouring shards
+        //don't share a cache line
+        struct alignas(64) shard {
+            std::mutex mutex;
+            std::vector<bucket> buckets;
+            std::vector<slot_entry> slots;  //linear probing table of bucket indexes
+            uint32_t used = 0;
+            uint32_t hand = 0;
+        };
+
+        static constexpr uint32_t empty_slot = UINT32_MAX;
+
+        size_t find_slot(const shard& s, uint64_t key) const;
+        void erase_slot(shard& s, size_t slot) const;
+        uint32_t evict(shard& s) const;
+
+        RateLimiter(bool enabled, size_t max_clients, const limit (&limits)[static_cast<size_t>(route_class::count)]);
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+
+        static limit read_limit(const char* name, uint32_t per_minute, uint32_t burst);
+
+        bool enabled_;
+        size_t shard_capacity_;
+        size_t slot_mask_;
+        limit limits_[static_cast<size_t>(route_class::count)];
+        std::unique_ptr<shard[]> shards_;
+    };
+}
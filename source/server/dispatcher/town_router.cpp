@@ -0,0 +1,413 @@
+#include <std_include.hpp>
+#include "town_router.hpp"
+#include "debugging/serverlog.hpp"
+#include <configuration.hpp>
+#include <evpp/libevent.h>
+#include <evpp/sockets.h>
+#include <evpp/httpc/request.h>
+#include <evpp/httpc/response.h>
+#include <libhashkit/hashkit.h>
+#include <algorithm>
+
+namespace server::dispatcher::http {
+
+    namespace {
+        //uri segments followed by a land id, for requests that don't carry mh_uid
+        constexpr const char* land_markers[] = {
+            "/protoland/",
+            "/extraLandUpdate/",
+            "/protocurrency/",
+            "/protoWholeLandToken/",
+        };
+
+        //connection level headers that must not be copied across a hop
+        bool is_hop_header(const char* name) {
+            static constexpr const char* hop_headers[] = {
+                "Connection", "Keep-Alive", "Transfer-Encoding", "Content-Length", "Host",
+                "Proxy-Connection", "TE", "Trailer", "Upgrade", "Date",
+            };
+            for (const char* h : hop_headers) {
+#ifdef _WIN32
+                if (_stricmp(name, h) == 0) return true;
+#else
+                if (strcasecmp(name, h) == 0) return true;
+#endif
+            }
+            return false;
+        }
+
+        //every address host resolves to, a numeric host is returned as it is
+        std::vector<std::string> resolve_host(const std::string& host) {
+            std::vector<std::string> ips;
+
+            struct addrinfo hints {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo* result = nullptr;
+            if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0) {
+                logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_SERVER_HTTP,
+                    "[ROUTER] Cannot resolve %s, requests it forwards will not be trusted", host.c_str());
+                return ips;
+            }
+
+            for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+                std::string ip = evpp::sock::ToIP(ai->ai_addr);
+                if (std::find(ips.begin(), ips.end(), ip) == ips.end()) {
+                    ips.push_back(std::move(ip));
+                }
+            }
+            freeaddrinfo(result);
+            return ips;
+        }
+
+        int64_t now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        std::string trim(const std::string& s) {
+            const size_t begin = s.find_first_not_of(" \t\r\n");
+            if (begin == std::string::npos) return "";
+            const size_t end = s.find_last_not_of(" \t\r\n");
+            return s.substr(begin, end - begin + 1);
+        }
+
+        //"host:port [weight]" per line, # starts a comment
+        bool read_members(const std::string& path, std::vector<std::pair<std::string, uint32_t>>& members) {
+            std::ifstream file(path);
+            if (!file.is_open()) {
+                return false;
+            }
+
+            std::string line;
+            while (std::getline(file, line)) {
+                const size_t comment = line.find('#');
+                if (comment != std::string::npos) {
+                    line.resize(comment);
+                }
+                line = trim(line);
+                if (line.empty()) {
+                    continue;
+                }
+
+                std::istringstream fields(line);
+                std::string address;
+                uint32_t weight = 1;
+                fields >> address;
+                if (!(fields >> weight) || weight == 0) {
+                    weight = 1;
+                }
+
+                if (address.find(':') == std::string::npos) {
+                    logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_SERVER_HTTP,
+                        "[ROUTER] Ignoring node '%s', expected host:port", address.c_str());
+                    continue;
+                }
+                members.emplace_back(address, weight);
+            }
+
+            std::sort(members.begin(), members.end());
+            members.erase(std::unique(members.begin(), members.end(),
+                [](const auto& a, const auto& b) { return a.first == b.first; }), members.end());
+            return true;
+        }
+    }
+
+    TownRouter::node::~node() {
+        //pooled connections have to be closed on the loop that opened them
+        if (pool) {
+            pool->Clear();
+        }
+    }
+
+    TownRouter::options TownRouter::options::from_config(const std::string& self_address) {
+        const char* section = "ServerConfig";
+        options o;
+        o.nodes_file = utils::configuration::ReadString(section, "ClusterNodesFile", "");
+        o.self = utils::configuration::ReadString(section, "ClusterSelf", self_address);
+        o.virtual_nodes = utils::configuration::ReadUnsignedInteger(section, "ClusterVirtualNodes", 160);
+        o.timeout_ms = utils::configuration::ReadUnsignedInteger(section, "ClusterForwardTimeoutMs", 5000);
+        o.down_seconds = utils::configuration::ReadUnsignedInteger(section, "ClusterNodeDownSeconds", 10);
+        o.shared_store = utils::configuration::ReadBoolean(section, "ClusterSharedStore", false);
+        return o;
+    }
+
+    TownRouter::TownRouter(evpp::http::HTTPRequestCallback local, player_fn player, options opts)
+        : local_(std::move(local)), player_(std::move(player)), options_(std::move(opts)) {
+        options_.virtual_nodes = (std::max)(4u, options_.virtual_nodes);
+
+        if (enabled()) {
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
+                "[ROUTER] Town routing on, this node is %s, members from %s%s", options_.self.c_str(), options_.nodes_file.c_str(),
+                options_.shared_store ? ", towns of a down node are served by the next one" : "");
+            reload();
+        }
+    }
+
+    TownRouter::~TownRouter() = default;
+
+    std::shared_ptr<const TownRouter::ring> TownRouter::current() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ring_;
+    }
+
+    std::shared_ptr<const TownRouter::ring> TownRouter::build_ring(const std::vector<std::pair<std::string, uint32_t>>& members) const {
+        auto old_ring = current();
+        auto next = std::make_shared<ring>();
+
+        for (const auto& [address, weight] : members) {
+            std::shared_ptr<node> n;
+
+            //keep the node, and its warm connections, when only other members changed
+            if (old_ring) {
+                for (const auto& existing : old_ring->nodes) {
+                    if (existing->address == address && existing->weight == weight) {
+                        n = existing;
+                        break;
+                    }
+                }
+            }
+
+            if (!n) {
+                n = std::make_shared<node>();
+                n->address = address;
+                n->weight = weight;
+                if (address != options_.self) {
+                    const size_t colon = address.rfind(':');
+                    const int port = std::atoi(address.c_str() + colon + 1);
+                    n->pool = std::make_unique<evpp::httpc::ConnPool>(address.substr(0, colon), port,
+                        evpp::Duration(static_cast<double>(options_.timeout_ms) / 1000.0));
+                    n->ips = resolve_host(address.substr(0, colon));
+                }
+            }
+
+            const size_t index = next->nodes.size();
+            next->nodes.push_back(n);
+
+            //ketama: each md5 of "<address>-<i>" gives four points on the ring
+            const uint32_t groups = (options_.virtual_nodes * weight) / 4;
+            for (uint32_t i = 0; i < groups; ++i) {
+                const std::string point_key = address + "-" + std::to_string(i);
+                unsigned char digest[16];
+                libhashkit_md5_signature(reinterpret_cast<const unsigned char*>(point_key.data()), point_key.size(), digest);
+                for (int part = 0; part < 4; ++part) {
+                    const uint32_t value = (static_cast<uint32_t>(digest[3 + part * 4]) << 24)
+                        | (static_cast<uint32_t>(digest[2 + part * 4]) << 16)
+                        | (static_cast<uint32_t>(digest[1 + part * 4]) << 8)
+                        | digest[part * 4];
+                    next->points.emplace_back(value, index);
+                }
+            }
+        }
+
+        std::sort(next->points.begin(), next->points.end());
+        return next;
+    }
+
+    void TownRouter::reload() {
+        if (!enabled()) {
+            return;
+        }
+
+        std::error_code ec;
+        const auto modified = std::filesystem::last_write_time(options_.nodes_file, ec);
+        if (ec) {
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_SERVER_HTTP,
+                "[ROUTER] Cannot read %s, keeping the current members", options_.nodes_file.c_str());
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ring_ && modified == nodes_file_time_) {
+                return;
+            }
+        }
+
+        std::vector<std::pair<std::string, uint32_t>> members;
+        if (!read_members(options_.nodes_file, members)) {
+            return;
+        }
+
+        auto next = build_ring(members);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ring_ = next;
+            nodes_file_time_ = modified;
+        }
+
+        const bool self_listed = std::any_of(members.begin(), members.end(),
+            [this](const auto& m) { return m.first == options_.self; });
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
+            "[ROUTER] Loaded %zu nodes, %zu ring points%s", members.size(), next->points.size(),
+            self_listed ? "" : " (this node is not a member and forwards everything)");
+    }
+
+    std::shared_ptr<TownRouter::node> TownRouter::lookup(const std::string& land_id) const {
+        auto r = current();
+        if (!r || r->points.empty()) {
+            return nullptr;
+        }
+
+        const uint32_t hash = libhashkit_md5(land_id.data(), land_id.size());
+        auto it = std::upper_bound(r->points.begin(), r->points.end(), std::make_pair(hash, SIZE_MAX));
+        const size_t start = static_cast<size_t>(it - r->points.begin());
+
+        //towns only the owner's store holds can't be served anywhere else
+        if (!options_.shared_store) {
+            return r->nodes[r->points[start % r->points.size()].second];
+        }
+
+        //walk clockwise past nodes that recently failed, their towns move to the next node
+        const int64_t now = now_ms();
+        for (size_t step = 0; step < r->points.size(); ++step) {
+            const auto& n = r->nodes[r->points[(start + step) % r->points.size()].second];
+            if (n->address == options_.self || n->down_until_ms.load(std::memory_order_relaxed) <= now) {
+                return n;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string TownRouter::owner_of(const std::string& land_id) const {
+        auto n = lookup(land_id);
+        if (!n || n->address == options_.self) {
+            return "";
+        }
+        return n->address;
+    }
+
+    std::string TownRouter::land_id_of(const evpp::http::ContextPtr& ctx) {
+        if (const char* mh_uid = ctx->FindRequestHeader("mh_uid")) {
+            if (*mh_uid) {
+                return mh_uid;
+            }
+        }
+
+        const std::string& uri = ctx->uri();
+        for (const char* marker : land_markers) {
+            const size_t pos = uri.find(marker);
+            if (pos == std::string::npos) {
+                continue;
+            }
+
+            const size_t start = pos + std::strlen(marker);
+            const size_t end = uri.find('/', start);
+            std::string id = uri.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            if (!id.empty()) {
+                return id;
+            }
+        }
+        return "";
+    }
+
+    bool TownRouter::from_peer(const evpp::http::ContextPtr& ctx) const {
+        const char* forwarded_by = ctx->FindRequestHeader(forwarded_header);
+        auto r = current();
+        if (!forwarded_by || !r) {
+            return false;
+        }
+
+        //the header names a member, and the connection has to come from that member's host
+        const std::string remote = ctx->remote_ip();
+        for (const auto& n : r->nodes) {
+            if (n->address == forwarded_by && n->address != options_.self) {
+                return std::find(n->ips.begin(), n->ips.end(), remote) != n->ips.end();
+            }
+        }
+        return false;
+    }
+
+    void TownRouter::handle(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+        const evpp::http::HTTPSendResponseCallback& cb) noexcept {
+        //only a peer may say a request was forwarded or whose town it is for, from anyone else
+        //the headers are dropped and the request is routed like any other
+        const bool forwarded = enabled() && from_peer(ctx);
+        if (!forwarded) {
+            struct evkeyvalq* headers = evhttp_request_get_input_headers(ctx->req());
+            for (const char* name : { forwarded_header, town_header, user_header }) {
+                while (evhttp_remove_header(headers, name) == 0) {
+                }
+            }
+        }
+
+        if (enabled() && !forwarded) {
+            try {
+                const std::string land_id = land_id_of(ctx);
+                if (!land_id.empty()) {
+                    auto target = lookup(land_id);
+                    if (target && target->address != options_.self) {
+                        //the owner failed lately and nobody else has its towns, serving the
+                        //player here would start a second copy of their town
+                        const int64_t wait_ms = target->down_until_ms.load(std::memory_order_relaxed) - now_ms();
+                        if (wait_ms > 0) {
+                            ctx->set_response_http_code(503);
+                            ctx->AddResponseHeader("Retry-After", std::to_string((wait_ms + 999) / 1000));
+                            cb("Service Unavailable");
+                            return;
+                        }
+                        forward(target, loop, ctx, cb);
+                        return;
+                    }
+                }
+            }
+            catch (const std::exception& ex) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
+                    "[ROUTER] Routing failed, handling locally: %s", ex.what());
+            }
+        }
+
+        local_(loop, ctx, cb);
+    }
+
+    void TownRouter::forward(const std::shared_ptr<node>& target, evpp::EventLoop* loop,
+        const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_SERVER_HTTP,
+            "[ROUTER] Forwarding %s %s to %s", ctx->GetMethod().c_str(), ctx->uri().c_str(), target->address.c_str());
+
+        auto* request = new evpp::httpc::Request(target->pool.get(), loop, ctx->original_uri(), ctx->body().ToString());
+        request->set_method(ctx->GetMethod());
+        //the owner answers with whatever code the handler chose, those must not be retried
+        request->set_retry_number(0);
+
+        struct evkeyvalq* headers = evhttp_request_get_input_headers(ctx->req());
+        for (struct evkeyval* header = headers->tqh_first; header; header = header->next.tqe_next) {
+            if (!is_hop_header(header->key)) {
+                request->AddHeader(header->key, header->value);
+            }
+        }
+        request->AddHeader(forwarded_header, options_.self);
+        request->AddHeader("X-Forwarded-For", ctx->remote_ip());
+
+        //the player is the one logged in to this node, the owner's session is someone else's
+        const auto [town, user_id] = player_();
+        request->AddHeader(town_header, town);
+        if (!user_id.empty()) {
+            request->AddHeader(user_header, user_id);
+        }
+
+        const int64_t down_ms = static_cast<int64_t>(options_.down_seconds) * 1000;
+        request->Execute([request, target, ctx, cb, down_ms](const std::shared_ptr<evpp::httpc::Response>& response) {
+            if (response->http_code() <= 0) {
+                target->down_until_ms.store(now_ms() + down_ms, std::memory_order_relaxed);
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
+                    "[ROUTER] Node %s unreachable, marking it down for %lld ms",
+                    target->address.c_str(), static_cast<long long>(down_ms));
+                ctx->set_response_http_code(502);
+                ctx->AddResponseHeader("Retry-After", "1");
+                cb("Bad Gateway");
+                delete request;
+                return;
+            }
+
+            ctx->set_response_http_code(response->http_code());
+            for (const auto& [key, value] : response->headers()) {
+                if (!is_hop_header(key.c_str())) {
+                    ctx->AddResponseHeader(key, value);
+                }
+            }
+            cb(response->body().ToString());
+            delete request;
+        });
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <evpp/http/context.h>
+#include <evpp/httpc/conn_pool.h>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace server::dispatcher::http {
+
+    //sits in front of the Dispatcher when several servers share the players. land ids (the
+    //mh_uid header, or the id in a protoland style uri) are hashed onto a ketama ring built from
+    //ServerConfig.ClusterNodesFile, the owning node handles the request and every other node
+    //forwards it there over pooled keep-alive connections. requests without a land id, and
+    //requests that were already forwarded once, are always handled locally.
+    //while an owner is down its towns are answered 503, unless the nodes share one store and the
+    //next node on the ring can serve them
+    class TownRouter {
+    public:
+        struct options {
+            std::string nodes_file;     //empty turns routing off
+            std::string self;           //this node's host:port as listed in nodes_file
+            uint32_t virtual_nodes = 160;
+            uint32_t timeout_ms = 5000;
+            uint32_t down_seconds = 10;
+            bool shared_store = false;
+
+            //ServerConfig.Cluster*, self defaults to self_address
+            static options from_config(const std::string& self_address);
+        };
+
+        //town filename and user id of the player logged in to this node
+        using player_fn = std::function<std::pair<std::string, std::string>()>;
+
+        //set on forwarded requests so they are never forwarded a second time. the owner's session
+        //belongs to whoever logged in there, so the request also names its player's town and
+        //user id (tsto::land::Land::resolve_player). handle() drops all three unless the request
+        //comes from a configured peer
+        static constexpr const char* forwarded_header = "X-Tsto-Forwarded-By";
+        static constexpr const char* town_header = "X-Tsto-Town";
+        static constexpr const char* user_header = "X-Tsto-User";
+
+        //local handles what this node owns, player names who its forwards are for
+        TownRouter(evpp::http::HTTPRequestCallback local, player_fn player, options opts);
+        ~TownRouter();
+
+        void handle(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+            const evpp::http::HTTPSendResponseCallback& cb) noexcept;
+
+        //re-reads the nodes file if it changed since the last call, safe from any thread. new
+        //members are resolved here, so it blocks on dns and belongs on the io pool
+        void reload();
+
+        bool enabled() const { return !options_.nodes_file.empty(); }
+
+        //address of the node serving land_id, empty when that is this node or routing is off
+        std::string owner_of(const std::string& land_id) const;
+
+        static std::string land_id_of(const evpp::http::ContextPtr& ctx);
+
+    private:
+        struct node {
+            std::string address;    //host:port, as written in the nodes file
+            uint32_t weight = 1;
+            std::unique_ptr<evpp::httpc::ConnPool> pool;
+            std::vector<std::string> ips;   //what the host resolved to, forwards from it come from these
+            std::atomic<int64_t> down_until_ms{ 0 };
+
+            ~node();
+        };
+
+        struct ring {
+            std::vector<std::pair<uint32_t, size_t>> points;    //hash -> index into nodes, sorted
+            std::vector<std::shared_ptr<node>> nodes;
+        };
+
+        std::shared_ptr<const ring> current() const;
+
+        //the node owning land_id. one that recently failed is only skipped for the next node on
+        //the ring when the store is shared, otherwise it is returned and the request waits for it
+        std::shared_ptr<node> lookup(const std::string& land_id) const;
+        bool from_peer(const evpp::http::ContextPtr& ctx) const;
+        std::shared_ptr<const ring> build_ring(const std::vector<std::pair<std::string, uint32_t>>& members) const;
+        void forward(const std::shared_ptr<node>& target, evpp::EventLoop* loop,
+            const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
+
+        evpp::http::HTTPRequestCallback local_;
+        player_fn player_;
+        options options_;
+
+        mutable std::mutex mutex_;
+        std::shared_ptr<const ring> ring_;
+        std::filesystem::file_time_type nodes_file_time_{};
+    };
+}
@@ -7,6 +7,8 @@
 #include <thread>
 #include <evpp/event_loop.h>
 #include "configuration.hpp"
+#include "webpanel_assets.hpp"
+#include "headers/response_headers.hpp"
 namespace file_server {
     FileServer::FileServer() : file_mutex_(), queue_mutex_() {
         std::lock_guard<std::mutex> lock(file_mutex_);
@@ -166,9 +168,16 @@ namespace file_server {
     void FileServer::handle_webpanel_file(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
 
-        cleanup_completed_ops();  // Clean up completed operations
-
         try {
+            if (!webpanel::serve_from_disk()) {
+                if (const auto* item = webpanel::find(ctx->uri())) {
+                    serve_embedded(ctx, cb, *item);
+                    return;
+                }
+            }
+
+            cleanup_completed_ops();  // Clean up completed operations
+
             std::string uri = ctx->uri();
             uri = sanitize_filename(uri);
 
@@ -188,6 +197,37 @@ namespace file_server {
         }
     }
 
+    void FileServer::serve_embedded(const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb,
+        const webpanel::asset& item) {
+        //the gzip bytes are a different representation than the plain ones, they carry their own etag
+        const char* accept_encoding = ctx->FindRequestHeader("Accept-Encoding");
+        const bool use_gzip = !item.gzip.empty() && accept_encoding
+            && std::string_view(accept_encoding).find("gzip") != std::string_view::npos;
+        const char* etag = use_gzip ? item.gzip_etag : item.etag;
+
+        ctx->AddResponseHeader("ETag", etag);
+        ctx->AddResponseHeader("Vary", "Accept-Encoding");
+        //pages have no versioned urls, make the browser revalidate them, the etag keeps that to a 304
+        ctx->AddResponseHeader("Cache-Control", std::string_view(item.content_type).starts_with("text/html")
+            ? "no-cache" : "public, max-age=3600");
+
+        if (tsto::headers::etag_matches(ctx->FindRequestHeader("If-None-Match"), etag, true)) {
+            ctx->set_response_http_code(304);
+            cb("");
+            return;
+        }
+
+        ctx->AddResponseHeader("Content-Type", item.content_type);
+
+        if (use_gzip) {
+            ctx->AddResponseHeader("Content-Encoding", "gzip");
+            cb(std::string(item.gzip));
+            return;
+        }
+
+        cb(std::string(item.data));
+    }
+
     bool FileServer::is_path_safe(const std::string& requested_path) const {
         try {
             // Allow any path as long as it exists
@@ -4,6 +4,7 @@
 #include <evpp/event_loop.h>
 #include <future>
 #include <queue>
+#include "webpanel_assets.hpp"
 
 namespace file_server {
     class FileServer {
@@ -20,6 +21,8 @@ namespace file_server {
         std::mutex queue_mutex_; 
         std::queue<std::future<void>> pending_ops_;
 
+        void serve_embedded(const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb,
+            const webpanel::asset& item);
         void async_read_file(evpp::EventLoop* loop, const std::string& file_path,
             const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
         bool is_path_safe(const std::string& requested_path) const;
@@ -0,0 +1,39 @@
+#include <std_include.hpp>
+#include "webpanel_assets.hpp"
+#include "configuration.hpp"
+#include <unordered_map>
+
+namespace file_server::webpanel {
+
+    namespace {
+        const std::unordered_map<std::string_view, const asset*>& index() {
+            static const auto table = [] {
+                std::unordered_map<std::string_view, const asset*> map;
+                map.reserve(embedded_asset_count * 2);
+                for (size_t i = 0; i < embedded_asset_count; ++i) {
+                    const auto* item = &embedded_assets[i];
+                    map.emplace(item->path, item);
+
+                    //panel pages are also linked without their extension
+                    std::string_view path = item->path;
+                    if (path.size() > 5 && path.substr(path.size() - 5) == ".html") {
+                        map.emplace(path.substr(0, path.size() - 5), item);
+                    }
+                }
+                return map;
+            }();
+            return table;
+        }
+    }
+
+    const asset* find(std::string_view uri) {
+        const auto& table = index();
+        auto it = table.find(uri);
+        return it == table.end() ? nullptr : it->second;
+    }
+
+    bool serve_from_disk() {
+        static const bool from_disk = utils::configuration::ReadBoolean("ServerConfig", "WebpanelFromDisk", false);
+        return from_disk;
+    }
+}
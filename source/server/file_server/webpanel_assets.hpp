@@ -0,0 +1,26 @@
+#pragma once
+#include <string_view>
+#include <cstddef>
+
+namespace file_server::webpanel {
+
+    //one file of webpanel/, packed into the binary at build time by webpanel_packer
+    struct asset {
+        const char* path;
+        const char* content_type;
+        std::string_view data;
+        std::string_view gzip;      //empty when the file doesn't compress (images)
+        const char* etag;
+        const char* gzip_etag;      //etag of the gzip variant, empty when there is none
+    };
+
+    //generated table, see build/src/webpanel/webpanel_assets.cpp
+    extern const asset embedded_assets[];
+    extern const size_t embedded_asset_count;
+
+    //exact uri lookup, "/game_config" also finds "/game_config.html", nullptr when not embedded
+    const asset* find(std::string_view uri);
+
+    //ServerConfig.WebpanelFromDisk, serve webpanel/ from disk while working on it
+    bool serve_from_disk();
+}
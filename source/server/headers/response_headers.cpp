@@ -21,6 +21,48 @@ namespace tsto {
             // ctx->AddResponseHeader("Server", "TSTO-Server/1.0");
         }
 
+        bool etag_matches(const char* header, std::string_view etag, bool weak) {
+            if (!header || etag.empty()) {
+                return false;
+            }
+            if (etag.starts_with("W/")) {
+                if (!weak) {
+                    return false;
+                }
+                etag.remove_prefix(2);
+            }
+
+            //a comma may sit inside the quotes of a tag, so the list is walked tag by tag
+            std::string_view list(header);
+            while (true) {
+                const size_t start = list.find_first_not_of(" \t,");
+                if (start == std::string_view::npos) {
+                    break;
+                }
+                list.remove_prefix(start);
+
+                if (list.starts_with("*")) {
+                    return true;
+                }
+                const bool weak_tag = list.starts_with("W/");
+                if (weak_tag) {
+                    list.remove_prefix(2);
+                }
+                if (!list.starts_with("\"")) {
+                    break;
+                }
+                const size_t close = list.find('"', 1);
+                if (close == std::string_view::npos) {
+                    break;
+                }
+                if ((weak || !weak_tag) && list.substr(0, close + 1) == etag) {
+                    return true;
+                }
+                list.remove_prefix(close + 1);
+            }
+            return false;
+        }
+
     } // namespace headers
 
 } // namespace tsto
\ No newline at end of file
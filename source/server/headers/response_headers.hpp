@@ -9,6 +9,11 @@ namespace tsto {
         void set_protobuf_response(const evpp::http::ContextPtr& ctx);
         void set_xml_response(const evpp::http::ContextPtr& ctx);
 
+        //true when the If-Match or If-None-Match value header, a list of entity-tags or "*", names
+        //etag. "*" names any etag but an empty one. If-None-Match compares weak, W/"x" matching
+        //"x", If-Match strong, where a W/ tag matches nothing
+        bool etag_matches(const char* header, std::string_view etag, bool weak);
+
     } 
 
 } 
\ No newline at end of file
@@ -1,18 +1,29 @@
 #include <std_include.hpp>
 
 #include "networking/server_startup.hpp"
-#include "debugging/console.hpp"
-#include "debugging/blackbox.hpp"
 #include "debugging/serverlog.hpp"
+#include "platform/platform.hpp"
 #include <iostream>
 
 #include <tsto_server.hpp>
+#include <flags.hpp>
+#include <configuration.hpp>
+#include "tsto/land/town_store.hpp"
+#include "dispatcher/rate_limiter.hpp"
 
 namespace tsto {
 
     bool TSTOServer::initialize(uint16_t port) {
         server_.SetThreadDispatchPolicy(evpp::ThreadDispatchPolicy::kIPAddressHashing);
 
+        //libevent buffers a whole body before a handler sees it, so the upload limit has to be
+        //set here, the dashboard's own Content-Length check can't stop a chunked upload
+        const uint64_t max_body_mb = utils::configuration::ReadUnsignedInteger("ServerConfig", "DashboardMaxUploadMB", 64);
+        server_.SetMaxBodySize(static_cast<size_t>(max_body_mb * 1024 * 1024));
+
+        //off unless asked for, with SO_REUSEPORT a second server on the same port starts without an error
+        server_.SetReusePort(utils::configuration::ReadBoolean("ServerConfig", "ReusePort", false));
+
         if (!server_.Init({ port })) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
                 "Failed to initialize TSTO server on port %d", port);
@@ -39,23 +50,53 @@ namespace tsto {
   
         google::InitGoogleLogging(argv[0]); // disable evpp verbose logging
 
-        WSADATA wsaData;
-        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-            std::cerr << "WSAStartup failed. Error: " << WSAGetLastError() << std::endl;
+        if (!platform::init_sockets()) {
             return 1;
         }
 
-        create_console();  // Launch debug console
+        platform::create_console();  // Launch debug console
+        platform::set_thread_name("tsto-main");
         logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_INITIALIZER, "Bods Evpp Server Console Started");
         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER, "Starting server...");
 
-        blackbox::initialize_exception_handler();
+        platform::install_crash_handler();
         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER, "Initialized Exception handler");
+
+        //offline migration of towns/*.pb into the packed store, run with -migrate-towns
+        if (utils::flags::has_flag("migrate-towns")) {
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER, "Migrating towns into packed store...");
+            tsto::land::FileTownStore file_store;
+            tsto::land::PackedTownStore packed_store("towns/packed", 64ull * 1024 * 1024, false);
+            tsto::land::TownStore::migrate(file_store, packed_store);
+
+            platform::shutdown_sockets();
+            google::ShutdownGoogleLogging();
+            return 0;
+        }
+
+        //prints what the request rate limiter costs per call, run with -bench-rate-limiter
+        if (utils::flags::has_flag("bench-rate-limiter")) {
+            server::dispatcher::http::RateLimiter::benchmark();
+
+            platform::shutdown_sockets();
+            google::ShutdownGoogleLogging();
+            return 0;
+        }
+
+        //prints what building the largest responses costs with a DOM and with the json writer, run with -bench-json
+        if (utils::flags::has_flag("bench-json")) {
+            tsto::TSTOServer::benchmark_json();
+
+            platform::shutdown_sockets();
+            google::ShutdownGoogleLogging();
+            return 0;
+        }
+
         initialize_servers();
 
         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER, "Server shutting down...");
 
-        WSACleanup();
+        platform::shutdown_sockets();
         google::ShutdownGoogleLogging();
 
         return 0;
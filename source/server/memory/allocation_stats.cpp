@@ -0,0 +1,100 @@
+#include <std_include.hpp>
+#include "allocation_stats.hpp"
+#include "headers/response_headers.hpp"
+#include <json_writer.hpp>
+#include <cstdlib>
+#include <new>
+
+namespace server::memory {
+    namespace {
+        thread_local uint64_t allocations = 0;
+    }
+
+    uint64_t thread_allocations() {
+        return allocations;
+    }
+}
+
+//every plain new goes through here, the array and nothrow forms call it as well. aligned new keeps
+//the runtime's own pair and is not counted
+void* operator new(size_t size) {
+    ++server::memory::allocations;
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        if (void* p = std::malloc(size)) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace server::memory {
+
+    AllocationStats& AllocationStats::get() {
+        static AllocationStats instance;
+        return instance;
+    }
+
+    void AllocationStats::record(std::string_view route, uint64_t allocations, size_t arena_bytes, size_t overflow_blocks) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = routes_.find(route);
+        if (it == routes_.end()) {
+            if (routes_.size() >= max_routes) {
+                route = "other";
+            }
+            it = routes_.try_emplace(std::string(route)).first;
+        }
+
+        auto& counters = it->second;
+        ++counters.requests;
+        counters.allocations += allocations;
+        counters.max_allocations = (std::max)(counters.max_allocations, allocations);
+        counters.arena_bytes += arena_bytes;
+        counters.overflow_blocks += overflow_blocks;
+    }
+
+    void AllocationStats::handle_metrics(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
+        const evpp::http::HTTPSendResponseCallback& cb) {
+        auto& stats = get();
+        tsto::headers::set_json_response(ctx);
+
+        std::string& response = utils::json::thread_buffer();
+        utils::json::writer writer(response);
+        writer.begin_object()
+            .member("status", "success")
+            .key("routes").begin_array();
+
+        {
+            std::lock_guard<std::mutex> lock(stats.mutex_);
+            for (const auto& [route, counters] : stats.routes_) {
+                const double requests = static_cast<double>(counters.requests);
+                writer.begin_object()
+                    .member("route", route)
+                    .member("requests", counters.requests)
+                    .member("heap_allocations_per_request", static_cast<double>(counters.allocations) / requests)
+                    .member("max_heap_allocations", counters.max_allocations)
+                    .member("arena_bytes_per_request", static_cast<double>(counters.arena_bytes) / requests)
+                    .member("arena_overflow_blocks", counters.overflow_blocks)
+                    .end_object();
+            }
+        }
+
+        writer.end_array().end_object();
+        cb(response);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <evpp/http/context.h>
+#include <evpp/http/http_server.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace server::memory {
+
+    //heap allocations made by the calling thread so far, counted by the replaced global operator new
+    uint64_t thread_allocations();
+
+    //heap allocations and arena use per route, recorded by RequestArena::scope at the end of each
+    //dispatch. routes are uris with their id segments replaced by *, past max_routes of them the
+    //rest is counted under "other"
+    class AllocationStats {
+    public:
+        static AllocationStats& get();
+
+        void record(std::string_view route, uint64_t allocations, size_t arena_bytes, size_t overflow_blocks);
+
+        // /api/server/allocations
+        static void handle_metrics(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+            const evpp::http::HTTPSendResponseCallback& cb);
+
+    private:
+        struct route_counters {
+            uint64_t requests = 0;
+            uint64_t allocations = 0;
+            uint64_t max_allocations = 0;
+            uint64_t arena_bytes = 0;
+            uint64_t overflow_blocks = 0;
+        };
+
+        static constexpr size_t max_routes = 256;
+
+        AllocationStats() = default;
+        AllocationStats(const AllocationStats&) = delete;
+        AllocationStats& operator=(const AllocationStats&) = delete;
+
+        std::mutex mutex_;
+        std::map<std::string, route_counters, std::less<>> routes_;
+    };
+}
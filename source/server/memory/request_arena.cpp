@@ -0,0 +1,149 @@
+#include <std_include.hpp>
+#include "request_arena.hpp"
+#include "allocation_stats.hpp"
+#include <configuration.hpp>
+#include <cstring>
+#include <vector>
+
+namespace server::memory {
+
+    namespace {
+        struct arena_config {
+            size_t initial_size;
+            size_t pool_size;
+        };
+
+        const arena_config& config() {
+            static const arena_config instance{
+                static_cast<size_t>((std::max)(1u, utils::configuration::ReadUnsignedInteger("ServerConfig", "RequestArenaKB", 16))) * 1024,
+                utils::configuration::ReadUnsignedInteger("ServerConfig", "RequestArenaPool", 8),
+            };
+            return instance;
+        }
+
+        //rewound arenas kept for the next requests on this thread
+        struct arena_pool {
+            std::vector<RequestArena*> free;
+
+            ~arena_pool() {
+                for (RequestArena* arena : free) {
+                    delete arena;
+                }
+            }
+        };
+
+        thread_local arena_pool pool;
+        thread_local RequestArena* current_arena = nullptr;
+    }
+
+    void* RequestArena::counted_upstream::do_allocate(size_t bytes, size_t alignment) {
+        ++blocks;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void RequestArena::counted_upstream::do_deallocate(void* p, size_t bytes, size_t alignment) {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    RequestArena::RequestArena(size_t initial_size)
+        : initial_(std::make_unique<std::byte[]>(initial_size))
+        , initial_size_(initial_size)
+        , resource_(initial_.get(), initial_size, &upstream_) {
+    }
+
+    RequestArena::ref::~ref() {
+        if (arena_ && arena_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            recycle(arena_);
+        }
+    }
+
+    void* RequestArena::do_allocate(size_t bytes, size_t alignment) {
+        used_ += bytes;
+        return resource_.allocate(bytes, alignment);
+    }
+
+    void RequestArena::rewind() {
+        resource_.release();
+        upstream_.blocks = 0;
+        used_ = 0;
+    }
+
+    void RequestArena::recycle(RequestArena* arena) {
+        //an arena whose last ref goes on another thread than it was made on just joins that thread's pool
+        if (pool.free.size() >= config().pool_size) {
+            delete arena;
+            return;
+        }
+        arena->rewind();
+        pool.free.push_back(arena);
+    }
+
+    RequestArena::ref RequestArena::acquire() {
+        if (pool.free.empty()) {
+            return ref(new RequestArena(config().initial_size));
+        }
+        RequestArena* arena = pool.free.back();
+        pool.free.pop_back();
+        return ref(arena);
+    }
+
+    RequestArena* RequestArena::current() {
+        return current_arena;
+    }
+
+    RequestArena::ref RequestArena::for_request() {
+        return current_arena ? ref(current_arena) : acquire();
+    }
+
+    std::string_view RequestArena::copy(std::string_view str) {
+        if (str.empty()) {
+            return {};
+        }
+        auto* data = static_cast<char*>(allocate(str.size(), 1));
+        std::memcpy(data, str.data(), str.size());
+        return { data, str.size() };
+    }
+
+    RequestArena::scope::scope(RequestArena& arena)
+        : arena_(arena)
+        , previous_(std::exchange(current_arena, &arena))
+        , start_allocations_(thread_allocations()) {
+    }
+
+    RequestArena::scope::~scope() {
+        const uint64_t allocations = thread_allocations() - start_allocations_;
+        current_arena = previous_;
+        if (!route_.empty()) {
+            AllocationStats::get().record(route_, allocations, arena_.used(), arena_.overflow_blocks());
+        }
+    }
+
+    void* json_allocator::Malloc(size_t size) {
+        if (!size) {
+            return nullptr;
+        }
+        return arena_->allocate(size, alignof(std::max_align_t));
+    }
+
+    void* json_allocator::Realloc(void* original, size_t original_size, size_t new_size) {
+        if (!original) {
+            return Malloc(new_size);
+        }
+        if (!new_size) {
+            return nullptr;
+        }
+        if (new_size <= original_size) {
+            return original;
+        }
+        void* grown = Malloc(new_size);
+        std::memcpy(grown, original, original_size);
+        return grown;
+    }
+
+    google::protobuf::ArenaOptions proto_arena_options(RequestArena& arena, size_t initial_size) {
+        google::protobuf::ArenaOptions options;
+        options.initial_block = static_cast<char*>(arena.allocate(initial_size, alignof(std::max_align_t)));
+        options.initial_block_size = initial_size;
+        return options;
+    }
+}
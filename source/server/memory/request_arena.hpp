@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <google/protobuf/arena.h>
+#include <rapidjson/document.h>
+
+namespace server::memory {
+
+    //the transient memory of one request: uri pieces, parse trees, protobuf messages and whatever
+    //else dies with the response. allocating only bumps a pointer, nothing is freed one by one.
+    //once the last ref is gone the arena is rewound and kept by the thread for its next request,
+    //ServerConfig.RequestArenaPool of them per thread, each starting with RequestArenaKB of memory
+    class RequestArena final : public std::pmr::memory_resource {
+    public:
+        //shared ownership of an arena, the dispatcher holds one for the request and coroutine
+        //handlers take their own when arena memory has to outlive a co_await
+        class ref {
+        public:
+            ref() = default;
+            explicit ref(RequestArena* arena) : arena_(arena) { if (arena_) { arena_->refs_.fetch_add(1, std::memory_order_relaxed); } }
+            ref(const ref& other) : ref(other.arena_) {}
+            ref(ref&& other) noexcept : arena_(std::exchange(other.arena_, nullptr)) {}
+            ref& operator=(ref other) noexcept { std::swap(arena_, other.arena_); return *this; }
+            ~ref();
+
+            RequestArena* get() const { return arena_; }
+            RequestArena& operator*() const { return *arena_; }
+            RequestArena* operator->() const { return arena_; }
+            explicit operator bool() const { return arena_ != nullptr; }
+
+        private:
+            RequestArena* arena_ = nullptr;
+        };
+
+        //makes an arena current on this thread while the dispatcher runs, and charges the heap
+        //allocations made meanwhile to the route. a coroutine handler's work after its first
+        //co_await runs outside the scope and is not counted
+        class scope {
+        public:
+            explicit scope(RequestArena& arena);
+            ~scope();
+            scope(const scope&) = delete;
+            scope& operator=(const scope&) = delete;
+
+            //the view must stay valid until the scope ends, keep it in the arena
+            void set_route(std::string_view route) { route_ = route; }
+
+        private:
+            RequestArena& arena_;
+            RequestArena* previous_;
+            uint64_t start_allocations_;
+            std::string_view route_;
+        };
+
+        //a rewound arena from this thread's pool, or a new one
+        static ref acquire();
+
+        //the arena of the request being dispatched on this thread, null outside of one
+        static RequestArena* current();
+
+        //current() when there is a request, otherwise a fresh arena, so handlers also work when
+        //called directly
+        static ref for_request();
+
+        //copies str into the arena
+        std::string_view copy(std::string_view str);
+
+        size_t used() const { return used_; }
+        size_t overflow_blocks() const { return upstream_.blocks; }
+
+    private:
+        //blocks past the first come from the heap, counted so the metrics show arenas that are too small
+        struct counted_upstream final : public std::pmr::memory_resource {
+            size_t blocks = 0;
+
+            void* do_allocate(size_t bytes, size_t alignment) override;
+            void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+            bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+        };
+
+        explicit RequestArena(size_t initial_size);
+        RequestArena(const RequestArena&) = delete;
+        RequestArena& operator=(const RequestArena&) = delete;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+
+        void rewind();
+        static void recycle(RequestArena* arena);
+
+        std::unique_ptr<std::byte[]> initial_;
+        size_t initial_size_;
+        counted_upstream upstream_;
+        std::pmr::monotonic_buffer_resource resource_;
+        size_t used_ = 0;
+        std::atomic<uint32_t> refs_{ 0 };
+    };
+
+    //rapidjson allocator over an arena, Free does nothing and memory goes back with the arena
+    class json_allocator {
+    public:
+        static const bool kNeedFree = false;
+
+        json_allocator() = default;
+        explicit json_allocator(RequestArena* arena) : arena_(arena) {}
+
+        void* Malloc(size_t size);
+        void* Realloc(void* original, size_t original_size, size_t new_size);
+        static void Free(void*) {}
+
+        bool operator==(const json_allocator& other) const { return arena_ == other.arena_; }
+        bool operator!=(const json_allocator& other) const { return arena_ != other.arena_; }
+
+    private:
+        RequestArena* arena_ = nullptr;
+    };
+
+    namespace detail {
+        struct json_allocators {
+            json_allocator base;
+            rapidjson::MemoryPoolAllocator<json_allocator> pool;
+
+            explicit json_allocators(RequestArena& arena) : base(&arena), pool(1024, &base) {}
+        };
+    }
+
+    //a rapidjson document whose values, strings and parse stack all live in the arena; used like
+    //rapidjson::Document for parsing request bodies
+    class JsonDocument final : private detail::json_allocators,
+        public rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<json_allocator>, json_allocator> {
+    public:
+        explicit JsonDocument(RequestArena& arena)
+            : detail::json_allocators(arena)
+            , GenericDocument(&pool, 256, &base) {
+        }
+    };
+
+    //a protobuf arena whose first block comes from the request arena, so request messages of up
+    //to about initial_size bytes never reach the heap
+    google::protobuf::ArenaOptions proto_arena_options(RequestArena& arena, size_t initial_size = 4096);
+}
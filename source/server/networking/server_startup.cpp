@@ -1,46 +1,21 @@
 #include <std_include.hpp>
 #include "server_startup.hpp"
 #include "dispatcher/dispatcher.hpp"
+#include "dispatcher/town_router.hpp"
+#include "dispatcher/admission_control.hpp"
+#include "async/task.hpp"
 #include "debugging/console.hpp"
 #include "debugging/serverlog.hpp"
 #include "configuration.hpp"
 #include "../discord/discord_rpc.hpp"
 #include "../updater/updater.hpp"
 #include "../tsto/dashboard/dashboard.hpp"
-#include <WS2tcpip.h>
-#include <iphlpapi.h>
-#pragma comment(lib, "iphlpapi.lib")
-#pragma comment(lib, "ws2_32.lib")
-
-
-std::string get_local_ipv4() {
-    ULONG bufferSize = 0;
-    if (GetAdaptersAddresses(AF_INET, 0, nullptr, nullptr, &bufferSize) == ERROR_BUFFER_OVERFLOW) {
-        std::vector<unsigned char> buffer(bufferSize);
-        auto addresses = reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data());
-
-        if (GetAdaptersAddresses(AF_INET, 0, nullptr, addresses, &bufferSize) == ERROR_SUCCESS) {
-            for (auto adapter = addresses; adapter != nullptr; adapter = adapter->Next) {
-                // Skip loopback and disabled adapters
-                if (adapter->OperStatus != IfOperStatusUp ||
-                    adapter->IfType == IF_TYPE_SOFTWARE_LOOPBACK)
-                    continue;
-
-                auto address = adapter->FirstUnicastAddress;
-                while (address != nullptr) {
-                    if (address->Address.lpSockaddr->sa_family == AF_INET) {
-                        char ip[INET_ADDRSTRLEN];
-                        sockaddr_in* sockaddr = reinterpret_cast<sockaddr_in*>(address->Address.lpSockaddr);
-                        inet_ntop(AF_INET, &(sockaddr->sin_addr), ip, INET_ADDRSTRLEN);
-                        return std::string(ip);
-                    }
-                    address = address->Next;
-                }
-            }
-        }
-    }
-    return "127.0.0.1"; // Fallback to localhost
-}
+#include "../tsto/land/land.hpp"
+#include "../tsto/cache/shared_cache.hpp"
+#include "../tsto/tracking/telemetry_export.hpp"
+#include "../tsto/tracking/telemetry_store.hpp"
+#include "../platform/platform.hpp"
+
 
 void initialize_servers() {  //for now dlc on same port as game
     logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER, "Initializing HTTP Servers...");
@@ -74,7 +49,7 @@ void initialize_servers() {  //for now dlc on same port as game
     std::string initial_donuts = utils::configuration::ReadString("Server", "InitialDonutAmount", "1000");
     utils::configuration::WriteString("Server", "InitialDonutAmount", initial_donuts);
 
-    std::string detected_ip = get_local_ipv4();
+    std::string detected_ip = platform::get_local_ipv4();
     bool auto_detect_ip = utils::configuration::ReadBoolean(CONFIG_SECTION, "AutoDetectIP", true);
     utils::configuration::WriteBoolean(CONFIG_SECTION, "AutoDetectIP", auto_detect_ip);
 
@@ -99,6 +74,17 @@ void initialize_servers() {  //for now dlc on same port as game
 
     auto dispatcher = std::make_shared<server::dispatcher::http::Dispatcher>(tsto_server);
 
+    //off unless ServerConfig.ClusterNodesFile is set, then players are sent to the node owning their town
+    auto router = std::make_shared<server::dispatcher::http::TownRouter>(
+        [dispatcher](evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+            dispatcher->handle(loop, ctx, cb);
+        },
+        []() {
+            const auto player = tsto::land::Land::session_player();
+            return std::make_pair(player.town, player.user_id);
+        },
+        server::dispatcher::http::TownRouter::options::from_config(server_ip + ":" + std::to_string(game_port)));
+
     //// DLC Server on port 3074
     //evpp::EventLoop dlc_loop;
     //evpp::http::Server dlc_server(2);
@@ -109,10 +95,17 @@ void initialize_servers() {  //for now dlc on same port as game
     evpp::http::Server game_server(2);
     game_server.SetThreadDispatchPolicy(evpp::ThreadDispatchPolicy::kIPAddressHashing);
 
-    game_server.RegisterDefaultHandler([dispatcher](evpp::EventLoop* loop,
+    game_server.RegisterDefaultHandler([router](evpp::EventLoop* loop,
         const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
-            dispatcher->handle(loop, ctx, cb);
+            //refused with 503 while this worker loop is overloaded, see ServerConfig.Admission*
+            auto& admission = server::dispatcher::http::AdmissionControl::get();
+            if (!admission.admit(loop, ctx, cb)) {
+                return;
+            }
+            const evpp::Timestamp started = evpp::Timestamp::Now();
+            router->handle(loop, ctx, cb);
+            admission.handled(loop, started);
         });
 
     /*   if (!dlc_server.Init({ static_cast<uint16_t>(dlc_port) })) {
@@ -126,6 +119,9 @@ void initialize_servers() {  //for now dlc on same port as game
     }
 
 
+    //coroutine handlers move their database and file work here, see ServerConfig.IoPoolThreads
+    server::async::IoPool::get().start();
+
     // Start servers
     //dlc_server.Start();
     game_server.Start();
@@ -147,9 +143,33 @@ void initialize_servers() {  //for now dlc on same port as game
         discord_thread.detach();
     }
 
+    //membership changes are picked up without a restart
+    if (router->enabled()) {
+        const uint32_t reload_seconds = (std::max)(1u, utils::configuration::ReadUnsignedInteger(CONFIG_SECTION, "ClusterReloadSeconds", 10));
+        //new members are resolved with getaddrinfo, so the reload runs on the io pool, always on
+        //the same thread so two slow ones never overlap
+        game_loop.RunEvery(evpp::Duration(static_cast<double>(reload_seconds)), [router]() {
+            if (auto* io_loop = server::async::IoPool::get().next(std::hash<std::string>{}("cluster"))) {
+                io_loop->RunInLoop([router]() { router->reload(); });
+            }
+            else {
+                router->reload();
+            }
+        });
+    }
+
+    //off unless ServerConfig.TelemetryNsqd is set, also replays telemetry spilled by the last run
+    tsto::tracking::TelemetryExport::get().start();
+    tsto::tracking::TelemetryStore::get().start();
+
     game_loop.Run();
     //dlc_thread.join();
 
+    tsto::tracking::TelemetryExport::get().shutdown();
+    tsto::tracking::TelemetryStore::get().shutdown();
+    tsto::cache::SharedCache::get().shutdown();
+    server::async::IoPool::get().shutdown();
+
     // clean shitcord
     if (enable_discord) {
         server::discord::DiscordRPC::Shutdown();
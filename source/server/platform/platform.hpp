@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <optional>
+
+//everything the server needs from the OS, implemented in platform_windows.cpp and platform_posix.cpp
+namespace platform
+{
+	enum class console_color
+	{
+		normal,
+		red,
+		green,
+		cyan,
+		blue,
+		yellow
+	};
+
+	bool init_sockets();
+	void shutdown_sockets();
+
+	void create_console();
+	void write_console(const std::string& line, console_color color);
+	void debug_output(const std::string& line);
+
+	//first up, non loopback ipv4 address, 127.0.0.1 if there is none
+	std::string get_local_ipv4();
+
+	void install_crash_handler();
+
+	//names longer than 15 chars are cut on linux
+	void set_thread_name(const std::string& name);
+
+	//start a fresh copy of the server and exit this one, false if it could not be started
+	bool restart_process();
+	[[noreturn]] void exit_process(int code);
+
+	//native folder picker, nullopt when cancelled or when there is no desktop
+	std::optional<std::string> browse_directory(const std::string& title);
+}
@@ -0,0 +1,166 @@
+#include <std_include.hpp>
+#include "platform.hpp"
+
+#ifndef _WIN32
+#include <csignal>
+#include <cstring>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <pthread.h>
+#include <execinfo.h>
+
+namespace platform
+{
+	namespace
+	{
+		const char* crash_log_path = "tsto_server_crash.log";
+
+		//only async signal safe calls in here, the heap may be what broke
+		void crash_signal_handler(int sig)
+		{
+			const int fd = ::open(crash_log_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+			char header[64];
+			const int header_length = std::snprintf(header, sizeof(header), "fatal signal %d\n", sig);
+			::write(STDERR_FILENO, header, header_length);
+
+			void* frames[64];
+			const int count = ::backtrace(frames, 64);
+			::backtrace_symbols_fd(frames, count, STDERR_FILENO);
+
+			if (fd >= 0) {
+				::write(fd, header, header_length);
+				::backtrace_symbols_fd(frames, count, fd);
+				::close(fd);
+			}
+
+			//default action so the core dump still happens
+			::signal(sig, SIG_DFL);
+			::raise(sig);
+		}
+	}
+
+	bool init_sockets()
+	{
+		//a closed peer must not kill the process in the middle of a write
+		::signal(SIGPIPE, SIG_IGN);
+		return true;
+	}
+
+	void shutdown_sockets()
+	{
+	}
+
+	void create_console()
+	{
+		//already attached to the terminal
+		std::ios::sync_with_stdio(false);
+	}
+
+	void write_console(const std::string& line, console_color color)
+	{
+		static const bool use_color = ::isatty(STDOUT_FILENO) != 0;
+		if (!use_color) {
+			std::cout << line << std::endl;
+			return;
+		}
+
+		const char* escape = "\033[0m";
+		switch (color)
+		{
+		case console_color::red: escape = "\033[1;31m"; break;
+		case console_color::green: escape = "\033[1;32m"; break;
+		case console_color::cyan: escape = "\033[1;36m"; break;
+		case console_color::blue: escape = "\033[1;34m"; break;
+		case console_color::yellow: escape = "\033[1;33m"; break;
+		default: break;
+		}
+
+		std::cout << escape << line << "\033[0m" << std::endl;
+	}
+
+	void debug_output(const std::string&)
+	{
+		//no debugger channel, the log file has everything
+	}
+
+	std::string get_local_ipv4()
+	{
+		ifaddrs* addresses = nullptr;
+		if (::getifaddrs(&addresses) != 0) {
+			return "127.0.0.1";
+		}
+
+		std::string result = "127.0.0.1"; // Fallback to localhost
+		for (auto address = addresses; address != nullptr; address = address->ifa_next) {
+			// Skip loopback and disabled interfaces
+			if (address->ifa_addr == nullptr || address->ifa_addr->sa_family != AF_INET ||
+				!(address->ifa_flags & IFF_UP) || (address->ifa_flags & IFF_LOOPBACK))
+				continue;
+
+			char ip[INET_ADDRSTRLEN];
+			auto sockaddr = reinterpret_cast<sockaddr_in*>(address->ifa_addr);
+			if (inet_ntop(AF_INET, &(sockaddr->sin_addr), ip, INET_ADDRSTRLEN)) {
+				result = ip;
+				break;
+			}
+		}
+
+		::freeifaddrs(addresses);
+		return result;
+	}
+
+	void install_crash_handler()
+	{
+		//backtrace() loads libgcc lazily, do it now instead of inside the handler
+		void* warmup[1];
+		::backtrace(warmup, 1);
+
+		struct sigaction action {};
+		action.sa_handler = crash_signal_handler;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESETHAND;
+
+		for (int sig : { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL }) {
+			::sigaction(sig, &action, nullptr);
+		}
+	}
+
+	void set_thread_name(const std::string& name)
+	{
+		::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+	}
+
+	bool restart_process()
+	{
+		std::vector<std::string> args;
+		{
+			std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+			std::string arg;
+			while (std::getline(cmdline, arg, '\0')) {
+				args.push_back(arg);
+			}
+		}
+
+		std::vector<char*> argv;
+		for (auto& arg : args) {
+			argv.push_back(arg.data());
+		}
+		argv.push_back(nullptr);
+
+		//replaces this process, listening sockets are CLOEXEC in libevent so the port is free again
+		::execv("/proc/self/exe", argv.data());
+		return false;
+	}
+
+	void exit_process(int code)
+	{
+		std::_Exit(code);
+	}
+
+	std::optional<std::string> browse_directory(const std::string&)
+	{
+		return std::nullopt;
+	}
+}
+#endif
@@ -0,0 +1,154 @@
+#include <std_include.hpp>
+#include "platform.hpp"
+
+#ifdef _WIN32
+#include "debugging/console.hpp"
+#include "debugging/blackbox.hpp"
+#include <string.hpp>
+
+namespace platform
+{
+	bool init_sockets()
+	{
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+			std::cerr << "WSAStartup failed. Error: " << WSAGetLastError() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void shutdown_sockets()
+	{
+		WSACleanup();
+	}
+
+	void create_console()
+	{
+		::create_console();
+	}
+
+	void write_console(const std::string& line, console_color color)
+	{
+		static bool utf8_initialized = false;
+		if (!utf8_initialized) {
+			SetConsoleOutputCP(CP_UTF8);
+			utf8_initialized = true;
+		}
+
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		if (hConsole == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		WORD attributes = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
+		switch (color)
+		{
+		case console_color::red: attributes = FOREGROUND_RED | FOREGROUND_INTENSITY; break;
+		case console_color::green: attributes = FOREGROUND_GREEN | FOREGROUND_INTENSITY; break;
+		case console_color::cyan: attributes = FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY; break;
+		case console_color::blue: attributes = FOREGROUND_BLUE | FOREGROUND_INTENSITY; break;
+		case console_color::yellow: attributes = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY; break;
+		default: break;
+		}
+
+		SetConsoleTextAttribute(hConsole, attributes);
+		std::cout << line << std::endl;
+		SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+	}
+
+	void debug_output(const std::string& line)
+	{
+		OutputDebugStringA(line.c_str());
+	}
+
+	std::string get_local_ipv4()
+	{
+		ULONG bufferSize = 0;
+		if (GetAdaptersAddresses(AF_INET, 0, nullptr, nullptr, &bufferSize) == ERROR_BUFFER_OVERFLOW) {
+			std::vector<unsigned char> buffer(bufferSize);
+			auto addresses = reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data());
+
+			if (GetAdaptersAddresses(AF_INET, 0, nullptr, addresses, &bufferSize) == ERROR_SUCCESS) {
+				for (auto adapter = addresses; adapter != nullptr; adapter = adapter->Next) {
+					// Skip loopback and disabled adapters
+					if (adapter->OperStatus != IfOperStatusUp ||
+						adapter->IfType == IF_TYPE_SOFTWARE_LOOPBACK)
+						continue;
+
+					auto address = adapter->FirstUnicastAddress;
+					while (address != nullptr) {
+						if (address->Address.lpSockaddr->sa_family == AF_INET) {
+							char ip[INET_ADDRSTRLEN];
+							sockaddr_in* sockaddr = reinterpret_cast<sockaddr_in*>(address->Address.lpSockaddr);
+							inet_ntop(AF_INET, &(sockaddr->sin_addr), ip, INET_ADDRSTRLEN);
+							return std::string(ip);
+						}
+						address = address->Next;
+					}
+				}
+			}
+		}
+		return "127.0.0.1"; // Fallback to localhost
+	}
+
+	void install_crash_handler()
+	{
+		blackbox::initialize_exception_handler();
+	}
+
+	void set_thread_name(const std::string& name)
+	{
+		//SetThreadDescription is win10+, look it up so older systems still start
+		using set_thread_description_t = HRESULT(WINAPI*)(HANDLE, PCWSTR);
+		static const auto set_thread_description = reinterpret_cast<set_thread_description_t>(
+			GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetThreadDescription"));
+		if (set_thread_description) {
+			set_thread_description(GetCurrentThread(), utils::string::convert(name).c_str());
+		}
+	}
+
+	bool restart_process()
+	{
+		char exePath[MAX_PATH];
+		GetModuleFileNameA(NULL, exePath, MAX_PATH);
+
+		STARTUPINFOA si = { sizeof(STARTUPINFOA) };
+		PROCESS_INFORMATION pi;
+
+		if (!CreateProcessA(exePath, NULL, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+			return false;
+		}
+
+		CloseHandle(pi.hProcess);
+		CloseHandle(pi.hThread);
+		ExitProcess(0);
+	}
+
+	void exit_process(int code)
+	{
+		ExitProcess(static_cast<UINT>(code));
+	}
+
+	std::optional<std::string> browse_directory(const std::string& title)
+	{
+		BROWSEINFO bi = { 0 };
+		bi.lpszTitle = title.c_str();
+		bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
+
+		LPITEMIDLIST pidl = SHBrowseForFolder(&bi);
+		if (pidl == nullptr) {
+			return std::nullopt;
+		}
+
+		char path[MAX_PATH];
+		const bool found = SHGetPathFromIDList(pidl, path);
+		CoTaskMemFree(pidl);
+
+		if (!found) {
+			return std::nullopt;
+		}
+		return std::string(path);
+	}
+}
+#endif
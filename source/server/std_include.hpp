@@ -1,5 +1,6 @@
 #pragma once
 
+#ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable: 4100)
 #pragma warning(disable: 4127)
@@ -22,11 +23,10 @@
 #pragma warning(disable: 26498)
 #pragma warning(disable: 26812)
 #pragma warning(disable: 28020)
-
-#ifdef _WIN32
 #pragma warning(disable: 4996)  // Disable UTF-8 warnings
 #endif
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 
 #include <Windows.h>
@@ -56,6 +56,15 @@
 #ifdef min
 #undef min
 #endif
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <csetjmp>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
 
 #include <map>
 #include <atomic>
@@ -81,9 +90,12 @@
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/stringbuffer.h>
 
+#ifdef _MSC_VER
 #pragma warning(pop)
 #pragma warning(disable: 4100)
+#endif
 
+#ifdef _WIN32
 #pragma comment(lib, "ntdll.lib")
 #pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "urlmon.lib" )
@@ -94,6 +106,7 @@
 
 #pragma comment(lib, "bcrypt.lib") // libevent-arc4random
 //#pragma comment(lib, "glog.lib") 
+#endif
 
 
 
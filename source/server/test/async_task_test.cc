@@ -0,0 +1,123 @@
+#include <std_include.hpp>
+#include "test_common.h"
+
+#include "async/task.hpp"
+
+#include <evpp/libevent.h>
+#include <evpp/event_loop_thread.h>
+#include <evpp/http/http_server.h>
+#include <evpp/httpc/request.h>
+#include <evpp/httpc/response.h>
+
+// The io pool is a process singleton that can't be started again once shut down, so the
+// shutdown test comes last
+namespace {
+    const int kPort = 49040;
+
+    struct Reply {
+        int code = 0;
+        std::string body;
+    };
+
+    Reply Get(evpp::EventLoop* loop, const std::string& path) {
+        std::atomic<bool> done(false);
+        Reply reply;
+        auto request = new evpp::httpc::Request(loop, "http://127.0.0.1:" + std::to_string(kPort) + path, "", evpp::Duration(5.0));
+        request->set_retry_number(0);
+        request->Execute([request, &reply, &done](const std::shared_ptr<evpp::httpc::Response>& response) {
+            reply.code = response->http_code();
+            reply.body = response->body().ToString();
+            delete request;
+            done = true;
+        });
+        while (!done) {
+            usleep(1000);
+        }
+        return reply;
+    }
+
+    server::async::task ThrowAfterIo(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb) {
+        const int n = co_await server::async::io(loop, []() { return 1; });
+        if (n == 1) {
+            throw std::runtime_error("handler failed");
+        }
+        cb("unreachable");
+    }
+
+    server::async::task ThrowAfterReply(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb) {
+        co_await server::async::io(loop, []() {});
+        cb("answered");
+        throw std::runtime_error("handler failed after answering");
+    }
+
+    server::async::task SlowIo(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb,
+                               std::atomic<bool>* resumed) {
+        co_await server::async::io(loop, []() { usleep(300 * 1000); });
+        *resumed = true;
+        cb("slow");
+    }
+}
+
+TEST_UNIT(testAsyncTaskAnswersThrow) {
+    server::async::IoPool::get().start();
+
+    evpp::http::Server server(1);
+    server.RegisterHandler("/throw", [](evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        ThrowAfterIo(loop, ctx, cb);
+    });
+    server.RegisterHandler("/answered", [](evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        ThrowAfterReply(loop, ctx, cb);
+    });
+    H_TEST_ASSERT(server.Init(kPort) && server.Start());
+
+    evpp::EventLoopThread client;
+    client.Start(true);
+
+    // A handler that throws once it was resumed is still answered, with a 500
+    Reply r = Get(client.loop(), "/throw");
+    H_TEST_EQUAL(r.code, 500);
+
+    // One that already replied keeps its reply
+    r = Get(client.loop(), "/answered");
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_EQUAL(r.body, "answered");
+
+    client.Stop(true);
+    server.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
+
+TEST_UNIT(testIoPoolShutdownResumes) {
+    server::async::IoPool::get().start();
+
+    std::atomic<bool> resumed(false);
+    evpp::http::Server server(1);
+    server.RegisterHandler("/slow", [&resumed](evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+        SlowIo(loop, ctx, cb, &resumed);
+    });
+    H_TEST_ASSERT(server.Init(kPort) && server.Start());
+
+    evpp::EventLoopThread client;
+    client.Start(true);
+
+    std::atomic<bool> done(false);
+    std::thread request([&client, &done]() {
+        H_TEST_EQUAL(Get(client.loop(), "/slow").body, "slow");
+        done = true;
+    });
+    usleep(100 * 1000);
+
+    // The handler is suspended on the pool: shutdown waits until it was resumed on its loop
+    server::async::IoPool::get().shutdown();
+    H_TEST_ASSERT(resumed);
+
+    request.join();
+    H_TEST_ASSERT(done);
+
+    // Afterwards io work runs inline
+    H_TEST_ASSERT(server::async::IoPool::get().next() == nullptr);
+
+    client.Stop(true);
+    server.Stop();
+    usleep(1000 * 1000); // sleep a while to release the listening address and port
+}
@@ -0,0 +1,9 @@
+#include <std_include.hpp>
+#include "debugging/serverlog.hpp"
+
+// The code under test only logs through logger::write, the real one needs the console and the
+// platform layer
+namespace logger {
+    void write(const char*, const std::string&) {}
+    void write(LogLevel, LogLabel, const char*, ...) {}
+}
@@ -0,0 +1,283 @@
+#include <std_include.hpp>
+#include "test_common.h"
+
+#include "dispatcher/town_router.hpp"
+
+#include <evpp/libevent.h>
+#include <evpp/event_loop_thread.h>
+#include <evpp/http/http_server.h>
+#include <evpp/httpc/request.h>
+#include <evpp/httpc/response.h>
+
+
+// Three nodes: A and B on 127.0.0.1, C on 127.0.0.2 and never listening. C's
+// address is a member but a request from 127.0.0.1 can't come from it.
+namespace {
+    using server::dispatcher::http::TownRouter;
+
+    const int kPortA = 49030;
+    const int kPortB = 49031;
+    const int kPortC = 49032;
+
+    std::string NodeA() { return "127.0.0.1:" + std::to_string(kPortA); }
+    std::string NodeB() { return "127.0.0.1:" + std::to_string(kPortB); }
+    std::string NodeC() { return "127.0.0.2:" + std::to_string(kPortC); }
+
+    std::string NodesFile() {
+        return (std::filesystem::temp_directory_path() / "town_router_test_nodes.txt").string();
+    }
+
+    // Writes the members with a new file time, reload() only reads a changed file. keep_time
+    // leaves the file time as the last call set it
+    void WriteNodes(const std::vector<std::string>& nodes, bool keep_time = false) {
+        static auto stamp = std::filesystem::file_time_type::clock::now();
+        if (!keep_time) {
+            stamp += std::chrono::seconds(2);
+        }
+
+        std::ofstream file(NodesFile(), std::ios::trunc);
+        file << "# written by town_router_test\n";
+        for (const auto& n : nodes) {
+            file << n << "\n";
+        }
+        file.close();
+        std::filesystem::last_write_time(NodesFile(), stamp);
+    }
+
+    TownRouter::options Options(const std::string& self, bool shared_store = false) {
+        TownRouter::options o;
+        o.nodes_file = NodesFile();
+        o.self = self;
+        o.timeout_ms = 1000;
+        o.down_seconds = 30;
+        o.shared_store = shared_store;
+        return o;
+    }
+
+    // Answers with the node's name and the forwarding headers it was left with
+    evpp::http::HTTPRequestCallback LocalHandler(const std::string& name) {
+        return [name](evpp::EventLoop*, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+            const char* by = ctx->FindRequestHeader(TownRouter::forwarded_header);
+            const char* town = ctx->FindRequestHeader(TownRouter::town_header);
+            cb(name + " by=" + (by ? by : "-") + " town=" + (town ? town : "-"));
+        };
+    }
+
+    TownRouter::player_fn Player(const std::string& town) {
+        return [town]() { return std::make_pair(town, std::string("user-") + town); };
+    }
+
+    std::shared_ptr<TownRouter> MakeRouter(const std::string& name, const std::string& self, bool shared_store = false) {
+        return std::make_shared<TownRouter>(LocalHandler(name), Player(name + ".pb"), Options(self, shared_store));
+    }
+
+    // A land id the router sends to owner, "" meaning itself
+    std::string LandOwnedBy(const TownRouter& router, const std::string& owner) {
+        for (int i = 0; i < 10000; ++i) {
+            const std::string id = "land-" + std::to_string(i);
+            if (router.owner_of(id) == owner) {
+                return id;
+            }
+        }
+        return "";
+    }
+
+    struct Reply {
+        int code = 0;
+        std::string body;
+        std::string retry_after;
+    };
+
+    Reply Send(evpp::EventLoop* loop, int port, const std::string& land_id,
+               const std::vector<std::pair<std::string, std::string>>& headers = {}) {
+        std::atomic<bool> done(false);
+        Reply reply;
+        const std::string url = "http://127.0.0.1:" + std::to_string(port) + "/protoland/" + land_id + "/";
+        auto request = new evpp::httpc::Request(loop, url, "", evpp::Duration(5.0));
+        request->set_retry_number(0);
+        request->AddHeader("mh_uid", land_id);
+        for (const auto& h : headers) {
+            request->AddHeader(h.first, h.second);
+        }
+        request->Execute([request, &reply, &done](const std::shared_ptr<evpp::httpc::Response>& response) {
+            reply.code = response->http_code();
+            reply.body = response->body().ToString();
+            if (const char* retry_after = response->FindHeader("Retry-After")) {
+                reply.retry_after = retry_after;
+            }
+            delete request;
+            done = true;
+        });
+        while (!done) {
+            usleep(1000);
+        }
+        return reply;
+    }
+
+    // An http server on port whose every request goes through router
+    struct Node {
+        std::shared_ptr<TownRouter> router;
+        evpp::http::Server server;
+        bool started = false;
+
+        Node(std::shared_ptr<TownRouter> r, int port) : router(std::move(r)), server(1) {
+            TownRouter* handler = router.get();
+            server.RegisterDefaultHandler([handler](evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
+                                                    const evpp::http::HTTPSendResponseCallback& cb) {
+                handler->handle(loop, ctx, cb);
+            });
+            started = server.Init(port) && server.Start();
+        }
+
+        ~Node() {
+            // The forwarding connections are closed on the worker loops that opened them, so the
+            // router goes while they still run
+            router.reset();
+            server.Stop();
+            usleep(1000 * 1000); // sleep a while to release the listening address and port
+        }
+    };
+}
+
+TEST_UNIT(testTownRouterRingLookup) {
+    WriteNodes({NodeA(), NodeB(), NodeC()});
+    auto a = MakeRouter("A", NodeA());
+    auto b = MakeRouter("B", NodeB());
+    auto c = MakeRouter("C", NodeC());
+
+    // Every node agrees on the owner of every land id, and each node owns some
+    std::map<std::string, int> owned;
+    for (int i = 0; i < 3000; ++i) {
+        const std::string id = "land-" + std::to_string(i);
+        const std::string by_a = a->owner_of(id);
+        const std::string by_b = b->owner_of(id);
+        const std::string by_c = c->owner_of(id);
+        const std::string owner = by_a.empty() ? NodeA() : by_a;
+        H_TEST_EQUAL(by_b.empty() ? NodeB() : by_b, owner);
+        H_TEST_EQUAL(by_c.empty() ? NodeC() : by_c, owner);
+        owned[owner]++;
+    }
+    H_TEST_EQUAL(owned.size(), 3u);
+    for (const auto& o : owned) {
+        H_TEST_ASSERT(o.second > 500);
+    }
+
+    // Off without a nodes file, everything is local
+    TownRouter off(LocalHandler("off"), Player("off.pb"), TownRouter::options());
+    H_TEST_ASSERT(!off.enabled());
+    H_TEST_EQUAL(off.owner_of("land-1"), "");
+}
+
+TEST_UNIT(testTownRouterForwardAndPeerTrust) {
+    WriteNodes({NodeA(), NodeB(), NodeC()});
+    Node a(MakeRouter("A", NodeA()), kPortA);
+    Node b(MakeRouter("B", NodeB()), kPortB);
+    H_TEST_ASSERT(a.started && b.started);
+
+    evpp::EventLoopThread client;
+    client.Start(true);
+
+    const std::string owned_by_a = LandOwnedBy(*a.router, "");
+    const std::string owned_by_b = LandOwnedBy(*a.router, NodeB());
+    H_TEST_ASSERT(!owned_by_a.empty() && !owned_by_b.empty());
+
+    // A handles its own towns and forwards B's, naming the player logged in to A
+    Reply r = Send(client.loop(), kPortA, owned_by_a);
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_EQUAL(r.body, "A by=- town=-");
+
+    r = Send(client.loop(), kPortA, owned_by_b);
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_EQUAL(r.body, "B by=" + NodeA() + " town=A.pb");
+
+    // A peer's forward is handled where it lands, even for a town the receiver does not own
+    r = Send(client.loop(), kPortB, owned_by_a, {{TownRouter::forwarded_header, NodeA()}, {TownRouter::town_header, "peer.pb"}});
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_EQUAL(r.body, "B by=" + NodeA() + " town=peer.pb");
+
+    // C is a member, but this connection is not from C's host: the headers are dropped and the
+    // request is routed like any other
+    r = Send(client.loop(), kPortB, owned_by_b, {{TownRouter::forwarded_header, NodeC()}, {TownRouter::town_header, "victim.pb"}});
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_EQUAL(r.body, "B by=- town=-");
+
+    r = Send(client.loop(), kPortB, owned_by_a, {{TownRouter::forwarded_header, "10.1.1.1:80"}, {TownRouter::town_header, "victim.pb"}});
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_EQUAL(r.body, "A by=" + NodeB() + " town=B.pb");
+
+    client.Stop(true);
+}
+
+TEST_UNIT(testTownRouterOwnerDown) {
+    WriteNodes({NodeA(), NodeB(), NodeC()});
+    Node a(MakeRouter("A", NodeA()), kPortA);
+    Node b(MakeRouter("B", NodeB()), kPortB);
+    H_TEST_ASSERT(a.started && b.started);
+
+    evpp::EventLoopThread client;
+    client.Start(true);
+
+    const std::string owned_by_c = LandOwnedBy(*a.router, NodeC());
+    H_TEST_ASSERT(!owned_by_c.empty());
+
+    // The forward fails once, then the town waits for its owner instead of moving to a node
+    // that does not have it
+    Reply r = Send(client.loop(), kPortA, owned_by_c);
+    H_TEST_EQUAL(r.code, 502);
+    r = Send(client.loop(), kPortA, owned_by_c);
+    H_TEST_EQUAL(r.code, 503);
+    H_TEST_ASSERT(!r.retry_after.empty() && std::atoi(r.retry_after.c_str()) > 0);
+    H_TEST_EQUAL(a.router->owner_of(owned_by_c), NodeC());
+
+    client.Stop(true);
+}
+
+TEST_UNIT(testTownRouterSharedStoreFailover) {
+    WriteNodes({NodeA(), NodeB(), NodeC()});
+    Node a(MakeRouter("A", NodeA(), true), kPortA);
+    Node b(MakeRouter("B", NodeB(), true), kPortB);
+    H_TEST_ASSERT(a.started && b.started);
+
+    evpp::EventLoopThread client;
+    client.Start(true);
+
+    const std::string owned_by_c = LandOwnedBy(*a.router, NodeC());
+    H_TEST_ASSERT(!owned_by_c.empty());
+
+    // Every node can read C's towns, so once C failed the next node on the ring serves them
+    Reply r = Send(client.loop(), kPortA, owned_by_c);
+    H_TEST_EQUAL(r.code, 502);
+    r = Send(client.loop(), kPortA, owned_by_c);
+    H_TEST_EQUAL(r.code, 200);
+    H_TEST_ASSERT(r.body == "A by=- town=-" || r.body == "B by=" + NodeA() + " town=A.pb");
+    H_TEST_ASSERT(a.router->owner_of(owned_by_c) != NodeC());
+
+    client.Stop(true);
+}
+
+TEST_UNIT(testTownRouterReload) {
+    WriteNodes({NodeA(), NodeB()});
+    auto a = MakeRouter("A", NodeA());
+    const std::string owned_by_b = LandOwnedBy(*a, NodeB());
+    H_TEST_ASSERT(!owned_by_b.empty());
+
+    // B leaves, its towns come to A
+    WriteNodes({NodeA()});
+    a->reload();
+    H_TEST_EQUAL(a->owner_of(owned_by_b), "");
+
+    // Nothing is re-read while the file time is unchanged
+    WriteNodes({NodeA(), NodeB()}, true);
+    a->reload();
+    H_TEST_EQUAL(a->owner_of(owned_by_b), "");
+
+    // B is back, and owns the same towns as before
+    WriteNodes({NodeA(), NodeB()});
+    a->reload();
+    H_TEST_EQUAL(a->owner_of(owned_by_b), NodeB());
+
+    // A file that can't be read keeps the members
+    std::filesystem::remove(NodesFile());
+    a->reload();
+    H_TEST_EQUAL(a->owner_of(owned_by_b), NodeB());
+}
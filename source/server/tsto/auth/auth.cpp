@@ -5,11 +5,13 @@
 #include <rapidjson/stringbuffer.h>
 #include "tsto_server.hpp"
 #include <serialization.hpp>
+#include <json_writer.hpp>
 #include "tsto/includes/session.hpp" 
 #include <AuthData.pb.h> 
 #include <sstream>
 #include <random>
 #include "tsto/database/database.hpp"
+#include "token_signer.hpp"
 #include <vector>
 #include <cctype> 
 #include <algorithm> 
@@ -43,15 +45,7 @@ namespace tsto::auth {
 
     //gen random string
     std::string generate_random_string(size_t length) {
-        static const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
-        std::string result;
-        result.resize(length);
-
-        for (size_t i = 0; i < length; ++i) {
-            result[i] = charset[rand() % (sizeof(charset) - 1)];
-        }
-
-        return result;
+        return utils::cryptography::random::get_alnum(length);
     }
 
     //gen random token
@@ -61,33 +55,64 @@ namespace tsto::auth {
     }
     
     std::string Auth::generate_access_token(const std::string& user_id) {
-        // Format: AT0:2.0:3.0:86400:[random_string]:[user_id]:[random_suffix]
-        std::string random_part = generate_random_string(32);
-        std::string random_suffix = generate_random_string(5);
-        
-        return "AT0:2.0:3.0:86400:" + random_part + ":" + user_id + ":" + random_suffix;
+        return Auth::generate_typed_access_token("AT", user_id);
     }
 
     std::string Auth::generate_random_code() {
         return generate_random_string(40); // 40 char random string
     }
 
-    //gen access token with type prefix
-    std::string Auth::generate_typed_access_token(const std::string& type, const std::string& user_id) {
-        std::stringstream ss;
-        ss << type << "0:2.0:3.0:86400:";
-        ss << generate_random_string(32); // 32 char random string
-        ss << ":" << user_id << ":";
-        ss << generate_random_string(5);  // 5 char random suffix
-        return ss.str();
+    //gen signed access token with type prefix
+    std::string Auth::generate_typed_access_token(const std::string& type, const std::string& user_id, int64_t mayhem_id) {
+        return TokenSigner::get_instance().issue(type, user_id, mayhem_id);
+    }
+
+    bool Auth::resolve_token(const std::string& token, std::string& user_id) {
+        TokenClaims claims;
+        switch (TokenSigner::get_instance().verify(token, claims)) {
+        case TokenCheck::valid:
+            user_id = claims.user_id;
+            return true;
+        case TokenCheck::invalid:
+            return false;
+        case TokenCheck::unknown:
+            break;
+        }
+
+        auto& db = tsto::database::Database::get_instance();
+        std::string email;
+        return db.validate_access_token(token, email) && db.get_user_id(email, user_id);
+    }
+
+    bool Auth::store_user_id(const std::string& email, const std::string& user_id, const std::string& access_token,
+        int64_t mayhem_id, const std::string& access_code) {
+        std::string replaced_token;
+        if (!tsto::database::Database::get_instance().store_user_id(email, user_id, access_token, mayhem_id, access_code, &replaced_token)) {
+            return false;
+        }
+        if (!replaced_token.empty()) {
+            TokenSigner::get_instance().revoke(replaced_token);
+        }
+        return true;
+    }
+
+    bool Auth::update_access_token(const std::string& email, const std::string& access_token) {
+        std::string replaced_token;
+        if (!tsto::database::Database::get_instance().update_access_token(email, access_token, &replaced_token)) {
+            return false;
+        }
+        if (!replaced_token.empty()) {
+            TokenSigner::get_instance().revoke(replaced_token);
+        }
+        return true;
     }
 
     std::string Auth::generate_access_code(const std::string& user_id) {
         return Auth::generate_typed_access_token("AC", user_id);
     }
 
-    void Auth::handle_check_token(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Auth::handle_check_token(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             helpers::log_request(ctx);
 
@@ -123,15 +148,14 @@ namespace tsto::auth {
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH, 
                 "[CHECK TOKEN] User ID: %s, Token: %s", user_id.c_str(), token.c_str());
             
-            auto& db = tsto::database::Database::get_instance();
-            std::string email;
+            std::string token_user_id;
             bool valid = false;
             
             if (!token.empty()) {
-                valid = db.validate_access_token(token, email);
+                valid = co_await server::async::io(loop, [&token, &token_user_id]() { return Auth::resolve_token(token, token_user_id); });
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
-                    "[CHECK TOKEN] Token validation result: %s, email: %s", 
-                    valid ? "valid" : "invalid", email.c_str());
+                    "[CHECK TOKEN] Token validation result: %s, user_id: %s", 
+                    valid ? "valid" : "invalid", token_user_id.c_str());
             }
             
             auto& session = tsto::Session::get();
@@ -159,8 +183,8 @@ namespace tsto::auth {
         }
     }
 
-    void Auth::handle_connect_auth(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Auth::handle_connect_auth(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             logger::write(logger::LOG_LEVEL_INCOMING, logger::LOG_LABEL_AUTH,
                 "[CONNECT AUTH] Request from %s", std::string(ctx->remote_ip()).c_str());
@@ -209,7 +233,7 @@ namespace tsto::auth {
                             "[CONNECT AUTH] Invalid signature format");
                         ctx->set_response_http_code(403);
                         cb("");
-                        return;
+                        co_return;
                     }
 
                     try {
@@ -225,17 +249,11 @@ namespace tsto::auth {
                     }
                 }
 
-                rapidjson::Document doc;
-                doc.SetObject();
-                auto& allocator = doc.GetAllocator();
-
                 //gen a random code and token
                 std::string random_code = Auth::generate_random_code();
                 std::string token = Auth::generate_random_token("47082");
                 std::string lnglv_token = utils::cryptography::base64::encode(token);
-                
-                doc.AddMember("code", rapidjson::Value(random_code.c_str(), allocator), allocator);
-                doc.AddMember("lnglv_token", rapidjson::Value(lnglv_token.c_str(), allocator), allocator);
+
 
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
                     "[CONNECT AUTH] Generated response:\n"
@@ -245,16 +263,17 @@ namespace tsto::auth {
                     lnglv_token.c_str());
 
                 headers::set_json_response(ctx);
-                std::string response = utils::serialization::serialize_json(doc);
+                std::string& response = utils::json::thread_buffer();
+                utils::json::writer writer(response);
+                writer.begin_object()
+                    .member("code", random_code)
+                    .member("lnglv_token", lnglv_token)
+                    .end_object();
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
                     "[CONNECT AUTH] Sending response: %s", response.c_str());
                 cb(response);
             }
             else {
-                rapidjson::Document doc;
-                doc.SetObject();
-                auto& allocator = doc.GetAllocator();
-
                 //gen a random code for anonymous auth
                 std::string random_code = Auth::generate_random_code();
                 
@@ -263,30 +282,36 @@ namespace tsto::auth {
                 
                 //gen a temporary email for anonymous user
                 std::string anon_email = "anonymous_" + generate_random_string(10) + "@temp.com";
+                std::string user_id = session.user_user_id;
                 
                 // Store the anonymous user in the database with the access code
                 // This will allow the code to be validated later
-                std::string access_token = Auth::generate_typed_access_token("AT", session.user_user_id);
+                int64_t mayhem_id = co_await server::async::io(loop, [&db]() { return db.get_next_mayhem_id(); });
+                std::string access_token = Auth::generate_typed_access_token("AT", user_id, mayhem_id);
                 
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
                     "[CONNECT AUTH] Storing anonymous user: email=%s, user_id=%s, access_token=%s, access_code=%s",
-                    anon_email.c_str(), session.user_user_id.c_str(), access_token.c_str(), random_code.c_str());
+                    anon_email.c_str(), user_id.c_str(), access_token.c_str(), random_code.c_str());
                 
                 //store the user data in the database
-                int64_t mayhem_id = db.get_next_mayhem_id();
-                if (!db.store_user_id(anon_email, session.user_user_id, access_token, mayhem_id, random_code)) {
+                const bool stored = co_await server::async::io(loop, [&]() {
+                    return Auth::store_user_id(anon_email, user_id, access_token, mayhem_id, random_code);
+                });
+                if (!stored) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
                         "[CONNECT AUTH] Failed to store anonymous user in database");
                 }
-                
-                doc.AddMember("code", rapidjson::Value(random_code.c_str(), allocator), allocator);
 
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
                     "[CONNECT AUTH] Generated anonymous response:\n"
                     "code: %s", random_code.c_str());
 
                 headers::set_json_response(ctx);
-                std::string response = utils::serialization::serialize_json(doc);
+                std::string& response = utils::json::thread_buffer();
+                utils::json::writer writer(response);
+                writer.begin_object()
+                    .member("code", random_code)
+                    .end_object();
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
                     "[CONNECT AUTH] Sending anonymous response: %s", response.c_str());
                 cb(response);
@@ -304,13 +329,12 @@ namespace tsto::auth {
         }
     }
 
-    void Auth::handle_connect_tokeninfo(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Auth::handle_connect_tokeninfo(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             logger::write(logger::LOG_LEVEL_INCOMING, logger::LOG_LABEL_AUTH,
                 "[CONNECT TOKENINFO] Request from %s", std::string(ctx->remote_ip()).c_str());
 
-            auto& db = tsto::database::Database::get_instance();
             auto& session = tsto::Session::get();
 
             session.reinitialize(); // hacky fix to restart if delete token not called
@@ -420,55 +444,31 @@ namespace tsto::auth {
                     "[CONNECT TOKENINFO] No access token provided in request");
                 ctx->set_response_http_code(400);
                 cb("{\"error\":\"invalid_request\",\"error_description\":\"Missing access token\"}");
-                return;
+                co_return;
             }
 
             headers::set_json_response(ctx);
-            rapidjson::Document doc;
-            doc.SetObject();
-            auto& allocator = doc.GetAllocator();
 
-            //scan token exists in database
-            std::string email;
-            bool found = false;
+            //signed tokens verify in memory, older tokens are looked up in the database
             std::string user_id;
-            int64_t mayhem_id = 0;
-            
-            found = db.validate_access_token(access_token, email);
+            bool found = co_await server::async::io(loop, [&access_token, &user_id]() { return Auth::resolve_token(access_token, user_id); });
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
-                "[CONNECT TOKENINFO] Database lookup result: found=%s, email=%s", 
-                found ? "true" : "false", found ? email.c_str() : "none");
+                "[CONNECT TOKENINFO] Token lookup result: found=%s, user_id=%s", 
+                found ? "true" : "false", found ? user_id.c_str() : "none");
             
             if (found) {
-                if (db.get_user_id(email, user_id)) {
-                    session.user_user_id = user_id;
-                    session.access_token = access_token;
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
-                        "[CONNECT TOKENINFO] User logged in successfully: email=%s, user_id=%s",
-                        email.c_str(), user_id.c_str());
-                } else {
-                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
-                        "[CONNECT TOKENINFO] Failed to get user_id for email: %s", email.c_str());
-                    ctx->set_response_http_code(401);
-                    cb("{\"error\":\"invalid_token\",\"error_description\":\"Invalid token\"}");
-                    return;
-                }
+                session.user_user_id = user_id;
+                session.access_token = access_token;
+                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
+                    "[CONNECT TOKENINFO] User logged in successfully: user_id=%s", user_id.c_str());
             } else {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
                     "[CONNECT TOKENINFO] Invalid access token: %s", access_token.c_str());
                 ctx->set_response_http_code(401);
                 cb("{\"error\":\"invalid_token\",\"error_description\":\"Invalid token\"}");
-                return;
+                co_return;
             }
 
-            doc.AddMember("client_id", "simpsons4-android-client", allocator);
-            doc.AddMember("scope", "offline basic.antelope.links.bulk openid signin antelope-rtm-readwrite search.identity basic.antelope basic.identity basic.persona antelope-inbox-readwrite", allocator);
-            doc.AddMember("expires_in", 4242, allocator);
-            doc.AddMember("pid_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-            doc.AddMember("pid_type", "AUTHENTICATOR_ANONYMOUS", allocator);
-            doc.AddMember("user_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-            doc.AddMember("persona_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-
             //check if we need to include additional fields based on headers
             bool include_underage = false;
             bool include_authenticators = false;
@@ -495,31 +495,44 @@ namespace tsto::auth {
                 include_tid = true;
             }
 
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object()
+                .member("client_id", "simpsons4-android-client")
+                .member("scope", "offline basic.antelope.links.bulk openid signin antelope-rtm-readwrite search.identity basic.antelope basic.identity basic.persona antelope-inbox-readwrite")
+                .member("expires_in", 4242)
+                .member("pid_id", user_id)
+                .member("pid_type", "AUTHENTICATOR_ANONYMOUS")
+                .member("user_id", user_id)
+                .member("persona_id", user_id);
+
             if (include_underage) {
-                doc.AddMember("is_underage", rapidjson::Value(), allocator); //null value
+                writer.key("is_underage").null();
             }
 
             if (include_authenticators) {
-                rapidjson::Value authenticators(rapidjson::kArrayType);
-                rapidjson::Value authenticator(rapidjson::kObjectType);
-                authenticator.AddMember("authenticator_type", "AUTHENTICATOR_ANONYMOUS", allocator);
-                authenticator.AddMember("authenticator_pid_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-                authenticators.PushBack(authenticator, allocator);
-                doc.AddMember("authenticators", authenticators, allocator);
+                writer.key("authenticators").begin_array()
+                    .begin_object()
+                    .member("authenticator_type", "AUTHENTICATOR_ANONYMOUS")
+                    .member("authenticator_pid_id", user_id)
+                    .end_object()
+                    .end_array();
             }
 
             if (include_stopprocess) {
-                doc.AddMember("stopProcess", "OFF", allocator);
+                writer.member("stopProcess", "OFF");
             }
 
             if (include_tid) {
-                doc.AddMember("telemetry_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
+                writer.member("telemetry_id", user_id);
             }
 
+            writer.end_object();
+
             logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_AUTH,
                 "[CONNECT TOKENINFO] Sending response for client_id: %s", ctx->GetQuery("client_id").c_str());
 
-            cb(utils::serialization::serialize_json(doc));
+            cb(response);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH, 
@@ -529,8 +542,8 @@ namespace tsto::auth {
         }
     }
 
-    void Auth::handle_connect_token(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Auth::handle_connect_token(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             logger::write(logger::LOG_LEVEL_INCOMING, logger::LOG_LABEL_AUTH,
                 "[CONNECT TOKEN] Request from %s", std::string(ctx->remote_ip()).c_str());
@@ -548,43 +561,53 @@ namespace tsto::auth {
                     "[CONNECT TOKEN] Missing code parameter");
                 ctx->set_response_http_code(400);
                 cb("{\"error\":\"invalid_request\",\"error_description\":\"Missing code parameter\"}");
-                return;
+                co_return;
             }
 
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
                 "[CONNECT TOKEN] Received code: %s", code.c_str());
 
-            // Get database instance
-            auto& db = tsto::database::Database::get_instance();
-            
-            // Look up the email by access code
+            //the three lookups go to the database together on the io pool
             std::string email;
-            if (!db.get_email_by_access_code(code, email)) {
+            std::string user_id;
+            std::string access_token;
+            enum class lookup { ok, bad_code, no_user, no_token };
+            const lookup found = co_await server::async::io(loop, [&]() {
+                auto& db = tsto::database::Database::get_instance();
+                if (!db.get_email_by_access_code(code, email)) {
+                    return lookup::bad_code;
+                }
+                if (!db.get_user_id(email, user_id)) {
+                    return lookup::no_user;
+                }
+                return db.get_access_token(email, access_token) ? lookup::ok : lookup::no_token;
+            });
+
+            // Look up the email by access code
+            if (found == lookup::bad_code) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
                     "[CONNECT TOKEN] Invalid access code: %s", code.c_str());
                 ctx->set_response_http_code(400);
                 cb("{\"error\":\"invalid_grant\",\"error_description\":\"Invalid code\"}");
-                return;
+                co_return;
             }
 
             // Get the user ID
-            std::string user_id;
-            if (!db.get_user_id(email, user_id)) {
+            if (found == lookup::no_user) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
                     "[CONNECT TOKEN] Failed to get user ID for email: %s", email.c_str());
                 ctx->set_response_http_code(500);
                 cb("{\"error\":\"server_error\",\"error_description\":\"Failed to get user data\"}");
-                return;
+                co_return;
             }
 
             // Get the access token
-            std::string access_token;
-            if (!db.get_access_token(email, access_token)) {
+            if (found == lookup::no_token) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
                     "[CONNECT TOKEN] Failed to get access token for email: %s", email.c_str());
                 ctx->set_response_http_code(500);
                 cb("{\"error\":\"server_error\",\"error_description\":\"Failed to get user data\"}");
-                return;
+                co_return;
             }
 
             headers::set_json_response(ctx);
@@ -592,48 +615,48 @@ namespace tsto::auth {
             session.user_user_id = user_id;
             session.access_token = access_token;
 
-            rapidjson::Document doc;
-            doc.SetObject();
-            auto& allocator = doc.GetAllocator();
-
             // Generate random refresh token with same format but RT0 prefix
             std::string refresh_token_base = "RT0" + access_token.substr(3);  // Replace AT0 with RT0
             std::string refresh_token = refresh_token_base + ".MpDW6wVO8Ek79nu6jxMdSQwOqP";
 
             std::string id_token_header = utils::cryptography::base64::encode("{\"typ\":\"JWT\",\"alg\":\"HS256\"}");
 
-            rapidjson::Document id_token_body_doc;
-            id_token_body_doc.SetObject();
-            id_token_body_doc.AddMember("aud", rapidjson::Value(client_id.c_str(), allocator), allocator);
-            id_token_body_doc.AddMember("iss", "accounts.ea.com", allocator);
-            id_token_body_doc.AddMember("iat", (int64_t)(std::time(nullptr)), allocator);
-            id_token_body_doc.AddMember("exp", (int64_t)(std::time(nullptr)) + 4242, allocator);
-            id_token_body_doc.AddMember("pid_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-            id_token_body_doc.AddMember("user_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-            id_token_body_doc.AddMember("persona_id", rapidjson::Value(user_id.c_str(), allocator), allocator);
-            id_token_body_doc.AddMember("pid_type", "AUTHENTICATOR_ANONYMOUS", allocator);
-            id_token_body_doc.AddMember("auth_time", 0, allocator);
-
-            std::string id_token_body = utils::cryptography::base64::encode(
-                utils::serialization::serialize_json(id_token_body_doc)
-            );
+            std::string id_token_json;
+            utils::json::writer id_token_writer(id_token_json);
+            id_token_writer.begin_object()
+                .member("aud", client_id)
+                .member("iss", "accounts.ea.com")
+                .member("iat", (int64_t)(std::time(nullptr)))
+                .member("exp", (int64_t)(std::time(nullptr)) + 4242)
+                .member("pid_id", user_id)
+                .member("user_id", user_id)
+                .member("persona_id", user_id)
+                .member("pid_type", "AUTHENTICATOR_ANONYMOUS")
+                .member("auth_time", 0)
+                .end_object();
+
+            std::string id_token_body = utils::cryptography::base64::encode(id_token_json);
 
             std::string hex_sig = "2Tok8RykmQD41uWDv5mI7JTZ7NIhcZAIPtiBm4Z5";
             std::string id_token = id_token_header + "." + id_token_body + "." + 
                 utils::cryptography::base64::encode(hex_sig);
 
-            doc.AddMember("access_token", rapidjson::Value(access_token.c_str(), allocator), allocator);
-            doc.AddMember("token_type", "Bearer", allocator);
-            doc.AddMember("expires_in", 4242, allocator);
-            doc.AddMember("refresh_token", rapidjson::Value(refresh_token.c_str(), allocator), allocator);
-            doc.AddMember("refresh_token_expires_in", 4242, allocator);
-            doc.AddMember("id_token", rapidjson::Value(id_token.c_str(), allocator), allocator);
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object()
+                .member("access_token", access_token)
+                .member("token_type", "Bearer")
+                .member("expires_in", 4242)
+                .member("refresh_token", refresh_token)
+                .member("refresh_token_expires_in", 4242)
+                .member("id_token", id_token)
+                .end_object();
 
             logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_AUTH,
                 "[CONNECT TOKEN] Sending %s response for client_id: %s",
                 is_ios ? "iOS" : "Android", client_id.c_str());
 
-            cb(utils::serialization::serialize_json(doc));
+            cb(response);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH, 
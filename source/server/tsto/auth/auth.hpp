@@ -6,6 +6,7 @@
 #include "debugging/serverlog.hpp"
 #include "headers/response_headers.hpp"
 #include "tsto/includes/session.hpp"
+#include "async/task.hpp"
 
 namespace tsto::auth {
     std::string generate_access_token(const std::string& type, const std::string& user_id);
@@ -13,17 +14,17 @@ namespace tsto::auth {
 
     class Auth {
     public:
-        static void handle_check_token(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
-            const evpp::http::HTTPSendResponseCallback& cb);
+        static server::async::task handle_check_token(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+            evpp::http::HTTPSendResponseCallback cb);
 
-        static void handle_connect_auth(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
-            const evpp::http::HTTPSendResponseCallback& cb);
+        static server::async::task handle_connect_auth(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+            evpp::http::HTTPSendResponseCallback cb);
 
-        static void handle_connect_token(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
-            const evpp::http::HTTPSendResponseCallback& cb);
+        static server::async::task handle_connect_token(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+            evpp::http::HTTPSendResponseCallback cb);
 
-        static void handle_connect_tokeninfo(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
-            const evpp::http::HTTPSendResponseCallback& cb);
+        static server::async::task handle_connect_tokeninfo(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+            evpp::http::HTTPSendResponseCallback cb);
 
         static std::string generate_random_code();
 
@@ -31,7 +32,16 @@ namespace tsto::auth {
         
         static std::string generate_access_token(const std::string& user_id);
         
-        static std::string generate_typed_access_token(const std::string& type, const std::string& user_id);
+        static std::string generate_typed_access_token(const std::string& type, const std::string& user_id, int64_t mayhem_id = 0);
+
+        //signed tokens are checked in memory, legacy tokens still go through the database
+        static bool resolve_token(const std::string& token, std::string& user_id);
+
+        //store the user or their token in the database and revoke the signed token the new one
+        //replaces, it would otherwise keep verifying without the database. blocking, run on the io pool
+        static bool store_user_id(const std::string& email, const std::string& user_id, const std::string& access_token,
+            int64_t mayhem_id = 0, const std::string& access_code = "");
+        static bool update_access_token(const std::string& email, const std::string& access_token);
         
         static std::string generate_access_code(const std::string& user_id);
     };
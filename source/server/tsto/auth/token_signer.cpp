@@ -0,0 +1,298 @@
+#include <std_include.hpp>
+#include "token_signer.hpp"
+#include "debugging/serverlog.hpp"
+#include <configuration.hpp>
+#include <cryptography.hpp>
+#include <string.hpp>
+
+namespace tsto::auth {
+
+    namespace {
+        constexpr const char* keys_path = "token_keys.dat";
+        constexpr const char* revocations_path = "token_revocations.dat";
+        constexpr int64_t max_clock_skew = 5 * 60;
+        constexpr size_t secret_size = 32;
+        constexpr size_t signature_size = 16;   //truncated hmac, 32 hex chars like the old random part
+        constexpr size_t max_keys = 4;          //current key plus the ones still accepted
+
+        int64_t now_seconds() {
+            return std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        std::string from_hex(const std::string& hex) {
+            std::string out;
+            out.reserve(hex.size() / 2);
+            for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+                out.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+            }
+            return out;
+        }
+
+        bool equal_constant_time(const std::string& a, const std::string& b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            unsigned char diff = 0;
+            for (size_t i = 0; i < a.size(); ++i) {
+                diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+            }
+            return diff == 0;
+        }
+
+        std::vector<std::string> split(const std::string& text, char delimiter) {
+            std::vector<std::string> parts;
+            size_t start = 0;
+            size_t pos;
+            while ((pos = text.find(delimiter, start)) != std::string::npos) {
+                parts.push_back(text.substr(start, pos - start));
+                start = pos + 1;
+            }
+            parts.push_back(text.substr(start));
+            return parts;
+        }
+    }
+
+    TokenSigner& TokenSigner::get_instance() {
+        static TokenSigner instance;
+        return instance;
+    }
+
+    TokenSigner::TokenSigner() {
+        int64_t days = 30;
+        try {
+            days = std::stoll(utils::configuration::ReadString("ServerConfig", "TokenKeyRotationDays", "30"));
+        }
+        catch (const std::exception&) {
+        }
+        rotation_seconds_ = std::max<int64_t>(days, 1) * 24 * 60 * 60;
+
+        {
+            std::unique_lock<std::shared_mutex> _(keys_mutex_);
+            load_keys();
+            rotate_locked(now_seconds());
+        }
+        load_revocations();
+    }
+
+    void TokenSigner::load_revocations() {
+        //"R <nonce> <expires>" per revoked token, the ones that expired since are dropped here
+        const int64_t now = now_seconds();
+        std::vector<std::pair<std::string, int64_t>> live;
+        {
+            std::ifstream input(revocations_path);
+            std::string line;
+            while (input.is_open() && std::getline(input, line)) {
+                std::istringstream fields(line);
+                std::string type, nonce;
+                int64_t expires = 0;
+                if (fields >> type >> nonce >> expires && type == "R" && expires > now) {
+                    live.emplace_back(std::move(nonce), expires);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> _(revoked_mutex_);
+        const std::string temp_path = std::string(revocations_path) + ".tmp";
+        {
+            std::ofstream output(temp_path, std::ios::trunc);
+            for (const auto& [nonce, expires] : live) {
+                output << "R " << nonce << " " << expires << "\n";
+                revoked_nonces_.insert(nonce);
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, revocations_path, ec);
+
+        revocations_file_ = std::fopen(revocations_path, "ab");
+        if (!revocations_file_) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
+                "[TOKEN] Failed to open %s, revocations will not survive a restart", revocations_path);
+        }
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_AUTH,
+            "[TOKEN] Loaded %zu revoked tokens from %s", live.size(), revocations_path);
+    }
+
+    bool TokenSigner::load_keys() {
+        std::ifstream input(keys_path);
+        if (!input.is_open()) {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            std::string type, secret;
+            signing_key key;
+            if (fields >> type >> key.id >> key.created >> secret && type == "K" && secret.size() == secret_size * 2) {
+                key.secret = from_hex(secret);
+                keys_.push_back(std::move(key));
+            }
+        }
+
+        std::sort(keys_.begin(), keys_.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_AUTH,
+            "[TOKEN] Loaded %zu signing keys from %s", keys_.size(), keys_path);
+        return true;
+    }
+
+    bool TokenSigner::save_keys_locked() {
+        const std::string temp_path = std::string(keys_path) + ".tmp";
+        {
+            std::ofstream output(temp_path, std::ios::trunc);
+            if (!output.is_open()) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
+                    "[TOKEN] Failed to write %s", temp_path.c_str());
+                return false;
+            }
+            for (const auto& key : keys_) {
+                output << "K " << key.id << " " << key.created << " " << utils::string::dump_hex(key.secret, "") << "\n";
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_path, keys_path, ec);
+        if (ec) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
+                "[TOKEN] Failed to install %s: %s", keys_path, ec.message().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void TokenSigner::rotate_locked(int64_t now) {
+        if (!keys_.empty() && now - keys_.back().created < rotation_seconds_) {
+            return;
+        }
+
+        signing_key key;
+        key.id = keys_.empty() ? 1 : keys_.back().id + 1;
+        key.created = now;
+        key.secret.resize(secret_size);
+        utils::cryptography::random::get_data(key.secret.data(), key.secret.size());
+        keys_.push_back(std::move(key));
+
+        //tokens signed with a dropped key are not rejected, they go back to the database check
+        if (keys_.size() > max_keys) {
+            keys_.erase(keys_.begin(), keys_.end() - max_keys);
+        }
+
+        save_keys_locked();
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_AUTH,
+            "[TOKEN] Rotated signing key, current key id %u", keys_.back().id);
+    }
+
+    std::string TokenSigner::sign(const std::string& data, const std::string& secret) const {
+        return utils::string::dump_hex(
+            utils::cryptography::hmac_sha256::compute(data, secret).substr(0, signature_size), "");
+    }
+
+    std::string TokenSigner::issue(const std::string& type, const std::string& user_id, int64_t mayhem_id) {
+        const int64_t now = now_seconds();
+
+        signing_key key;
+        {
+            std::shared_lock<std::shared_mutex> lock(keys_mutex_);
+            if (now - keys_.back().created < rotation_seconds_) {
+                key = keys_.back();
+            }
+        }
+        if (key.secret.empty()) {
+            std::unique_lock<std::shared_mutex> _(keys_mutex_);
+            rotate_locked(now);
+            key = keys_.back();
+        }
+
+        std::stringstream ss;
+        ss << type << "0:2.0:3.0:86400:";
+        ss << "s" << key.id << "." << mayhem_id << "." << now << "." << utils::cryptography::random::get_alnum(8);
+        ss << ":" << user_id;
+
+        const std::string unsigned_token = ss.str();
+        return unsigned_token + ":" + sign(unsigned_token, key.secret);
+    }
+
+    TokenCheck TokenSigner::verify(const std::string& token, TokenClaims& claims) {
+        const size_t sig_pos = token.rfind(':');
+        if (sig_pos == std::string::npos) {
+            return TokenCheck::unknown;
+        }
+
+        const auto parts = split(token, ':');
+        if (parts.size() != 7 || parts[4].size() < 2 || parts[4][0] != 's' || parts[4].find('.') == std::string::npos) {
+            return TokenCheck::unknown;
+        }
+
+        const auto fields = split(parts[4].substr(1), '.');
+        if (fields.size() != 4) {
+            return TokenCheck::invalid;
+        }
+
+        int64_t lifetime = 0;
+        try {
+            lifetime = std::stoll(parts[3]);
+            claims.key_id = static_cast<uint32_t>(std::stoul(fields[0]));
+            claims.mayhem_id = std::stoll(fields[1]);
+            claims.issued_at = std::stoll(fields[2]);
+        }
+        catch (const std::exception&) {
+            return TokenCheck::invalid;
+        }
+        claims.nonce = fields[3];
+        claims.user_id = parts[5];
+
+        std::string secret;
+        {
+            std::shared_lock<std::shared_mutex> lock(keys_mutex_);
+            for (const auto& key : keys_) {
+                if (key.id == claims.key_id) {
+                    secret = key.secret;
+                    break;
+                }
+            }
+        }
+        if (secret.empty()) {
+            return TokenCheck::unknown;
+        }
+
+        if (!equal_constant_time(sign(token.substr(0, sig_pos), secret), parts[6])) {
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_AUTH,
+                "[TOKEN] Signature mismatch for user %s", claims.user_id.c_str());
+            return TokenCheck::invalid;
+        }
+
+        //the lifetime is signed along with the rest, so it can be trusted once the signature is
+        const int64_t now = now_seconds();
+        if (claims.issued_at > now + max_clock_skew || now - claims.issued_at > lifetime) {
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_AUTH,
+                "[TOKEN] Expired token for user %s", claims.user_id.c_str());
+            return TokenCheck::invalid;
+        }
+
+        std::lock_guard<std::mutex> _(revoked_mutex_);
+        if (revoked_nonces_.contains(claims.nonce)) {
+            return TokenCheck::invalid;
+        }
+
+        return TokenCheck::valid;
+    }
+
+    void TokenSigner::revoke(const std::string& token) {
+        TokenClaims claims;
+        if (verify(token, claims) != TokenCheck::valid) {
+            return;
+        }
+
+        const auto parts = split(token, ':');
+        const int64_t expires = claims.issued_at + std::stoll(parts[3]);
+
+        std::lock_guard<std::mutex> _(revoked_mutex_);
+        if (!revoked_nonces_.insert(claims.nonce).second || !revocations_file_) {
+            return;
+        }
+        std::fprintf(revocations_file_, "R %s %lld\n", claims.nonce.c_str(), static_cast<long long>(expires));
+        std::fflush(revocations_file_);
+    }
+}
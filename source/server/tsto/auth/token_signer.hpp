@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+#include <cstdint>
+#include <cstdio>
+
+namespace tsto::auth {
+
+    struct TokenClaims {
+        std::string user_id;
+        int64_t mayhem_id = 0;
+        int64_t issued_at = 0;
+        uint32_t key_id = 0;
+        std::string nonce;
+    };
+
+    enum class TokenCheck {
+        valid,
+        invalid,    //signed by us but tampered, revoked, expired or malformed
+        unknown     //legacy random token or signed with a retired key, ask the database
+    };
+
+    //issues and verifies HMAC-SHA256 signed access tokens, verification never touches disk
+    //token: <type>0:2.0:3.0:86400:s<key>.<mayhem_id>.<issued_at>.<nonce>:<user_id>:<signature>
+    class TokenSigner {
+    public:
+        static TokenSigner& get_instance();
+
+        std::string issue(const std::string& type, const std::string& user_id, int64_t mayhem_id);
+        TokenCheck verify(const std::string& token, TokenClaims& claims);
+
+        //revoked tokens are kept in memory and appended to token_revocations.dat, so they stay
+        //revoked after a restart until they would have expired anyway
+        void revoke(const std::string& token);
+
+    private:
+        struct signing_key {
+            uint32_t id = 0;
+            int64_t created = 0;
+            std::string secret;
+        };
+
+        TokenSigner();
+        TokenSigner(const TokenSigner&) = delete;
+        TokenSigner& operator=(const TokenSigner&) = delete;
+
+        bool load_keys();
+        bool save_keys_locked();
+        void load_revocations();
+        void rotate_locked(int64_t now);
+        std::string sign(const std::string& data, const std::string& secret) const;
+
+        std::shared_mutex keys_mutex_;
+        std::vector<signing_key> keys_;     //newest last
+        int64_t rotation_seconds_;
+
+        std::mutex revoked_mutex_;
+        std::unordered_set<std::string> revoked_nonces_;
+        FILE* revocations_file_ = nullptr;
+    };
+}
@@ -0,0 +1,166 @@
+#include <std_include.hpp>
+#include "shared_cache.hpp"
+#include "debugging/serverlog.hpp"
+#include <configuration.hpp>
+#include <cryptography.hpp>
+#include <evmc/memcache_client_pool.h>
+#include <future>
+
+namespace tsto::cache {
+
+    namespace {
+        //bump when the layout of a cached value changes
+        constexpr uint32_t format_version = 1;
+
+        const char* kind_name(kind k) {
+            switch (k) {
+            case kind::town: return "town";
+            case kind::token: return "token";
+            }
+            return "unknown";
+        }
+
+        //memcached keys are at most 250 bytes with no spaces or control characters
+        bool plain_id(const std::string& id) {
+            if (id.size() > 128) {
+                return false;
+            }
+            for (unsigned char c : id) {
+                if (c <= ' ' || c >= 0x7F) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    SharedCache& SharedCache::get() {
+        static SharedCache instance;
+        return instance;
+    }
+
+    SharedCache::SharedCache() {
+        const std::string servers = utils::configuration::ReadString("ServerConfig", "Memcached", "");
+        if (servers.empty()) {
+            return;
+        }
+
+        const uint32_t generation = utils::configuration::ReadUnsignedInteger("ServerConfig", "CacheGeneration", 1);
+        key_version_ = std::to_string(format_version) + "." + std::to_string(generation);
+        expire_seconds_ = utils::configuration::ReadUnsignedInteger("ServerConfig", "MemcachedExpireSeconds", 3600);
+        max_item_size_ = utils::configuration::ReadUnsignedInteger("ServerConfig", "MemcachedMaxItemSize", 1000 * 1024);
+        timeout_ms_ = static_cast<int>(utils::configuration::ReadUnsignedInteger("ServerConfig", "MemcachedTimeoutMs", 100));
+        const int threads = static_cast<int>(utils::configuration::ReadUnsignedInteger("ServerConfig", "MemcachedThreads", 2));
+
+        auto pool = std::make_unique<evmc::MemcacheClientPool>(servers.c_str(), threads, timeout_ms_);
+        if (!pool->Start()) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_DATABASE,
+                "[CACHE] Failed to start memcached client for %s, shared cache disabled", servers.c_str());
+            return;
+        }
+
+        pool_ = std::move(pool);
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_DATABASE,
+            "[CACHE] Shared cache on %s, key version %s, expiry %us", servers.c_str(), key_version_.c_str(), expire_seconds_);
+    }
+
+    SharedCache::~SharedCache() {
+        shutdown();
+    }
+
+    void SharedCache::shutdown() {
+        if (pool_) {
+            pool_->Stop(true);
+            pool_.reset();
+        }
+    }
+
+    std::string SharedCache::key(kind k, const std::string& id) const {
+        std::string key = "tsto:";
+        key += kind_name(k);
+        key += ':';
+        key += key_version_;
+        key += ':';
+
+        //tokens are hashed so they never show up in memcached's key space
+        if (k != kind::token && plain_id(id)) {
+            key += id;
+        }
+        else {
+            char hashed[17];
+            std::snprintf(hashed, sizeof(hashed), "%016llx",
+                static_cast<unsigned long long>(utils::cryptography::xxh64::compute(id)));
+            key += hashed;
+        }
+
+        return key;
+    }
+
+    void SharedCache::get(evpp::EventLoop* loop, kind k, const std::string& id, get_callback callback) {
+        if (!pool_) {
+            callback(false, std::string());
+            return;
+        }
+
+        pool_->Get(loop, key(k, id), [callback](const std::string& key, const evmc::GetResult& result) {
+            if (result.code != evmc::SUC_RET && result.code != evmc::NOT_FIND_RET) {
+                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
+                    "[CACHE] Get %s failed with code %d", key.c_str(), result.code);
+            }
+            callback(result.code == evmc::SUC_RET, result.value);
+        });
+    }
+
+    bool SharedCache::get_sync(kind k, const std::string& id, std::string& value) {
+        if (!pool_) {
+            return false;
+        }
+
+        //shared so that a reply arriving after we gave up has somewhere to go
+        auto done = std::make_shared<std::promise<std::pair<bool, std::string>>>();
+        auto reply = done->get_future();
+        get(nullptr, k, id, [done](bool hit, const std::string& v) {
+            done->set_value(std::make_pair(hit, v));
+        });
+
+        //evmc fails the command itself after timeout_ms_, this only guards against a lost reply
+        if (reply.wait_for(std::chrono::milliseconds(timeout_ms_ * 2 + 50)) != std::future_status::ready) {
+            return false;
+        }
+
+        auto result = reply.get();
+        if (result.first) {
+            value = std::move(result.second);
+        }
+        return result.first;
+    }
+
+    void SharedCache::set(kind k, const std::string& id, const std::string& value) {
+        if (!pool_) {
+            return;
+        }
+
+        if (value.size() > max_item_size_) {
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
+                "[CACHE] Not caching %s %s, %zu bytes is over the item limit", kind_name(k), id.c_str(), value.size());
+            //a smaller, older copy must not outlive this write
+            remove(k, id);
+            return;
+        }
+
+        pool_->Set(nullptr, key(k, id), value, 0, expire_seconds_, [](const std::string& key, int code) {
+            if (code != evmc::SUC_RET) {
+                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
+                    "[CACHE] Set %s failed with code %d", key.c_str(), code);
+            }
+        });
+    }
+
+    void SharedCache::remove(kind k, const std::string& id) {
+        if (!pool_) {
+            return;
+        }
+
+        pool_->Remove(nullptr, key(k, id), [](const std::string&, int) {});
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+namespace evpp {
+    class EventLoop;
+}
+
+namespace evmc {
+    class MemcacheClientPool;
+}
+
+namespace tsto::cache {
+
+    enum class kind {
+        town,       //serialized LandMessage, keyed by town filename
+        token       //access token -> email
+    };
+
+    //optional memcached tier shared by every tsto_server node, off unless ServerConfig.Memcached
+    //is set to "host:port" or a vbucket config. it only ever holds copies, the town store and
+    //the database stay authoritative.
+    //keys are tsto:<kind>:<format>.<generation>:<id>, bumping ServerConfig.CacheGeneration on
+    //every node orphans all older entries at once
+    class SharedCache {
+    public:
+        using get_callback = std::function<void(bool hit, const std::string& value)>;
+
+        static SharedCache& get();
+        ~SharedCache();
+
+        bool enabled() const { return pool_ != nullptr; }
+
+        //callback runs on loop, or on a cache thread when loop is nullptr. a disabled cache,
+        //a timeout or a down server all count as a miss
+        void get(evpp::EventLoop* loop, kind k, const std::string& id, get_callback callback);
+
+        //blocks for up to the configured timeout, for call sites that can't wait asynchronously
+        bool get_sync(kind k, const std::string& id, std::string& value);
+
+        //fire and forget, values over the item size limit are not cached. commands for the same
+        //id reach memcached in the order they were made
+        void set(kind k, const std::string& id, const std::string& value);
+        void remove(kind k, const std::string& id);
+
+        std::string key(kind k, const std::string& id) const;
+
+        void shutdown();
+
+    private:
+        SharedCache();
+        SharedCache(const SharedCache&) = delete;
+        SharedCache& operator=(const SharedCache&) = delete;
+
+        std::unique_ptr<evmc::MemcacheClientPool> pool_;
+        std::string key_version_;
+        uint32_t expire_seconds_ = 0;
+        uint32_t max_item_size_ = 0;
+        int timeout_ms_ = 0;
+    };
+}
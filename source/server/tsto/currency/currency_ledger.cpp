@@ -0,0 +1,471 @@
+#include <std_include.hpp>
+#include "currency_ledger.hpp"
+#include "debugging/serverlog.hpp"
+#include "platform/platform.hpp"
+#include <configuration.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace tsto::currency {
+
+    namespace {
+        constexpr const char* ledger_path = "towns/currency.ledger";
+        constexpr const char* snapshot_path = "towns/currency.snapshot";
+        constexpr uint64_t snapshot_interval = 10000;   //records between snapshots
+        constexpr size_t max_remembered_deltas = 1024;  //per user idempotency window
+
+        std::string delta_key(const Data::ExtraLandMessage::CurrencyDelta& delta) {
+            //the client reuses ids across sessions, updatedAt keeps retries apart from new deltas
+            return std::to_string(delta.id()) + "@" + std::to_string(delta.updatedat());
+        }
+
+        bool sync_file(FILE* file) {
+            if (std::fflush(file) != 0) {
+                return false;
+            }
+#ifdef _WIN32
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+
+        //records are split on whitespace, so the user field has whitespace, '%' and control
+        //characters written as %XX. records from before stay readable, usernames had none of them
+        std::string escape_user(const std::string& user) {
+            static constexpr char hex[] = "0123456789ABCDEF";
+            std::string escaped;
+            escaped.reserve(user.size());
+            for (const char c : user) {
+                const auto byte = static_cast<unsigned char>(c);
+                if (byte <= ' ' || byte == '%' || byte == 0x7F) {
+                    escaped += '%';
+                    escaped += hex[byte >> 4];
+                    escaped += hex[byte & 0xF];
+                }
+                else {
+                    escaped += c;
+                }
+            }
+            return escaped;
+        }
+
+        std::string unescape_user(const std::string& field) {
+            const auto digit = [](char c) -> int {
+                if (c >= '0' && c <= '9') return c - '0';
+                if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                return -1;
+            };
+
+            std::string user;
+            user.reserve(field.size());
+            for (size_t i = 0; i < field.size(); ++i) {
+                if (field[i] == '%' && i + 2 < field.size() && digit(field[i + 1]) >= 0 && digit(field[i + 2]) >= 0) {
+                    user += static_cast<char>(digit(field[i + 1]) << 4 | digit(field[i + 2]));
+                    i += 2;
+                }
+                else {
+                    user += field[i];
+                }
+            }
+            return user;
+        }
+
+        //makes a rename in towns/ durable, windows has no directory handle to flush
+        void sync_directory(const char* path) {
+#ifndef _WIN32
+            const int fd = open(path, O_RDONLY);
+            if (fd >= 0) {
+                fsync(fd);
+                close(fd);
+            }
+#endif
+        }
+    }
+
+    CurrencyLedger& CurrencyLedger::get_instance() {
+        static CurrencyLedger instance;
+        return instance;
+    }
+
+    CurrencyLedger::CurrencyLedger() {
+        std::filesystem::create_directories("towns");
+        recover();
+
+        ledger_file_ = std::fopen(ledger_path, "ab");
+        if (!ledger_file_) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Failed to open %s, currency changes will not persist", ledger_path);
+        }
+        std::error_code ec;
+        ledger_size_ = std::filesystem::file_size(ledger_path, ec);
+        if (ec) {
+            ledger_size_ = 0;
+        }
+
+        writer_thread_ = std::thread(&CurrencyLedger::writer_loop, this);
+    }
+
+    CurrencyLedger::~CurrencyLedger() {
+        shutdown();
+    }
+
+    std::string CurrencyLedger::user_from_town(const std::string& town_filename) {
+        std::string user = town_filename;
+
+        size_t pb_pos = user.find(".pb");
+        if (pb_pos != std::string::npos) {
+            user = user.substr(0, pb_pos);
+        }
+        size_t txt_pos = user.find(".txt");
+        if (txt_pos != std::string::npos) {
+            user = user.substr(0, txt_pos);
+        }
+
+        if (user.empty() || user == "mytown") {
+            return "default";
+        }
+        return user;
+    }
+
+    void CurrencyLedger::recover() {
+        std::lock_guard<std::mutex> _(mutex_);
+
+        load_snapshot();
+        next_seq_ = snapshot_seq_;
+        replay_ledger();
+        committed_seq_ = next_seq_;
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+            "[CURRENCY] Recovered %zu balances (snapshot seq %llu, ledger seq %llu)", accounts_.size(),
+            static_cast<unsigned long long>(snapshot_seq_), static_cast<unsigned long long>(next_seq_));
+    }
+
+    bool CurrencyLedger::load_snapshot() {
+        std::ifstream input(snapshot_path);
+        if (!input.is_open()) {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            std::string type;
+            fields >> type;
+
+            if (type == "seq") {
+                fields >> snapshot_seq_;
+            }
+            else if (type == "B") {
+                std::string user;
+                int64_t balance = 0;
+                if (fields >> user >> balance) {
+                    accounts_[unescape_user(user)].balance = balance;
+                }
+            }
+            else if (type == "I") {
+                std::string user, key;
+                if (fields >> user >> key) {
+                    remember_delta_locked(accounts_[unescape_user(user)], key);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void CurrencyLedger::replay_ledger() {
+        std::ifstream input(ledger_path);
+        if (!input.is_open()) {
+            return;
+        }
+
+        size_t replayed = 0;
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            uint64_t seq = 0;
+            std::string type, user;
+            if (!(fields >> seq >> type >> user)) {
+                //torn final line from a crash mid-append
+                break;
+            }
+
+            if (seq <= snapshot_seq_) {
+                continue;
+            }
+
+            auto& acc = accounts_[unescape_user(user)];
+            if (type == "S") {
+                int64_t balance = 0;
+                if (!(fields >> balance)) {
+                    break;
+                }
+                acc.balance = balance;
+            }
+            else if (type == "D") {
+                std::string key;
+                int64_t amount = 0;
+                if (!(fields >> key >> amount)) {
+                    break;
+                }
+                if (!acc.applied_deltas.contains(key)) {
+                    acc.balance += amount;
+                    remember_delta_locked(acc, key);
+                }
+            }
+
+            next_seq_ = std::max(next_seq_, seq);
+            replayed++;
+        }
+
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+            "[CURRENCY] Replayed %zu ledger records", replayed);
+    }
+
+    bool CurrencyLedger::write_snapshot_locked() {
+        const std::string temp_path = std::string(snapshot_path) + ".tmp";
+        std::string contents = "seq " + std::to_string(committed_seq_) + "\n";
+        for (const auto& [user, acc] : accounts_) {
+            const std::string field = escape_user(user);
+            contents += "B " + field + " " + std::to_string(acc.balance) + "\n";
+            for (const auto& key : acc.recent_deltas) {
+                contents += "I " + field + " " + key + "\n";
+            }
+        }
+
+        FILE* output = std::fopen(temp_path.c_str(), "wb");
+        if (!output) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Failed to write snapshot %s", temp_path.c_str());
+            return false;
+        }
+
+        //the snapshot has to be on disk before it replaces the old one and the ledger is emptied,
+        //a crash in between would otherwise lose every balance
+        const bool written = std::fwrite(contents.data(), 1, contents.size(), output) == contents.size()
+            && sync_file(output);
+        if (std::fclose(output) != 0 || !written) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Failed to write snapshot %s", temp_path.c_str());
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_path, snapshot_path, ec);
+        if (ec) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Failed to install snapshot: %s", ec.message().c_str());
+            return false;
+        }
+        sync_directory("towns");
+        snapshot_seq_ = committed_seq_;
+
+        //everything in the ledger is now covered by the snapshot
+        if (ledger_file_) {
+            std::fclose(ledger_file_);
+        }
+        ledger_file_ = std::fopen(ledger_path, "wb");
+        ledger_size_ = 0;
+
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+            "[CURRENCY] Wrote snapshot at seq %llu", static_cast<unsigned long long>(snapshot_seq_));
+        return true;
+    }
+
+    CurrencyLedger::account& CurrencyLedger::account_locked(const std::string& user) {
+        auto it = accounts_.find(user);
+        if (it != accounts_.end()) {
+            return it->second;
+        }
+
+        //first touch, import the old per-user text file if there is one
+        int64_t balance = std::stoi(utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
+        const std::string legacy_path = user == "default" ? "towns/currency.txt" : "towns/currency_" + user + ".txt";
+
+        std::ifstream input(legacy_path);
+        if (input.is_open()) {
+            input >> balance;
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Imported legacy balance for %s from %s (Balance: %lld)",
+                user.c_str(), legacy_path.c_str(), static_cast<long long>(balance));
+        }
+
+        auto& acc = accounts_[user];
+        acc.balance = balance;
+        append_locked("S " + escape_user(user) + " " + std::to_string(balance));
+        return acc;
+    }
+
+    void CurrencyLedger::remember_delta_locked(account& acc, const std::string& key) {
+        if (!acc.applied_deltas.insert(key).second) {
+            return;
+        }
+
+        acc.recent_deltas.push_back(key);
+        if (acc.recent_deltas.size() > max_remembered_deltas) {
+            acc.applied_deltas.erase(acc.recent_deltas.front());
+            acc.recent_deltas.pop_front();
+        }
+    }
+
+    uint64_t CurrencyLedger::append_locked(const std::string& record) {
+        const uint64_t seq = ++next_seq_;
+        pending_ += std::to_string(seq);
+        pending_ += ' ';
+        pending_ += record;
+        pending_ += '\n';
+        pending_cv_.notify_one();
+        return seq;
+    }
+
+    bool CurrencyLedger::wait_for_commit(std::unique_lock<std::mutex>& lock, uint64_t seq) {
+        committed_cv_.wait(lock, [&] { return committed_seq_ >= seq || failed_seq_ >= seq; });
+        return committed_seq_ >= seq;
+    }
+
+    void CurrencyLedger::writer_loop() {
+        platform::set_thread_name("tsto-ledger");
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (true) {
+            pending_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                break;
+            }
+
+            //group commit, everything queued while the last fsync ran goes out in one write
+            std::string batch;
+            batch.swap(pending_);
+            const uint64_t batch_seq = next_seq_;
+            FILE* file = ledger_file_;
+
+            lock.unlock();
+            const bool written = file
+                && std::fwrite(batch.data(), 1, batch.size(), file) == batch.size()
+                && sync_file(file);
+            lock.lock();
+
+            if (!written) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[CURRENCY] Failed to append %zu bytes to %s", batch.size(), ledger_path);
+
+                //replay stops at a torn line, cut the ledger back to its whole records before retrying
+                if (ledger_file_) {
+                    std::fclose(ledger_file_);
+                }
+                std::error_code ec;
+                std::filesystem::resize_file(ledger_path, ledger_size_, ec);
+                ledger_file_ = std::fopen(ledger_path, "ab");
+
+                //the batch stays queued ahead of newer records, its waiters learn it is not on disk yet
+                pending_.insert(0, batch);
+                failed_seq_ = batch_seq;
+                committed_cv_.notify_all();
+
+                if (stopping_) {
+                    //the final snapshot still covers these balances
+                    pending_.clear();
+                    break;
+                }
+                pending_cv_.wait_for(lock, std::chrono::seconds(1), [this] { return stopping_; });
+                continue;
+            }
+
+            ledger_size_ += batch.size();
+            committed_seq_ = batch_seq;
+            committed_cv_.notify_all();
+
+            if (pending_.empty() && committed_seq_ - snapshot_seq_ >= snapshot_interval) {
+                write_snapshot_locked();
+            }
+        }
+    }
+
+    int64_t CurrencyLedger::get_balance(const std::string& user) {
+        std::lock_guard<std::mutex> _(mutex_);
+        return account_locked(user).balance;
+    }
+
+    int64_t CurrencyLedger::set_balance(const std::string& user, int64_t balance) {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        auto& acc = account_locked(user);
+        acc.balance = balance;
+        if (!wait_for_commit(lock, append_locked("S " + escape_user(user) + " " + std::to_string(balance)))) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Balance of %s is not on disk yet, it is retried", user.c_str());
+        }
+
+        return balance;
+    }
+
+    DeltaResult CurrencyLedger::apply_deltas(const std::string& user,
+        const google::protobuf::RepeatedPtrField<Data::ExtraLandMessage::CurrencyDelta>& deltas) {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        DeltaResult result;
+        auto& acc = account_locked(user);
+        const std::string user_field = escape_user(user);
+        uint64_t last_seq = 0;
+
+        for (const auto& delta : deltas) {
+            //retries still get acknowledged so the client stops resending them
+            result.processed_ids.push_back(delta.id());
+
+            const std::string key = delta_key(delta);
+            if (acc.applied_deltas.contains(key)) {
+                result.duplicates++;
+                continue;
+            }
+
+            if (delta.amount() > 0) {
+                result.earned += delta.amount();
+            }
+            else {
+                result.spent += std::abs(static_cast<int64_t>(delta.amount()));
+            }
+
+            acc.balance += delta.amount();
+            remember_delta_locked(acc, key);
+            last_seq = append_locked("D " + user_field + " " + key + " " + std::to_string(delta.amount()));
+        }
+
+        if (last_seq) {
+            result.committed = wait_for_commit(lock, last_seq);
+        }
+        else if (result.duplicates && committed_seq_ < failed_seq_) {
+            //retries of deltas whose first write failed and is still being retried
+            result.committed = false;
+        }
+
+        result.balance = acc.balance;
+        return result;
+    }
+
+    void CurrencyLedger::shutdown() {
+        {
+            std::lock_guard<std::mutex> _(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        pending_cv_.notify_all();
+
+        if (writer_thread_.joinable()) {
+            writer_thread_.join();
+        }
+
+        std::lock_guard<std::mutex> _(mutex_);
+        write_snapshot_locked();
+        if (ledger_file_) {
+            std::fclose(ledger_file_);
+            ledger_file_ = nullptr;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdio>
+#include "LandData.pb.h"
+
+namespace tsto::currency {
+
+    struct DeltaResult {
+        int64_t balance = 0;
+        int64_t earned = 0;
+        int64_t spent = 0;
+        size_t duplicates = 0;
+        std::vector<int32_t> processed_ids;
+        bool committed = true;      //false when the ledger could not be written, the deltas are retried
+    };
+
+    //per-user donut balances kept in memory, every change is appended to
+    //towns/currency.ledger and periodically folded into towns/currency.snapshot
+    class CurrencyLedger {
+    public:
+        static CurrencyLedger& get_instance();
+        ~CurrencyLedger();
+
+        //"mytown.pb", "mytown", "" -> "default", "<email>.pb" -> "<email>"
+        static std::string user_from_town(const std::string& town_filename);
+
+        int64_t get_balance(const std::string& user);
+        int64_t set_balance(const std::string& user, int64_t balance);
+
+        //applies each delta once, retried deltas are acknowledged but not re-applied
+        DeltaResult apply_deltas(const std::string& user,
+            const google::protobuf::RepeatedPtrField<Data::ExtraLandMessage::CurrencyDelta>& deltas);
+
+        //flushes pending records and writes a snapshot
+        void shutdown();
+
+    private:
+        struct account {
+            int64_t balance = 0;
+            std::deque<std::string> recent_deltas;
+            std::unordered_set<std::string> applied_deltas;
+        };
+
+        CurrencyLedger();
+        CurrencyLedger(const CurrencyLedger&) = delete;
+        CurrencyLedger& operator=(const CurrencyLedger&) = delete;
+
+        void recover();
+        bool load_snapshot();
+        void replay_ledger();
+        bool write_snapshot_locked();
+
+        account& account_locked(const std::string& user);
+        void remember_delta_locked(account& acc, const std::string& delta_key);
+        uint64_t append_locked(const std::string& record);
+        //false when the write of seq failed, it stays queued and is retried
+        bool wait_for_commit(std::unique_lock<std::mutex>& lock, uint64_t seq);
+        void writer_loop();
+
+        std::mutex mutex_;
+        std::condition_variable pending_cv_;
+        std::condition_variable committed_cv_;
+        std::unordered_map<std::string, account> accounts_;
+
+        std::string pending_;
+        uint64_t next_seq_ = 0;
+        uint64_t committed_seq_ = 0;
+        uint64_t failed_seq_ = 0;       //last seq whose write failed, waiters up to it are told
+        uint64_t snapshot_seq_ = 0;
+        FILE* ledger_file_ = nullptr;
+        uint64_t ledger_size_ = 0;      //bytes of whole records in the ledger
+
+        std::thread writer_thread_;
+        bool stopping_ = false;
+    };
+}
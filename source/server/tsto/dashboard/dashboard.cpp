@@ -3,12 +3,12 @@
 #include "configuration.hpp"
 #include "debugging/serverlog.hpp"
 #include "LandData.pb.h"
-#include <Windows.h>
-#include <ShlObj.h>
+#include "platform/platform.hpp"
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/prettywriter.h>
+#include <json_writer.hpp>
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/util/json_util.h>
 #include <chrono>
@@ -20,10 +20,17 @@
 #include <ctime>
 
 #include "tsto/land/land.hpp"
+#include "tsto/land/town_store.hpp"
+#include "tsto/currency/currency_ledger.hpp"
 #include "tsto/events/events.hpp"
 #include "tsto/database/database.hpp"
+#include "tsto/auth/auth.hpp"
+#include "save_exporter.hpp"
+#include "html_template.hpp"
+#include "file_server/webpanel_assets.hpp"
 #include "tsto/includes/session.hpp"
 #include "headers/response_headers.hpp"
+#include "multipart.hpp"
 
 namespace tsto::dashboard {
 
@@ -31,6 +38,42 @@ namespace tsto::dashboard {
     std::string Dashboard::server_ip_;
     uint16_t Dashboard::server_port_;
 
+    namespace {
+        //<option> list for the event picker, only rebuilt when the selected event or the table changes
+        std::shared_ptr<const std::string> event_rows(time_t selected) {
+            static std::mutex mutex;
+            static std::shared_ptr<const std::string> rows;
+            static time_t rows_selected = 0;
+            static size_t rows_table_size = 0;
+
+            std::lock_guard<std::mutex> _(mutex);
+            if (rows && rows_selected == selected && rows_table_size == tsto::events::tsto_events.size()) {
+                return rows;
+            }
+
+            std::string html;
+            html.reserve(tsto::events::tsto_events.size() * 96);
+            for (const auto& event_pair : tsto::events::tsto_events) {
+                if (event_pair.first == 0) continue;
+
+                html += "<option value=\"";
+                html += std::to_string(event_pair.first);
+                html += "\"";
+                if (event_pair.first == selected) {
+                    html += " selected";
+                }
+                html += ">";
+                html += event_pair.second;
+                html += "</option>\n";
+            }
+
+            rows = std::make_shared<const std::string>(std::move(html));
+            rows_selected = selected;
+            rows_table_size = tsto::events::tsto_events.size();
+            return rows;
+        }
+    }
+
     void Dashboard::handle_server_restart(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
         ctx->AddResponseHeader("Content-Type", "application/json");
@@ -41,32 +84,9 @@ namespace tsto::dashboard {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
                 "Server stopping for restart...");
 
-            char exePath[MAX_PATH];
-            GetModuleFileNameA(NULL, exePath, MAX_PATH);
-
-            STARTUPINFOA si = { sizeof(STARTUPINFOA) };
-            PROCESS_INFORMATION pi;
-
-            if (CreateProcessA(
-                exePath,
-                NULL,
-                NULL,
-                NULL,
-                FALSE,
-                0,
-                NULL,
-                NULL,
-                &si,
-                &pi
-            )) {
-                CloseHandle(pi.hProcess);
-                CloseHandle(pi.hThread);
-
-                ExitProcess(0);
-            }
-            else {
+            if (!platform::restart_process()) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
-                    "Failed to restart server: %d", GetLastError());
+                    "Failed to restart server: %d", errno);
             }
         });
     }
@@ -79,65 +99,53 @@ namespace tsto::dashboard {
         try {
             std::filesystem::path templatePath = "webpanel/dashboard.html";
 
-            if (!std::filesystem::exists(templatePath)) {
+            //same order as the values below
+            static const std::vector<HtmlTemplate::slot_marker> slots = {
+                { "%SERVER_IP%" },
+                { "{{ GAME_PORT }}" },
+                { "%UPTIME%" },
+                { "%DLC_DIRECTORY%" },
+                { "%INITIAL_DONUTS%" },
+                { "%CURRENT_EVENT%" },
+                { "%EVENT_ROWS%", true },   //the page script mentions the marker again
+            };
+
+            std::shared_ptr<const HtmlTemplate> page;
+            if (file_server::webpanel::serve_from_disk()) {
+                page = HtmlTemplate::load(templatePath, slots);
+            }
+            else {
+                //the embedded copy never changes, compile it once
+                static const auto embedded = [] {
+                    const auto* item = file_server::webpanel::find("/dashboard.html");
+                    return item ? HtmlTemplate::compile(std::string(item->data), slots) : nullptr;
+                }();
+                page = embedded;
+            }
+            if (!page) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER,
                     "Dashboard template not found at %s", templatePath.string().c_str());
                 cb("Error: Dashboard template file not found");
                 return;
             }
 
-            std::ifstream file(templatePath, std::ios::binary);
-            if (!file.is_open()) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER,
-                    "Failed to open dashboard template: %s", templatePath.string().c_str());
-                cb("Error: Failed to open dashboard template");
-                return;
-            }
-
-            std::stringstream template_stream;
-            template_stream << file.rdbuf();
-            std::string html_template = template_stream.str();
-
-            html_template = std::regex_replace(html_template, std::regex("%SERVER_IP%"), server_ip_);
-            html_template = std::regex_replace(html_template, std::regex("\\{\\{ GAME_PORT \\}\\}"), std::to_string(server_port_));
-
             static auto start_time = std::chrono::system_clock::now();
             auto now = std::chrono::system_clock::now();
             auto uptime = std::chrono::duration_cast<std::chrono::seconds>(now - start_time);
             auto hours = std::chrono::duration_cast<std::chrono::hours>(uptime);
             auto minutes = std::chrono::duration_cast<std::chrono::minutes>(uptime % std::chrono::hours(1));
             auto seconds = uptime % std::chrono::minutes(1);
-            std::stringstream uptime_str;
-            uptime_str << hours.count() << "h " << minutes.count() << "m " << seconds.count() << "s";
-            html_template = std::regex_replace(html_template, std::regex("%UPTIME%"), uptime_str.str());
+            const std::string uptime_str = std::to_string(hours.count()) + "h " + std::to_string(minutes.count()) + "m " +
+                std::to_string(seconds.count()) + "s";
 
-            std::string currency_path = "towns/currency.txt";
-            std::string dlc_directory = utils::configuration::ReadString("Server", "DLCDirectory", "dlc");
-            html_template = std::regex_replace(html_template, std::regex("%DLC_DIRECTORY%"), dlc_directory);
-
-            html_template = std::regex_replace(html_template, std::regex("%INITIAL_DONUTS%"),
-                utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
+            const std::string port = std::to_string(server_port_);
+            const std::string dlc_directory = utils::configuration::ReadString("Server", "DLCDirectory", "dlc");
+            const std::string initial_donuts = utils::configuration::ReadString("Server", "InitialDonutAmount", "1000");
 
             auto current_event = tsto::events::Events::get_current_event();
-            html_template = std::regex_replace(html_template, std::regex("%CURRENT_EVENT%"), current_event.name);
+            auto rows = event_rows(current_event.start_time);
 
-            std::stringstream rows;
-            for (const auto& event_pair : tsto::events::tsto_events) {
-                if (event_pair.first == 0) continue;
-
-                rows << "<option value=\"" << event_pair.first << "\"";
-                if (event_pair.first == current_event.start_time) {
-                    rows << " selected";
-                }
-                rows << ">" << event_pair.second << "</option>\n";
-            }
-
-            size_t event_pos = html_template.find("%EVENT_ROWS%");
-            if (event_pos != std::string::npos) {
-                html_template.replace(event_pos, 12, rows.str());
-            }
-
-            cb(html_template);
+            cb(page->render({ server_ip_, port, uptime_str, dlc_directory, initial_donuts, current_event.name, *rows }));
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER,
@@ -155,7 +163,7 @@ namespace tsto::dashboard {
         loop->RunAfter(evpp::Duration(1.0), []() {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
                 "Server stopping...");
-            ExitProcess(0);
+            platform::exit_process(0);
             });
     }
 
@@ -189,8 +197,8 @@ namespace tsto::dashboard {
         }
     }
 
-    void Dashboard::handle_force_save_protoland(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_force_save_protoland(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             auto& session = tsto::Session::get();
 
@@ -198,10 +206,10 @@ namespace tsto::dashboard {
                 ctx->AddResponseHeader("Content-Type", "application/json");
                 ctx->set_response_http_code(400);
                 cb("{\"status\":\"error\",\"message\":\"No land data to save\"}");
-                return;
+                co_return;
             }
 
-            if (tsto::land::Land::save_town()) {
+            if (co_await tsto::land::Land::save_town_async(loop)) {
                 ctx->AddResponseHeader("Content-Type", "application/json");
                 cb("{\"status\":\"success\"}");
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
@@ -317,33 +325,24 @@ namespace tsto::dashboard {
         }
     }
 
-    void Dashboard::handle_browse_directory(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_browse_directory(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
-            BROWSEINFO bi = { 0 };
-            bi.lpszTitle = "Select DLC Directory";
-            bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
-
-            LPITEMIDLIST pidl = SHBrowseForFolder(&bi);
-            if (pidl != nullptr) {
-                char path[MAX_PATH];
-                if (SHGetPathFromIDList(pidl, path)) {
-                    CoTaskMemFree(pidl);
-                    
-                    rapidjson::StringBuffer buffer;
-                    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-                    writer.StartObject();
-                    writer.Key("success");
-                    writer.Bool(true);
-                    writer.Key("path");
-                    writer.String(path);
-                    writer.EndObject();
+            //the dialog stays open until the user picks a folder, that wait is on the io pool
+            auto path = co_await server::async::io(loop, []() { return platform::browse_directory("Select DLC Directory"); });
+            if (path) {
+                rapidjson::StringBuffer buffer;
+                rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+                writer.StartObject();
+                writer.Key("success");
+                writer.Bool(true);
+                writer.Key("path");
+                writer.String(path->c_str());
+                writer.EndObject();
 
-                    headers::set_json_response(ctx);
-                    cb(buffer.GetString());
-                    return;
-                }
-                CoTaskMemFree(pidl);
+                headers::set_json_response(ctx);
+                cb(buffer.GetString());
+                co_return;
             }
 
             headers::set_json_response(ctx);
@@ -357,8 +356,8 @@ namespace tsto::dashboard {
         }
     }
 
-    void Dashboard::handle_edit_user_currency(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_edit_user_currency(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             std::string body = ctx->body().ToString();
             rapidjson::Document doc;
@@ -373,72 +372,45 @@ namespace tsto::dashboard {
             int amount = doc["amount"].GetInt();
 
             //clean up the email/username string
-            size_t pb_pos = email.find(".pb");
-            if (pb_pos != std::string::npos) {
-                email = email.substr(0, pb_pos);
-            }
-            size_t txt_pos = email.find(".txt");
-            if (txt_pos != std::string::npos) {
-                email = email.substr(0, txt_pos);
-            }
-
-            //unique currency file for each user
-            std::string currency_file;
-            if (email == "mytown") {
-                currency_file = "towns/currency.txt"; //legacy default path
-            } else {
-                currency_file = "towns/currency_" + email + ".txt";
-            }
-
-            std::filesystem::create_directories("towns");
-
-            std::ofstream output(currency_file);
-            if (!output.good()) {
-                throw std::runtime_error("Failed to open currency file for writing");
-            }
-            output << amount;
-            output.close();
+            const std::string user = tsto::currency::CurrencyLedger::user_from_town(email);
+            co_await server::async::io(loop, [user, amount]() {
+                tsto::currency::CurrencyLedger::get_instance().set_balance(user, amount);
+            });
 
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                "[CURRENCY] Updated currency for user %s to %d donuts (file: %s)",
-                email.c_str(), amount, currency_file.c_str());
-
-            rapidjson::Document response;
-            response.SetObject();
-            auto& allocator = response.GetAllocator();
+                "[CURRENCY] Updated currency for user %s to %d donuts",
+                user.c_str(), amount);
 
-            response.AddMember("status", "success", response.GetAllocator());
-            response.AddMember("message", "Currency updated successfully", response.GetAllocator());
-            response.AddMember("amount", amount, response.GetAllocator());
-
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            response.Accept(writer);
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object()
+                .member("status", "success")
+                .member("message", "Currency updated successfully")
+                .member("amount", amount)
+                .end_object();
 
             headers::set_json_response(ctx);
-            cb(buffer.GetString());
+            cb(response);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                 "[CURRENCY] Error updating currency: %s", ex.what());
 
-            rapidjson::Document response;
-            response.SetObject();
-            response.AddMember("status", "error", response.GetAllocator());
-            response.AddMember("message", rapidjson::StringRef(ex.what()), response.GetAllocator());
-
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            response.Accept(writer);
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object()
+                .member("status", "error")
+                .member("message", ex.what())
+                .end_object();
 
             ctx->set_response_http_code(500);
             headers::set_json_response(ctx);
-            cb(buffer.GetString());
+            cb(response);
         }
     }
     
-    void Dashboard::handle_upload_town_file(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_upload_town_file(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[UPLOAD] Received town file upload request from: %s", std::string(ctx->remote_ip()).c_str());
@@ -450,17 +422,17 @@ namespace tsto::dashboard {
                 ctx->set_response_http_code(400);
                 headers::set_json_response(ctx);
                 cb("{\"success\":false,\"message\":\"Invalid content type. Expected multipart/form-data\"}");
-                return;
+                co_return;
             }
             
             const char* auth_header = ctx->FindRequestHeader("nucleus_token");
             if (auth_header && strlen(auth_header) > 0) {
-                auto& db = tsto::database::Database::get_instance();
-                std::string token_email;
+                std::string token_user_id;
                 
-                if (db.validate_access_token(auth_header, token_email)) {
+                const std::string token = auth_header;
+                if (co_await server::async::io(loop, [&token, &token_user_id]() { return tsto::auth::Auth::resolve_token(token, token_user_id); })) {
                     logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[UPLOAD] Valid token for user: %s", token_email.c_str());
+                        "[UPLOAD] Valid token for user: %s", token_user_id.c_str());
                 } else {
                     logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_GAME,
                         "[UPLOAD] Invalid token provided");
@@ -471,105 +443,118 @@ namespace tsto::dashboard {
                     "[UPLOAD] No authentication token provided");
             }
             
-            // Create a temporary directory if it doesn't exist
-            std::filesystem::create_directories("temp");
-            
-            std::random_device rd;
-            std::mt19937 gen(rd());
-            std::uniform_int_distribution<> dis(0, 15);
-            std::uniform_int_distribution<> dis2(8, 11);
-            
-            std::stringstream ss;
-            ss << "temp/upload_" << std::time(nullptr) << "_";
-            for (int i = 0; i < 16; i++) {
-                ss << std::hex << dis(gen);
-            }
-            ss << ".pb";
-            
-            std::string temp_file_path = ss.str();
-            
-            auto& body = ctx->body();
-            
-            std::string boundary;
-            size_t boundary_pos = content_type.find("boundary=");
-            if (boundary_pos != std::string::npos) {
-                boundary = content_type.substr(boundary_pos + 9);
-                if (boundary.front() == '"' && boundary.back() == '"') {
-                    boundary = boundary.substr(1, boundary.length() - 2);
-                }
-            } else {
+            const std::string boundary = utils::http::multipart_parser::boundary_from_content_type(content_type);
+            if (boundary.empty()) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                     "[UPLOAD] No boundary found in content type");
                 ctx->set_response_http_code(400);
                 headers::set_json_response(ctx);
                 cb("{\"success\":false,\"message\":\"Invalid multipart form data format\"}");
-                return;
-            }
-            
-            std::string full_boundary = "--" + boundary;
-            std::string body_str = body.ToString();
-            
-            size_t pos = body_str.find(full_boundary);
-            if (pos == std::string::npos) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[UPLOAD] Could not find boundary in request body");
-                ctx->set_response_http_code(400);
-                headers::set_json_response(ctx);
-                cb("{\"success\":false,\"message\":\"Invalid multipart form data format\"}");
-                return;
-            }
-            
-            pos = body_str.find("Content-Disposition:", pos);
-            if (pos == std::string::npos) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[UPLOAD] Could not find Content-Disposition header");
-                ctx->set_response_http_code(400);
-                headers::set_json_response(ctx);
-                cb("{\"success\":false,\"message\":\"Invalid multipart form data format\"}");
-                return;
-            }
-            
-            size_t headers_end = body_str.find("\r\n\r\n", pos);
-            if (headers_end == std::string::npos) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[UPLOAD] Could not find end of headers");
-                ctx->set_response_http_code(400);
-                headers::set_json_response(ctx);
-                cb("{\"success\":false,\"message\":\"Invalid multipart form data format\"}");
-                return;
+                co_return;
             }
-            
-            size_t data_start = headers_end + 4;
-            
-            size_t data_end = body_str.find(full_boundary, data_start);
-            if (data_end == std::string::npos) {
+
+            const uint64_t max_upload = static_cast<uint64_t>(
+                utils::configuration::ReadUnsignedInteger("ServerConfig", "DashboardMaxUploadMB", 64)) * 1024 * 1024;
+
+            //refuse before touching the body when the client already says it is too big
+            const char* content_length = ctx->FindRequestHeader("Content-Length");
+            if (max_upload && content_length && std::strtoull(content_length, nullptr, 10) > max_upload) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[UPLOAD] Could not find end boundary");
-                ctx->set_response_http_code(400);
+                    "[UPLOAD] Upload of %s bytes is over the %llu byte limit", content_length,
+                    static_cast<unsigned long long>(max_upload));
+                ctx->set_response_http_code(413);
                 headers::set_json_response(ctx);
-                cb("{\"success\":false,\"message\":\"Invalid multipart form data format\"}");
-                return;
-            }
-            
-            if (data_end > 2) {
-                data_end -= 2;
+                cb("{\"success\":false,\"message\":\"Uploaded file is too large\"}");
+                co_return;
             }
+
+            // Create a temporary directory if it doesn't exist
+            std::filesystem::create_directories("temp");
             
-            std::string file_data = body_str.substr(data_start, data_end - data_start);
+            std::stringstream ss;
+            ss << "temp/upload_" << std::time(nullptr) << "_";
+            ss << utils::cryptography::random::get_hex(16);
+            ss << ".pb";
             
-            std::ofstream out_file(temp_file_path, std::ios::binary);
-            if (!out_file.is_open()) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[UPLOAD] Failed to open temporary file for writing: %s", temp_file_path.c_str());
-                ctx->set_response_http_code(500);
-                headers::set_json_response(ctx);
-                cb("{\"success\":false,\"message\":\"Failed to save uploaded file\"}");
-                return;
+            std::string temp_file_path = ss.str();
+
+            //the first part of the form is the town file, it goes to disk as the parser finds it
+            //so the upload is never copied into one string
+            std::ofstream out_file;
+            bool file_written = false;
+            bool open_failed = false;
+
+            utils::http::multipart_parser parser(boundary, max_upload);
+            parser.on_part_begin = [&](const utils::http::multipart_parser::part&) {
+                if (file_written || out_file.is_open()) {
+                    return true;
+                }
+                out_file.open(temp_file_path, std::ios::binary);
+                open_failed = !out_file.is_open();
+                return !open_failed;
+            };
+            parser.on_part_data = [&](const char* data, size_t size) {
+                if (!out_file.is_open()) {
+                    return true;
+                }
+                out_file.write(data, static_cast<std::streamsize>(size));
+                return out_file.good();
+            };
+            parser.on_part_end = [&]() {
+                if (out_file.is_open()) {
+                    out_file.close();
+                    file_written = !out_file.fail();
+                    return file_written;
+                }
+                return true;
+            };
+
+            //fed in the segments libevent received, the body is never pulled up into one block. the
+            //parse and the writes run on the io pool, the request stays untouched on the loop meanwhile
+            const auto segments = ctx->body_segments();
+            co_await server::async::io(loop, [&]() {
+                for (const auto& segment : segments) {
+                    if (!parser.feed(segment.data(), segment.size())) {
+                        break;
+                    }
+                }
+
+                if (!file_written || !parser.done()) {
+                    if (out_file.is_open()) {
+                        out_file.close();
+                    }
+                    std::error_code ec;
+                    std::filesystem::remove(temp_file_path, ec);
+                }
+            });
+
+            if (!file_written || !parser.done()) {
+
+                if (open_failed || parser.last_error() == utils::http::multipart_parser::error::aborted) {
+                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                        "[UPLOAD] Failed to write temporary file: %s", temp_file_path.c_str());
+                    ctx->set_response_http_code(500);
+                    headers::set_json_response(ctx);
+                    cb("{\"success\":false,\"message\":\"Failed to save uploaded file\"}");
+                }
+                else if (parser.last_error() == utils::http::multipart_parser::error::too_large) {
+                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                        "[UPLOAD] Upload is over the %llu byte limit", static_cast<unsigned long long>(max_upload));
+                    ctx->set_response_http_code(413);
+                    headers::set_json_response(ctx);
+                    cb("{\"success\":false,\"message\":\"Uploaded file is too large\"}");
+                }
+                else {
+                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                        "[UPLOAD] Malformed multipart body (%llu bytes read)",
+                        static_cast<unsigned long long>(parser.body_size()));
+                    ctx->set_response_http_code(400);
+                    headers::set_json_response(ctx);
+                    cb("{\"success\":false,\"message\":\"Invalid multipart form data format\"}");
+                }
+                co_return;
             }
             
-            out_file.write(file_data.c_str(), file_data.size());
-            out_file.close();
-            
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[UPLOAD] Successfully saved uploaded town file to: %s", temp_file_path.c_str());
             
@@ -585,81 +570,59 @@ namespace tsto::dashboard {
         }
     }
 
-    void Dashboard::handle_list_users(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_list_users(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         ctx->AddResponseHeader("Content-Type", "application/json");
 
         try {
-            std::string users_file = "users.json";
-            rapidjson::Document users_doc;
+            //users.json, the town store and the ledger are all read on the io pool
+            const std::string listing = co_await server::async::io(loop, []() {
+                std::string users_file = "users.json";
+                rapidjson::Document users_doc;
+
+                if (!std::filesystem::exists(users_file)) {
+                    std::ofstream file(users_file);
+                    file << "{\"users\": []}" << std::endl;
+                    file.close();
+                }
 
-            if (!std::filesystem::exists(users_file)) {
-                std::ofstream file(users_file);
-                file << "{\"users\": []}" << std::endl;
+                std::ifstream file(users_file);
+                std::string json_str((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
                 file.close();
-            }
-
-            std::ifstream file(users_file);
-            std::string json_str((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            file.close();
-
-            if (users_doc.Parse(json_str.c_str()).HasParseError()) {
-                throw std::runtime_error("Failed to parse users.json");
-            }
 
-            std::vector<std::string> town_files;
-            for (const auto& entry : std::filesystem::directory_iterator("towns")) {
-                if (entry.path().extension() == ".pb") {
-                    town_files.push_back(entry.path().filename().string());
+                if (users_doc.Parse(json_str.c_str()).HasParseError()) {
+                    throw std::runtime_error("Failed to parse users.json");
                 }
-            }
 
-            rapidjson::Document response;
-            response.SetObject();
-            auto& allocator = response.GetAllocator();
+                std::vector<std::string> town_files = tsto::land::TownStore::get().list();
+
+                //built on the io thread and handed back, so not in the per thread buffer
+                std::string listing;
+                utils::json::writer writer(listing);
+                writer.begin_object().key("users").begin_array();
+                for (const auto& town_file : town_files) {
+                    std::string username = town_file;
+                    size_t pos = username.find(".pb");
+                    if (pos != std::string::npos) {
+                        username = username.substr(0, pos);
+                    }
 
-            rapidjson::Value users_array(rapidjson::kArrayType);
-            for (const auto& town_file : town_files) {
-                rapidjson::Value user_obj(rapidjson::kObjectType);
-                
-                std::string username = town_file;
-                size_t pos = username.find(".pb");
-                if (pos != std::string::npos) {
-                    username = username.substr(0, pos);
-                }
+                    //currency using the same logic as handle_edit_user_currency
+                    const int currency = static_cast<int>(tsto::currency::CurrencyLedger::get_instance().get_balance(
+                        tsto::currency::CurrencyLedger::user_from_town(username)));
 
-                //currency using the same logic as handle_edit_user_currency
-                std::string currency_file;
-                if (username == "mytown") {
-                    currency_file = "towns/currency.txt";
-                } else {
-                    currency_file = "towns/currency_" + username + ".txt";
-                }
-                
-                int currency = 0;
-                if (std::filesystem::exists(currency_file)) {
-                    std::ifstream curr_file(currency_file);
-                    curr_file >> currency;
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                        "[CURRENCY] Read currency for user %s: %d donuts (file: %s)",
-                        username.c_str(), currency, currency_file.c_str());
+                    writer.begin_object()
+                        .member("username", username)
+                        .member("townFile", town_file)
+                        .member("currency", currency)
+                        .member("isLegacy", username == "mytown")
+                        .end_object();
                 }
+                writer.end_array().end_object();
+                return listing;
+            });
 
-                user_obj.AddMember("username", rapidjson::Value(username.c_str(), allocator), allocator);
-                user_obj.AddMember("townFile", rapidjson::Value(town_file.c_str(), allocator), allocator);
-                user_obj.AddMember("currency", currency, allocator);
-                user_obj.AddMember("isLegacy", username == "mytown", allocator);
-
-                users_array.PushBack(user_obj, allocator);
-            }
-
-            response.AddMember("users", users_array, allocator);
-
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            response.Accept(writer);
-
-            cb(buffer.GetString());
+            cb(listing);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP,
@@ -668,7 +631,7 @@ namespace tsto::dashboard {
         }
     }
 
-    void Dashboard::handle_get_user_save(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_get_user_save(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb) {
         ctx->AddResponseHeader("Content-Type", "application/json");
         
         try {
@@ -680,6 +643,9 @@ namespace tsto::dashboard {
             
             std::string username;
             bool isLegacy = false;
+            std::string fields;
+            size_t offset = 0;
+            size_t limit = SIZE_MAX;
     
             if (!requestBody.empty()) {
                 rapidjson::Document request;
@@ -690,18 +656,35 @@ namespace tsto::dashboard {
                         parseResult.Code(), parseResult.Offset());
                     ctx->set_response_http_code(400);
                     cb("{\"error\": \"Invalid JSON in request\"}");
-                    return;
+                    co_return;
                 }
     
                 if (!request.HasMember("username") || !request["username"].IsString()) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, "Missing username in request");
                     ctx->set_response_http_code(400);
                     cb("{\"error\": \"Missing username\"}");
-                    return;
+                    co_return;
                 }
     
                 username = request["username"].GetString();
                 isLegacy = request.HasMember("isLegacy") && request["isLegacy"].IsBool() && request["isLegacy"].GetBool();
+
+                if (request.HasMember("fields") && request["fields"].IsString()) {
+                    fields = request["fields"].GetString();
+                }
+                else if (request.HasMember("fields") && request["fields"].IsArray()) {
+                    for (const auto& field : request["fields"].GetArray()) {
+                        if (field.IsString()) {
+                            fields += std::string(fields.empty() ? "" : ",") + field.GetString();
+                        }
+                    }
+                }
+                if (request.HasMember("offset") && request["offset"].IsUint64()) {
+                    offset = request["offset"].GetUint64();
+                }
+                if (request.HasMember("limit") && request["limit"].IsUint64()) {
+                    limit = request["limit"].GetUint64();
+                }
             } else {
                 const std::string& uri = ctx->original_uri();
                 size_t pos = uri.find("username=");
@@ -709,7 +692,7 @@ namespace tsto::dashboard {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, "Missing username parameter");
                     ctx->set_response_http_code(400);
                     cb("{\"error\": \"Missing username parameter\"}");
-                    return;
+                    co_return;
                 }
                 
                 username = uri.substr(pos + 9); 
@@ -740,92 +723,95 @@ namespace tsto::dashboard {
                 
                 username = decoded;
                 isLegacy = (username == "mytown");
+
+                //field paths are plain identifiers, only the separator can arrive encoded
+                fields = ctx->GetQuery("fields");
+                for (size_t comma; (comma = fields.find("%2C")) != std::string::npos || (comma = fields.find("%2c")) != std::string::npos;) {
+                    fields.replace(comma, 3, ",");
+                }
+                const std::string offset_param = ctx->GetQuery("offset");
+                const std::string limit_param = ctx->GetQuery("limit");
+                if (!offset_param.empty()) {
+                    offset = std::stoull(offset_param);
+                }
+                if (!limit_param.empty()) {
+                    limit = std::stoull(limit_param);
+                }
             }
     
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP, 
                 "Loading save for user: %s%s", username.c_str(), isLegacy ? " (legacy)" : "");
     
+            bool streaming = false;
             try {
-                std::filesystem::path townsDir = std::filesystem::current_path() / "towns";
-                
-                if (!std::filesystem::exists(townsDir)) {
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP, 
-                        "Creating towns directory: %s", townsDir.string().c_str());
-                    if (!std::filesystem::create_directories(townsDir)) {
-                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, 
-                            "Failed to create towns directory: %s", townsDir.string().c_str());
-                        ctx->set_response_http_code(500);
-                        cb("{\"error\": \"Failed to create towns directory\"}");
-                        return;
-                    }
-                }
-    
-                std::filesystem::path savePath = townsDir;
-                if (isLegacy) {
-                    savePath /= "mytown.pb";
-                } else {
-                    savePath /= (username + ".pb");
-                }
+                auto& store = tsto::land::TownStore::get();
+                const std::string town_filename = isLegacy ? "mytown.pb" : username + ".pb";
     
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP, 
-                    "Attempting to read save file: %s", savePath.string().c_str());
+                    "Attempting to read save file: %s", town_filename.c_str());
     
-                if (!std::filesystem::exists(savePath)) {
+                std::string town_data;
+                const bool exists = co_await server::async::io(loop, [&store, &town_filename, &town_data]() {
+                    if (!store.exists(town_filename)) {
+                        return false;
+                    }
+                    if (!store.load(town_filename, town_data)) {
+                        throw std::runtime_error("Failed to open save file for reading");
+                    }
+                    return true;
+                });
+
+                if (!exists) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, 
-                        "Save file does not exist: %s", savePath.string().c_str());
+                        "Save file does not exist: %s", town_filename.c_str());
                     ctx->set_response_http_code(404);
                     cb("{\"error\": \"Save file not found\"}");
-                    return;
-                }
-    
-                std::ifstream in(savePath, std::ios::binary);
-                if (!in.is_open()) {
-                    throw std::runtime_error("Failed to open save file for reading");
+                    co_return;
                 }
 
                 Data::LandMessage save_data;
-                if (!save_data.ParseFromIstream(&in)) {
+                if (!save_data.ParseFromString(town_data)) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, 
                         "Failed to parse save file for user: %s", username.c_str());
                     ctx->set_response_http_code(500);
                     cb("{\"error\": \"Failed to parse save file\"}");
-                    return;
+                    co_return;
                 }
 
-                // Convert protobuf to JSON
-                std::string json_string;
-                google::protobuf::util::JsonPrintOptions options;
-                options.add_whitespace = true;
-                options.preserve_proto_field_names = true;
-                
-                auto status = google::protobuf::util::MessageToJsonString(save_data, &json_string, options);
-                if (!status.ok()) {
-                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, 
-                        "Failed to convert save to JSON for user: %s - %s", username.c_str(), status.ToString().c_str());
-                    ctx->set_response_http_code(500);
-                    cb("{\"error\": \"Failed to convert save to JSON\"}");
-                    return;
-                }
+                //the binary town is no longer needed once parsed
+                std::string().swap(town_data);
 
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP, 
-                    "Successfully loaded save file for user: %s", username.c_str());
-
-                rapidjson::Document response;
-                response.SetObject();
-                auto& allocator = response.GetAllocator();
-
-                response.AddMember("status", "success", allocator);
-                response.AddMember("save", rapidjson::Value(json_string.c_str(), allocator), allocator);
-
-                rapidjson::StringBuffer buffer;
-                rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-                response.Accept(writer);
+                    "Successfully loaded save file for user: %s (fields: %s, offset: %zu)",
+                    username.c_str(), fields.empty() ? "all" : fields.c_str(), offset);
 
+                //stream the JSON out as chunks instead of building the whole document
                 ctx->set_response_http_code(200);
-                cb(buffer.GetString());
+                ctx->SendReplyStart();
+                streaming = true;
+
+                SaveExporter exporter([&ctx](std::string&& chunk) {
+                    ctx->SendReplyChunk(std::move(chunk));
+                });
+                exporter.set_field_mask(fields);
+                exporter.set_page(offset, limit);
+
+                exporter.write_raw("{\"status\":\"success\",\"sizes\":");
+                exporter.write_sizes(save_data);
+                exporter.write_raw(",\"save\":");
+                exporter.write_quoted(save_data);
+                exporter.write_raw("}");
+                exporter.flush();
+
+                ctx->SendReplyEnd();
             } catch (const std::exception& e) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, 
                     "Exception while loading save: %s", e.what());
+                if (streaming) {
+                    //headers are already out, end the truncated body
+                    ctx->SendReplyEnd();
+                    co_return;
+                }
                 ctx->set_response_http_code(500);
                 cb(std::string("{\"error\": \"Failed to read save file: ") + e.what() + "\"}");
             }
@@ -837,7 +823,7 @@ namespace tsto::dashboard {
         }
     }
 
-    void Dashboard::handle_save_user_save(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Dashboard::handle_save_user_save(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb) {
         ctx->AddResponseHeader("Content-Type", "application/json");
         
         try {
@@ -853,7 +839,7 @@ namespace tsto::dashboard {
                     parseResult.Code(), parseResult.Offset());
                 ctx->set_response_http_code(400);
                 cb("{\"error\": \"Invalid JSON in request\"}");
-                return;
+                co_return;
             }
     
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP, 
@@ -864,14 +850,14 @@ namespace tsto::dashboard {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, "Missing required fields in request");
                 ctx->set_response_http_code(400);
                 cb("{\"error\": \"Missing required fields\"}");
-                return;
+                co_return;
             }
     
             if (!request["username"].IsString() || !request["isLegacy"].IsBool() || !request["save"].IsString()) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, "Invalid field types in request");
                 ctx->set_response_http_code(400);
                 cb("{\"error\": \"Invalid field types\"}");
-                return;
+                co_return;
             }
     
             const std::string username = request["username"].GetString();
@@ -888,34 +874,11 @@ namespace tsto::dashboard {
                         "Failed to parse JSON for user: %s - %s", username.c_str(), status.ToString().c_str());
                     ctx->set_response_http_code(400);
                     cb("{\"error\": \"Invalid save data format\"}");
-                    return;
-                }
-
-                std::filesystem::path savePath = std::filesystem::current_path() / "towns";
-                if (!std::filesystem::exists(savePath)) {
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP,
-                        "Creating towns directory: %s", savePath.string().c_str());
-                    if (!std::filesystem::create_directories(savePath)) {
-                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, 
-                            "Failed to create towns directory: %s", savePath.string().c_str());
-                        ctx->set_response_http_code(500);
-                        cb("{\"error\": \"Failed to create towns directory\"}");
-                        return;
-                    }
+                    co_return;
                 }
 
-                if (isLegacy) {
-                    savePath /= "mytown.pb";
-                } else {
-                    savePath /= (username + ".pb");
-                }
-
-                //backup
-                if (std::filesystem::exists(savePath)) {
-                    std::filesystem::path backupPath = savePath;
-                    backupPath += ".bak";
-                    std::filesystem::copy_file(savePath, backupPath, std::filesystem::copy_options::overwrite_existing);
-                }
+                auto& store = tsto::land::TownStore::get();
+                const std::string town_filename = isLegacy ? "mytown.pb" : username + ".pb";
 
                 //save the protobuf data using the same format as the game's load
                 std::string serialized;
@@ -923,28 +886,26 @@ namespace tsto::dashboard {
                     throw std::runtime_error("Failed to serialize protobuf data");
                 }
 
-                //to vector<char> like the game uses
-                std::vector<char> buffer(serialized.begin(), serialized.end());
-
-                std::ofstream out(savePath, std::ios::binary);
-                if (!out.is_open()) {
-                    throw std::runtime_error("Failed to open save file for writing");
-                }
-
-                out.write(buffer.data(), buffer.size());
-                out.close();
+                co_await server::async::io(loop, [&store, &town_filename, &serialized]() {
+                    //backup
+                    std::string previous;
+                    if (store.load(town_filename, previous)) {
+                        store.save(town_filename + ".bak", previous);
+                    }
 
-                //verify we can read it back
-                std::ifstream verify(savePath, std::ios::binary);
-                if (verify.is_open()) {
-                    std::vector<char> check_buffer((std::istreambuf_iterator<char>(verify)), std::istreambuf_iterator<char>());
-                    verify.close();
+                    if (!store.save(town_filename, serialized)) {
+                        throw std::runtime_error("Failed to open save file for writing");
+                    }
 
-                    Data::LandMessage test_load;
-                    if (!test_load.ParseFromArray(check_buffer.data(), static_cast<int>(check_buffer.size()))) {
-                        throw std::runtime_error("Failed to verify saved protobuf data");
+                    //verify we can read it back
+                    std::string check_buffer;
+                    if (store.load(town_filename, check_buffer)) {
+                        Data::LandMessage test_load;
+                        if (!test_load.ParseFromString(check_buffer)) {
+                            throw std::runtime_error("Failed to verify saved protobuf data");
+                        }
                     }
-                }
+                });
 
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_SERVER_HTTP, 
                     "Successfully saved and verified file for user: %s", username.c_str());
@@ -973,13 +934,13 @@ namespace tsto::dashboard {
         ctx->AddResponseHeader("Expires", "0");
 
         try {
-            rapidjson::Document doc;
-            doc.SetObject();
-            auto& allocator = doc.GetAllocator();
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object();
 
             //server IP and port
-            doc.AddMember("server_ip", rapidjson::Value(server_ip_.c_str(), allocator), allocator);
-            doc.AddMember("server_port", server_port_, allocator);
+            writer.member("server_ip", server_ip_)
+                .member("server_port", server_port_);
 
             //uptime
             static auto start_time = std::chrono::system_clock::now();
@@ -990,35 +951,29 @@ namespace tsto::dashboard {
             auto seconds = uptime % std::chrono::minutes(1);
             std::stringstream uptime_str;
             uptime_str << hours.count() << "h " << minutes.count() << "m " << seconds.count() << "s";
-            doc.AddMember("uptime", rapidjson::Value(uptime_str.str().c_str(), allocator), allocator);
+            writer.member("uptime", uptime_str.str());
 
             //DLC directory
-            std::string dlc_directory = utils::configuration::ReadString("Server", "DLCDirectory", "dlc");
-            doc.AddMember("dlc_directory", rapidjson::Value(dlc_directory.c_str(), allocator), allocator);
+            writer.member("dlc_directory", utils::configuration::ReadString("Server", "DLCDirectory", "dlc"));
 
             //initial donuts
-            std::string initial_donuts = utils::configuration::ReadString("Server", "InitialDonutAmount", "1000");
-            doc.AddMember("initial_donuts", rapidjson::Value(initial_donuts.c_str(), allocator), allocator);
+            writer.member("initial_donuts", utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
 
             //current event
             auto current_event = tsto::events::Events::get_current_event();
-            doc.AddMember("current_event", rapidjson::Value(current_event.name.c_str(), allocator), allocator);
-            doc.AddMember("current_event_time", current_event.start_time, allocator);
+            writer.member("current_event", current_event.name)
+                .member("current_event_time", current_event.start_time);
 
             //events list
-            rapidjson::Value events_obj(rapidjson::kObjectType);
+            writer.key("events").begin_object();
             for (const auto& event_pair : tsto::events::tsto_events) {
-                rapidjson::Value key(std::to_string(event_pair.first).c_str(), allocator);
-                rapidjson::Value value(event_pair.second.c_str(), allocator);
-                events_obj.AddMember(key, value, allocator);
+                writer.key(std::to_string(event_pair.first)).value(event_pair.second);
             }
-            doc.AddMember("events", events_obj, allocator);
+            writer.end_object();
 
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            doc.Accept(writer);
+            writer.end_object();
 
-            cb(buffer.GetString());
+            cb(response);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER,
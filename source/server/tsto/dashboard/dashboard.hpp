@@ -5,6 +5,7 @@
 #include <evpp/http/context.h>
 #include <evpp/http/http_server.h>
 #include <evpp/event_loop.h>
+#include "async/task.hpp"
 
 namespace tsto::dashboard {
 
@@ -20,16 +21,16 @@ namespace tsto::dashboard {
         static void handle_server_stop(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
         static void handle_update_initial_donuts(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
         static void handle_set_event(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
-        static void handle_force_save_protoland(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
+        static server::async::task handle_force_save_protoland(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
         static void handle_update_dlc_directory(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
         static void handle_update_server_ip(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
         static void handle_update_server_port(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
-        static void handle_browse_directory(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
-        static void handle_list_users(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
-        static void handle_edit_user_currency(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
-        static void handle_get_user_save(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
-        static void handle_save_user_save(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
-        static void handle_upload_town_file(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
+        static server::async::task handle_browse_directory(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
+        static server::async::task handle_list_users(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
+        static server::async::task handle_edit_user_currency(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
+        static server::async::task handle_get_user_save(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
+        static server::async::task handle_save_user_save(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
+        static server::async::task handle_upload_town_file(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
         
         // New API endpoints for dashboard refresh
         static void handle_server_status(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
@@ -0,0 +1,105 @@
+#include <std_include.hpp>
+#include "html_template.hpp"
+#include "debugging/serverlog.hpp"
+
+namespace tsto::dashboard {
+
+    std::mutex HtmlTemplate::cache_mutex_;
+    std::unordered_map<std::string, HtmlTemplate::cache_entry> HtmlTemplate::cache_;
+
+    std::shared_ptr<const HtmlTemplate> HtmlTemplate::compile(std::string source, const std::vector<slot_marker>& slots) {
+        auto compiled = std::make_shared<HtmlTemplate>();
+        compiled->source_ = std::move(source);
+        compiled->slot_count_ = slots.size();
+
+        const std::string& text = compiled->source_;
+
+        //every marker position, sorted so the segments come out in document order
+        std::vector<std::pair<size_t, int>> hits;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            const auto& marker = slots[i].marker;
+            if (marker.empty()) {
+                continue;
+            }
+            for (size_t pos = text.find(marker); pos != std::string::npos; pos = text.find(marker, pos + marker.size())) {
+                hits.emplace_back(pos, static_cast<int>(i));
+                if (slots[i].first_only) {
+                    break;
+                }
+            }
+        }
+        std::sort(hits.begin(), hits.end());
+
+        size_t cursor = 0;
+        for (const auto& [pos, slot] : hits) {
+            //markers never overlap in practice, if they do the first one wins
+            if (pos < cursor) {
+                continue;
+            }
+            if (pos > cursor) {
+                compiled->segments_.push_back({ cursor, pos - cursor, -1 });
+                compiled->literal_size_ += pos - cursor;
+            }
+            compiled->segments_.push_back({ pos, 0, slot });
+            cursor = pos + slots[slot].marker.size();
+        }
+        if (cursor < text.size()) {
+            compiled->segments_.push_back({ cursor, text.size() - cursor, -1 });
+            compiled->literal_size_ += text.size() - cursor;
+        }
+
+        return compiled;
+    }
+
+    std::shared_ptr<const HtmlTemplate> HtmlTemplate::load(const std::filesystem::path& path, const std::vector<slot_marker>& slots) {
+        std::error_code ec;
+        const auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            return nullptr;
+        }
+
+        const std::string key = path.string();
+        {
+            std::lock_guard<std::mutex> _(cache_mutex_);
+            auto it = cache_.find(key);
+            if (it != cache_.end() && it->second.mtime == mtime && it->second.compiled->slot_count_ == slots.size()) {
+                return it->second.compiled;
+            }
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return nullptr;
+        }
+        std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        auto compiled = compile(std::move(source), slots);
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_SERVER_HTTP,
+            "[DASHBOARD] Compiled template %s (%zu segments)", key.c_str(), compiled->segments_.size());
+
+        std::lock_guard<std::mutex> _(cache_mutex_);
+        cache_[key] = { mtime, compiled };
+        return compiled;
+    }
+
+    std::string HtmlTemplate::render(const std::vector<std::string_view>& values) const {
+        size_t total = literal_size_;
+        for (const auto& segment : segments_) {
+            if (segment.slot >= 0 && static_cast<size_t>(segment.slot) < values.size()) {
+                total += values[segment.slot].size();
+            }
+        }
+
+        std::string output;
+        output.reserve(total);
+        for (const auto& segment : segments_) {
+            if (segment.slot < 0) {
+                output.append(source_, segment.offset, segment.length);
+            }
+            else if (static_cast<size_t>(segment.slot) < values.size()) {
+                output.append(values[segment.slot]);
+            }
+        }
+        return output;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <filesystem>
+#include <unordered_map>
+
+namespace tsto::dashboard {
+
+    //a template split once into literal text and slots, rendering is a single sized append pass
+    class HtmlTemplate {
+    public:
+        struct slot_marker {
+            std::string marker;         //e.g. "%SERVER_IP%"
+            bool first_only = false;    //later copies stay literal, like a single find/replace
+        };
+
+        static std::shared_ptr<const HtmlTemplate> compile(std::string source, const std::vector<slot_marker>& slots);
+
+        //compiled template for a file, recompiled only when its mtime changes, nullptr if it can't be read
+        static std::shared_ptr<const HtmlTemplate> load(const std::filesystem::path& path, const std::vector<slot_marker>& slots);
+
+        //values[i] fills every occurrence of slots[i]
+        std::string render(const std::vector<std::string_view>& values) const;
+
+        size_t slot_count() const { return slot_count_; }
+
+    private:
+        struct segment {
+            size_t offset;
+            size_t length;
+            int slot;       //-1 for literal text
+        };
+
+        struct cache_entry {
+            std::filesystem::file_time_type mtime;
+            std::shared_ptr<const HtmlTemplate> compiled;
+        };
+
+        std::string source_;
+        std::vector<segment> segments_;
+        size_t literal_size_ = 0;
+        size_t slot_count_ = 0;
+
+        static std::mutex cache_mutex_;
+        static std::unordered_map<std::string, cache_entry> cache_;
+    };
+}
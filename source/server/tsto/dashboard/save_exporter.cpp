@@ -0,0 +1,348 @@
+#include <std_include.hpp>
+#include "save_exporter.hpp"
+#include <cryptography.hpp>
+#include <charconv>
+#include <cmath>
+
+namespace tsto::dashboard {
+
+    using google::protobuf::FieldDescriptor;
+    using google::protobuf::Message;
+    using google::protobuf::Reflection;
+
+    namespace {
+        template <typename T>
+        std::string format_floating(T value) {
+            if (std::isnan(value)) {
+                return "\"NaN\"";
+            }
+            if (std::isinf(value)) {
+                return value > 0 ? "\"Infinity\"" : "\"-Infinity\"";
+            }
+
+            char text[32];
+            auto result = std::to_chars(text, text + sizeof(text), value);
+            return std::string(text, result.ptr);
+        }
+    }
+
+    SaveExporter::SaveExporter(chunk_sink sink, size_t chunk_size)
+        : sink_(std::move(sink)), chunk_size_(chunk_size) {
+        buffer_.reserve(chunk_size_ + 256);
+    }
+
+    void SaveExporter::set_field_mask(const std::string& paths) {
+        mask_.clear();
+
+        size_t start = 0;
+        while (start <= paths.size()) {
+            size_t end = paths.find(',', start);
+            if (end == std::string::npos) {
+                end = paths.size();
+            }
+
+            std::string path = paths.substr(start, end - start);
+            path.erase(0, path.find_first_not_of(" \t"));
+            path.erase(path.find_last_not_of(" \t") + 1);
+            if (!path.empty()) {
+                mask_.push_back(path);
+            }
+            start = end + 1;
+        }
+    }
+
+    void SaveExporter::set_page(size_t offset, size_t limit) {
+        page_offset_ = offset;
+        page_limit_ = limit;
+    }
+
+    SaveExporter::mask_match SaveExporter::match(const std::string& path) const {
+        if (mask_.empty()) {
+            return mask_match::full;
+        }
+
+        mask_match result = mask_match::none;
+        for (const auto& entry : mask_) {
+            if (entry == path || (path.size() > entry.size() && path.compare(0, entry.size(), entry) == 0 && path[entry.size()] == '.')) {
+                return mask_match::full;
+            }
+            //a deeper path was asked for, descend but keep filtering
+            if (entry.size() > path.size() && entry.compare(0, path.size(), path) == 0 && entry[path.size()] == '.') {
+                result = mask_match::partial;
+            }
+        }
+        return result;
+    }
+
+    void SaveExporter::emit(char c) {
+        if (!quoted_) {
+            buffer_.push_back(c);
+        }
+        else {
+            switch (c) {
+            case '"': buffer_ += "\\\""; break;
+            case '\\': buffer_ += "\\\\"; break;
+            case '\n': buffer_ += "\\n"; break;
+            default: buffer_.push_back(c); break;
+            }
+        }
+
+        if (buffer_.size() >= chunk_size_) {
+            flush();
+        }
+    }
+
+    void SaveExporter::emit(std::string_view text) {
+        for (char c : text) {
+            emit(c);
+        }
+    }
+
+    void SaveExporter::flush() {
+        if (buffer_.empty()) {
+            return;
+        }
+
+        std::string chunk;
+        chunk.reserve(chunk_size_ + 256);
+        chunk.swap(buffer_);
+        sink_(std::move(chunk));
+    }
+
+    void SaveExporter::write_raw(std::string_view text) {
+        emit(text);
+    }
+
+    void SaveExporter::write_quoted(const Message& message) {
+        emit('"');
+        quoted_ = true;
+        write_message(message, "", mask_.empty(), 0);
+        quoted_ = false;
+        emit('"');
+    }
+
+    void SaveExporter::write_sizes(const Message& message) {
+        const auto* descriptor = message.GetDescriptor();
+        const auto* reflection = message.GetReflection();
+
+        emit('{');
+        bool first = true;
+        for (int i = 0; i < descriptor->field_count(); ++i) {
+            const auto* field = descriptor->field(i);
+            if (!field->is_repeated() || match(field->name()) == mask_match::none) {
+                continue;
+            }
+
+            if (!first) {
+                emit(',');
+            }
+            first = false;
+
+            write_string(field->name());
+            emit(':');
+            emit(std::to_string(reflection->FieldSize(message, field)));
+        }
+        emit('}');
+    }
+
+    void SaveExporter::newline(int depth) {
+        if (!pretty_) {
+            return;
+        }
+
+        emit('\n');
+        for (int i = 0; i < depth; ++i) {
+            emit(' ');
+        }
+    }
+
+    void SaveExporter::write_string(std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+
+        emit('"');
+        for (unsigned char c : text) {
+            switch (c) {
+            case '"': emit("\\\""); break;
+            case '\\': emit("\\\\"); break;
+            case '\b': emit("\\b"); break;
+            case '\f': emit("\\f"); break;
+            case '\n': emit("\\n"); break;
+            case '\r': emit("\\r"); break;
+            case '\t': emit("\\t"); break;
+            default:
+                if (c < 0x20) {
+                    const char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                    emit(std::string_view(escaped, sizeof(escaped)));
+                }
+                else {
+                    emit(static_cast<char>(c));
+                }
+                break;
+            }
+        }
+        emit('"');
+    }
+
+    void SaveExporter::write_message(const Message& message, const std::string& prefix, bool full, int depth) {
+        const auto* reflection = message.GetReflection();
+
+        //set fields only, in field number order like MessageToJsonString
+        std::vector<const FieldDescriptor*> fields;
+        reflection->ListFields(message, &fields);
+
+        emit('{');
+        bool first = true;
+        for (const auto* field : fields) {
+            const std::string path = prefix.empty() ? field->name() : prefix + "." + field->name();
+
+            bool field_full = full;
+            if (!full) {
+                const auto matched = match(path);
+                if (matched == mask_match::none) {
+                    continue;
+                }
+                field_full = matched == mask_match::full;
+            }
+
+            if (!first) {
+                emit(',');
+            }
+            first = false;
+
+            newline(depth + 1);
+            write_string(field->name());
+            emit(pretty_ ? ": " : ":");
+            write_field(message, field, path, field_full, depth + 1);
+        }
+
+        if (!first) {
+            newline(depth);
+        }
+        emit('}');
+    }
+
+    void SaveExporter::write_field(const Message& message, const FieldDescriptor* field,
+        const std::string& path, bool full, int depth) {
+        if (field->is_map()) {
+            write_map(message, field, path, full, depth);
+            return;
+        }
+
+        if (!field->is_repeated()) {
+            write_value(message, field, -1, path, full, depth);
+            return;
+        }
+
+        const int size = message.GetReflection()->FieldSize(message, field);
+        size_t begin = 0;
+        size_t end = static_cast<size_t>(size);
+        if (depth == 1) {
+            begin = std::min(page_offset_, end);
+            end = begin + std::min(page_limit_, end - begin);
+        }
+
+        emit('[');
+        for (size_t i = begin; i < end; ++i) {
+            if (i != begin) {
+                emit(',');
+            }
+            newline(depth + 1);
+            write_value(message, field, static_cast<int>(i), path, full, depth + 1);
+        }
+        if (end != begin) {
+            newline(depth);
+        }
+        emit(']');
+    }
+
+    void SaveExporter::write_map(const Message& message, const FieldDescriptor* field,
+        const std::string& path, bool full, int depth) {
+        const auto* reflection = message.GetReflection();
+        const auto* key = field->message_type()->map_key();
+        const auto* value = field->message_type()->map_value();
+        const int size = reflection->FieldSize(message, field);
+
+        emit('{');
+        for (int i = 0; i < size; ++i) {
+            const auto& entry = reflection->GetRepeatedMessage(message, field, i);
+            if (i != 0) {
+                emit(',');
+            }
+            newline(depth + 1);
+            write_map_key(entry, key);
+            emit(pretty_ ? ": " : ":");
+            write_value(entry, value, -1, path, full, depth + 1);
+        }
+        if (size != 0) {
+            newline(depth);
+        }
+        emit('}');
+    }
+
+    void SaveExporter::write_map_key(const Message& entry, const FieldDescriptor* key) {
+        const auto* reflection = entry.GetReflection();
+
+        switch (key->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_STRING: write_string(reflection->GetString(entry, key)); break;
+        case FieldDescriptor::CPPTYPE_INT32: write_string(std::to_string(reflection->GetInt32(entry, key))); break;
+        case FieldDescriptor::CPPTYPE_INT64: write_string(std::to_string(reflection->GetInt64(entry, key))); break;
+        case FieldDescriptor::CPPTYPE_UINT32: write_string(std::to_string(reflection->GetUInt32(entry, key))); break;
+        case FieldDescriptor::CPPTYPE_UINT64: write_string(std::to_string(reflection->GetUInt64(entry, key))); break;
+        case FieldDescriptor::CPPTYPE_BOOL: write_string(reflection->GetBool(entry, key) ? "true" : "false"); break;
+        default: write_string(""); break;
+        }
+    }
+
+    void SaveExporter::write_value(const Message& message, const FieldDescriptor* field,
+        int index, const std::string& path, bool full, int depth) {
+        const auto* reflection = message.GetReflection();
+        const bool repeated = index >= 0;
+
+        switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_INT32:
+            emit(std::to_string(repeated ? reflection->GetRepeatedInt32(message, field, index) : reflection->GetInt32(message, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            emit(std::to_string(repeated ? reflection->GetRepeatedUInt32(message, field, index) : reflection->GetUInt32(message, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_INT64:
+            //64 bit integers are strings in proto JSON
+            write_string(std::to_string(repeated ? reflection->GetRepeatedInt64(message, field, index) : reflection->GetInt64(message, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT64:
+            write_string(std::to_string(repeated ? reflection->GetRepeatedUInt64(message, field, index) : reflection->GetUInt64(message, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            emit(format_floating(repeated ? reflection->GetRepeatedFloat(message, field, index) : reflection->GetFloat(message, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            emit(format_floating(repeated ? reflection->GetRepeatedDouble(message, field, index) : reflection->GetDouble(message, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            emit((repeated ? reflection->GetRepeatedBool(message, field, index) : reflection->GetBool(message, field)) ? "true" : "false");
+            break;
+        case FieldDescriptor::CPPTYPE_ENUM: {
+            const auto* value = repeated ? reflection->GetRepeatedEnum(message, field, index) : reflection->GetEnum(message, field);
+            write_string(value->name());
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_STRING: {
+            std::string scratch;
+            const std::string& value = repeated
+                ? reflection->GetRepeatedStringReference(message, field, index, &scratch)
+                : reflection->GetStringReference(message, field, &scratch);
+            if (field->type() == FieldDescriptor::TYPE_BYTES) {
+                write_string(utils::cryptography::base64::encode(value));
+            }
+            else {
+                write_string(value);
+            }
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            write_message(repeated ? reflection->GetRepeatedMessage(message, field, index) : reflection->GetMessage(message, field),
+                path, full, depth);
+            break;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <google/protobuf/message.h>
+
+namespace tsto::dashboard {
+
+    //writes a message as JSON (proto field names, same output as MessageToJsonString)
+    //straight into fixed size chunks, the full document never exists in memory
+    class SaveExporter {
+    public:
+        using chunk_sink = std::function<void(std::string&& chunk)>;
+
+        explicit SaveExporter(chunk_sink sink, size_t chunk_size = 64 * 1024);
+
+        //comma separated field paths, e.g. "buildingData,userData.level", empty exports everything
+        void set_field_mask(const std::string& paths);
+
+        //window applied to every top level repeated field
+        void set_page(size_t offset, size_t limit);
+
+        void set_pretty(bool pretty) { pretty_ = pretty; }
+
+        //raw JSON text for the envelope around the save
+        void write_raw(std::string_view text);
+
+        //the message as a JSON string literal, e.g. the "save" value of get-user-save
+        void write_quoted(const google::protobuf::Message& message);
+
+        //{"<field>": <size>, ...} for the top level repeated fields selected by the mask
+        void write_sizes(const google::protobuf::Message& message);
+
+        void flush();
+
+    private:
+        enum class mask_match { none, partial, full };
+
+        mask_match match(const std::string& path) const;
+
+        void write_message(const google::protobuf::Message& message, const std::string& prefix, bool full, int depth);
+        void write_field(const google::protobuf::Message& message, const google::protobuf::FieldDescriptor* field,
+            const std::string& path, bool full, int depth);
+        void write_value(const google::protobuf::Message& message, const google::protobuf::FieldDescriptor* field,
+            int index, const std::string& path, bool full, int depth);
+        void write_map(const google::protobuf::Message& message, const google::protobuf::FieldDescriptor* field,
+            const std::string& path, bool full, int depth);
+        void write_map_key(const google::protobuf::Message& entry, const google::protobuf::FieldDescriptor* key);
+        void write_string(std::string_view text);
+        void newline(int depth);
+
+        void emit(std::string_view text);
+        void emit(char c);
+
+        chunk_sink sink_;
+        size_t chunk_size_;
+        std::string buffer_;
+
+        std::vector<std::string> mask_;
+        size_t page_offset_ = 0;
+        size_t page_limit_ = SIZE_MAX;
+        bool pretty_ = true;
+        bool quoted_ = false;
+    };
+}
@@ -1,6 +1,7 @@
 #include <std_include.hpp>
 #include "database.hpp"
 #include "debugging/serverlog.hpp"
+#include "tsto/cache/shared_cache.hpp"
 #include <sqlite3.h>
 #include <string>
 #include <mutex>
@@ -183,7 +184,7 @@ int64_t Database::get_next_mayhem_id() {
 
 bool Database::store_user_id(const std::string& email, const std::string& user_id, 
                             const std::string& access_token, int64_t mayhem_id, 
-                            const std::string& access_code) {
+                            const std::string& access_code, std::string* replaced_token) {
     if (!db_) {
         logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_DATABASE,
             "Cannot store user data - database not initialized");
@@ -195,6 +196,15 @@ bool Database::store_user_id(const std::string& email, const std::string& user_i
         mayhem_id = get_next_mayhem_id();
     }
 
+    //the row is replaced whole, the token it held stops resolving here
+    std::string previous_token;
+    if (!access_token.empty() && get_access_token(email, previous_token) && previous_token != access_token) {
+        cache::SharedCache::get().remove(cache::kind::token, previous_token);
+    }
+    else {
+        previous_token.clear();
+    }
+
     logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
         "Storing user data - Email: %s, User ID: %s, Access Token: %s, Mayhem ID: %lld, Access Code: %s", 
         email.c_str(), user_id.c_str(), access_token.c_str(), mayhem_id, access_code.c_str());
@@ -225,6 +235,12 @@ bool Database::store_user_id(const std::string& email, const std::string& user_i
     } else {
         logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
             "Successfully stored user data for email: %s", email.c_str());
+        if (!access_token.empty()) {
+            cache::SharedCache::get().set(cache::kind::token, access_token, email);
+        }
+        if (replaced_token) {
+            *replaced_token = previous_token;
+        }
     }
 
     sqlite3_finalize(stmt);
@@ -399,9 +415,17 @@ bool Database::get_access_token(const std::string& email, std::string& access_to
     return found;
 }
 
-bool Database::update_access_token(const std::string& email, const std::string& access_token) {
+bool Database::update_access_token(const std::string& email, const std::string& access_token, std::string* replaced_token) {
     if (!db_) return false;
 
+    std::string previous_token;
+    if (!access_token.empty() && get_access_token(email, previous_token) && previous_token != access_token) {
+        cache::SharedCache::get().remove(cache::kind::token, previous_token);
+    }
+    else {
+        previous_token.clear();
+    }
+
     const char* sql = "UPDATE users SET access_token = ? WHERE email = ? COLLATE NOCASE;";
     sqlite3_stmt* stmt = nullptr;
     
@@ -438,6 +462,12 @@ bool Database::update_access_token(const std::string& email, const std::string&
     } else {
         logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
             "Successfully updated access token for email: %s", email.c_str());
+        if (!access_token.empty()) {
+            cache::SharedCache::get().set(cache::kind::token, access_token, email);
+        }
+        if (replaced_token) {
+            *replaced_token = previous_token;
+        }
     }
 
     sqlite3_finalize(stmt);
@@ -445,7 +475,7 @@ bool Database::update_access_token(const std::string& email, const std::string&
 }
 
 bool Database::get_email_by_token(const std::string& access_token, std::string& email) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
     
     sqlite3_stmt* stmt = nullptr;
     const char* query = "SELECT email FROM users WHERE access_token = ? COLLATE NOCASE";
@@ -469,6 +499,12 @@ bool Database::get_email_by_token(const std::string& access_token, std::string&
     }
     
     sqlite3_finalize(stmt);
+    lock.unlock();
+
+    //tokens issued by another node may not have reached this database
+    if (!found) {
+        found = cache::SharedCache::get().get_sync(cache::kind::token, access_token, email);
+    }
     return found;
 }
 
@@ -483,7 +519,7 @@ bool Database::validate_access_token(const std::string& access_token, std::strin
     logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_DATABASE,
         "Validating access token: %s...", token_prefix.c_str());
     
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
     
     sqlite3_stmt* stmt = nullptr;
     const char* query = "SELECT email FROM users WHERE access_token = ? COLLATE NOCASE";
@@ -555,6 +591,12 @@ bool Database::validate_access_token(const std::string& access_token, std::strin
     }
     
     sqlite3_finalize(stmt);
+    lock.unlock();
+
+    //tokens issued by another node may not have reached this database
+    if (!found) {
+        found = cache::SharedCache::get().get_sync(cache::kind::token, access_token, email);
+    }
     return found;
 }
 
@@ -33,14 +33,18 @@ public:
     void close();
     int64_t get_next_user_id();
     int64_t get_next_mayhem_id();  
-    bool store_user_id(const std::string& email, const std::string& user_id, const std::string& access_token, int64_t mayhem_id = 0, const std::string& access_code = "");
+    //replaced_token gets the token the row held before when a new one replaces it, revoking it
+    //is up to the caller (tsto::auth::Auth::store_user_id)
+    bool store_user_id(const std::string& email, const std::string& user_id, const std::string& access_token, int64_t mayhem_id = 0, const std::string& access_code = "", std::string* replaced_token = nullptr);
     bool get_user_id(const std::string& email, std::string& user_id);
+    //a token not in this database is looked up in the shared cache, waiting on memcached for up
+    //to its timeout, so handlers call this and validate_access_token on the io pool
     bool get_email_by_token(const std::string& access_token, std::string& email);
     bool get_access_token(const std::string& email, std::string& access_token);
     bool get_access_code(const std::string& email, std::string& access_code);
     bool get_email_by_access_code(const std::string& access_code, std::string& email);
     bool get_mayhem_id(const std::string& email, int64_t& mayhem_id);
-    bool update_access_token(const std::string& email, const std::string& new_token);
+    bool update_access_token(const std::string& email, const std::string& new_token, std::string* replaced_token = nullptr);
     std::optional<UserData> find_user_by_token(const std::string& access_token);
     bool validate_access_token(const std::string& access_token, std::string& email);
 
@@ -4,6 +4,7 @@
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
 #include "ClientTelemetry.pb.h"
+#include "memory/request_arena.hpp"
 
 namespace tsto::device {
 
@@ -12,9 +13,9 @@ namespace tsto::device {
         try {
             logger::write(logger::LOG_LEVEL_INCOMING, logger::LOG_LABEL_SERVER_HTTP, "[DEVICE REGISTRATION] Request from %s", ctx->remote_ip().data());
 
-            rapidjson::Document request_body;
-            std::string body_content = ctx->body().ToString(); 
-            if (request_body.Parse(body_content.c_str()).HasParseError()) {
+            const auto arena = server::memory::RequestArena::for_request();
+            server::memory::JsonDocument request_body(*arena);
+            if (request_body.Parse(ctx->body().data(), ctx->body().size()).HasParseError()) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_SERVER_HTTP, "[DEVICE REGISTRATION] Failed to parse JSON body");
                 ctx->set_response_http_code(400);
                 cb(R"({"status": "error", "message": "Invalid JSON in request body"})");
@@ -5,6 +5,8 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/prettywriter.h>
+#include <json_writer.hpp>
+#include "memory/request_arena.hpp"
 #include <fstream>
 #include <filesystem>
 #include "configuration.hpp"
@@ -268,8 +270,9 @@ namespace tsto::events {
             std::string event_time_str;
 
             if (!body.empty()) {
-                rapidjson::Document doc;
-                doc.Parse(body.c_str());
+                const auto arena = server::memory::RequestArena::for_request();
+                server::memory::JsonDocument doc(*arena);
+                doc.Parse(body.data(), body.size());
                 if (!doc.HasParseError() && doc.HasMember("event_time")) {
                     if (doc["event_time"].IsString()) {
                         event_time_str = doc["event_time"].GetString();
@@ -351,8 +354,9 @@ namespace tsto::events {
             int minutes_offset = 0;
 
             if (!body.empty()) {
-                rapidjson::Document doc;
-                doc.Parse(body.c_str());
+                const auto arena = server::memory::RequestArena::for_request();
+                server::memory::JsonDocument doc(*arena);
+                doc.Parse(body.data(), body.size());
                 if (!doc.HasParseError() && doc.HasMember("minutes_offset")) {
                     if (doc["minutes_offset"].IsInt()) {
                         minutes_offset = doc["minutes_offset"].GetInt();
@@ -507,20 +511,17 @@ namespace tsto::events {
                 event_time = current_time;
             }
 
-            rapidjson::Document doc;
-            doc.SetObject();
-            
-            doc.AddMember("status", "success", doc.GetAllocator());
-            doc.AddMember("current_time", rapidjson::Value(static_cast<int64_t>(current_time)), doc.GetAllocator());
-            doc.AddMember("event_time", rapidjson::Value(static_cast<int64_t>(event_time)), doc.GetAllocator());
-            doc.AddMember("event_name", rapidjson::Value(current_event.name.c_str(), doc.GetAllocator()), doc.GetAllocator());
-            doc.AddMember("event_is_active", current_event.is_active, doc.GetAllocator());
-            
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            doc.Accept(writer);
-            
-            cb(buffer.GetString());
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object()
+                .member("status", "success")
+                .member("current_time", static_cast<int64_t>(current_time))
+                .member("event_time", static_cast<int64_t>(event_time))
+                .member("event_name", current_event.name)
+                .member("event_is_active", current_event.is_active)
+                .end_object();
+
+            cb(response);
             
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[EVENTS] Sent time info: current_time=%lld, event_time=%lld, event=%s",
@@ -530,17 +531,14 @@ namespace tsto::events {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                 "[EVENTS] Error getting time: %s", ex.what());
                 
-            rapidjson::Document doc;
-            doc.SetObject();
-            
-            doc.AddMember("status", "error", doc.GetAllocator());
-            doc.AddMember("message", rapidjson::Value(ex.what(), doc.GetAllocator()), doc.GetAllocator());
-            
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            doc.Accept(writer);
-            
-            cb(buffer.GetString());
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object()
+                .member("status", "error")
+                .member("message", ex.what())
+                .end_object();
+
+            cb(response);
         }
     }
 
@@ -0,0 +1,75 @@
+#pragma once
+#include <std_include.hpp>
+#include <evpp/http/context.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+namespace tsto {
+
+    //reads a request body segment by segment as libevent received it, so protobuf parses it in
+    //place instead of from a pulled up or copied string. keep the context alive while reading.
+    class BodyInputStream final : public google::protobuf::io::ZeroCopyInputStream {
+    public:
+        explicit BodyInputStream(const evpp::http::ContextPtr& ctx)
+            : segments_(ctx->body_segments()) {
+        }
+
+        bool Next(const void** data, int* size) override {
+            if (backed_up_ > 0) {
+                const auto& segment = segments_[index_ - 1];
+                *data = segment.data() + segment.size() - backed_up_;
+                *size = static_cast<int>(backed_up_);
+                position_ += backed_up_;
+                backed_up_ = 0;
+                return true;
+            }
+
+            if (index_ >= segments_.size()) {
+                return false;
+            }
+
+            const auto& segment = segments_[index_++];
+            *data = segment.data();
+            *size = static_cast<int>(segment.size());
+            position_ += segment.size();
+            return true;
+        }
+
+        void BackUp(int count) override {
+            backed_up_ += static_cast<size_t>(count);
+            position_ -= static_cast<size_t>(count);
+        }
+
+        bool Skip(int count) override {
+            const void* data;
+            int size;
+            while (count > 0 && Next(&data, &size)) {
+                if (size > count) {
+                    BackUp(size - count);
+                    return true;
+                }
+                count -= size;
+            }
+            return count == 0;
+        }
+
+        int64_t ByteCount() const override {
+            return static_cast<int64_t>(position_);
+        }
+
+        //the same segments for code that does not go through protobuf, e.g. zlib
+        std::vector<std::string_view> views() const {
+            std::vector<std::string_view> views;
+            views.reserve(segments_.size());
+            for (const auto& segment : segments_) {
+                views.emplace_back(segment.data(), segment.size());
+            }
+            return views;
+        }
+
+    private:
+        std::vector<evpp::Slice> segments_;
+        size_t index_ = 0;
+        size_t backed_up_ = 0;
+        size_t position_ = 0;
+    };
+}
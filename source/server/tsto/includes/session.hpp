@@ -7,6 +7,7 @@
 
 #include "debugging/serverlog.hpp"
 #include "LandData.pb.h"
+#include "tsto/land/town_snapshot.hpp"
 
 namespace tsto {
     class Session {
@@ -49,6 +50,8 @@ namespace tsto {
         std::string access_token;    
 
         Data::LandMessage land_proto;
+        //serialized land_proto, invalidate it on every change to the town
+        tsto::land::TownSnapshot land_snapshot;
 
         // Reinitialize the session
         void reinitialize() {
@@ -63,12 +66,7 @@ namespace tsto {
 
 
         std::string generate_random_digits(size_t length) {
-            std::string result;
-            result.reserve(length);
-            for (size_t i = 0; i < length; i++) {
-                result += std::to_string(utils::cryptography::random::get_integer() % 10);
-            }
-            return result;
+            return utils::cryptography::random::get_digits(length);
         }
 
         std::string generate_random_name(size_t min_length, size_t max_length) {
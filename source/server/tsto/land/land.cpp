@@ -6,19 +6,34 @@
 #include <evpp/http/context.h>
 #include <evpp/http/http_server.h>
 #include <evpp/http/service.h>
-#include <3rdparty/libevent/include/event2/http.h>
+#include <evpp/libevent.h>
 #include <compression.hpp>
 #include <configuration.hpp>
+#include <io.hpp>
+#include <finally.hpp>
 #include "tsto/database/database.hpp"
+#include "tsto/auth/auth.hpp"
+#include "town_store.hpp"
+#include "tsto/currency/currency_ledger.hpp"
+#include "tsto/cache/shared_cache.hpp"
+#include "tsto/includes/body_stream.hpp"
+#include "dispatcher/town_router.hpp"
 
 namespace tsto::land {
 
+    namespace {
+        //"mytown.pb" for legacy users, "<email>.pb" for everyone else
+        bool valid_town_filename(const std::string& filename) {
+            return filename == "mytown.pb" || (filename.find('@') != std::string::npos && filename.ends_with(".pb")
+                && filename.find_first_of("/\\") == std::string::npos);
+        }
+    }
+
     void Land::handle_proto_whole_land_token(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
         try {
-            std::string uri = ctx->uri();
-            std::string token;
-            std::string user_id;
+            const std::string_view uri = ctx->uri();
+            std::string_view token;
 
             size_t token_start = uri.find("/checkToken/") + 11;
             size_t token_end = uri.find("/protoWholeLandToken/");
@@ -32,9 +47,9 @@ namespace tsto::land {
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_LAND,
                 "[CHECK TOKEN] Request params:\n"
                 "URI: %s\n"
-                "Token: %s",
+                "Token: %.*s",
                 ctx->uri().c_str(),
-                token.c_str()
+                static_cast<int>(token.size()), token.data()
             );
 
             auto& session = tsto::Session::get();
@@ -44,7 +59,7 @@ namespace tsto::land {
             response.set_sessionkey(session.session_key);
             response.set_expirationdate(0);
 
-            logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_LAND, "[CHECK TOKEN] Sending response for token: %s", token.c_str());
+            logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_LAND, "[CHECK TOKEN] Sending response for token: %.*s", static_cast<int>(token.size()), token.data());
 
             headers::set_protobuf_response(ctx);
             cb(utils::serialization::serialize_protobuf(response));
@@ -91,27 +106,24 @@ namespace tsto::land {
         }
 
         std::filesystem::path town_file_path = "towns/" + filename;
+        auto& store = TownStore::get();
 
         logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
             "[LAND] Attempting to load %s", town_file_path.string().c_str());
 
-        std::filesystem::create_directories("towns");
-
-        if (std::filesystem::exists(town_file_path)) {
+        if (store.exists(filename)) {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[LAND] Town file exists, loading: %s", town_file_path.string().c_str());
             
             try {
-                std::ifstream file(town_file_path, std::ios::binary);
-                if (!file.is_open()) {
+                std::string buffer;
+                if (!store.load(filename, buffer)) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, 
                         "[LAND] Failed to open town file: %s", town_file_path.string().c_str());
                     return false;
                 }
 
-                std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-                file.close();
-
+                const auto town_changed = utils::finally([&session]() { session.land_snapshot.invalidate(); });
                 if (session.land_proto.ParseFromArray(buffer.data(), static_cast<int>(buffer.size()))) {
                     logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
                         "[LAND] Successfully loaded town file (direct parse)");
@@ -188,20 +200,19 @@ namespace tsto::land {
                 "[LAND] Set default ID for new legacy town: %s", default_id.c_str());
         }
         
-        std::ofstream output(town_file_path, std::ios::binary);
-        if (!output.is_open()) {
+        std::string serialized;
+        if (!land_data.SerializeToString(&serialized)) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                "[LAND] Failed to create town file: %s", town_file_path.string().c_str());
+                "[LAND] Failed to serialize town data to: %s", town_file_path.string().c_str());
             return false;
         }
         
-        if (!land_data.SerializeToOstream(&output)) {
+        if (!store.save(filename, serialized)) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                "[LAND] Failed to serialize town data to: %s", town_file_path.string().c_str());
+                "[LAND] Failed to create town file: %s", town_file_path.string().c_str());
             return false;
         }
         
-        output.close();
         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
             "[LAND] Successfully created new town: %s", town_file_path.string().c_str());
         
@@ -218,9 +229,7 @@ namespace tsto::land {
         std::string filename = email_ + ".pb";
         std::filesystem::path town_file_path = "towns/" + filename;
         
-        std::filesystem::create_directories("towns");
-        
-        if (!std::filesystem::exists(town_file_path)) {
+        if (!TownStore::get().exists(filename)) {
             return instance_load_town(); 
         }
         
@@ -230,9 +239,9 @@ namespace tsto::land {
         return true;
     }
 
-    bool Land::static_load_town() {
+    bool Land::resolve_session_town(std::string& filename) {
         auto& session = tsto::Session::get();
-        std::string filename = session.town_filename;
+        filename = session.town_filename;
 
         //legacy users or when not logged in
         if (filename.empty()) {
@@ -242,12 +251,53 @@ namespace tsto::land {
                 "[LAND] Using default town file: %s", filename.c_str());
         }
         //logged in users, validate email format
-        else if (filename != "mytown.pb" && (filename.find('@') == std::string::npos || !filename.ends_with(".pb"))) {
+        else if (!valid_town_filename(filename)) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                 "[LAND] Invalid town filename format: %s", filename.c_str());
             return false;
         }
 
+        return true;
+    }
+
+    bool Land::resolve_player(const evpp::http::ContextPtr& ctx, player& p) {
+        //the router only lets these headers through from its peers
+        const char* town = ctx->FindRequestHeader(server::dispatcher::http::TownRouter::town_header);
+        if (!town) {
+            p = session_player();
+            return resolve_session_town(p.town);
+        }
+
+        const char* user_id = ctx->FindRequestHeader(server::dispatcher::http::TownRouter::user_header);
+        p.town = town;
+        p.user_id = user_id ? user_id : "";
+        p.forwarded = true;
+        p.own_town = std::make_shared<town_state>();
+        if (!valid_town_filename(p.town)) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[LAND] Invalid forwarded town filename: %s", p.town.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    Data::LandMessage& Land::player::proto() const {
+        return own_town ? own_town->proto : tsto::Session::get().land_proto;
+    }
+
+    TownSnapshot& Land::player::snapshot() const {
+        return own_town ? own_town->snapshot : tsto::Session::get().land_snapshot;
+    }
+
+    Land::player Land::session_player() {
+        const auto& session = tsto::Session::get();
+        player p;
+        p.town = save_filename();
+        p.user_id = session.user_user_id;
+        return p;
+    }
+
+    std::string Land::lookup_user_id(const std::string& filename) {
         // Get the user's ID from the database if available
         auto& db = tsto::database::Database::get_instance();
         std::string stored_user_id;
@@ -255,82 +305,126 @@ namespace tsto::land {
         if (email.ends_with(".pb")) {
             email = email.substr(0, email.length() - 3); // Remove .pb extension
         }
-        
-        if (db.get_user_id(email, stored_user_id)) {
-            //update session with stored user ID
-            session.user_user_id = stored_user_id;
-            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                "[LAND] Using stored user_id for %s: %s", email.c_str(), stored_user_id.c_str());
+
+        if (!db.get_user_id(email, stored_user_id)) {
+            stored_user_id.clear();
         }
+        return stored_user_id;
+    }
 
-        std::filesystem::path town_file_path = "towns/" + filename;
+    void Land::apply_user_id(player& p, const std::string& user_id) {
+        if (user_id.empty()) {
+            return;
+        }
 
-        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-            "[LAND] Attempting to load %s", town_file_path.string().c_str());
+        //the session is only this node's own player, a forwarded one keeps the id it came with
+        if (p.forwarded) {
+            if (p.user_id.empty()) {
+                p.user_id = user_id;
+            }
+            return;
+        }
 
-        //create towns directory if it doesn't exist
-        std::filesystem::create_directories("towns");
+        //update session with stored user ID
+        tsto::Session::get().user_user_id = user_id;
+        p.user_id = user_id;
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+            "[LAND] Using stored user_id for %s: %s", p.town.c_str(), user_id.c_str());
+    }
 
-        //try to load existing town or create new one
-        if (!std::filesystem::exists(town_file_path)) {
-            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME, "[LAND] No existing town found at %s, creating new town", town_file_path.string().c_str());
-            create_blank_town();
-            return save_town();
-        }
+    bool Land::apply_town_data(const player& p, const std::string& buffer, std::optional<uint64_t> revision) {
+        const std::string& filename = p.town;
 
-        try {
-            std::ifstream file(town_file_path, std::ios::binary);
-            if (!file.is_open()) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[LAND] Failed to open town file: %s", town_file_path.string().c_str());
-                return false;
+        //a town that has not changed since it was loaded or saved is kept with its snapshot
+        const uint64_t stored_hash = TownSnapshot::hash(buffer);
+        if (p.snapshot().holds(filename, stored_hash)
+            && (p.user_id.empty() || p.proto().id() == p.user_id)) {
+            if (revision) {
+                p.snapshot().verified(filename, stored_hash, *revision);
             }
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+                "[LAND] Town %s unchanged, keeping the loaded one", filename.c_str());
+            return true;
+        }
 
-            std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            file.close();
+        auto town_changed = utils::finally([&p]() { p.snapshot().invalidate(); });
 
-            if (session.land_proto.ParseFromArray(buffer.data(), static_cast<int>(buffer.size()))) {
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                    "[LAND] Successfully loaded town file (direct parse)");
-            }
-            else {
-                logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_GAME, 
-                    "[LAND] Direct parse failed. Attempting Tsto backup offset parse.");
+        if (p.proto().ParseFromArray(buffer.data(), static_cast<int>(buffer.size()))) {
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
+                "[LAND] Successfully loaded town file (direct parse)");
+        }
+        else {
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_GAME, 
+                "[LAND] Direct parse failed. Attempting Tsto backup offset parse.");
 
-                constexpr size_t backup_offset = 0x0C;
-                if (buffer.size() > backup_offset) {
-                    if (!session.land_proto.ParseFromArray(buffer.data() + backup_offset, 
-                                                          static_cast<int>(buffer.size() - backup_offset))) {
-                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, 
-                            "[LAND] Failed to parse town file after both direct and backup parse attempts");
-                        return false;
-                    }
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                        "[LAND] Successfully loaded town file (Tsto Backup)");
-                }
-                else {
+            constexpr size_t backup_offset = 0x0C;
+            if (buffer.size() > backup_offset) {
+                if (!p.proto().ParseFromArray(buffer.data() + backup_offset, 
+                                                      static_cast<int>(buffer.size() - backup_offset))) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, 
-                        "[LAND] Buffer too small for backup format parsing");
+                        "[LAND] Failed to parse town file after both direct and backup parse attempts");
                     return false;
                 }
+                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
+                    "[LAND] Successfully loaded town file (Tsto Backup)");
+            }
+            else {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, 
+                    "[LAND] Buffer too small for backup format parsing");
+                return false;
             }
+        }
 
-            // Update the land proto ID to match the user_user_id
-            if (!session.user_user_id.empty()) {
-                //logged-in users with a valid user_user_id, update the land ID
-                session.land_proto.set_id(session.user_user_id);
+        // Update the land proto ID to match the user_user_id
+        if (!p.user_id.empty()) {
+            //logged-in users with a valid user_user_id, update the land ID
+            p.proto().set_id(p.user_id);
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
+                "[LAND] Updated land_proto ID to match session: %s", p.user_id.c_str());
+        } else if (filename == "mytown.pb") {
+            // For legacy/non-logged-in users, preserve the existing ID or generate a default one if empty
+            if (p.proto().id().empty()) {
+                std::string default_id = "default_" + std::to_string(std::time(nullptr));
+                p.proto().set_id(default_id);
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                    "[LAND] Updated land_proto ID to match session: %s", session.user_user_id.c_str());
-            } else if (filename == "mytown.pb") {
-                // For legacy/non-logged-in users, preserve the existing ID or generate a default one if empty
-                if (session.land_proto.id().empty()) {
-                    std::string default_id = "default_" + std::to_string(std::time(nullptr));
-                    session.land_proto.set_id(default_id);
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                        "[LAND] Set default ID for legacy town: %s", default_id.c_str());
-                } else {
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                        "[LAND] Preserved existing ID for legacy town: %s", session.land_proto.id().c_str());
-                }
+                    "[LAND] Set default ID for legacy town: %s", default_id.c_str());
+            } else {
+                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
+                    "[LAND] Preserved existing ID for legacy town: %s", p.proto().id().c_str());
+            }
+        }
+
+        town_changed.cancel();
+        p.snapshot().loaded(filename, buffer, revision);
+        return true;
+    }
+
+    Land::town_read Land::read_town(const std::string& filename) {
+        town_read read;
+        read.user_id = lookup_user_id(filename);
+
+        auto& store = TownStore::get();
+        read.revision = TownStore::revision(filename);
+        read.exists = store.exists(filename);
+        if (read.exists) {
+            read.loaded = store.load(filename, read.data);
+        }
+        return read;
+    }
+
+    bool Land::apply_town_read(const player& p, const town_read& read) {
+        std::filesystem::path town_file_path = "towns/" + p.town;
+
+        if (!read.loaded) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[LAND] Failed to open town file: %s", town_file_path.string().c_str());
+            return false;
+        }
+
+        try {
+            //the cache is only filled by saves, a read finishing after a save would put the
+            //older town back over it
+            if (!apply_town_data(p, read.data, read.revision)) {
+                return false;
             }
 
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
@@ -343,66 +437,142 @@ namespace tsto::land {
         }
     }
 
-    bool Land::save_town() {
-        auto& session = tsto::Session::get();
-        std::string filename = session.town_filename;
+    bool Land::static_load_town() {
+        player p = session_player();
+        if (!resolve_session_town(p.town)) {
+            return false;
+        }
+
+        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
+            "[LAND] Attempting to load towns/%s", p.town.c_str());
+
+        const town_read read = read_town(p.town);
+        apply_user_id(p, read.user_id);
+
+        //try to load existing town or create new one
+        if (!read.exists) {
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME, "[LAND] No existing town found at towns/%s, creating new town", p.town.c_str());
+            create_blank_town(p);
+            return save_town();
+        }
+
+        return apply_town_read(p, read);
+    }
+
+    std::string Land::save_filename() {
+        const auto& filename = tsto::Session::get().town_filename;
 
         //legacy users or when not logged in, use mytown.pb
-        if (filename.empty()) {
-            filename = "mytown.pb";
+        return filename.empty() ? "mytown.pb" : filename;
+    }
+
+    std::string Land::read_stored_etag(const std::string& filename, const TownSnapshot& snapshot) {
+        std::string etag = snapshot.stored_etag(filename, TownStore::revision(filename));
+        if (!etag.empty()) {
+            return etag;
+        }
+
+        auto& store = TownStore::get();
+        std::string data;
+        if (!store.exists(filename) || !store.load(filename, data)) {
+            return {};
+        }
+        return TownSnapshot::etag_of(TownSnapshot::hash(data));
+    }
+
+    Land::save_check Land::check_save(const evpp::http::ContextPtr& ctx, const player& p, uint64_t body_hash,
+        const std::string& stored_etag) {
+        const std::string& filename = p.town;
+
+        const char* if_match = ctx->FindRequestHeader("If-Match");
+        if (if_match && !headers::etag_matches(if_match, stored_etag, false)) {
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_GAME,
+                "[PROTOLAND] Skipping stale save of %s: expected %s, town is at %s", filename.c_str(), if_match,
+                stored_etag.empty() ? "none" : stored_etag.c_str());
+            return save_check::stale;
         }
 
+        //the body must also still be what the store holds, another server may have saved since
+        if (p.snapshot().holds(filename, body_hash) && p.snapshot().current(filename, TownStore::revision(filename))) {
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+                "[PROTOLAND] %s already holds this town, skipping the save", filename.c_str());
+            return save_check::duplicate;
+        }
+        return save_check::save;
+    }
+
+    bool Land::prepare_town_write(town_write& write, const player& p) {
+        write.filename = p.town;
+        write.own_town = p.own_town;
+
         //ensure user ID is set in the land proto
-        if (!session.user_user_id.empty()) {
+        if (!p.user_id.empty()) {
             //logged-in users with a valid user_user_id, update the land ID
-            session.land_proto.set_id(session.user_user_id);
+            p.proto().set_id(p.user_id);
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                "[LAND] Setting user_id in land proto: %s", session.user_user_id.c_str());
-        } else if (filename == "mytown.pb") {
+                "[LAND] Setting user_id in land proto: %s", p.user_id.c_str());
+        } else if (write.filename == "mytown.pb") {
             // For legacy/non-logged-in users, preserve the existing ID or generate a default one if empty
-            if (session.land_proto.id().empty()) {
+            if (p.proto().id().empty()) {
                 std::string default_id = "default_" + std::to_string(std::time(nullptr));
-                session.land_proto.set_id(default_id);
+                p.proto().set_id(default_id);
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
                     "[LAND] Set default ID for legacy town: %s", default_id.c_str());
             } else {
                 logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                    "[LAND] Preserved existing ID for legacy town: %s", session.land_proto.id().c_str());
+                    "[LAND] Preserved existing ID for legacy town: %s", p.proto().id().c_str());
             }
         }
 
-        std::filesystem::path town_file_path = "towns/" + filename;
-        
         try {
-            std::filesystem::create_directories("towns");
-
-            std::ofstream file(town_file_path, std::ios::binary);
-            if (!file.is_open()) {
+            std::string serialized;
+            if (!p.proto().SerializeToString(&serialized)) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[LAND] Failed to open town file for writing: %s", town_file_path.string().c_str());
+                    "[LAND] Failed to serialize town data");
+                p.snapshot().invalidate();
                 return false;
             }
+            //the next GET answers with these same bytes
+            write.data = p.snapshot().set(std::move(serialized), write.filename);
+        }
+        catch (const std::exception& ex) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[LAND] Error saving town file: %s", ex.what());
+            p.snapshot().invalidate();
+            return false;
+        }
 
-            std::string serialized;
-            if (!session.land_proto.SerializeToString(&serialized)) {
+        // Store user ID in database if we have an email
+        //a forwarded player's account is kept by the node it logged in to
+        if (!p.forwarded && write.filename.ends_with(".pb") && write.filename != "mytown.pb") {
+            write.email = write.filename.substr(0, write.filename.length() - 3); // Remove .pb extension
+            write.user_id = p.user_id;
+        }
+        return true;
+    }
+
+    bool Land::write_town(const town_write& write) {
+        std::filesystem::path town_file_path = "towns/" + write.filename;
+
+        try {
+            const uint64_t revision = TownStore::revision(write.filename);
+            if (!TownStore::get().save(write.filename, *write.data)) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[LAND] Failed to serialize town data");
+                    "[LAND] Failed to open town file for writing: %s", town_file_path.string().c_str());
                 return false;
             }
 
-            file.write(serialized.data(), serialized.size());
-            file.close();
+            //nothing else wrote the town meanwhile, so the next GET can answer without reading it
+            if (TownStore::revision(write.filename) == revision + 1) {
+                auto& snapshot = write.own_town ? write.own_town->snapshot : tsto::Session::get().land_snapshot;
+                snapshot.written(write.data, revision + 1);
+            }
 
-            // Store user ID in database if we have an email
-            std::string email = filename;
-            if (email.ends_with(".pb") && email != "mytown.pb") {
-                email = email.substr(0, email.length() - 3); // Remove .pb extension
+            if (!write.email.empty() && !write.user_id.empty()) {
                 auto& db = tsto::database::Database::get_instance();
-                if (!session.user_user_id.empty()) {
-                    if (!db.store_user_id(email, session.user_user_id, "")) {
-                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                            "[LAND] Failed to store user_id in database for email: %s", email.c_str());
-                    }
+                if (!db.store_user_id(write.email, write.user_id, "")) {
+                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                        "[LAND] Failed to store user_id in database for email: %s", write.email.c_str());
                 }
             }
 
@@ -417,26 +587,29 @@ namespace tsto::land {
         }
     }
 
+    bool Land::save_town() {
+        town_write write;
+        return prepare_town_write(write, session_player()) && write_town(write);
+    }
 
-    void Land::create_blank_town() {
-        auto& session = tsto::Session::get();
 
-        session.land_proto.Clear();
+    void Land::create_blank_town(const player& p) {
+        p.proto().Clear();
         
         //Set the ID to match the user_user_id if available
-        if (!session.user_user_id.empty()) {
-            session.land_proto.set_id(session.user_user_id);
+        if (!p.user_id.empty()) {
+            p.proto().set_id(p.user_id);
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
-                "[LAND] Set user_id in new land proto: %s", session.user_user_id.c_str());
-        } else if (session.town_filename == "mytown.pb") {
+                "[LAND] Set user_id in new land proto: %s", p.user_id.c_str());
+        } else if (p.town == "mytown.pb") {
             //legacy/non-logged-in users, generate a default ID
             std::string default_id = "default_" + std::to_string(std::time(nullptr));
-            session.land_proto.set_id(default_id);
+            p.proto().set_id(default_id);
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, 
                 "[LAND] Set default ID for new legacy town: %s", default_id.c_str());
         }
         
-        auto* friend_data = session.land_proto.mutable_frienddata();
+        auto* friend_data = p.proto().mutable_frienddata();
         friend_data->set_dataversion(72);
         friend_data->set_haslemontree(false);
         friend_data->set_language(0);
@@ -444,9 +617,10 @@ namespace tsto::land {
         friend_data->set_name("");
         friend_data->set_rating(0);
         friend_data->set_boardwalktilecount(0);
+        p.snapshot().invalidate();
 
         std::string email = "mytown"; // Default value
-        std::string town_filename = session.town_filename;
+        const std::string& town_filename = p.town;
         
         if (!town_filename.empty()) {
             size_t pb_pos = town_filename.find(".pb");
@@ -456,28 +630,18 @@ namespace tsto::land {
         }
         
         int initial_donuts = std::stoi(utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
-        
-        std::string currency_path;
-        if (email == "mytown") {
-            currency_path = "towns/currency.txt"; 
-        } else {
-            currency_path = "towns/" + email + ".txt";
-        }
-        
-        std::filesystem::create_directories("towns");
-        std::ofstream output(currency_path);
-        output << initial_donuts;
-        output.close();
+        tsto::currency::CurrencyLedger::get_instance().set_balance(
+            tsto::currency::CurrencyLedger::user_from_town(email), initial_donuts);
 
         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME, 
             "[LAND] Created new blank town for user %s with data version %d and initial donuts: %d", 
             email.c_str(), friend_data->dataversion(), initial_donuts);
     }
 
-    void Land::handle_protoland(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
+    void Land::handle_protoland(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
         try {
-            const std::string uri = ctx->uri();
+            const std::string& uri = ctx->uri();
             const size_t land_start = uri.find("/protoland/") + 11;
             const size_t land_end = uri.find("/", land_start);
 
@@ -491,24 +655,11 @@ namespace tsto::land {
 
             const std::string land_id = uri.substr(land_start, land_end - land_start);
 
-            std::string access_token;
-            auto auth_header = ctx->FindRequestHeader("mh_auth_params");
-            if (auth_header) {
-                std::string auth_str(auth_header);
-                if (auth_str.substr(0, 7) == "Bearer ") {
-                    access_token = auth_str.substr(7);
-                }
-                else {
-                    access_token = auth_str;
-                }
-            }
-
-
             auto& session = tsto::Session::get();
 
             // Verify mh_uid matches land_id for security
             auto mh_uid = ctx->FindRequestHeader("mh_uid");
-            if (mh_uid && std::string(mh_uid) != land_id) {
+            if (mh_uid && land_id != mh_uid) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_LAND,
                     "[PROTOLAND] Land ID mismatch - URI: %s, mh_uid: %s",
                     land_id.c_str(), mh_uid);
@@ -523,13 +674,13 @@ namespace tsto::land {
 
             const std::string method = ctx->GetMethod();
             if (method == "GET") {
-                handle_get_request(ctx, cb, land_id);
+                handle_get_request(loop, ctx, cb, land_id);
             }
             else if (method == "PUT") {
-                handle_put_request(ctx, cb);
+                handle_put_request(loop, ctx, cb);
             }
             else if (method == "POST") {
-                handle_post_request(ctx, cb);
+                handle_post_request(loop, ctx, cb);
             }
             else {
                 ctx->set_response_http_code(405);
@@ -545,62 +696,227 @@ namespace tsto::land {
         }
     }
 
-    void Land::handle_get_request(const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb, const std::string& land_id) {
-        if (!static_load_town()) {
-            create_blank_town();
+    server::async::task Land::handle_get_request(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb, std::string land_id) {
+        auto& cache = tsto::cache::SharedCache::get();
+        player p;
+        const bool resolved = resolve_player(ctx, p);
+        if (!cache.enabled() || !resolved) {
+            send_town(loop, ctx, cb, land_id, p, false);
+            co_return;
         }
 
-        logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_GAME, "[PROTOLAND] Sending land data for land_id: %s", land_id.c_str());
+        const std::string filename = p.town;
+        try {
+            const std::string user_id = co_await server::async::io(loop, [filename]() { return lookup_user_id(filename); });
+            apply_user_id(p, user_id);
+        }
+        catch (const std::exception& ex) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[PROTOLAND] Error: %s", ex.what());
+            ctx->set_response_http_code(500);
+            cb("");
+            co_return;
+        }
 
-        headers::set_protobuf_response(ctx);
-        std::string serialized;
-        tsto::Session::get().land_proto.SerializeToString(&serialized);
-        cb(serialized);
+        //answered from the loop once memcached replies, the store is only read on a miss
+        const uint64_t version = p.snapshot().version();
+        cache.get(loop, tsto::cache::kind::town, filename,
+            [loop, ctx, cb, land_id, p, version](bool hit, const std::string& data) {
+                try {
+                    //a town saved while memcached answered is newer than the copy it sent
+                    const auto& snapshot = p.snapshot();
+                    const bool loaded = snapshot.version() != version
+                        ? snapshot.holds(p.town)
+                        : hit && apply_town_data(p, data);
+                    if (loaded) {
+                        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+                            "[PROTOLAND] Town %s served from the shared cache", p.town.c_str());
+                    }
+                    send_town(loop, ctx, cb, land_id, p, loaded);
+                }
+                catch (const std::exception& ex) {
+                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                        "[PROTOLAND] Error: %s", ex.what());
+                    ctx->set_response_http_code(500);
+                    cb("");
+                }
+            });
     }
 
-    void Land::handle_put_request(const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
-        const evpp::Slice& body = ctx->body();
-        logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, "[PROTOLAND] Body size: %zu", body.size());
+    server::async::task Land::send_town(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb, std::string land_id, player p, bool loaded) {
+        try {
+            //the database and the store are read on the io pool, the town is only touched here
+            //the store can't hold anything newer than the town when nothing wrote it
+            //since it was loaded or saved. with the shared cache other servers may have
+            if (!loaded && !tsto::cache::SharedCache::get().enabled()
+                && p.snapshot().current(p.town, TownStore::revision(p.town))) {
+                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+                    "[LAND] Town %s unchanged since it was loaded, not reading it again", p.town.c_str());
+                loaded = true;
+            }
 
-        if (body.empty()) {
-            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME, "[PROTOLAND] Creating new empty town");
-            create_blank_town();
-            if (!save_town()) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] Failed to save empty town");
-                ctx->set_response_http_code(500);
-                cb("Failed to save empty town");
-                return;
+            if (!loaded && valid_town_filename(p.town)) {
+                const std::string filename = p.town;
+
+                //reads and saves of a town run in order, but a save prepared while the read ran is
+                //still newer than what it brings back. such a read is dropped, and read again
+                //when the session moved on to another town meanwhile
+                constexpr int max_reads = 3;
+                for (int attempt = 1; attempt <= max_reads; ++attempt) {
+                    const uint64_t version = p.snapshot().version();
+                    const town_read read = co_await server::async::io_ordered(loop, filename, [filename]() { return read_town(filename); });
+                    apply_user_id(p, read.user_id);
+
+                    if (p.snapshot().version() != version) {
+                        if (p.snapshot().holds(filename)) {
+                            loaded = true;
+                            break;
+                        }
+                        if (attempt < max_reads) {
+                            continue;
+                        }
+                    }
+
+                    if (!read.exists) {
+                        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME, "[LAND] No existing town found at towns/%s, creating new town", filename.c_str());
+                        create_blank_town(p);
+                        loaded = co_await save_town_async(loop, p);
+                    }
+                    else {
+                        loaded = apply_town_read(p, read);
+                    }
+                    break;
+                }
             }
+
+            if (!loaded) {
+                create_blank_town(p);
+            }
+
+            logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_GAME, "[PROTOLAND] Sending land data for land_id: %s", land_id.c_str());
+
+            headers::set_protobuf_response(ctx);
+
+            //a client that still has this version gets a 304 without the town
+            const std::string etag = p.snapshot().etag(p.proto());
+            if (!etag.empty()) {
+                ctx->AddResponseHeader("ETag", etag);
+                if (headers::etag_matches(ctx->FindRequestHeader("If-None-Match"), etag, true)) {
+                    ctx->set_response_http_code(304);
+                    cb("");
+                    co_return;
+                }
+            }
+
+            //the town is serialized (and compressed) once per change, not once per GET
+            static const bool gzip_town = utils::configuration::ReadBoolean("ServerConfig", "TownGzip", false);
+            if (gzip_town) {
+                ctx->AddResponseHeader("Vary", "Accept-Encoding");
+                const char* accept_encoding = ctx->FindRequestHeader("Accept-Encoding");
+                if (accept_encoding && std::string_view(accept_encoding).find("gzip") != std::string_view::npos) {
+                    if (const auto compressed = p.snapshot().gzip(p.proto())) {
+                        ctx->AddResponseHeader("Content-Encoding", "gzip");
+                        cb(*compressed);
+                        co_return;
+                    }
+                }
+            }
+
+            const auto serialized = p.snapshot().serialized(p.proto());
+            cb(serialized ? *serialized : std::string());
         }
-        else {
-            auto& session = tsto::Session::get();
-            if (!session.land_proto.ParseFromArray(body.data(), body.size())) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] Failed to parse request body");
+        catch (const std::exception& ex) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[PROTOLAND] Error: %s", ex.what());
+            ctx->set_response_http_code(500);
+            cb("");
+        }
+    }
+
+    server::async::task Land::handle_put_request(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb) {
+        try {
+            const evpp::Slice& body = ctx->body();
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME, "[PROTOLAND] Body size: %zu", body.size());
+
+            player p;
+            if (!resolve_player(ctx, p)) {
                 ctx->set_response_http_code(400);
-                cb("Failed to parse body");
-                return;
+                cb("Invalid town");
+                co_return;
+            }
+
+            //If-Match is compared with the town the store holds, which need not be the one loaded here
+            std::string stored_etag;
+            if (ctx->FindRequestHeader("If-Match")) {
+                stored_etag = co_await stored_etag_async(loop, p);
+            }
+
+            const save_check check = check_save(ctx, p, TownSnapshot::hash(std::string_view(body.data(), body.size())), stored_etag);
+            if (check == save_check::stale) {
+                ctx->set_response_http_code(412);
+                cb("Town changed since it was loaded");
+                co_return;
             }
 
-            if (!save_town()) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] Failed to save town data");
+            //a duplicate is answered with the town as it is, nothing is parsed or written
+            if (check == save_check::save) {
+                if (body.empty()) {
+                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME, "[PROTOLAND] Creating new empty town");
+                    create_blank_town(p);
+                }
+                else {
+                    const bool parsed = p.proto().ParseFromArray(body.data(), body.size());
+                    p.snapshot().invalidate();
+                    if (!parsed) {
+                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] Failed to parse request body");
+                        ctx->set_response_http_code(400);
+                        cb("Failed to parse body");
+                        co_return;
+                    }
+                }
+            }
+
+            //the reply is the town as saved, read before the save is waited on as the town may
+            //change again meanwhile
+            std::optional<decltype(save_town_async(loop, p))> save;
+            if (check == save_check::save) {
+                save.emplace(save_town_async(loop, p));
+            }
+            const std::string etag = p.snapshot().etag(p.proto());
+            const auto serialized = p.snapshot().serialized(p.proto());
+
+            if (save && !co_await *save) {
+                const char* message = body.empty() ? "Failed to save empty town" : "Failed to save town data";
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] %s", message);
                 ctx->set_response_http_code(500);
-                cb("Failed to save town data");
-                return;
+                cb(message);
+                co_return;
             }
-        }
 
-        headers::set_protobuf_response(ctx);
-        std::string serialized;
-        if (!tsto::Session::get().land_proto.SerializeToString(&serialized)) {
-            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] Failed to serialize response");
+            headers::set_protobuf_response(ctx);
+            ctx->AddResponseHeader("ETag", etag);
+            if (!serialized) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME, "[PROTOLAND] Failed to serialize response");
+                ctx->set_response_http_code(500);
+                cb("Failed to serialize response");
+                co_return;
+            }
+            cb(*serialized);
+        }
+        catch (const std::exception& ex) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[PROTOLAND] Error: %s", ex.what());
             ctx->set_response_http_code(500);
-            cb("Failed to serialize response");
-            return;
+            cb("");
         }
-        cb(serialized);
     }
 
-    void Land::handle_post_request(const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb) {
+    namespace {
+        const std::string whole_land_update_response = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+            "<WholeLandUpdateResponse/>";
+    }
+
+    server::async::task Land::handle_post_request(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb) {
         try {
             const char* auth_header = ctx->FindRequestHeader("mh_auth_params");
             if (!auth_header) {
@@ -608,60 +924,93 @@ namespace tsto::land {
                     "[PROTOLAND] Missing authentication token");
                 ctx->set_response_http_code(401);
                 cb("Authentication required");
-                return;
+                co_return;
             }
 
 
-            const std::string compressed_data = ctx->body().ToString();
+            //the body is read in the segments libevent received it in, never pulled up or copied
+            BodyInputStream body(ctx);
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                "[PROTOLAND] Received compressed data size: %zu", compressed_data.size());
+                "[PROTOLAND] Received compressed data size: %zu", ctx->body_size());
 
             std::string decompressed_data;
             const char* encoding = ctx->FindRequestHeader("Content-Encoding");
-            if (encoding && strcmp(encoding, "gzip") == 0) {
-                decompressed_data = utils::compression::zlib::decompress(compressed_data);
+            const bool gzip = encoding && strcmp(encoding, "gzip") == 0;
+            if (gzip) {
+                decompressed_data = utils::compression::zlib::decompress(body.views());
                 if (decompressed_data.empty()) {
                     logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                         "[PROTOLAND] Failed to decompress data");
                     ctx->set_response_http_code(400);
                     cb("Failed to decompress data");
-                    return;
+                    co_return;
                 }
             }
-            else {
-                decompressed_data = compressed_data;
+
+            player p;
+            if (!resolve_player(ctx, p)) {
+                ctx->set_response_http_code(400);
+                cb("Invalid town");
+                co_return;
             }
 
             auto& session = tsto::Session::get();
-            session.access_token = auth_header;
+            if (!p.forwarded) {
+                session.access_token = auth_header;
+            }
+
+            std::string stored_etag;
+            if (ctx->FindRequestHeader("If-Match")) {
+                stored_etag = co_await stored_etag_async(loop, p);
+            }
+
+            const save_check check = check_save(ctx, p,
+                gzip ? TownSnapshot::hash(decompressed_data) : TownSnapshot::hash(body.views()), stored_etag);
+            if (check == save_check::stale) {
+                ctx->set_response_http_code(412);
+                cb("Town changed since it was loaded");
+                co_return;
+            }
+            if (check == save_check::duplicate) {
+                ctx->AddResponseHeader("ETag", p.snapshot().etag(p.proto()));
+                ctx->AddResponseHeader("Content-Type", "application/xml");
+                cb(whole_land_update_response);
+                co_return;
+            }
 
-            if (!session.land_proto.ParseFromString(decompressed_data)) {
+            const bool parsed = gzip
+                ? p.proto().ParseFromString(decompressed_data)
+                : p.proto().ParseFromZeroCopyStream(&body);
+            if (parsed && !p.user_id.empty()) {
+                p.proto().set_id(p.user_id);
+            }
+            p.snapshot().invalidate();
+            if (!parsed) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                     "[PROTOLAND] Failed to parse decompressed data");
                 ctx->set_response_http_code(400);
                 cb("Failed to parse data");
-                return;
+                co_return;
             }
 
-            session.land_proto.set_id(session.user_user_id);
-
-            if (!save_town()) {
+            //the ETag is that of the town as saved, the town may change again while it is written
+            auto save = save_town_async(loop, p);
+            const std::string etag = p.snapshot().etag(p.proto());
+            if (!co_await save) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                     "[PROTOLAND] Failed to save land data");
                 ctx->set_response_http_code(500);
                 cb("Failed to save data");
-                return;
+                co_return;
             }
 
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
                 "[PROTOLAND] Successfully saved land data for user: %s",
-                session.user_user_id.c_str());
-
-            const std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
-                "<WholeLandUpdateResponse/>";
+                p.user_id.c_str());
 
+            ctx->AddResponseHeader("ETag", etag);
             ctx->AddResponseHeader("Content-Type", "application/xml");
-            cb(xml);
+            cb(whole_land_update_response);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
@@ -797,8 +1146,8 @@ namespace tsto::land {
     }
 
 
-    void Land::handle_extraland_update(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb, const std::string& land_id) {
+    server::async::task Land::handle_extraland_update(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb, std::string land_id) {
         try {
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
                 "[CURRENCY] Processing extraland update for land_id: %s", land_id.c_str());
@@ -809,78 +1158,32 @@ namespace tsto::land {
                 throw std::runtime_error("Failed to parse ExtraLandMessage");
             }
 
-            //grab the current session to access the email-based filename // this cud cause dementia
-            auto& session = tsto::Session::get();
-            std::string currency_path;
-            std::string user_identifier;
-
-            //check if we're using mytown.pb (non-logged in) or email-based town (logged in)
-            std::string current_town = session.town_filename.empty() ? "mytown.pb" : session.town_filename;
-            
-            if (current_town == "mytown.pb") {
-                //non logged in user - use currency.txt
-                currency_path = "towns/currency.txt";
-                user_identifier = "default";
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Using legacy currency file for non-logged in user");
-            } else {
-                //logged in user - use email-based currency file
-                std::string email_base = current_town;
-                size_t pb_pos = email_base.find(".pb");
-                if (pb_pos != std::string::npos) {
-                    email_base = email_base.substr(0, pb_pos);
-                }
-                size_t txt_pos = email_base.find(".txt");
-                if (txt_pos != std::string::npos) {
-                    email_base = email_base.substr(0, txt_pos);
-                }
-                currency_path = "towns/currency_" + email_base + ".txt";
-                user_identifier = email_base;
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Using email-based currency file for user: %s", email_base.c_str());
-            }
-            
-            std::filesystem::create_directories("towns");
-            
-            int balance = std::stoi(utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
-            if (std::filesystem::exists(currency_path)) {
-                std::ifstream input(currency_path);
-                if (input.good()) {
-                    input >> balance;
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                        "[CURRENCY] Loaded existing currency data for user: %s (Balance: %d)", 
-                        user_identifier.c_str(), balance);
-                }
-                input.close();
-            } else {
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Creating new currency file for user: %s with initial balance: %d", 
-                    user_identifier.c_str(), balance);
+            //the email-based filename of the session, or of the player a forwarded request names
+            player p;
+            if (!resolve_player(ctx, p)) {
+                ctx->set_response_http_code(400);
+                cb("Invalid town");
+                co_return;
             }
+            const std::string user_identifier = tsto::currency::CurrencyLedger::user_from_town(p.town);
 
-            int32_t total_earned = 0;
-            int32_t total_spent = 0;
-            Data::ExtraLandResponse response;
+            //the ledger waits for its group commit, that wait happens on the io pool
+            auto result = co_await server::async::io(loop, [&user_identifier, &extraland_msg]() {
+                return tsto::currency::CurrencyLedger::get_instance().apply_deltas(user_identifier, extraland_msg.currencydelta());
+            });
 
-            for (const auto& delta : extraland_msg.currencydelta()) {
-                if (delta.amount() > 0) {
-                    total_earned += delta.amount();
-                } else {
-                    total_spent += std::abs(delta.amount());  //absolute value for spent amount
-                }
-                
-                auto* processed = response.add_processedcurrencydelta();
-                processed->set_id(delta.id());
+            //nothing is acknowledged until the ledger has it, the client sends the deltas again
+            if (!result.committed) {
+                ctx->set_response_http_code(500);
+                cb("");
+                co_return;
             }
 
-            balance = balance + total_earned - total_spent;
-
-            std::ofstream output(currency_path);
-            if (!output.is_open()) {
-                throw std::runtime_error("Failed to open currency file for writing: " + currency_path);
+            Data::ExtraLandResponse response;
+            for (const auto id : result.processed_ids) {
+                auto* processed = response.add_processedcurrencydelta();
+                processed->set_id(id);
             }
-            output << balance;
-            output.close();
 
             headers::set_protobuf_response(ctx);
             std::string serialized;
@@ -891,8 +1194,9 @@ namespace tsto::land {
             }
 
             logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_GAME,
-                "[CURRENCY] Updated currency for user: %s (Balance: %d, Earned: %d, Spent: %d)",
-                user_identifier.c_str(), balance, total_earned, total_spent);
+                "[CURRENCY] Updated currency for user: %s (Balance: %lld, Earned: %lld, Spent: %lld, Retried: %zu)",
+                user_identifier.c_str(), static_cast<long long>(result.balance), static_cast<long long>(result.earned),
+                static_cast<long long>(result.spent), result.duplicates);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
@@ -934,8 +1238,6 @@ namespace tsto::land {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[LAND] Saving town as: %s", filename.c_str());
 
-            std::filesystem::create_directories("towns");
-
             if (!session.user_user_id.empty()) {
                 // Set the user ID in the land proto
                 session.land_proto.set_id(session.user_user_id);
@@ -959,19 +1261,17 @@ namespace tsto::land {
             if (!session.land_proto.SerializeToString(&serialized)) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                     "[LAND] Failed to serialize land proto");
+                session.land_snapshot.invalidate();
                 return false;
             }
+            const auto data = session.land_snapshot.set(std::move(serialized), email + ".pb");
 
-            std::ofstream file(filename, std::ios::binary);
-            if (!file.is_open()) {
+            if (!TownStore::get().save(email + ".pb", *data)) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                     "[LAND] Failed to open file for writing: %s", filename.c_str());
                 return false;
             }
 
-            file.write(serialized.data(), serialized.size());
-            file.close();
-
             // Store the user ID in the database if we have one
             if (!session.user_user_id.empty()) {
                 // Get the current access token from the session
@@ -993,13 +1293,13 @@ namespace tsto::land {
                         }
                     } else {
                         // Update the existing user record
-                        if (!db.store_user_id(email, session.user_user_id, access_token)) {
+                        if (!tsto::auth::Auth::store_user_id(email, session.user_user_id, access_token)) {
                             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                                 "[LAND] Failed to store user ID for email: %s", email.c_str());
                         }
                     }
                 } else {
-                    if (!db.store_user_id(email, session.user_user_id, access_token)) {
+                    if (!tsto::auth::Auth::store_user_id(email, session.user_user_id, access_token)) {
                         logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                             "[LAND] Failed to store user ID for email: %s", email.c_str());
                     }
@@ -1094,16 +1394,18 @@ namespace tsto::land {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[LAND] Importing town from %s to %s", source_path.c_str(), dest_path.c_str());
 
-            std::filesystem::copy_file(
-                source_path, 
-                dest_path,
-                std::filesystem::copy_options::overwrite_existing
-            );
+            std::string town_data;
+            if (!utils::io::read_file(source_path, &town_data) ||
+                !TownStore::get().save(std::filesystem::path(dest_path).filename().string(), town_data)) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[LAND] Failed to copy %s into town store", source_path.c_str());
+                return false;
+            }
             
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[LAND] File copied successfully");
             
-            if (std::filesystem::exists(dest_path)) {
+            if (TownStore::get().exists(std::filesystem::path(dest_path).filename().string())) {
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                     "[LAND] Target file exists after copy: %s", dest_path.c_str());
             } else {
@@ -1140,8 +1442,8 @@ namespace tsto::land {
         }
     }
 
-    void Land::handle_town_operations(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task Land::handle_town_operations(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                 "[TOWN OPS] Received request: RemoteIP: '%s', URI: '%s'",
@@ -1158,127 +1460,93 @@ namespace tsto::land {
                 headers::set_json_response(ctx);
                 ctx->set_response_http_code(400);
                 cb("{\"error\":\"Invalid JSON\"}");
-                return;
+                co_return;
             }
 
-            if (doc.HasMember("operation") && doc["operation"].IsString() && 
-                std::string(doc["operation"].GetString()) == "import") {
-                
+            if (!doc.HasMember("operation") || !doc["operation"].IsString() ||
+                std::string(doc["operation"].GetString()) != "import") {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[TOWN OPS] Unknown operation");
+                headers::set_json_response(ctx);
+                ctx->set_response_http_code(400);
+                cb("{\"error\":\"Unknown operation\"}");
+                co_return;
+            }
+
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                "[TOWN OPS] Processing import operation");
+
+            std::string email;
+            if (doc.HasMember("email") && doc["email"].IsString()) {
+                email = doc["email"].GetString();
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                    "[TOWN OPS] Processing import operation");
-                
-                std::string email;
-                if (doc.HasMember("email") && doc["email"].IsString()) {
-                    email = doc["email"].GetString();
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Email provided: %s", email.c_str());
-                } else {
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] No email provided, using default filename");
-                }
-                
-                if (!doc.HasMember("filePath") || !doc["filePath"].IsString()) {
-                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Missing filePath in import request");
-                    headers::set_json_response(ctx);
-                    ctx->set_response_http_code(400);
-                    cb("{\"error\":\"Missing filePath\"}");
-                    return;
-                }
-                
-                std::string temp_file_path = doc["filePath"].GetString();
+                    "[TOWN OPS] Email provided: %s", email.c_str());
+            } else {
                 logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                    "[TOWN OPS] Temp file path: %s", temp_file_path.c_str());
-                
-                if (!std::filesystem::exists("towns")) {
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Creating towns directory");
-                    std::filesystem::create_directory("towns");
-                }
+                    "[TOWN OPS] No email provided, using default filename");
+            }
 
-                std::string target_file;
-                std::string currency_email;
-                
-                if (email.empty()) {
-                    target_file = "towns/mytown.pb";
-                    currency_email = "default";
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] No email provided, using default filename in towns directory: %s", target_file.c_str());
-                } else {
-                    target_file = "towns/" + email + ".pb";
-                    currency_email = email;
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Using email-based filename: %s", target_file.c_str());
-                }
-                
-                logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                    "[TOWN OPS] Target file path: %s", target_file.c_str());
-                
-                try {
-                    if (!std::filesystem::exists(temp_file_path)) {
-                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                            "[TOWN OPS] Source file does not exist: %s", temp_file_path.c_str());
-                        headers::set_json_response(ctx);
-                        ctx->set_response_http_code(500);
-                        cb("{\"error\":\"Source file not found\"}");
-                        return;
-                    }
-                    
-                    std::filesystem::path cwd = std::filesystem::current_path();
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Current working directory: %s", cwd.string().c_str());
-                    
-                    std::filesystem::path target_path(target_file);
-                    std::filesystem::path parent_path = target_path.parent_path();
-                    if (!parent_path.empty() && !std::filesystem::exists(parent_path)) {
-                        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                            "[TOWN OPS] Creating parent directory: %s", parent_path.string().c_str());
-                        std::filesystem::create_directories(parent_path);
-                    }
-                    
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Copying from %s to %s", temp_file_path.c_str(), target_file.c_str());
-                    
-                    std::filesystem::copy_file(
-                        temp_file_path, 
-                        target_file,
-                        std::filesystem::copy_options::overwrite_existing
-                    );
-                    
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] File copied successfully");
-                    
-                    if (std::filesystem::exists(target_file)) {
+            if (!doc.HasMember("filePath") || !doc["filePath"].IsString()) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[TOWN OPS] Missing filePath in import request");
+                headers::set_json_response(ctx);
+                ctx->set_response_http_code(400);
+                cb("{\"error\":\"Missing filePath\"}");
+                co_return;
+            }
+
+            std::string temp_file_path = doc["filePath"].GetString();
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                "[TOWN OPS] Temp file path: %s", temp_file_path.c_str());
+
+            //"default" is the currency of mytown.pb
+            const std::string town = email.empty() ? "mytown.pb" : email + ".pb";
+            const std::string currency_email = email.empty() ? "default" : email;
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                "[TOWN OPS] Target file path: towns/%s", town.c_str());
+
+            //the copy goes after the loads and saves of the same town already queued. the error, or
+            //empty once the town is imported
+            const std::string error = co_await server::async::io_ordered(loop, town,
+                [temp_file_path, town, currency_email]() -> std::string {
+                    try {
+                        if (!std::filesystem::exists(temp_file_path)) {
+                            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                                "[TOWN OPS] Source file does not exist: %s", temp_file_path.c_str());
+                            return "Source file not found";
+                        }
+
+                        std::string town_data;
+                        if (!utils::io::read_file(temp_file_path, &town_data) || !TownStore::get().save(town, town_data)) {
+                            throw std::runtime_error("failed to write town into store");
+                        }
                         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                            "[TOWN OPS] Target file exists after copy: %s", target_file.c_str());
-                    } else {
-                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                            "[TOWN OPS] Target file does not exist after copy: %s", target_file.c_str());
-                    }
-                    
-                    std::filesystem::remove(temp_file_path);
-                    
-                    if (!currency_email.empty()) {
+                            "[TOWN OPS] Copied %s to towns/%s", temp_file_path.c_str(), town.c_str());
+
+                        std::filesystem::remove(temp_file_path);
+
                         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
                             "[TOWN OPS] Creating currency file for email: %s", currency_email.c_str());
                         create_default_currency_file(currency_email);
+                        return {};
                     }
-                    
-                    logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Town file imported successfully: %s", target_file.c_str());
-                    
-                    headers::set_json_response(ctx);
-                    cb("{\"success\":true,\"message\":\"Town imported successfully\"}");
-                } catch (const std::exception& ex) {
-                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                        "[TOWN OPS] Failed to import town file: %s", ex.what());
-                    headers::set_json_response(ctx);
-                    ctx->set_response_http_code(500);
-                    cb("{\"error\":\"Failed to import town file: " + std::string(ex.what()) + "\"}");
-                }
-                return;
+                    catch (const std::exception& ex) {
+                        logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                            "[TOWN OPS] Failed to import town file: %s", ex.what());
+                        return "Failed to import town file: " + std::string(ex.what());
+                    }
+                });
+
+            headers::set_json_response(ctx);
+            if (!error.empty()) {
+                ctx->set_response_http_code(500);
+                cb("{\"error\":\"" + error + "\"}");
+                co_return;
             }
 
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                "[TOWN OPS] Town file imported successfully: towns/%s", town.c_str());
+            cb("{\"success\":true,\"message\":\"Town imported successfully\"}");
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
@@ -1298,57 +1566,18 @@ namespace tsto::land {
         }
         
         logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-            "[CURRENCY] Creating default currency file for email: %s", email.c_str());
-        
-        if (!std::filesystem::exists("towns")) {
-            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                "[CURRENCY] Creating towns directory");
-            std::filesystem::create_directory("towns");
-        }
+            "[CURRENCY] Creating default currency for email: %s", email.c_str());
         
         int default_donuts = std::stoi(utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
         
-        std::string currency_file;
-        if (email == "default") {
-            currency_file = "towns/currency.txt"; //mytown.pb, use currency.txt
-        } else {
-            currency_file = "towns/" + email + ".txt"; //email.pb, use email.txt
-        }
-        
-        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-            "[CURRENCY] Currency file path: %s", currency_file.c_str());
-        
-        std::filesystem::path cwd = std::filesystem::current_path();
-        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-            "[CURRENCY] Current working directory: %s", cwd.string().c_str());
-        
-        std::filesystem::path currency_path(currency_file);
-        std::filesystem::path parent_path = currency_path.parent_path();
-        if (!parent_path.empty() && !std::filesystem::exists(parent_path)) {
-            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                "[CURRENCY] Creating parent directory: %s", parent_path.string().c_str());
-            std::filesystem::create_directories(parent_path);
-        }
-        
         try {
-            std::ofstream out(currency_file);
-            if (!out.is_open()) {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Failed to open currency file for writing: %s", currency_file.c_str());
-                return;
-            }
-            
-            out << default_donuts;
-            out.close();
-            
-            if (std::filesystem::exists(currency_file)) {
-                logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Currency file created successfully: %s with %d donuts", 
-                    currency_file.c_str(), default_donuts);
-            } else {
-                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Currency file does not exist after creation: %s", currency_file.c_str());
-            }
+            //"default" is the mytown.pb user
+            const std::string user = tsto::currency::CurrencyLedger::user_from_town(email == "default" ? "" : email);
+            tsto::currency::CurrencyLedger::get_instance().set_balance(user, default_donuts);
+
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Currency created successfully for %s with %d donuts", 
+                user.c_str(), default_donuts);
         } catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
                 "[CURRENCY] Exception creating currency file: %s", ex.what());
@@ -8,19 +8,51 @@
 #include "tsto_server.hpp"
 #include "tsto/includes/session.hpp"
 #include "LandData.pb.h"
+#include "async/task.hpp"
 #include <evpp/http/context.h>
 
 namespace tsto::land {
     class Land {
     public:
+        //a town and the snapshot of its bytes
+        struct town_state {
+            Data::LandMessage proto;
+            TownSnapshot snapshot;
+        };
+
+        //the player a request is for. one forwarded by another node (dispatcher/town_router) names
+        //its player in headers, since this node's session belongs to whoever logged in here.
+        //anything else is for the session's player
+        struct player {
+            std::string town;       //town filename
+            std::string user_id;    //empty when the forwarding node did not know it
+            bool forwarded = false;
+
+            //a forwarded player's town, read for the request. forwarded requests come in on any
+            //worker loop, so they never touch the session's town
+            std::shared_ptr<town_state> own_town;
+
+            //the town the request works on, the session's unless forwarded
+            Data::LandMessage& proto() const;
+            TownSnapshot& snapshot() const;
+        };
+
+        //false when the town named is not a town filename
+        static bool resolve_player(const evpp::http::ContextPtr& ctx, player& p);
+        static player session_player();
+
         static void handle_proto_whole_land_token(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
         static void handle_protoland(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
-        static void handle_tutorial_land(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
-        static void handle_extraland_update(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb, const std::string& land_id);
+        static server::async::task handle_extraland_update(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb, std::string land_id);
         static void handle_delete_token(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
-        static void handle_town_operations(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
+        static server::async::task handle_town_operations(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
         static bool save_town();
         static bool static_load_town();
+
+        //save_town for coroutine handlers: the town is serialized now, on the loop, and written
+        //to the store and database on the io pool, after the loads and saves of the same town
+        //queued before it. co_await gives save_town's result
+        static auto save_town_async(evpp::EventLoop* loop, const player& p = session_player());
         static bool load_town_by_email(const std::string& email);
         static bool save_town_as(const std::string& email);
         static bool import_town_file(const std::string& source_path, const std::string& email);
@@ -36,11 +68,77 @@ namespace tsto::land {
         bool instance_save_town();
 
     private:
+        //a town read from the store on the io pool, applied to the session back on the loop
+        struct town_read {
+            std::string user_id;    //stored for the town's email, empty when there is none
+            bool exists = false;
+            bool loaded = false;
+            std::string data;
+            uint64_t revision = 0;  //TownStore::revision() from before the load
+        };
+
+        //what a save asks for against the town the session holds
+        enum class save_check {
+            save,
+            stale,      //If-Match names another version than the current one
+            duplicate,  //the store already holds exactly the body, e.g. a retried request
+        };
+
+        //a town serialized on the loop, written to the store on the io pool
+        struct town_write {
+            std::string filename;
+            std::string email;      //empty for mytown.pb
+            std::string user_id;
+            TownSnapshot::bytes data;   //shared with the town's snapshot
+            std::shared_ptr<town_state> own_town;   //player::own_town, null for the session's town
+        };
+
         std::string email_;
-        static void create_blank_town();
+        static void create_blank_town(const player& p = session_player());
         static bool validate_land_data(const Data::LandMessage& land_data);
-        static void handle_get_request(const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&, const std::string&);
-        static void handle_put_request(const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
-        static void handle_post_request(const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
+        static bool resolve_session_town(std::string& filename);
+        static void apply_user_id(player& p, const std::string& user_id);
+        static bool apply_town_data(const player& p, const std::string& buffer, std::optional<uint64_t> revision = std::nullopt);
+
+        //the blocking halves of static_load_town and save_town, safe to run off the loop
+        static std::string lookup_user_id(const std::string& filename);
+        static town_read read_town(const std::string& filename);
+        static bool write_town(const town_write& write);
+
+        static bool apply_town_read(const player& p, const town_read& read);
+        static bool prepare_town_write(town_write& write, const player& p);
+
+        //the file the session town is saved as
+        static std::string save_filename();
+        //the ETag of the town the store holds for p.town, read on the io pool after the saves of it
+        //queued before, unless p's snapshot is that town. empty when the store holds none
+        static auto stored_etag_async(evpp::EventLoop* loop, const player& p);
+        static std::string read_stored_etag(const std::string& filename, const TownSnapshot& snapshot);
+
+        //stored_etag is the ETag of the town the store holds, from stored_etag_async(), empty when
+        //it holds none or If-Match was not sent
+        static save_check check_save(const evpp::http::ContextPtr& ctx, const player& p, uint64_t body_hash,
+            const std::string& stored_etag);
+
+        static server::async::task handle_get_request(evpp::EventLoop*, evpp::http::ContextPtr, evpp::http::HTTPSendResponseCallback, std::string land_id);
+        static server::async::task send_town(evpp::EventLoop*, evpp::http::ContextPtr, evpp::http::HTTPSendResponseCallback, std::string land_id, player p, bool loaded);
+        static server::async::task handle_put_request(evpp::EventLoop*, evpp::http::ContextPtr, evpp::http::HTTPSendResponseCallback);
+        static server::async::task handle_post_request(evpp::EventLoop*, evpp::http::ContextPtr, evpp::http::HTTPSendResponseCallback);
     };
-}
\ No newline at end of file
+
+    inline auto Land::save_town_async(evpp::EventLoop* loop, const player& p) {
+        town_write write;
+        const bool prepared = prepare_town_write(write, p);
+        const std::string filename = write.filename;
+        return server::async::io_ordered(loop, filename, [prepared, write = std::move(write)]() {
+            return prepared && write_town(write);
+        });
+    }
+
+    inline auto Land::stored_etag_async(evpp::EventLoop* loop, const player& p) {
+        //own_town keeps a forwarded player's snapshot alive until the read is done
+        return server::async::io_ordered(loop, p.town, [filename = p.town, snapshot = &p.snapshot(), own_town = p.own_town]() {
+            return read_stored_etag(filename, *snapshot);
+        });
+    }
+}
@@ -0,0 +1,180 @@
+#include <std_include.hpp>
+#include "town_snapshot.hpp"
+#include <compression.hpp>
+#include <cryptography.hpp>
+#include <format>
+
+namespace tsto::land {
+
+    uint64_t TownSnapshot::version() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return version_;
+    }
+
+    void TownSnapshot::invalidate() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++version_;
+        source_.clear();
+        revision_.reset();
+        serialized_.reset();
+        gzip_.reset();
+        etag_.clear();
+    }
+
+    void TownSnapshot::loaded(const std::string& filename, std::string_view stored, std::optional<uint64_t> revision) {
+        const uint64_t stored_hash = hash(stored);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++version_;
+        source_ = filename;
+        source_hash_ = stored_hash;
+        revision_ = revision;
+        serialized_.reset();
+        gzip_.reset();
+        //the id set after parsing can make serialized() differ, the version is still the stored one
+        etag_ = etag_of(stored_hash);
+    }
+
+    TownSnapshot::bytes TownSnapshot::set(std::string data, const std::string& filename) {
+        const uint64_t stored_hash = hash(data);
+        auto shared = std::make_shared<const std::string>(std::move(data));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++version_;
+        source_ = filename;
+        source_hash_ = stored_hash;
+        revision_.reset();
+        serialized_ = shared;
+        gzip_.reset();
+        etag_ = etag_of(stored_hash);
+        return shared;
+    }
+
+    void TownSnapshot::written(const bytes& data, uint64_t revision) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (data && serialized_ == data) {
+            revision_ = revision;
+        }
+    }
+
+    void TownSnapshot::verified(const std::string& filename, uint64_t stored_hash, uint64_t revision) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!source_.empty() && source_ == filename && source_hash_ == stored_hash) {
+            revision_ = revision;
+        }
+    }
+
+    bool TownSnapshot::current(const std::string& filename, uint64_t revision) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !source_.empty() && source_ == filename && revision_ == revision;
+    }
+
+    bool TownSnapshot::holds(const std::string& filename, uint64_t stored_hash) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !source_.empty() && source_ == filename && source_hash_ == stored_hash;
+    }
+
+    bool TownSnapshot::holds(const std::string& filename) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !source_.empty() && source_ == filename;
+    }
+
+    std::string TownSnapshot::stored_etag(const std::string& filename, uint64_t revision) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (source_.empty() || source_ != filename || revision_ != revision) {
+            return {};
+        }
+        return etag_of(source_hash_);
+    }
+
+    std::string TownSnapshot::etag_of(uint64_t stored_hash) {
+        return std::format("\"{:016x}\"", stored_hash);
+    }
+
+    uint64_t TownSnapshot::hash(std::string_view data) {
+        return utils::cryptography::xxh64::compute(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    }
+
+    uint64_t TownSnapshot::hash(const std::vector<std::string_view>& segments) {
+        XXHash64 state(0);
+        for (const auto& segment : segments) {
+            state.add(segment.data(), segment.size());
+        }
+        return state.hash();
+    }
+
+    TownSnapshot::bytes TownSnapshot::serialized(const Data::LandMessage& town) {
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (serialized_) {
+                return serialized_;
+            }
+            version = version_;
+        }
+
+        std::string data;
+        if (!town.SerializeToString(&data)) {
+            return nullptr;
+        }
+        auto shared = std::make_shared<const std::string>(std::move(data));
+
+        //kept only when the town did not change while it was serialized
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (version_ == version && !serialized_) {
+            serialized_ = shared;
+        }
+        return shared;
+    }
+
+    TownSnapshot::bytes TownSnapshot::gzip(const Data::LandMessage& town) {
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (gzip_) {
+                return gzip_;
+            }
+            version = version_;
+        }
+
+        const bytes data = serialized(town);
+        if (!data) {
+            return nullptr;
+        }
+
+        std::string compressed = utils::compression::zlib::gzip(*data);
+        if (compressed.empty()) {
+            return nullptr;
+        }
+        auto shared = std::make_shared<const std::string>(std::move(compressed));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (version_ == version && !gzip_) {
+            gzip_ = shared;
+        }
+        return shared;
+    }
+
+    std::string TownSnapshot::etag(const Data::LandMessage& town) {
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!etag_.empty()) {
+                return etag_;
+            }
+            version = version_;
+        }
+
+        const bytes data = serialized(town);
+        if (!data) {
+            return {};
+        }
+        std::string tag = etag_of(hash(*data));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (version_ == version) {
+            etag_ = tag;
+        }
+        return tag;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "LandData.pb.h"
+
+namespace tsto::land {
+
+    //the serialized bytes of the session town, made at most once per version of it and shared
+    //by every response until the town changes. whoever changes land_proto calls invalidate() (or
+    //set() when it serialized the town itself), the buffers handed out before stay valid.
+    //the etag is a hash of the stored bytes, so it stays the same across restarts and servers
+    class TownSnapshot {
+    public:
+        using bytes = std::shared_ptr<const std::string>;
+
+        //goes up on every change of the town
+        uint64_t version() const;
+
+        //the town changed, drops the bytes of the previous version
+        void invalidate();
+
+        //the town was just parsed from stored, what the store holds for filename. revision is
+        //TownStore::revision() from before the read, when it is known
+        void loaded(const std::string& filename, std::string_view stored, std::optional<uint64_t> revision = std::nullopt);
+
+        //the town was just serialized to data and saved as filename, keeps that as the bytes of
+        //the new version
+        bytes set(std::string data, const std::string& filename);
+
+        //data, from set(), is what the store holds at revision, unless the town changed since
+        void written(const bytes& data, uint64_t revision);
+
+        //the town is still the one held, the store had stored_hash for filename at revision
+        void verified(const std::string& filename, uint64_t stored_hash, uint64_t revision);
+
+        //true when the town is filename as the store holds it at revision, so while that is the
+        //store's revision of filename it need not be read again
+        bool current(const std::string& filename, uint64_t revision) const;
+
+        //true when the town was parsed from, or saved as, the bytes hashed to stored_hash for
+        //filename and has not changed since, so loading or saving them again can be skipped
+        bool holds(const std::string& filename, uint64_t stored_hash) const;
+
+        //true when the town was loaded from or saved as filename and has not changed since
+        bool holds(const std::string& filename) const;
+
+        //hash of a town's bytes for holds(), also over a request body still in segments
+        static uint64_t hash(std::string_view data);
+        static uint64_t hash(const std::vector<std::string_view>& segments);
+
+        //the town's bytes, serialized now when this version has none yet. null when it does not
+        //serialize
+        bytes serialized(const Data::LandMessage& town);
+
+        //serialized() gzip compressed, also made once per version. null when compression fails
+        bytes gzip(const Data::LandMessage& town);
+
+        //the ETag header of the town: the stored bytes' etag_of() while it is the stored town, else
+        //that of serialized(). empty when the town does not serialize
+        std::string etag(const Data::LandMessage& town);
+
+        //etag() of the town filename holds at revision, empty when the town held is not that one
+        std::string stored_etag(const std::string& filename, uint64_t revision) const;
+
+        //quoted hash of stored bytes, what etag() gives for a town loaded from or saved as them
+        static std::string etag_of(uint64_t stored_hash);
+
+    private:
+        mutable std::mutex mutex_;
+        uint64_t version_ = 1;
+        std::string source_;            //filename the town was loaded from or saved as
+        uint64_t source_hash_ = 0;      //xxh64 of the bytes stored there
+        std::optional<uint64_t> revision_;  //TownStore::revision() of source_ those bytes are from
+        bytes serialized_;
+        bytes gzip_;
+        std::string etag_;
+    };
+}
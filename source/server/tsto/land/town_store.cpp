@@ -0,0 +1,653 @@
+#include <std_include.hpp>
+#include "town_store.hpp"
+#include "debugging/serverlog.hpp"
+#include "platform/platform.hpp"
+#include "tsto/cache/shared_cache.hpp"
+#include <configuration.hpp>
+#include <cryptography.hpp>
+#include <finally.hpp>
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace tsto::land {
+
+    namespace {
+        //record layout: magic | flags | key_size | value_size | checksum | key | value
+        constexpr uint32_t record_magic = 0x4B505354; //"TSPK"
+        constexpr uint32_t record_flag_tombstone = 1;
+        constexpr size_t record_header_size = 24;
+        constexpr uint32_t max_key_size = 4096;
+
+        struct record_header {
+            uint32_t magic;
+            uint32_t flags;
+            uint32_t key_size;
+            uint32_t value_size;
+            uint64_t checksum;
+        };
+        static_assert(sizeof(record_header) == record_header_size, "record header must be packed");
+
+        uint64_t record_checksum(const std::string& key, const char* value, size_t value_size) {
+            std::string buffer;
+            buffer.reserve(key.size() + value_size);
+            buffer.append(key);
+            buffer.append(value, value_size);
+            return utils::cryptography::xxh64::compute(buffer);
+        }
+
+        uint64_t record_size(uint32_t key_size, uint32_t value_size) {
+            return record_header_size + key_size + value_size;
+        }
+
+        bool valid_town_filename(const std::string& town_filename) {
+            return !town_filename.empty() && town_filename.size() <= max_key_size
+                && town_filename.find('/') == std::string::npos
+                && town_filename.find('\\') == std::string::npos
+                && town_filename.find("..") == std::string::npos;
+        }
+
+        //number of writes of each town so far
+        std::mutex revisions_mutex;
+        std::unordered_map<std::string, uint64_t> revisions;
+
+        void sync_file(FILE* file) {
+            std::fflush(file);
+#ifdef _WIN32
+            _commit(_fileno(file));
+#else
+            fsync(fileno(file));
+#endif
+        }
+    }
+
+    TownStore& TownStore::get() {
+        static std::unique_ptr<TownStore> instance = []() -> std::unique_ptr<TownStore> {
+            std::unique_ptr<TownStore> store;
+            const std::string backend = utils::configuration::ReadString("ServerConfig", "TownStore", "file");
+            if (backend == "packed") {
+                logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+                    "[TOWN STORE] Using packed town store");
+                store = std::make_unique<PackedTownStore>();
+            }
+            else {
+                if (backend != "file") {
+                    logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_GAME,
+                        "[TOWN STORE] Unknown store '%s', falling back to file store", backend.c_str());
+                }
+                store = std::make_unique<FileTownStore>();
+            }
+
+            if (tsto::cache::SharedCache::get().enabled()) {
+                store = std::make_unique<CachedTownStore>(std::move(store));
+            }
+            return store;
+        }();
+
+        return *instance;
+    }
+
+    uint64_t TownStore::revision(const std::string& town_filename) {
+        std::lock_guard<std::mutex> _(revisions_mutex);
+        const auto it = revisions.find(town_filename);
+        return it == revisions.end() ? 0 : it->second;
+    }
+
+    void TownStore::written(const std::string& town_filename) {
+        std::lock_guard<std::mutex> _(revisions_mutex);
+        ++revisions[town_filename];
+    }
+
+    size_t TownStore::migrate(TownStore& from, TownStore& to) {
+        size_t migrated = 0;
+
+        for (const auto& town_filename : from.list()) {
+            std::string data;
+            if (!from.load(town_filename, data)) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[TOWN STORE] Failed to read %s from %s store", town_filename.c_str(), from.name());
+                continue;
+            }
+
+            if (!to.save(town_filename, data)) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[TOWN STORE] Failed to write %s to %s store", town_filename.c_str(), to.name());
+                continue;
+            }
+
+            migrated++;
+        }
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+            "[TOWN STORE] Migrated %zu towns from %s store to %s store", migrated, from.name(), to.name());
+        return migrated;
+    }
+
+    CachedTownStore::CachedTownStore(std::unique_ptr<TownStore> backend)
+        : backend_(std::move(backend)) {
+    }
+
+    //reads stay on the backend, the protoland GET path asks the cache first without blocking
+    bool CachedTownStore::load(const std::string& town_filename, std::string& data) {
+        return backend_->load(town_filename, data);
+    }
+
+    bool CachedTownStore::save(const std::string& town_filename, const std::string& data) {
+        if (!backend_->save(town_filename, data)) {
+            //whatever is cached may no longer match the store
+            tsto::cache::SharedCache::get().remove(tsto::cache::kind::town, town_filename);
+            return false;
+        }
+
+        tsto::cache::SharedCache::get().set(tsto::cache::kind::town, town_filename, data);
+        return true;
+    }
+
+    bool CachedTownStore::exists(const std::string& town_filename) {
+        return backend_->exists(town_filename);
+    }
+
+    bool CachedTownStore::remove(const std::string& town_filename) {
+        tsto::cache::SharedCache::get().remove(tsto::cache::kind::town, town_filename);
+        return backend_->remove(town_filename);
+    }
+
+    std::vector<std::string> CachedTownStore::list() {
+        return backend_->list();
+    }
+
+    FileTownStore::FileTownStore(std::string directory) : directory_(std::move(directory)) {
+        std::filesystem::create_directories(directory_);
+    }
+
+    bool FileTownStore::load(const std::string& town_filename, std::string& data) {
+        if (!valid_town_filename(town_filename)) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> _(mutex_);
+        std::ifstream file(std::filesystem::path(directory_) / town_filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        data.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool FileTownStore::save(const std::string& town_filename, const std::string& data) {
+        if (!valid_town_filename(town_filename)) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> _(mutex_);
+        const auto bump = utils::finally([&town_filename]() { written(town_filename); });
+        std::filesystem::create_directories(directory_);
+
+        //write next to the target and rename so a crash never leaves a half written town
+        const auto path = std::filesystem::path(directory_) / town_filename;
+        auto temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                return false;
+            }
+            file.write(data.data(), data.size());
+            if (!file.good()) {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        return !ec;
+    }
+
+    bool FileTownStore::exists(const std::string& town_filename) {
+        if (!valid_town_filename(town_filename)) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> _(mutex_);
+        return std::filesystem::exists(std::filesystem::path(directory_) / town_filename);
+    }
+
+    bool FileTownStore::remove(const std::string& town_filename) {
+        if (!valid_town_filename(town_filename)) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> _(mutex_);
+        const auto bump = utils::finally([&town_filename]() { written(town_filename); });
+        std::error_code ec;
+        return std::filesystem::remove(std::filesystem::path(directory_) / town_filename, ec);
+    }
+
+    std::vector<std::string> FileTownStore::list() {
+        std::lock_guard<std::mutex> _(mutex_);
+        std::vector<std::string> towns;
+
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".pb") {
+                towns.push_back(entry.path().filename().string());
+            }
+        }
+
+        std::sort(towns.begin(), towns.end());
+        return towns;
+    }
+
+    PackedTownStore::PackedTownStore(std::string directory, uint64_t max_segment_size, bool background_compaction)
+        : directory_(std::move(directory)), max_segment_size_(max_segment_size) {
+        std::filesystem::create_directories(directory_);
+
+        if (!recover()) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[TOWN STORE] Failed to recover packed store in %s", directory_.c_str());
+        }
+
+        if (background_compaction) {
+            compaction_thread_ = std::thread(&PackedTownStore::compaction_loop, this);
+        }
+    }
+
+    PackedTownStore::~PackedTownStore() {
+        {
+            std::lock_guard<std::mutex> _(mutex_);
+            stopping_ = true;
+        }
+        compaction_cv_.notify_all();
+
+        if (compaction_thread_.joinable()) {
+            compaction_thread_.join();
+        }
+
+        if (active_file_) {
+            std::fclose(active_file_);
+            active_file_ = nullptr;
+        }
+    }
+
+    std::string PackedTownStore::segment_path(uint32_t segment) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "segment_%06u.tsp", segment);
+        return (std::filesystem::path(directory_) / name).string();
+    }
+
+    bool PackedTownStore::recover() {
+        std::lock_guard<std::mutex> _(mutex_);
+
+        std::vector<uint32_t> segment_ids;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+            const std::string filename = entry.path().filename().string();
+            uint32_t segment = 0;
+            if (entry.is_regular_file() && std::sscanf(filename.c_str(), "segment_%06u.tsp", &segment) == 1) {
+                segment_ids.push_back(segment);
+            }
+        }
+        std::sort(segment_ids.begin(), segment_ids.end());
+
+        for (size_t i = 0; i < segment_ids.size(); i++) {
+            scan_segment(segment_ids[i], i + 1 == segment_ids.size());
+        }
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+            "[TOWN STORE] Recovered %zu towns from %zu segments", index_.size(), segment_ids.size());
+
+        return open_active_segment(segment_ids.empty() ? 1 : segment_ids.back());
+    }
+
+    bool PackedTownStore::scan_segment(uint32_t segment, bool is_last) {
+        const std::string path = segment_path(segment);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        const uint64_t file_size = std::filesystem::file_size(path);
+        auto& info = segments_[segment];
+        info.size = file_size;
+
+        uint64_t offset = 0;
+        std::string key;
+        std::string value;
+
+        while (offset < file_size) {
+            record_header header{};
+            bool valid = file_size - offset >= record_header_size
+                && file.read(reinterpret_cast<char*>(&header), record_header_size).good()
+                && header.magic == record_magic
+                && header.flags <= record_flag_tombstone
+                && header.key_size > 0 && header.key_size <= max_key_size
+                && offset + record_size(header.key_size, header.value_size) <= file_size;
+
+            if (valid) {
+                key.resize(header.key_size);
+                value.resize(header.value_size);
+                valid = file.read(key.data(), header.key_size).good()
+                    && file.read(value.data(), header.value_size).good()
+                    && record_checksum(key, value.data(), value.size()) == header.checksum;
+            }
+
+            if (!valid) {
+                if (is_last) {
+                    //torn write at the tail of the active segment, drop it
+                    file.close();
+                    std::filesystem::resize_file(path, offset);
+                    info.size = offset;
+                    logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_GAME,
+                        "[TOWN STORE] Truncated %llu trailing bytes from %s",
+                        static_cast<unsigned long long>(file_size - offset), path.c_str());
+                }
+                else {
+                    logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                        "[TOWN STORE] Corrupt record in %s at offset %llu, ignoring rest of segment",
+                        path.c_str(), static_cast<unsigned long long>(offset));
+                }
+                break;
+            }
+
+            const uint64_t size = record_size(header.key_size, header.value_size);
+
+            auto existing = index_.find(key);
+            if (existing != index_.end()) {
+                segments_[existing->second.segment].live_bytes -=
+                    record_size(existing->second.key_size, existing->second.value_size);
+            }
+
+            if (header.flags & record_flag_tombstone) {
+                if (existing != index_.end()) {
+                    index_.erase(existing);
+                }
+            }
+            else {
+                index_[key] = location{ segment, offset, header.key_size, header.value_size, header.checksum };
+                info.live_bytes += size;
+            }
+
+            offset += size;
+        }
+
+        return true;
+    }
+
+    bool PackedTownStore::open_active_segment(uint32_t segment) {
+        if (active_file_) {
+            std::fclose(active_file_);
+            active_file_ = nullptr;
+        }
+
+        active_file_ = std::fopen(segment_path(segment).c_str(), "ab");
+        if (!active_file_) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[TOWN STORE] Failed to open segment %s", segment_path(segment).c_str());
+            return false;
+        }
+
+        active_segment_ = segment;
+        segments_[segment];
+        return true;
+    }
+
+    bool PackedTownStore::append_record_locked(const std::string& key, const std::string& value, bool tombstone) {
+        const uint64_t size = record_size(static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size()));
+
+        if (!active_file_ || (segments_[active_segment_].size > 0 && segments_[active_segment_].size + size > max_segment_size_)) {
+            if (!open_active_segment(active_file_ ? active_segment_ + 1 : active_segment_)) {
+                return false;
+            }
+        }
+
+        record_header header{};
+        header.magic = record_magic;
+        header.flags = tombstone ? record_flag_tombstone : 0;
+        header.key_size = static_cast<uint32_t>(key.size());
+        header.value_size = static_cast<uint32_t>(value.size());
+        header.checksum = record_checksum(key, value.data(), value.size());
+
+        std::string record;
+        record.reserve(size);
+        record.append(reinterpret_cast<const char*>(&header), record_header_size);
+        record.append(key);
+        record.append(value);
+
+        auto& info = segments_[active_segment_];
+        if (std::fwrite(record.data(), 1, record.size(), active_file_) != record.size()) {
+            //recovery stops at the first torn record, so nothing may be appended after one: cut
+            //the segment back to its last whole record, or start a new segment when that fails
+            const uint32_t segment = active_segment_;
+            std::fclose(active_file_);
+            active_file_ = nullptr;
+
+            std::error_code ec;
+            std::filesystem::resize_file(segment_path(segment), info.size, ec);
+            if (ec) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[TOWN STORE] Failed to truncate torn record in %s: %s", segment_path(segment).c_str(), ec.message().c_str());
+            }
+            open_active_segment(ec ? segment + 1 : segment);
+            return false;
+        }
+        sync_file(active_file_);
+
+        const location loc{ active_segment_, info.size, header.key_size, header.value_size, header.checksum };
+        info.size += size;
+
+        auto existing = index_.find(key);
+        if (existing != index_.end()) {
+            segments_[existing->second.segment].live_bytes -=
+                record_size(existing->second.key_size, existing->second.value_size);
+        }
+
+        if (tombstone) {
+            if (existing != index_.end()) {
+                index_.erase(existing);
+            }
+        }
+        else {
+            index_[key] = loc;
+            info.live_bytes += size;
+        }
+
+        return true;
+    }
+
+    bool PackedTownStore::read_record_locked(const location& loc, std::string& value) {
+        std::ifstream file(segment_path(loc.segment), std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        std::string key(loc.key_size, '\0');
+        value.resize(loc.value_size);
+
+        file.seekg(static_cast<std::streamoff>(loc.offset + record_header_size));
+        if (!file.read(key.data(), key.size()).good() || !file.read(value.data(), value.size()).good()) {
+            return false;
+        }
+
+        return record_checksum(key, value.data(), value.size()) == loc.checksum;
+    }
+
+    bool PackedTownStore::load(const std::string& town_filename, std::string& data) {
+        std::lock_guard<std::mutex> _(mutex_);
+
+        const auto it = index_.find(town_filename);
+        if (it == index_.end()) {
+            return false;
+        }
+
+        if (!read_record_locked(it->second, data)) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                "[TOWN STORE] Checksum mismatch reading %s", town_filename.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool PackedTownStore::save(const std::string& town_filename, const std::string& data) {
+        if (!valid_town_filename(town_filename)) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> _(mutex_);
+        const auto bump = utils::finally([&town_filename]() { written(town_filename); });
+        return append_record_locked(town_filename, data, false);
+    }
+
+    bool PackedTownStore::exists(const std::string& town_filename) {
+        std::lock_guard<std::mutex> _(mutex_);
+        return index_.contains(town_filename);
+    }
+
+    bool PackedTownStore::remove(const std::string& town_filename) {
+        std::lock_guard<std::mutex> _(mutex_);
+        if (!index_.contains(town_filename)) {
+            return false;
+        }
+
+        const auto bump = utils::finally([&town_filename]() { written(town_filename); });
+        return append_record_locked(town_filename, {}, true);
+    }
+
+    std::vector<std::string> PackedTownStore::list() {
+        std::lock_guard<std::mutex> _(mutex_);
+        std::vector<std::string> towns;
+        towns.reserve(index_.size());
+
+        for (const auto& [town_filename, loc] : index_) {
+            if (town_filename.ends_with(".pb")) {
+                towns.push_back(town_filename);
+            }
+        }
+
+        std::sort(towns.begin(), towns.end());
+        return towns;
+    }
+
+    size_t PackedTownStore::compact(double min_live_ratio) {
+        std::vector<uint32_t> candidates;
+        {
+            std::lock_guard<std::mutex> _(mutex_);
+            for (const auto& [segment, info] : segments_) {
+                if (segment == active_segment_) {
+                    continue;
+                }
+                if (info.size == 0 || static_cast<double>(info.live_bytes) / static_cast<double>(info.size) < min_live_ratio) {
+                    candidates.push_back(segment);
+                }
+            }
+        }
+
+        size_t compacted = 0;
+        for (const auto segment : candidates) {
+            if (stopping_) {
+                break;
+            }
+            if (compact_segment(segment)) {
+                compacted++;
+            }
+        }
+
+        return compacted;
+    }
+
+    bool PackedTownStore::compact_segment(uint32_t segment) {
+        //sealed segments are immutable, so they can be scanned without holding the lock
+        const std::string path = segment_path(segment);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        const uint64_t file_size = std::filesystem::file_size(path);
+        uint64_t offset = 0;
+        size_t moved = 0;
+        std::string key;
+        std::string value;
+
+        while (offset + record_header_size <= file_size) {
+            record_header header{};
+            if (!file.read(reinterpret_cast<char*>(&header), record_header_size).good()
+                || header.magic != record_magic || header.key_size == 0 || header.key_size > max_key_size
+                || offset + record_size(header.key_size, header.value_size) > file_size) {
+                break;
+            }
+
+            key.resize(header.key_size);
+            value.resize(header.value_size);
+            if (!file.read(key.data(), header.key_size).good() || !file.read(value.data(), header.value_size).good()) {
+                break;
+            }
+
+            std::lock_guard<std::mutex> _(mutex_);
+            if (header.flags & record_flag_tombstone) {
+                //an older segment may still hold the deleted town, keep the tombstone until it is gone
+                if (!index_.contains(key) && segments_.begin()->first < segment) {
+                    if (!append_record_locked(key, value, true)) {
+                        return false;
+                    }
+                    moved++;
+                }
+            }
+            else {
+                const auto it = index_.find(key);
+                if (it != index_.end() && it->second.segment == segment && it->second.offset == offset) {
+                    if (!append_record_locked(key, value, false)) {
+                        return false;
+                    }
+                    moved++;
+                }
+            }
+
+            offset += record_size(header.key_size, header.value_size);
+        }
+        file.close();
+
+        std::lock_guard<std::mutex> _(mutex_);
+        for (const auto& [town_filename, loc] : index_) {
+            if (loc.segment == segment) {
+                //something was left behind, keep the segment around
+                return false;
+            }
+        }
+
+        segments_.erase(segment);
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_GAME,
+            "[TOWN STORE] Compacted %s, moved %zu records", path.c_str(), moved);
+        return true;
+    }
+
+    void PackedTownStore::compaction_loop() {
+        platform::set_thread_name("tsto-compact");
+        while (!stopping_) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                compaction_cv_.wait_for(lock, std::chrono::minutes(5), [this] { return stopping_.load(); });
+            }
+
+            if (stopping_) {
+                break;
+            }
+
+            try {
+                compact();
+            }
+            catch (const std::exception& ex) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_GAME,
+                    "[TOWN STORE] Compaction failed: %s", ex.what());
+            }
+        }
+    }
+}
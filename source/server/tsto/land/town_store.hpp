@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <cstdio>
+
+namespace tsto::land {
+
+    //backend for town blobs, keyed by town filename ("mytown.pb", "<email>.pb")
+    class TownStore {
+    public:
+        virtual ~TownStore() = default;
+
+        virtual bool load(const std::string& town_filename, std::string& data) = 0;
+        virtual bool save(const std::string& town_filename, const std::string& data) = 0;
+        virtual bool exists(const std::string& town_filename) = 0;
+        virtual bool remove(const std::string& town_filename) = 0;
+        virtual std::vector<std::string> list() = 0;
+        virtual const char* name() const = 0;
+
+        //store selected by ServerConfig.TownStore ("file" or "packed")
+        static TownStore& get();
+
+        //copies every town from one store into another, returns number of towns copied
+        static size_t migrate(TownStore& from, TownStore& to);
+
+        //goes up by one on every save or remove of the town in this process, 0 before the first.
+        //a town loaded at revision r is still what the store holds while this returns r
+        static uint64_t revision(const std::string& town_filename);
+
+    protected:
+        //called by the stores after every save and remove, also the failed ones
+        static void written(const std::string& town_filename);
+    };
+
+    //one file per town under towns/, the original layout
+    class FileTownStore : public TownStore {
+    public:
+        explicit FileTownStore(std::string directory = "towns");
+
+        bool load(const std::string& town_filename, std::string& data) override;
+        bool save(const std::string& town_filename, const std::string& data) override;
+        bool exists(const std::string& town_filename) override;
+        bool remove(const std::string& town_filename) override;
+        std::vector<std::string> list() override;
+        const char* name() const override { return "file"; }
+
+    private:
+        std::string directory_;
+        std::mutex mutex_;
+    };
+
+    //write-through wrapper used when the shared cache is on: saves refresh the cached copy and
+    //removes drop it, so other nodes reading through the cache see the same town as the store
+    class CachedTownStore : public TownStore {
+    public:
+        explicit CachedTownStore(std::unique_ptr<TownStore> backend);
+
+        bool load(const std::string& town_filename, std::string& data) override;
+        bool save(const std::string& town_filename, const std::string& data) override;
+        bool exists(const std::string& town_filename) override;
+        bool remove(const std::string& town_filename) override;
+        std::vector<std::string> list() override;
+        const char* name() const override { return backend_->name(); }
+
+    private:
+        std::unique_ptr<TownStore> backend_;
+    };
+
+    //log-structured store, towns appended to segment files with an in-memory index
+    class PackedTownStore : public TownStore {
+    public:
+        explicit PackedTownStore(std::string directory = "towns/packed",
+            uint64_t max_segment_size = 64ull * 1024 * 1024, bool background_compaction = true);
+        ~PackedTownStore() override;
+
+        bool load(const std::string& town_filename, std::string& data) override;
+        bool save(const std::string& town_filename, const std::string& data) override;
+        bool exists(const std::string& town_filename) override;
+        bool remove(const std::string& town_filename) override;
+        std::vector<std::string> list() override;
+        const char* name() const override { return "packed"; }
+
+        //rewrites sealed segments whose live ratio dropped below the threshold
+        size_t compact(double min_live_ratio = 0.5);
+
+    private:
+        struct location {
+            uint32_t segment;
+            uint64_t offset;       //start of the record header
+            uint32_t key_size;
+            uint32_t value_size;
+            uint64_t checksum;
+        };
+
+        struct segment_info {
+            uint64_t size = 0;
+            uint64_t live_bytes = 0;
+        };
+
+        bool recover();
+        bool scan_segment(uint32_t segment, bool is_last);
+        bool open_active_segment(uint32_t segment);
+        bool append_record_locked(const std::string& key, const std::string& value, bool tombstone);
+        bool read_record_locked(const location& loc, std::string& value);
+        bool compact_segment(uint32_t segment);
+        void compaction_loop();
+        std::string segment_path(uint32_t segment) const;
+
+        std::string directory_;
+        uint64_t max_segment_size_;
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, location> index_;
+        std::map<uint32_t, segment_info> segments_;
+        uint32_t active_segment_ = 0;
+        FILE* active_file_ = nullptr;
+
+        std::thread compaction_thread_;
+        std::condition_variable compaction_cv_;
+        std::atomic<bool> stopping_{ false };
+    };
+}
@@ -0,0 +1,411 @@
+#include <std_include.hpp>
+#include "telemetry_export.hpp"
+#include "debugging/serverlog.hpp"
+#include <configuration.hpp>
+#include <evpp/event_loop.h>
+#include <evpp/event_loop_thread.h>
+#include <evnsq/producer.h>
+#include <google/protobuf/util/json_util.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <future>
+#include "ClientTelemetry.pb.h"
+#include "ClientLog.pb.h"
+#include "ClientMetrics.pb.h"
+
+namespace tsto::tracking {
+
+    namespace {
+        //spill files are rotated at this size so a replayed file can be deleted soon
+        constexpr uint64_t spill_file_bytes = 4 * 1024 * 1024;
+
+        //batches replayed from disk per flush, keeps replay from starving fresh events
+        constexpr int replay_batches_per_flush = 4;
+
+        constexpr const char* spill_extension = ".ndjson";
+
+        const char* kind_name(telemetry_kind kind) {
+            switch (kind) {
+            case telemetry_kind::log: return "log";
+            case telemetry_kind::metrics: return "metrics";
+            case telemetry_kind::telemetry: return "telemetry";
+            case telemetry_kind::core_log: return "core_log";
+            case telemetry_kind::pin_events: return "pin_events";
+            }
+            return "unknown";
+        }
+
+        int64_t wall_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        template <typename Message>
+        bool proto_to_json(const std::string& body, std::string& json) {
+            Message message;
+            if (!message.ParseFromString(body)) {
+                return false;
+            }
+            return google::protobuf::util::MessageToJsonString(message, &json).ok();
+        }
+
+        //oldest first, the names start with the creation time
+        std::string oldest_spill_file(const std::string& dir) {
+            std::error_code ec;
+            std::string oldest;
+            for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                if (entry.path().extension() != spill_extension) {
+                    continue;
+                }
+                const std::string path = entry.path().string();
+                if (oldest.empty() || path < oldest) {
+                    oldest = path;
+                }
+            }
+            return oldest;
+        }
+    }
+
+    TelemetryExport& TelemetryExport::get() {
+        static TelemetryExport instance;
+        return instance;
+    }
+
+    TelemetryExport::TelemetryExport() {
+        const char* section = "ServerConfig";
+        nsqd_ = utils::configuration::ReadString(section, "TelemetryNsqd", "");
+        topic_ = utils::configuration::ReadString(section, "TelemetryTopic", "tsto_telemetry");
+        queue_limit_ = utils::configuration::ReadUnsignedInteger(section, "TelemetryQueueLimit", 10000);
+        batch_size_ = (std::max)(1u, utils::configuration::ReadUnsignedInteger(section, "TelemetryBatchSize", 100));
+        flush_ms_ = (std::max)(10u, utils::configuration::ReadUnsignedInteger(section, "TelemetryFlushMs", 200));
+        spill_dir_ = utils::configuration::ReadString(section, "TelemetrySpillDir", "telemetry_spill");
+        spill_limit_ = static_cast<uint64_t>(utils::configuration::ReadUnsignedInteger(section, "TelemetrySpillMaxMB", 64)) * 1024 * 1024;
+    }
+
+    TelemetryExport::~TelemetryExport() {
+        shutdown();
+    }
+
+    void TelemetryExport::start() {
+        if (!enabled() || thread_) {
+            return;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(spill_dir_, ec);
+        for (const auto& entry : std::filesystem::directory_iterator(spill_dir_, ec)) {
+            if (entry.path().extension() == spill_extension) {
+                spill_bytes_ += entry.file_size(ec);
+            }
+        }
+
+        thread_ = std::make_unique<evpp::EventLoopThread>();
+        thread_->set_name("TelemetryExport");
+        thread_->Start(true);
+
+        evnsq::Option option;
+        option.client_id = "tsto_server";
+        option.user_agent = "tsto_server/evnsq";
+        producer_ = std::make_unique<evnsq::Producer>(thread_->loop(), option);
+
+        //a batch nsqd refused, or that was in flight when the connection broke, goes to disk
+        producer_->SetPublishResultCallback([this](const evnsq::CommandPtr& cmd, bool successfull) {
+            if (successfull) {
+                published_.fetch_add(cmd->body().size(), std::memory_order_relaxed);
+            }
+            else {
+                spill(cmd->body());
+            }
+        });
+
+        thread_->loop()->RunInLoop([this]() {
+            producer_->ConnectToNSQDs(nsqd_);
+        });
+        thread_->loop()->RunEvery(evpp::Duration(static_cast<double>(flush_ms_) / 1000.0), [this]() {
+            flush();
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = true;
+        }
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_TRACKING,
+            "[TELEMETRY] Exporting to nsqd %s topic %s, %llu bytes left to replay from %s",
+            nsqd_.c_str(), topic_.c_str(), static_cast<unsigned long long>(spill_bytes_), spill_dir_.c_str());
+    }
+
+    void TelemetryExport::enqueue(telemetry_kind kind, const evpp::http::ContextPtr& ctx) {
+        if (!enabled()) {
+            return;
+        }
+
+        event e{ kind, wall_ms(), ctx->remote_ip(), ctx->body().ToString() };
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            //before start() or after shutdown() nothing would send or spill it
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (queue_.size() >= queue_limit_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        queue_.push_back(std::move(e));
+
+        //a full batch is sent right away instead of waiting for the flush timer
+        if (queue_.size() >= batch_size_ && !wake_pending_.exchange(true)) {
+            thread_->loop()->QueueInLoop([this]() {
+                flush();
+            });
+        }
+    }
+
+    void TelemetryExport::shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+        }
+
+        //the producer reports unacknowledged batches as failed while closing, they are spilled
+        //with the queue and sent by the next run
+        auto closed = std::make_shared<std::promise<void>>();
+        auto closed_future = closed->get_future();
+        thread_->loop()->RunInLoop([this, closed]() {
+            std::vector<event> pending;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending.swap(queue_);
+            }
+
+            std::vector<std::string> messages;
+            messages.reserve(pending.size());
+            for (const auto& e : pending) {
+                messages.push_back(encode(e));
+            }
+            spill(messages);
+
+            if (producer_->IsReady()) {
+                auto notified = std::make_shared<bool>(false);
+                producer_->SetCloseCallback([closed, notified]() {
+                    if (!*notified) {
+                        *notified = true;
+                        closed->set_value();
+                    }
+                });
+            }
+            else {
+                closed->set_value();
+            }
+            producer_->Close();
+        });
+
+        closed_future.wait_for(std::chrono::seconds(2));
+        thread_->Stop(true);
+
+        if (spill_out_.is_open()) {
+            spill_out_.close();
+        }
+
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_TRACKING,
+            "[TELEMETRY] Stopped, %llu published, %llu spilled, %llu dropped",
+            static_cast<unsigned long long>(published()), static_cast<unsigned long long>(spilled()),
+            static_cast<unsigned long long>(dropped()));
+    }
+
+    void TelemetryExport::flush() {
+        wake_pending_.store(false);
+
+        std::vector<event> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending.swap(queue_);
+        }
+
+        //decoding happens here and not in the handlers, so a request only pays for a copy
+        std::vector<std::string> messages;
+        messages.reserve((std::min)(pending.size(), batch_size_));
+        for (const auto& e : pending) {
+            messages.push_back(encode(e));
+            if (messages.size() == batch_size_) {
+                publish(messages);
+                messages.clear();
+            }
+        }
+        publish(messages);
+
+        replay();
+    }
+
+    void TelemetryExport::publish(std::vector<std::string>& messages) {
+        if (messages.empty()) {
+            return;
+        }
+
+        //not connected, or too many batches waiting for nsqd to answer
+        if (!producer_->IsReady() || !producer_->MultiPublish(topic_, messages)) {
+            spill(messages);
+        }
+    }
+
+    void TelemetryExport::rotate_spill() {
+        if (spill_out_.is_open()) {
+            spill_out_.close();
+        }
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "telemetry-%013lld-%06llu%s",
+            static_cast<long long>(wall_ms()), static_cast<unsigned long long>(spill_seq_++), spill_extension);
+        spill_out_path_ = (std::filesystem::path(spill_dir_) / name).string();
+        spill_out_.open(spill_out_path_, std::ios::binary | std::ios::app);
+        spill_out_bytes_ = 0;
+
+        if (!spill_out_.is_open()) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_TRACKING,
+                "[TELEMETRY] Cannot write %s", spill_out_path_.c_str());
+        }
+    }
+
+    void TelemetryExport::spill(const std::vector<std::string>& messages) {
+        size_t written = 0;
+        for (const auto& message : messages) {
+            const uint64_t size = message.size() + 1;
+            if (spill_bytes_ + size > spill_limit_) {
+                break;
+            }
+
+            if (!spill_out_.is_open() || spill_out_bytes_ >= spill_file_bytes) {
+                rotate_spill();
+                if (!spill_out_.is_open()) {
+                    break;
+                }
+            }
+
+            spill_out_.write(message.data(), static_cast<std::streamsize>(message.size()));
+            spill_out_.put('\n');
+            spill_out_bytes_ += size;
+            spill_bytes_ += size;
+            ++written;
+        }
+
+        if (written > 0) {
+            spill_out_.flush();
+            spilled_.fetch_add(written, std::memory_order_relaxed);
+        }
+
+        if (written < messages.size()) {
+            dropped_.fetch_add(messages.size() - written, std::memory_order_relaxed);
+            logger::write(logger::LOG_LEVEL_WARN, logger::LOG_LABEL_TRACKING,
+                "[TELEMETRY] Spill dir %s is full, dropped %zu events", spill_dir_.c_str(), messages.size() - written);
+        }
+    }
+
+    void TelemetryExport::replay() {
+        if (spill_bytes_ == 0 || !producer_->IsReady()) {
+            return;
+        }
+
+        for (int round = 0; round < replay_batches_per_flush; ++round) {
+            if (replay_path_.empty()) {
+                replay_path_ = oldest_spill_file(spill_dir_);
+                replay_offset_ = 0;
+                if (replay_path_.empty()) {
+                    spill_bytes_ = 0;
+                    return;
+                }
+
+                //stop appending to the file being replayed, new spills start a new one
+                if (replay_path_ == spill_out_path_) {
+                    spill_out_.close();
+                    spill_out_path_.clear();
+                }
+            }
+
+            std::ifstream in(replay_path_, std::ios::binary);
+            in.seekg(replay_offset_);
+
+            std::vector<std::string> messages;
+            std::streamoff offset = replay_offset_;
+            std::string line;
+            while (messages.size() < batch_size_ && std::getline(in, line)) {
+                offset += static_cast<std::streamoff>(line.size()) + 1;
+                if (!line.empty()) {
+                    messages.push_back(std::move(line));
+                }
+            }
+            const bool done = in.eof() || !in;
+
+            //nsqd is busy, the same lines are tried again on the next flush
+            if (!messages.empty() && !producer_->MultiPublish(topic_, messages)) {
+                return;
+            }
+            replay_offset_ = offset;
+
+            if (done) {
+                std::error_code ec;
+                const uint64_t size = std::filesystem::file_size(replay_path_, ec);
+                in.close();
+                std::filesystem::remove(replay_path_, ec);
+                spill_bytes_ -= (std::min)(spill_bytes_, ec ? 0 : size);
+                replay_path_.clear();
+            }
+        }
+    }
+
+    std::string TelemetryExport::encode(const event& e) const {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+        writer.StartObject();
+        writer.Key("kind");
+        writer.String(kind_name(e.kind));
+        writer.Key("received_ms");
+        writer.Int64(e.received_ms);
+        writer.Key("remote_ip");
+        writer.String(e.remote_ip.data(), static_cast<rapidjson::SizeType>(e.remote_ip.size()));
+        writer.Key("event");
+
+        std::string json;
+        bool decoded = false;
+        switch (e.kind) {
+        case telemetry_kind::log:
+            decoded = proto_to_json<com::ea::simpsons::client::log::ClientLogMessage>(e.body, json);
+            break;
+        case telemetry_kind::metrics:
+            decoded = proto_to_json<com::ea::simpsons::client::metrics::ClientMetricsMessage>(e.body, json);
+            break;
+        case telemetry_kind::telemetry:
+            decoded = proto_to_json<com::ea::simpsons::client::telemetry::ClientTelemetryMessage>(e.body, json);
+            break;
+        case telemetry_kind::core_log:
+        case telemetry_kind::pin_events: {
+            //re-written rather than embedded so the line never contains a raw newline
+            rapidjson::Document doc;
+            if (!doc.Parse(e.body.data(), e.body.size()).HasParseError()) {
+                doc.Accept(writer);
+            }
+            else {
+                writer.String(e.body.data(), static_cast<rapidjson::SizeType>(e.body.size()));
+            }
+            writer.EndObject();
+            return std::string(buffer.GetString(), buffer.GetSize());
+        }
+        }
+
+        if (decoded) {
+            writer.RawValue(json.data(), json.size(), rapidjson::kObjectType);
+        }
+        else {
+            writer.Null();
+        }
+        writer.EndObject();
+        return std::string(buffer.GetString(), buffer.GetSize());
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <evpp/http/context.h>
+
+namespace evpp {
+    class EventLoopThread;
+}
+
+namespace evnsq {
+    class Producer;
+}
+
+namespace tsto::tracking {
+
+    enum class telemetry_kind {
+        log,                //ClientLogMessage protobuf
+        metrics,            //ClientMetricsMessage protobuf
+        telemetry,          //ClientTelemetryMessage protobuf
+        core_log,           //json
+        pin_events          //json
+    };
+
+    //ships what the tracking handlers receive to nsqd, off unless ServerConfig.TelemetryNsqd is
+    //set to "host:port[,host:port]". handlers only copy the raw body into a bounded queue, a
+    //publisher thread decodes it to json and sends it in MPUB batches. when nsqd is down, slow
+    //or refuses a batch the events go to ndjson files in TelemetrySpillDir and are replayed
+    //once it is back, so delivery is at least once. events are only dropped (and counted) when
+    //both the queue and the spill dir are full, or when they arrive before start() or after
+    //shutdown().
+    class TelemetryExport {
+    public:
+        static TelemetryExport& get();
+        ~TelemetryExport();
+
+        bool enabled() const { return !nsqd_.empty(); }
+
+        //connects to nsqd and replays files spilled by a previous run
+        void start();
+
+        //never blocks on nsqd or the disk, only on the queue mutex
+        void enqueue(telemetry_kind kind, const evpp::http::ContextPtr& ctx);
+
+        //spills whatever is still queued or unacknowledged, then stops the publisher
+        void shutdown();
+
+        uint64_t published() const { return published_.load(std::memory_order_relaxed); }
+        uint64_t spilled() const { return spilled_.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        struct event {
+            telemetry_kind kind;
+            int64_t received_ms;
+            std::string remote_ip;
+            std::string body;
+        };
+
+        TelemetryExport();
+        TelemetryExport(const TelemetryExport&) = delete;
+        TelemetryExport& operator=(const TelemetryExport&) = delete;
+
+        //everything below runs on the publisher thread
+        void flush();
+        void publish(std::vector<std::string>& messages);
+        void spill(const std::vector<std::string>& messages);
+        void replay();
+        void rotate_spill();
+        std::string encode(const event& e) const;
+
+        std::string nsqd_;
+        std::string topic_;
+        size_t queue_limit_ = 0;
+        size_t batch_size_ = 0;
+        uint32_t flush_ms_ = 0;
+        std::string spill_dir_;
+        uint64_t spill_limit_ = 0;
+
+        std::mutex mutex_;
+        std::vector<event> queue_;
+        bool running_ = false;
+        std::atomic<bool> wake_pending_{ false };
+
+        std::unique_ptr<evpp::EventLoopThread> thread_;
+        std::unique_ptr<evnsq::Producer> producer_;
+
+        std::ofstream spill_out_;
+        std::string spill_out_path_;
+        uint64_t spill_out_bytes_ = 0;
+        uint64_t spill_bytes_ = 0;         //every file in spill_dir_, including spill_out_
+        uint64_t spill_seq_ = 0;
+        std::string replay_path_;
+        std::streamoff replay_offset_ = 0;
+
+        std::atomic<uint64_t> published_{ 0 };
+        std::atomic<uint64_t> spilled_{ 0 };
+        std::atomic<uint64_t> dropped_{ 0 };
+    };
+}
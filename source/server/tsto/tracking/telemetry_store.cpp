@@ -0,0 +1,718 @@
+#include <std_include.hpp>
+#include "telemetry_store.hpp"
+#include "debugging/serverlog.hpp"
+#include "headers/response_headers.hpp"
+#include <configuration.hpp>
+#include <evpp/event_loop.h>
+#include <evpp/event_loop_thread.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <cmath>
+#include <future>
+#include <limits>
+#include "ClientTelemetry.pb.h"
+
+namespace tsto::tracking {
+
+    namespace {
+        constexpr uint32_t no_slot = 0xFFFFFFFFu;
+        constexpr size_t max_string_length = 64;
+
+        using telemetry_message = com::ea::simpsons::client::telemetry::ClientTelemetryMessage;
+
+        //every column with its file name, the same order for writing and reading
+        template <typename Columns, typename F>
+        void for_each_column(Columns& c, F&& f) {
+            f("received_ms", c.received_ms);
+            f("fps_min", c.fps_min);
+            f("fps_max", c.fps_max);
+            f("fps_average", c.fps_average);
+            f("touches", c.touches);
+            f("used_memory_max", c.used_memory_max);
+            f("free_memory_min", c.free_memory_min);
+            f("physical_memory", c.physical_memory);
+            f("dlc_downloaded_kb", c.dlc_downloaded_kb);
+            f("dlc_seconds", c.dlc_seconds);
+            f("dlc_crc_failed", c.dlc_crc_failed);
+            f("version", c.version);
+            f("platform", c.platform);
+        }
+
+        std::string column_path(const std::string& segment, const char* name) {
+            return (std::filesystem::path(segment) / (std::string(name) + ".col")).string();
+        }
+
+        //utc yyyymmddhh, segment directories sort by time
+        std::string hour_key(int64_t ms) {
+            const time_t seconds = static_cast<time_t>(ms / 1000);
+            tm gmtm{};
+#ifdef _WIN32
+            gmtime_s(&gmtm, &seconds);
+#else
+            gmtime_r(&seconds, &gmtm);
+#endif
+            char key[16];
+            std::strftime(key, sizeof(key), "%Y%m%d%H", &gmtm);
+            return key;
+        }
+
+        int64_t wall_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        //dictionary entries are one per line
+        std::string clean(const std::string& value) {
+            std::string out = value.substr(0, max_string_length);
+            for (char& c : out) {
+                if (c == '\n' || c == '\r') {
+                    c = ' ';
+                }
+            }
+            return out.empty() ? "unknown" : out;
+        }
+
+        std::string platform_from_user_agent(const char* user_agent) {
+            if (!user_agent) {
+                return "";
+            }
+            const std::string ua = user_agent;
+            if (ua.find("Android") != std::string::npos) {
+                return "android";
+            }
+            if (ua.find("iPhone") != std::string::npos || ua.find("iPad") != std::string::npos ||
+                ua.find("iOS") != std::string::npos) {
+                return "iphone";
+            }
+            return "";
+        }
+
+        template <typename T>
+        void append_file(const std::string& path, const std::vector<T>& values) {
+            std::ofstream out(path, std::ios::binary | std::ios::app);
+            out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+        }
+
+        template <typename T>
+        void read_file(const std::string& path, std::vector<T>& values) {
+            std::error_code ec;
+            const uint64_t size = std::filesystem::file_size(path, ec);
+            values.clear();
+            if (ec) {
+                return;
+            }
+            values.resize(static_cast<size_t>(size / sizeof(T)));
+            std::ifstream in(path, std::ios::binary);
+            in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+            values.resize(static_cast<size_t>(in.gcount()) / sizeof(T));
+        }
+
+        std::vector<std::string> read_dict(const std::string& path) {
+            std::vector<std::string> dict;
+            std::ifstream in(path, std::ios::binary);
+            std::string line;
+            while (std::getline(in, line)) {
+                dict.push_back(line);
+            }
+            return dict;
+        }
+
+        //only the named columns are read. a flush cut short leaves some columns longer than
+        //others, the extra rows are ignored
+        bool load_segment(const std::string& path, const std::vector<const char*>& wanted, TelemetryStore::columns& c) {
+            size_t rows = SIZE_MAX;
+            for_each_column(c, [&](const char* name, auto& values) {
+                if (std::find_if(wanted.begin(), wanted.end(), [name](const char* w) { return std::strcmp(w, name) == 0; }) == wanted.end()) {
+                    return;
+                }
+                read_file(column_path(path, name), values);
+                rows = (std::min)(rows, values.size());
+            });
+            if (rows == SIZE_MAX) {
+                return false;
+            }
+
+            for_each_column(c, [rows](const char*, auto& values) {
+                if (values.size() > rows) {
+                    values.resize(rows);
+                }
+            });
+            c.version_dict = read_dict((std::filesystem::path(path) / "version.dict").string());
+            c.platform_dict = read_dict((std::filesystem::path(path) / "platform.dict").string());
+            return true;
+        }
+
+        float percentile(std::vector<float>& values, double p) {
+            if (values.empty()) {
+                return 0.0f;
+            }
+            const size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+            std::nth_element(values.begin(), values.begin() + index, values.end());
+            return values[index];
+        }
+
+        enum class group_by {
+            none,
+            version,
+            platform
+        };
+
+        struct group_stats {
+            uint64_t sessions = 0;
+            uint64_t fps_samples = 0;
+            double fps_sum = 0;
+            std::vector<float> fps;
+            std::vector<float> fps_min;
+            int64_t touches = 0;
+            std::vector<float> used_memory_max;
+            uint64_t downloads = 0;
+            int64_t downloaded_kb = 0;
+            double download_seconds = 0;
+            int64_t crc_failed = 0;
+        };
+
+        struct scan_filter {
+            int64_t from_ms = 0;
+            int64_t to_ms = INT64_MAX;
+            group_by by = group_by::none;
+            std::string version;    //empty matches every version
+            std::string platform;
+        };
+
+        //maps the codes of one segment dictionary to group slots, no_slot when filtered out
+        std::vector<uint32_t> slots_for(const std::vector<std::string>& dict, bool grouped, const std::string& only,
+            std::map<std::string, group_stats>& groups, std::vector<group_stats*>& slots) {
+            //one extra entry for codes past the end of the dictionary (a torn write)
+            std::vector<uint32_t> mapping(dict.size() + 1, no_slot);
+            for (size_t code = 0; code <= dict.size(); ++code) {
+                const std::string& value = code < dict.size() ? dict[code] : std::string("unknown");
+                if (!only.empty() && value != only) {
+                    continue;
+                }
+                if (!grouped) {
+                    mapping[code] = 0;
+                    continue;
+                }
+                group_stats* g = &groups[value];
+                auto it = std::find(slots.begin(), slots.end(), g);
+                mapping[code] = static_cast<uint32_t>(it - slots.begin());
+                if (it == slots.end()) {
+                    slots.push_back(g);
+                }
+            }
+            return mapping;
+        }
+
+        //one pass over the rows: each row is given its group slot and added to that group at
+        //once, so the cost does not grow with the number of groups
+        void scan(const TelemetryStore::columns& c, const scan_filter& filter, std::map<std::string, group_stats>& groups) {
+            const size_t n = c.size();
+            if (n == 0) {
+                return;
+            }
+
+            std::vector<group_stats*> slots;
+            if (filter.by == group_by::none) {
+                slots.push_back(&groups["all"]);
+            }
+            const auto version_slots = slots_for(c.version_dict, filter.by == group_by::version, filter.version, groups, slots);
+            const auto platform_slots = slots_for(c.platform_dict, filter.by == group_by::platform, filter.platform, groups, slots);
+            const uint32_t version_max = static_cast<uint32_t>(c.version_dict.size());
+            const uint32_t platform_max = static_cast<uint32_t>(c.platform_dict.size());
+
+            const bool by_platform = filter.by == group_by::platform;
+            for (size_t i = 0; i < n; ++i) {
+                const uint32_t vs = version_slots[(std::min)(c.version[i], version_max)];
+                const uint32_t ps = platform_slots[(std::min)(c.platform[i], platform_max)];
+                if (c.received_ms[i] < filter.from_ms || c.received_ms[i] >= filter.to_ms || vs == no_slot || ps == no_slot) {
+                    continue;
+                }
+
+                group_stats& g = *slots[by_platform ? ps : vs];
+                g.sessions++;
+                g.touches += c.touches[i];
+                g.crc_failed += c.dlc_crc_failed[i];
+
+                //nan marks a value the client did not send, percentiles need the values themselves
+                if (c.fps_average[i] == c.fps_average[i]) {
+                    g.fps_samples++;
+                    g.fps_sum += c.fps_average[i];
+                    g.fps.push_back(c.fps_average[i]);
+                }
+                if (c.fps_min[i] == c.fps_min[i]) {
+                    g.fps_min.push_back(c.fps_min[i]);
+                }
+                if (c.used_memory_max[i] > 0) {
+                    g.used_memory_max.push_back(static_cast<float>(c.used_memory_max[i]));
+                }
+                if (c.dlc_downloaded_kb[i] > 0 && c.dlc_seconds[i] > 0.0f) {
+                    g.downloads++;
+                    g.downloaded_kb += c.dlc_downloaded_kb[i];
+                    g.download_seconds += c.dlc_seconds[i];
+                }
+            }
+        }
+
+        const std::vector<const char*> scan_columns = {
+            "received_ms", "fps_average", "fps_min", "touches", "used_memory_max",
+            "dlc_downloaded_kb", "dlc_seconds", "dlc_crc_failed", "version", "platform",
+        };
+
+        void write_groups(rapidjson::Writer<rapidjson::StringBuffer>& writer, std::map<std::string, group_stats>& groups) {
+            writer.StartArray();
+            for (auto& [key, g] : groups) {
+                if (g.sessions == 0) {
+                    continue;
+                }
+                writer.StartObject();
+                writer.Key("key");
+                writer.String(key.c_str());
+                writer.Key("sessions");
+                writer.Uint64(g.sessions);
+
+                writer.Key("fps_average");
+                writer.StartObject();
+                writer.Key("samples");
+                writer.Uint64(g.fps_samples);
+                writer.Key("mean");
+                writer.Double(g.fps_samples ? g.fps_sum / static_cast<double>(g.fps_samples) : 0.0);
+                writer.Key("p50");
+                writer.Double(percentile(g.fps, 0.50));
+                writer.Key("p95");
+                writer.Double(percentile(g.fps, 0.95));
+                writer.EndObject();
+
+                //the low tail is what players notice, so the minimum gets p5 as well
+                writer.Key("fps_min");
+                writer.StartObject();
+                writer.Key("p5");
+                writer.Double(percentile(g.fps_min, 0.05));
+                writer.Key("p50");
+                writer.Double(percentile(g.fps_min, 0.50));
+                writer.EndObject();
+
+                writer.Key("touches_mean");
+                writer.Double(static_cast<double>(g.touches) / static_cast<double>(g.sessions));
+                writer.Key("used_memory_max_p95");
+                writer.Double(percentile(g.used_memory_max, 0.95));
+
+                writer.Key("dlc");
+                writer.StartObject();
+                writer.Key("downloads");
+                writer.Uint64(g.downloads);
+                writer.Key("downloaded_kb");
+                writer.Int64(g.downloaded_kb);
+                writer.Key("seconds");
+                writer.Double(g.download_seconds);
+                writer.Key("kb_per_second");
+                writer.Double(g.download_seconds > 0 ? static_cast<double>(g.downloaded_kb) / g.download_seconds : 0.0);
+                writer.Key("crc_failures");
+                writer.Int64(g.crc_failed);
+                writer.EndObject();
+
+                writer.EndObject();
+            }
+            writer.EndArray();
+        }
+
+        uint32_t hours_param(const evpp::http::ContextPtr& ctx, uint32_t retention_hours) {
+            const std::string value = ctx->GetQuery("hours");
+            uint32_t hours = 24;
+            if (!value.empty()) {
+                hours = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+            }
+            return std::clamp(hours, 1u, (std::max)(1u, retention_hours));
+        }
+    }
+
+    TelemetryStore& TelemetryStore::get() {
+        static TelemetryStore instance;
+        return instance;
+    }
+
+    TelemetryStore::TelemetryStore() {
+        const char* section = "ServerConfig";
+        dir_ = utils::configuration::ReadString(section, "TelemetryStoreDir", "telemetry");
+        pending_limit_ = utils::configuration::ReadUnsignedInteger(section, "TelemetryStoreQueueLimit", 10000);
+        flush_seconds_ = (std::max)(1u, utils::configuration::ReadUnsignedInteger(section, "TelemetryStoreFlushSeconds", 5));
+        rollup_seconds_ = (std::max)(1u, utils::configuration::ReadUnsignedInteger(section, "TelemetryRollupSeconds", 60));
+        retention_hours_ = utils::configuration::ReadUnsignedInteger(section, "TelemetryStoreRetentionHours", 24 * 30);
+    }
+
+    TelemetryStore::~TelemetryStore() {
+        shutdown();
+    }
+
+    void TelemetryStore::start() {
+        if (!enabled() || thread_) {
+            return;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        if (ec) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_TRACKING,
+                "[TELEMETRY] Cannot create %s, the telemetry store is off: %s", dir_.c_str(), ec.message().c_str());
+            return;
+        }
+
+        thread_ = std::make_unique<evpp::EventLoopThread>();
+        thread_->set_name("TelemetryStore");
+        thread_->Start(true);
+        thread_->loop()->RunEvery(evpp::Duration(static_cast<double>(flush_seconds_)), [this]() {
+            flush();
+        });
+        thread_->loop()->RunEvery(evpp::Duration(static_cast<double>(rollup_seconds_)), [this]() {
+            rollup();
+            expire();
+        });
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+
+    void TelemetryStore::shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+        }
+
+        auto done = std::make_shared<std::promise<void>>();
+        auto done_future = done->get_future();
+        thread_->loop()->RunInLoop([this, done]() {
+            flush();
+            rollup();
+            done->set_value();
+        });
+        done_future.wait();
+        thread_->Stop(true);
+    }
+
+    void TelemetryStore::append(const telemetry_message& message, const evpp::http::ContextPtr& ctx) {
+        if (!enabled()) {
+            return;
+        }
+
+        const auto& client = message.clientprovidedtelemetry();
+        const auto& server = message.serverprovidedtelemetry();
+        const float missing = std::numeric_limits<float>::quiet_NaN();
+
+        row r;
+        r.received_ms = wall_ms();
+        r.fps_min = client.has_fps_min() ? client.fps_min() : missing;
+        r.fps_max = client.has_fps_max() ? client.fps_max() : missing;
+        r.fps_average = client.has_fps_average() ? client.fps_average() : missing;
+        r.touches = client.touchesduringsession();
+        r.used_memory_max = client.usedmemory().max();
+        r.free_memory_min = client.freememory().min();
+        r.physical_memory = client.physicalmemory();
+        r.dlc_downloaded_kb = static_cast<int64_t>(client.dlcinfo().sizedownloadedkb());
+        r.dlc_seconds = client.dlcinfo().downloadtimeseconds();
+        r.dlc_crc_failed = static_cast<int32_t>(client.dlcinfo().numpackagecrcchecksfailed());
+
+        //the client leaves the server block empty, fall back to what the request says
+        r.version = server.has_bgclientversion() ? server.bgclientversion() : server.mhclientversion();
+        r.platform = server.has_clientplatform() ? server.clientplatform() : platform_from_user_agent(ctx->FindRequestHeader("User-Agent"));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        if (pending_.size() >= pending_limit_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        pending_.push_back(std::move(r));
+    }
+
+    TelemetryStore::segment_writer& TelemetryStore::writer_for(const std::string& hour) {
+        auto it = writers_.find(hour);
+        if (it != writers_.end()) {
+            return it->second;
+        }
+
+        segment_writer& w = writers_[hour];
+        w.path = (std::filesystem::path(dir_) / hour).string();
+        std::error_code ec;
+        std::filesystem::create_directories(w.path, ec);
+
+        //cut every column back to the shortest one, so appends stay row aligned after a
+        //flush that was cut short
+        columns sizes;
+        size_t rows = SIZE_MAX;
+        for_each_column(sizes, [&](const char* name, auto& values) {
+            using value_type = typename std::decay_t<decltype(values)>::value_type;
+            const uint64_t size = std::filesystem::file_size(column_path(w.path, name), ec);
+            rows = (std::min)(rows, ec ? size_t(0) : static_cast<size_t>(size / sizeof(value_type)));
+        });
+        for_each_column(sizes, [&](const char* name, auto& values) {
+            using value_type = typename std::decay_t<decltype(values)>::value_type;
+            const std::string path = column_path(w.path, name);
+            if (std::filesystem::exists(path, ec)) {
+                std::filesystem::resize_file(path, rows * sizeof(value_type), ec);
+            }
+        });
+        w.rows = rows;
+
+        const auto versions = read_dict((std::filesystem::path(w.path) / "version.dict").string());
+        for (uint32_t i = 0; i < versions.size(); ++i) {
+            w.version_codes.emplace(versions[i], i);
+        }
+        const auto platforms = read_dict((std::filesystem::path(w.path) / "platform.dict").string());
+        for (uint32_t i = 0; i < platforms.size(); ++i) {
+            w.platform_codes.emplace(platforms[i], i);
+        }
+        return w;
+    }
+
+    void TelemetryStore::flush() {
+        std::vector<row> rows;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rows.swap(pending_);
+        }
+        if (rows.empty()) {
+            return;
+        }
+
+        //rows arrive in time order, so a flush touches one segment, two around the hour
+        size_t begin = 0;
+        while (begin < rows.size()) {
+            const std::string hour = hour_key(rows[begin].received_ms);
+            size_t end = begin + 1;
+            while (end < rows.size() && hour_key(rows[end].received_ms) == hour) {
+                ++end;
+            }
+
+            segment_writer& w = writer_for(hour);
+            columns batch;
+            std::string new_versions;
+            std::string new_platforms;
+            auto code_of = [](std::unordered_map<std::string, uint32_t>& codes, const std::string& value, std::string& added) {
+                const std::string key = clean(value);
+                auto [it, inserted] = codes.emplace(key, static_cast<uint32_t>(codes.size()));
+                if (inserted) {
+                    added += key;
+                    added += '\n';
+                }
+                return it->second;
+            };
+
+            for (size_t i = begin; i < end; ++i) {
+                const row& r = rows[i];
+                batch.received_ms.push_back(r.received_ms);
+                batch.fps_min.push_back(r.fps_min);
+                batch.fps_max.push_back(r.fps_max);
+                batch.fps_average.push_back(r.fps_average);
+                batch.touches.push_back(r.touches);
+                batch.used_memory_max.push_back(r.used_memory_max);
+                batch.free_memory_min.push_back(r.free_memory_min);
+                batch.physical_memory.push_back(r.physical_memory);
+                batch.dlc_downloaded_kb.push_back(r.dlc_downloaded_kb);
+                batch.dlc_seconds.push_back(r.dlc_seconds);
+                batch.dlc_crc_failed.push_back(r.dlc_crc_failed);
+                batch.version.push_back(code_of(w.version_codes, r.version, new_versions));
+                batch.platform.push_back(code_of(w.platform_codes, r.platform, new_platforms));
+            }
+
+            //dictionaries first, a reader must never see a code it cannot resolve
+            if (!new_versions.empty()) {
+                std::ofstream((std::filesystem::path(w.path) / "version.dict").string(), std::ios::binary | std::ios::app) << new_versions;
+            }
+            if (!new_platforms.empty()) {
+                std::ofstream((std::filesystem::path(w.path) / "platform.dict").string(), std::ios::binary | std::ios::app) << new_platforms;
+            }
+            for_each_column(batch, [&w](const char* name, const auto& values) {
+                append_file(column_path(w.path, name), values);
+            });
+
+            w.rows += end - begin;
+            w.dirty = true;
+            begin = end;
+        }
+    }
+
+    void TelemetryStore::rollup() {
+        for (auto& [hour, w] : writers_) {
+            if (!w.dirty) {
+                continue;
+            }
+            w.dirty = false;
+
+            columns c;
+            if (!load_segment(w.path, scan_columns, c)) {
+                continue;
+            }
+
+            std::map<std::string, group_stats> by_version;
+            std::map<std::string, group_stats> by_platform;
+            scan_filter filter;
+            filter.by = group_by::version;
+            scan(c, filter, by_version);
+            filter.by = group_by::platform;
+            scan(c, filter, by_platform);
+
+            rapidjson::StringBuffer buffer;
+            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+            writer.StartObject();
+            writer.Key("hour");
+            writer.String(hour.c_str());
+            writer.Key("rows");
+            writer.Uint64(c.size());
+            writer.Key("by_version");
+            write_groups(writer, by_version);
+            writer.Key("by_platform");
+            write_groups(writer, by_platform);
+            writer.EndObject();
+
+            //written aside and renamed, so a reader never sees half a file
+            const auto target = std::filesystem::path(w.path) / "rollup.json";
+            const auto temp = std::filesystem::path(w.path) / "rollup.json.tmp";
+            {
+                std::ofstream out(temp.string(), std::ios::binary | std::ios::trunc);
+                out.write(buffer.GetString(), static_cast<std::streamsize>(buffer.GetSize()));
+            }
+            std::error_code ec;
+            std::filesystem::rename(temp, target, ec);
+        }
+
+        //past hours are complete, only the current one can still get rows
+        const std::string current = hour_key(wall_ms());
+        for (auto it = writers_.begin(); it != writers_.end();) {
+            if (it->first < current && !it->second.dirty) {
+                it = writers_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void TelemetryStore::expire() {
+        if (retention_hours_ == 0) {
+            return;
+        }
+
+        const std::string oldest = hour_key(wall_ms() - static_cast<int64_t>(retention_hours_) * 3600 * 1000);
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (entry.is_directory() && name.size() == oldest.size() && name < oldest) {
+                std::filesystem::remove_all(entry.path(), ec);
+                logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_TRACKING,
+                    "[TELEMETRY] Removed segment %s, older than %u hours", name.c_str(), retention_hours_);
+            }
+        }
+    }
+
+    std::vector<std::string> TelemetryStore::hours_since(int64_t from_ms) const {
+        const std::string first = hour_key(from_ms);
+        std::vector<std::string> hours;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (entry.is_directory() && name.size() == first.size() && name >= first) {
+                hours.push_back(name);
+            }
+        }
+        std::sort(hours.begin(), hours.end());
+        return hours;
+    }
+
+    server::async::task TelemetryStore::handle_query(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
+        auto& store = get();
+        headers::set_json_response(ctx);
+        if (!store.enabled()) {
+            ctx->set_response_http_code(404);
+            cb(R"({"status": "error", "message": "Telemetry store is off"})");
+            co_return;
+        }
+
+        try {
+            const uint32_t hours = hours_param(ctx, store.retention_hours_);
+            const std::string group = ctx->GetQuery("group");
+
+            scan_filter filter;
+            filter.from_ms = wall_ms() - static_cast<int64_t>(hours) * 3600 * 1000;
+            filter.by = group == "version" ? group_by::version : group == "platform" ? group_by::platform : group_by::none;
+            filter.version = ctx->GetQuery("version");
+            filter.platform = ctx->GetQuery("platform");
+
+            //a month of segments is a lot of reading, none of it on the loop
+            const std::string response = co_await server::async::io(loop, [&store, hours, filter]() {
+                std::map<std::string, group_stats> groups;
+                uint64_t rows = 0;
+                for (const auto& hour : store.hours_since(filter.from_ms)) {
+                    columns c;
+                    if (load_segment((std::filesystem::path(store.dir_) / hour).string(), scan_columns, c)) {
+                        rows += c.size();
+                        scan(c, filter, groups);
+                    }
+                }
+
+                rapidjson::StringBuffer buffer;
+                rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+                writer.StartObject();
+                writer.Key("status");
+                writer.String("success");
+                writer.Key("hours");
+                writer.Uint(hours);
+                writer.Key("group");
+                writer.String(filter.by == group_by::version ? "version" : filter.by == group_by::platform ? "platform" : "none");
+                writer.Key("rows_scanned");
+                writer.Uint64(rows);
+                writer.Key("groups");
+                write_groups(writer, groups);
+                writer.EndObject();
+                return std::string(buffer.GetString(), buffer.GetSize());
+            });
+            cb(response);
+        }
+        catch (const std::exception& ex) {
+            logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_TRACKING,
+                "[TELEMETRY] Query failed: %s", ex.what());
+            ctx->set_response_http_code(500);
+            cb(R"({"status": "error", "message": "Query failed"})");
+        }
+    }
+
+    server::async::task TelemetryStore::handle_rollups(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
+        auto& store = get();
+        headers::set_json_response(ctx);
+        if (!store.enabled()) {
+            ctx->set_response_http_code(404);
+            cb(R"({"status": "error", "message": "Telemetry store is off"})");
+            co_return;
+        }
+
+        const uint32_t hours = hours_param(ctx, store.retention_hours_);
+        const std::string response = co_await server::async::io(loop, [&store, hours]() {
+            std::string response = R"({"status":"success","hours":)" + std::to_string(hours) + R"(,"rollups":[)";
+            bool first = true;
+            for (const auto& hour : store.hours_since(wall_ms() - static_cast<int64_t>(hours) * 3600 * 1000)) {
+                std::ifstream in((std::filesystem::path(store.dir_) / hour / "rollup.json").string(), std::ios::binary);
+                if (!in.is_open()) {
+                    continue;
+                }
+                std::string rollup((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                if (rollup.empty()) {
+                    continue;
+                }
+                if (!first) {
+                    response += ',';
+                }
+                response += rollup;
+                first = false;
+            }
+            response += "]}";
+            return response;
+        });
+        cb(response);
+    }
+}
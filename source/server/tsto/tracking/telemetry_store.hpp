@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <evpp/http/context.h>
+#include <evpp/http/http_server.h>
+#include "async/task.hpp"
+
+namespace evpp {
+    class EventLoopThread;
+}
+
+namespace com::ea::simpsons::client::telemetry {
+    class ClientTelemetryMessage;
+}
+
+namespace tsto::tracking {
+
+    //keeps the numbers of every ClientTelemetryMessage on local disk so the dashboard can show
+    //fps, memory and dlc download figures per client version and platform. rows are appended to
+    //one segment per utc hour (ServerConfig.TelemetryStoreDir/<yyyymmddhh>/), one file per
+    //column: fixed width numbers, and dictionary codes for the version and platform strings.
+    //a background thread writes the rows and keeps a rollup.json per hour, queries scan only
+    //the columns they need. an empty TelemetryStoreDir turns the store off.
+    class TelemetryStore {
+    public:
+        static TelemetryStore& get();
+        ~TelemetryStore();
+
+        bool enabled() const { return !dir_.empty(); }
+
+        void start();
+        void shutdown();
+
+        //copies the numbers out of message, never touches the disk
+        void append(const com::ea::simpsons::client::telemetry::ClientTelemetryMessage& message,
+            const evpp::http::ContextPtr& ctx);
+
+        //both read their segments on the io pool
+        // /api/telemetry/query?hours=24&group=version|platform|none&version=..&platform=..
+        static server::async::task handle_query(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+            evpp::http::HTTPSendResponseCallback cb);
+
+        // /api/telemetry/rollups?hours=24
+        static server::async::task handle_rollups(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+            evpp::http::HTTPSendResponseCallback cb);
+
+        struct row {
+            int64_t received_ms = 0;
+            float fps_min = 0;
+            float fps_max = 0;
+            float fps_average = 0;
+            int64_t touches = 0;
+            int64_t used_memory_max = 0;
+            int64_t free_memory_min = 0;
+            int64_t physical_memory = 0;
+            int64_t dlc_downloaded_kb = 0;
+            float dlc_seconds = 0;
+            int32_t dlc_crc_failed = 0;
+            std::string version;
+            std::string platform;
+        };
+
+        //one segment loaded column by column, dictionary strings resolved per segment
+        struct columns {
+            std::vector<int64_t> received_ms;
+            std::vector<float> fps_min;
+            std::vector<float> fps_max;
+            std::vector<float> fps_average;
+            std::vector<int64_t> touches;
+            std::vector<int64_t> used_memory_max;
+            std::vector<int64_t> free_memory_min;
+            std::vector<int64_t> physical_memory;
+            std::vector<int64_t> dlc_downloaded_kb;
+            std::vector<float> dlc_seconds;
+            std::vector<int32_t> dlc_crc_failed;
+            std::vector<uint32_t> version;
+            std::vector<uint32_t> platform;
+            std::vector<std::string> version_dict;
+            std::vector<std::string> platform_dict;
+
+            size_t size() const { return received_ms.size(); }
+        };
+
+    private:
+        struct segment_writer {
+            std::string path;
+            size_t rows = 0;
+            std::unordered_map<std::string, uint32_t> version_codes;
+            std::unordered_map<std::string, uint32_t> platform_codes;
+            bool dirty = false;     //rows written since the last rollup
+        };
+
+        TelemetryStore();
+        TelemetryStore(const TelemetryStore&) = delete;
+        TelemetryStore& operator=(const TelemetryStore&) = delete;
+
+        //store thread only
+        void flush();
+        void rollup();
+        void expire();
+        segment_writer& writer_for(const std::string& hour);
+
+        std::vector<std::string> hours_since(int64_t from_ms) const;
+
+        std::string dir_;
+        size_t pending_limit_ = 0;
+        uint32_t flush_seconds_ = 0;
+        uint32_t rollup_seconds_ = 0;
+        uint32_t retention_hours_ = 0;
+
+        std::mutex mutex_;
+        std::vector<row> pending_;
+        bool running_ = false;
+
+        std::unique_ptr<evpp::EventLoopThread> thread_;
+        std::map<std::string, segment_writer> writers_;
+
+        std::atomic<uint64_t> dropped_{ 0 };
+    };
+}
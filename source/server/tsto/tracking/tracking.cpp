@@ -1,5 +1,7 @@
 #include <std_include.hpp>
 #include "tracking.hpp"
+#include "telemetry_export.hpp"
+#include "telemetry_store.hpp"
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
@@ -7,15 +9,18 @@
 #include "ClientLog.pb.h"
 #include "ClientMetrics.pb.h"
 #include "AuthData.pb.h"
+#include "memory/request_arena.hpp"
 
 namespace tsto::tracking {
 
     void Tracking::handle_tracking_log(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
         try {
-            // Parse protobuf message
-            com::ea::simpsons::client::log::ClientLogMessage req;
-            if (!req.ParseFromString(std::string(ctx->body().data(), ctx->body().size()))) {
+            // Parse protobuf message, in the request arena
+            const auto arena = server::memory::RequestArena::for_request();
+            google::protobuf::Arena proto_arena(server::memory::proto_arena_options(*arena));
+            auto& req = *google::protobuf::Arena::Create<com::ea::simpsons::client::log::ClientLogMessage>(&proto_arena);
+            if (!req.ParseFromArray(ctx->body().data(), static_cast<int>(ctx->body().size()))) {
                 ctx->set_response_http_code(400);
                 cb("");
                 return;
@@ -26,6 +31,8 @@ namespace tsto::tracking {
                 "[TRACKING LOG] Message: %s", req.DebugString().c_str());
 #endif
 
+            TelemetryExport::get().enqueue(telemetry_kind::log, ctx);
+
             // Return XML response
             const char* xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Resources><URI>OK</URI></Resources>";
             headers::set_xml_response(ctx);
@@ -46,17 +53,11 @@ namespace tsto::tracking {
                 ctx->body().empty() ? "(empty)" : std::string(ctx->body().data(), ctx->body().size()).c_str());
 #endif
 
-            // Return JSON response
-            rapidjson::Document doc;
-            doc.SetObject();
-            doc.AddMember("status", "ok", doc.GetAllocator());
-
-            rapidjson::StringBuffer buffer;
-            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-            doc.Accept(writer);
+            TelemetryExport::get().enqueue(telemetry_kind::core_log, ctx);
 
+            // Return JSON response
             headers::set_json_response(ctx);
-            cb(buffer.GetString());
+            cb(R"({"status":"ok"})");
         }
         catch (const std::exception& e) {
             ctx->set_response_http_code(500);
@@ -79,6 +80,8 @@ namespace tsto::tracking {
             }
 #endif
 
+            TelemetryExport::get().enqueue(telemetry_kind::pin_events, ctx);
+
             // Return JSON response
             headers::set_json_response(ctx);
             cb(R"({"status": "ok"})");
@@ -92,9 +95,11 @@ namespace tsto::tracking {
     void Tracking::handle_tracking_metrics(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
         const evpp::http::HTTPSendResponseCallback& cb) {
         try {
-            // Parse protobuf message
-            com::ea::simpsons::client::metrics::ClientMetricsMessage req;
-            if (!req.ParseFromString(std::string(ctx->body().data(), ctx->body().size()))) {
+            // Parse protobuf message, in the request arena
+            const auto arena = server::memory::RequestArena::for_request();
+            google::protobuf::Arena proto_arena(server::memory::proto_arena_options(*arena));
+            auto& req = *google::protobuf::Arena::Create<com::ea::simpsons::client::metrics::ClientMetricsMessage>(&proto_arena);
+            if (!req.ParseFromArray(ctx->body().data(), static_cast<int>(ctx->body().size()))) {
                 ctx->set_response_http_code(400);
                 cb("");
                 return;
@@ -105,11 +110,7 @@ namespace tsto::tracking {
                 "[TRACKING METRICS] Message: %s", req.DebugString().c_str());
 #endif
 
-            // Create token data
-            auto& session = tsto::Session::get();
-            Data::TokenData data;
-            data.set_sessionkey(session.token_session_key);
-            data.set_expirationdate(0);
+            TelemetryExport::get().enqueue(telemetry_kind::metrics, ctx);
 
             // Return XML response
             const char* xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Resources><URI>OK</URI></Resources>";
@@ -130,8 +131,10 @@ namespace tsto::tracking {
                 "[CLIENT TELEMETRY] Request received from %s",
                 ctx->remote_ip().data());
 
-            com::ea::simpsons::client::telemetry::ClientTelemetryMessage telemetry;
-            if (!telemetry.ParseFromString(std::string(ctx->body().data(), ctx->body().size()))) {
+            const auto arena = server::memory::RequestArena::for_request();
+            google::protobuf::Arena proto_arena(server::memory::proto_arena_options(*arena));
+            auto& telemetry = *google::protobuf::Arena::Create<com::ea::simpsons::client::telemetry::ClientTelemetryMessage>(&proto_arena);
+            if (!telemetry.ParseFromArray(ctx->body().data(), static_cast<int>(ctx->body().size()))) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_TRACKING,
                     "[CLIENT TELEMETRY] Failed to parse protobuf message");
                 ctx->set_response_http_code(400);
@@ -139,6 +142,9 @@ namespace tsto::tracking {
                 return;
             }
 
+            TelemetryStore::get().append(telemetry, ctx);
+            TelemetryExport::get().enqueue(telemetry_kind::telemetry, ctx);
+
             const char* response = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Resources><URI>OK</URI></Resources>";
             headers::set_xml_response(ctx);
 
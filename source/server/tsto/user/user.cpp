@@ -1,8 +1,6 @@
 #include <std_include.hpp>
 #include "user.hpp"
-#include <rapidjson/document.h>
-#include <rapidjson/writer.h>
-#include <rapidjson/stringbuffer.h>
+#include <json_writer.hpp>
 
 namespace tsto::user {
 
@@ -15,57 +13,55 @@ namespace tsto::user {
             std::string uri = ctx->uri();
             auto& session = tsto::Session::get();
 
-            rapidjson::Document doc;
-            doc.SetObject();
-            auto& allocator = doc.GetAllocator();
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            writer.begin_object();
 
             if (uri.find("/proxy/identity/pids//personas") == 0) {
-
-                rapidjson::Value personas(rapidjson::kObjectType);
-                rapidjson::Value personaArray(rapidjson::kArrayType);
-
-                rapidjson::Value persona(rapidjson::kObjectType);
-                persona.AddMember("personaId", rapidjson::Value(session.personal_id.c_str(), allocator), allocator);
-                persona.AddMember("pidId", rapidjson::Value(session.me_persona_pid_id.c_str(), allocator), allocator);
-                persona.AddMember("displayName", rapidjson::Value(session.display_name.c_str(), allocator), allocator);
-                persona.AddMember("name", rapidjson::Value(session.persona_name.c_str(), allocator), allocator);
-                persona.AddMember("namespaceName", "cem_ea_id", allocator);
-                persona.AddMember("isVisible", true, allocator);
-                persona.AddMember("status", "ACTIVE", allocator);
-                persona.AddMember("statusReasonCode", "", allocator);
-                persona.AddMember("showPersona", "FRIENDS", allocator);
-                persona.AddMember("dateCreated", "2024-12-25T0:00Z", allocator);
-                persona.AddMember("lastAuthenticated", "", allocator);
-
-                personaArray.PushBack(persona, allocator);
-                personas.AddMember("persona", personaArray, allocator);
-                doc.AddMember("personas", personas, allocator);
+                writer.key("personas").begin_object()
+                    .key("persona").begin_array()
+                    .begin_object()
+                    .member("personaId", session.personal_id)
+                    .member("pidId", session.me_persona_pid_id)
+                    .member("displayName", session.display_name)
+                    .member("name", session.persona_name)
+                    .member("namespaceName", "cem_ea_id")
+                    .member("isVisible", true)
+                    .member("status", "ACTIVE")
+                    .member("statusReasonCode", "")
+                    .member("showPersona", "FRIENDS")
+                    .member("dateCreated", "2024-12-25T0:00Z")
+                    .member("lastAuthenticated", "")
+                    .end_object()
+                    .end_array()
+                    .end_object();
             }
             else {
-                rapidjson::Value persona(rapidjson::kObjectType);
-                persona.AddMember("personaId", rapidjson::Value(session.personal_id.c_str(), allocator), allocator);
-                persona.AddMember("pidId", rapidjson::Value(session.me_persona_pid_id.c_str(), allocator), allocator);
-                persona.AddMember("displayName", rapidjson::Value(session.me_persona_display_name.c_str(), allocator), allocator);
-                persona.AddMember("name", rapidjson::Value(session.me_persona_name.c_str(), allocator), allocator);
-                persona.AddMember("namespaceName", "gsp-redcrow-simpsons4", allocator);
-                persona.AddMember("isVisible", true, allocator);
-                persona.AddMember("status", "ACTIVE", allocator);
-                persona.AddMember("statusReasonCode", "", allocator);
-                persona.AddMember("showPersona", "EVERYONE", allocator);
-                persona.AddMember("dateCreated", "2012-02-29T0:00Z", allocator);
-                persona.AddMember("lastAuthenticated", "2024-12-28T5:25Z", allocator);
-                persona.AddMember("anonymousId", rapidjson::Value(session.me_persona_anonymous_id.c_str(), allocator), allocator);
-
-                doc.AddMember("persona", persona, allocator);
+                writer.key("persona").begin_object()
+                    .member("personaId", session.personal_id)
+                    .member("pidId", session.me_persona_pid_id)
+                    .member("displayName", session.me_persona_display_name)
+                    .member("name", session.me_persona_name)
+                    .member("namespaceName", "gsp-redcrow-simpsons4")
+                    .member("isVisible", true)
+                    .member("status", "ACTIVE")
+                    .member("statusReasonCode", "")
+                    .member("showPersona", "EVERYONE")
+                    .member("dateCreated", "2012-02-29T0:00Z")
+                    .member("lastAuthenticated", "2024-12-28T5:25Z")
+                    .member("anonymousId", session.me_persona_anonymous_id)
+                    .end_object();
             }
 
+            writer.end_object();
+
             logger::write(logger::LOG_LEVEL_RESPONSE, logger::LOG_LABEL_USER,
                 "[ME PERSONAS] Sending response for user_id: %s",
                 uri.substr(uri.find_last_of('/') + 1).c_str());
 
             headers::set_json_response(ctx);
 
-            cb(utils::serialization::serialize_json(doc));
+            cb(response);
         }
         catch (const std::exception& ex) {
             logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_USER,
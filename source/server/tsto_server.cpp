@@ -13,6 +13,9 @@
 #include "tsto/auth/auth.hpp"
 #include "tsto/database/database.hpp"
 #include "tsto/includes/session.hpp"
+#include "tsto/includes/body_stream.hpp"
+#include "tsto/currency/currency_ledger.hpp"
+#include "memory/request_arena.hpp"
 
 namespace tsto {
 
@@ -20,120 +23,236 @@ namespace tsto {
         return utils::cryptography::random::get_challenge();
     }
 
-    void TSTOServer::handle_get_direction(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb, const std::string& platform) {
-        headers::set_json_response(ctx);
+    void TSTOServer::write_direction(utils::json::writer& writer, const std::string& platform,
+        const std::string& protocol, const std::string& server_address) {
+        static constexpr const char* redirect_keys[] = {
+            "nexus.portal", "antelope.groups.url", "service.discovery.url",
+            "synergy.tracking", "antelope.friends.url", "dmg.url",
+            "avatars.url", "synergy.m2u", "akamai.url", "synergy.pns",
+            "mayhem.url", "group.recommendations.url", "synergy.s2s",
+            "friend.recommendations.url", "geoip.url", "river.pin",
+            "origincasualserver.url", "ens.url", "eadp.friends.host",
+            "synergy.product", "synergy.drm", "synergy.user",
+            "antelope.inbox.url", "antelope.rtm.url", "friends.url",
+            "aruba.url", "synergy.cipgl", "nexus.connect",
+            "synergy.director", "pin.aruba.url", "nexus.proxy"
+        };
+
+        const bool ios = platform == "ios";
+        const std::string base_url = protocol + "://" + server_address;
+
+        writer.begin_object()
+            .member("DMGId", 0)
+            .member("appUpgrade", 0)
+            .member("bundleId", ios ? "com.ea.simpsonssocial.inc2" : "com.ea.game.simpsons4_row")
+            .member("clientId", "simpsons4-" + platform + "-client")
+            .member("clientSecret", "D0fpQvaBKmAgBRCwGPvROmBf96zHnAuZmNepQht44SgyhbCdCfFgtUTdCezpWpbRI8N6oPtb38aOVg2y");
+        writer.key("disabledFeatures").begin_array().end_array();
+        writer.member("facebookAPIKey", "43b9130333cc984c79d06aa0cad3a0c8")
+            .member("facebookAppId", "185424538221919")
+            .member("hwId", 2363)
+            .member("mayhemGameCode", "bg_gameserver_plugin")
+            .member("mdmAppKey", "simpsons-4-" + platform)
+            .member("millennialId", "")
+            .member("packageId", "com.ea.game.simpsons4_row");
+
+        writer.key("pollIntervals").begin_array()
+            .begin_object().member("key", "badgePollInterval").member("value", "300").end_object()
+            .end_array();
+
+        writer.member("productId", 48302)
+            .member("resultCode", 0)
+            .member("sellId", 857120)
+            .member("serverApiVersion", "1.0.0");
+
+        auto entry = [&writer](const char* key, const std::string& value) {
+            writer.begin_object().member("key", key).member("value", value).end_object();
+        };
+
+        writer.key("serverData").begin_array();
+        entry("antelope.rtm.host", base_url + ":9000");
+        if (ios) {
+            entry("applecert.url", "https://www.apple.com/appleca/AppleIncRootCertificate.cer");
+        }
+        entry("origincasualapp.url", base_url + (ios ? "/loader/mobile/ios/" : "/loader/mobile/android/"));
+        entry("akamai.url", "https://cdn.skum.eamobile.com/skumasset/gameasset/");
+        for (const char* key : redirect_keys) {
+            entry(key, base_url);
+        }
+        writer.end_array();
 
-        try {
-            logger::write(logger::LOG_LEVEL_INCOMING, logger::LOG_LABEL_GAME,
-                "[DIRECTION] Request from %s: %s (Platform: %s)",
-                ctx->remote_ip().data(), ctx->uri().data(), platform.c_str());
+        writer.member("telemetryFreq", 300)
+            .end_object();
+    }
 
+    namespace {
+        //the android direction body as it was built before the writer, the baseline for -bench-json
+        std::string direction_dom(const std::string& protocol, const std::string& server_address) {
             rapidjson::Document doc;
             doc.SetObject();
             auto& allocator = doc.GetAllocator();
 
+            const std::string client_id = "simpsons4-android-client";
+            const std::string mdm_app_key = "simpsons-4-android";
+            const std::string base_url = protocol + "://" + server_address;
+
             doc.AddMember("DMGId", 0, allocator);
             doc.AddMember("appUpgrade", 0, allocator);
-
-            std::string protocol = "http";
-            const char* forwarded_proto = ctx->FindRequestHeader("X-Forwarded-Proto");
-            if (forwarded_proto && std::string(forwarded_proto) == "https") {
-                protocol = "https";
-            }
-
-            if (platform == "ios") {
-                doc.AddMember("bundleId", "com.ea.simpsonssocial.inc2", allocator);
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[DIRECTION] Platform is iOS, bundleId set to: com.ea.simpsonssocial.inc2");
-            }
-            else {
-                doc.AddMember("bundleId", "com.ea.game.simpsons4_row", allocator);
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[DIRECTION] Platform is Android, bundleId set to: com.ea.game.simpsons4_row");
-            }
-
-            std::string clientId = "simpsons4-" + platform + "-client";
-            doc.AddMember("clientId", rapidjson::StringRef(clientId.c_str()), allocator);
-
+            doc.AddMember("bundleId", "com.ea.game.simpsons4_row", allocator);
+            doc.AddMember("clientId", rapidjson::StringRef(client_id.c_str()), allocator);
             doc.AddMember("clientSecret", "D0fpQvaBKmAgBRCwGPvROmBf96zHnAuZmNepQht44SgyhbCdCfFgtUTdCezpWpbRI8N6oPtb38aOVg2y", allocator);
             doc.AddMember("disabledFeatures", rapidjson::Value(rapidjson::kArrayType), allocator);
             doc.AddMember("facebookAPIKey", "43b9130333cc984c79d06aa0cad3a0c8", allocator);
             doc.AddMember("facebookAppId", "185424538221919", allocator);
             doc.AddMember("hwId", 2363, allocator);
             doc.AddMember("mayhemGameCode", "bg_gameserver_plugin", allocator);
-
-            std::string mdmAppKey = "simpsons-4-" + platform;
-            doc.AddMember("mdmAppKey", rapidjson::StringRef(mdmAppKey.c_str()), allocator);
-
+            doc.AddMember("mdmAppKey", rapidjson::StringRef(mdm_app_key.c_str()), allocator);
             doc.AddMember("millennialId", "", allocator);
             doc.AddMember("packageId", "com.ea.game.simpsons4_row", allocator);
 
-            rapidjson::Value pollIntervals(rapidjson::kArrayType);
-            rapidjson::Value pollInterval(rapidjson::kObjectType);
-            pollInterval.AddMember("key", "badgePollInterval", allocator);
-            pollInterval.AddMember("value", "300", allocator);
-            pollIntervals.PushBack(pollInterval, allocator);
-            doc.AddMember("pollIntervals", pollIntervals, allocator);
+            rapidjson::Value poll_intervals(rapidjson::kArrayType);
+            rapidjson::Value poll_interval(rapidjson::kObjectType);
+            poll_interval.AddMember("key", "badgePollInterval", allocator);
+            poll_interval.AddMember("value", "300", allocator);
+            poll_intervals.PushBack(poll_interval, allocator);
+            doc.AddMember("pollIntervals", poll_intervals, allocator);
 
             doc.AddMember("productId", 48302, allocator);
             doc.AddMember("resultCode", 0, allocator);
             doc.AddMember("sellId", 857120, allocator);
             doc.AddMember("serverApiVersion", "1.0.0", allocator);
 
-            rapidjson::Value serverData(rapidjson::kArrayType);
-
-            std::string server_address = get_server_address();
+            std::vector<std::pair<const char*, std::string>> entries = {
+                {"antelope.rtm.host", base_url + ":9000"},
+                {"origincasualapp.url", base_url + "/loader/mobile/android/"},
+                {"akamai.url", "https://cdn.skum.eamobile.com/skumasset/gameasset/"}
+            };
+            for (const char* key : { "nexus.portal", "antelope.groups.url", "service.discovery.url",
+                "synergy.tracking", "antelope.friends.url", "dmg.url", "avatars.url", "synergy.m2u",
+                "akamai.url", "synergy.pns", "mayhem.url", "group.recommendations.url", "synergy.s2s",
+                "friend.recommendations.url", "geoip.url", "river.pin", "origincasualserver.url",
+                "ens.url", "eadp.friends.host", "synergy.product", "synergy.drm", "synergy.user",
+                "antelope.inbox.url", "antelope.rtm.url", "friends.url", "aruba.url", "synergy.cipgl",
+                "nexus.connect", "synergy.director", "pin.aruba.url", "nexus.proxy" }) {
+                entries.emplace_back(key, base_url);
+            }
 
-            std::vector<std::pair<const char*, std::string>> initialEntries;
-            if (platform == "ios") {
-                initialEntries = {
-                    {"antelope.rtm.host", protocol + "://" + server_address + ":9000"},
-                    {"applecert.url", "https://www.apple.com/appleca/AppleIncRootCertificate.cer"},
-                    {"origincasualapp.url", protocol + "://" + server_address + "/loader/mobile/ios/"},
-                    {"akamai.url", "https://cdn.skum.eamobile.com/skumasset/gameasset/"}
-                };
+            rapidjson::Value server_data(rapidjson::kArrayType);
+            for (const auto& entry : entries) {
+                rapidjson::Value server_entry(rapidjson::kObjectType);
+                server_entry.AddMember("key", rapidjson::StringRef(entry.first), allocator);
+                server_entry.AddMember("value", rapidjson::StringRef(entry.second.c_str()), allocator);
+                server_data.PushBack(server_entry, allocator);
             }
-            else {
-                initialEntries = {
-                    {"antelope.rtm.host", protocol + "://" + server_address + ":9000"},
-                    {"origincasualapp.url", protocol + "://" + server_address + "/loader/mobile/android/"},
-                    {"akamai.url", "https://cdn.skum.eamobile.com/skumasset/gameasset/"}
-                };
+            doc.AddMember("serverData", server_data, allocator);
+            doc.AddMember("telemetryFreq", 300, allocator);
+
+            return utils::serialization::serialize_json(doc);
+        }
+
+        //the /connect/token body, the most common small response
+        std::string token_dom(const std::string& access_token, const std::string& refresh_token, const std::string& id_token) {
+            rapidjson::Document doc;
+            doc.SetObject();
+            auto& allocator = doc.GetAllocator();
+            doc.AddMember("access_token", rapidjson::Value(access_token.c_str(), allocator), allocator);
+            doc.AddMember("token_type", "Bearer", allocator);
+            doc.AddMember("expires_in", 4242, allocator);
+            doc.AddMember("refresh_token", rapidjson::Value(refresh_token.c_str(), allocator), allocator);
+            doc.AddMember("refresh_token_expires_in", 4242, allocator);
+            doc.AddMember("id_token", rapidjson::Value(id_token.c_str(), allocator), allocator);
+            return utils::serialization::serialize_json(doc);
+        }
+
+        void write_token(utils::json::writer& writer, const std::string& access_token,
+            const std::string& refresh_token, const std::string& id_token) {
+            writer.begin_object()
+                .member("access_token", access_token)
+                .member("token_type", "Bearer")
+                .member("expires_in", 4242)
+                .member("refresh_token", refresh_token)
+                .member("refresh_token_expires_in", 4242)
+                .member("id_token", id_token)
+                .end_object();
+        }
+    }
+
+    void TSTOServer::benchmark_json() {
+        const std::string address = "192.168.1.100:8080";
+        const std::string access_token = "AT0:2.0:3.0:86400:KhEgEwE1a4dM9AVmVOImfOAjuK3mwdL5WQ4:47082:rd1kc";
+        const std::string refresh_token = "RT0:2.0:3.0:86400:KhEgEwE1a4dM9AVmVOImfOAjuK3mwdL5WQ4:47082:rd1kc.MpDW6wVO8Ek79nu6jxMdSQwOqP";
+        const std::string id_token = "eyJ0eXAiOiJKV1QiLCJhbGciOiJIUzI1NiJ9." + std::string(320, 'e') + ".MlRvazhSeWttUUQ0MXVXRHY1bUk3SlRaN05JaGNaQUlQdGlCbTRaNQ==";
+
+        auto now_ns = []() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        };
+
+        auto run = [&](const char* name, size_t iterations, auto&& dom, auto&& write) {
+            //both paths must give the same bytes or the numbers mean nothing
+            const std::string expected = dom();
+            std::string& check = utils::json::thread_buffer();
+            utils::json::writer check_writer(check);
+            write(check_writer);
+            if (check != expected) {
+                logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER,
+                    "[JSON] %s: writer output differs from the DOM\n%s\n%s", name, expected.c_str(), check.c_str());
+                return;
             }
 
-            for (const auto& entry : initialEntries) {
-                rapidjson::Value serverEntry(rapidjson::kObjectType);
-                serverEntry.AddMember("key", rapidjson::StringRef(entry.first), allocator);
-                serverEntry.AddMember("value", rapidjson::StringRef(entry.second.c_str()), allocator);
-                serverData.PushBack(serverEntry, allocator);
+            //summed so the loops are not optimized away
+            size_t bytes = 0;
+            int64_t start = now_ns();
+            for (size_t i = 0; i < iterations; ++i) {
+                bytes += dom().size();
             }
+            const double dom_ns = static_cast<double>(now_ns() - start) / iterations;
+
+            start = now_ns();
+            for (size_t i = 0; i < iterations; ++i) {
+                std::string& response = utils::json::thread_buffer();
+                utils::json::writer writer(response);
+                write(writer);
+                bytes += response.size();
+            }
+            const double writer_ns = static_cast<double>(now_ns() - start) / iterations;
+
+            logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER,
+                "[JSON] %-10s %5zu bytes: DOM %7.0f ns, writer %7.0f ns (%.1fx faster, %zu bytes written)",
+                name, expected.size(), dom_ns, writer_ns, dom_ns / writer_ns, bytes);
+        };
+
+        run("direction", 200000,
+            [&]() { return direction_dom("http", address); },
+            [&](utils::json::writer& writer) { write_direction(writer, "android", "http", address); });
+        run("token", 1000000,
+            [&]() { return token_dom(access_token, refresh_token, id_token); },
+            [&](utils::json::writer& writer) { write_token(writer, access_token, refresh_token, id_token); });
+    }
 
-            const std::vector<const char*> redirectKeys = {
-                "nexus.portal", "antelope.groups.url", "service.discovery.url",
-                "synergy.tracking", "antelope.friends.url", "dmg.url",
-                "avatars.url", "synergy.m2u", "akamai.url", "synergy.pns",
-                "mayhem.url", "group.recommendations.url", "synergy.s2s",
-                "friend.recommendations.url", "geoip.url", "river.pin",
-                "origincasualserver.url", "ens.url", "eadp.friends.host",
-                "synergy.product", "synergy.drm", "synergy.user",
-                "antelope.inbox.url", "antelope.rtm.url", "friends.url",
-                "aruba.url", "synergy.cipgl", "nexus.connect",
-                "synergy.director", "pin.aruba.url", "nexus.proxy"
-            };
+    void TSTOServer::handle_get_direction(evpp::EventLoop*, const evpp::http::ContextPtr& ctx,
+        const evpp::http::HTTPSendResponseCallback& cb, const std::string& platform) {
+        headers::set_json_response(ctx);
 
-            std::string baseUrl = protocol + "://" + server_address;
-            for (const auto& key : redirectKeys) {
-                rapidjson::Value serverEntry(rapidjson::kObjectType);
-                serverEntry.AddMember("key", rapidjson::StringRef(key), allocator);
-                serverEntry.AddMember("value", rapidjson::StringRef(baseUrl.c_str()), allocator);
-                serverData.PushBack(serverEntry, allocator);
+        try {
+            logger::write(logger::LOG_LEVEL_INCOMING, logger::LOG_LABEL_GAME,
+                "[DIRECTION] Request from %s: %s (Platform: %s)",
+                ctx->remote_ip().data(), ctx->uri().data(), platform.c_str());
+
+            std::string protocol = "http";
+            const char* forwarded_proto = ctx->FindRequestHeader("X-Forwarded-Proto");
+            if (forwarded_proto && std::string(forwarded_proto) == "https") {
+                protocol = "https";
             }
 
-            doc.AddMember("serverData", serverData, allocator);
-            doc.AddMember("telemetryFreq", 300, allocator);
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+                "[DIRECTION] Platform is %s, bundleId set to: %s", platform == "ios" ? "iOS" : "Android",
+                platform == "ios" ? "com.ea.simpsonssocial.inc2" : "com.ea.game.simpsons4_row");
+
+            std::string& response = utils::json::thread_buffer();
+            utils::json::writer writer(response);
+            write_direction(writer, platform, protocol, get_server_address());
 
-            std::string response = utils::serialization::serialize_json(doc);
             logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
                 "[DIRECTION] Response for %s platform: %s", platform.c_str(), response.c_str());
 
@@ -233,10 +352,7 @@ namespace tsto {
             const auto* encoding = ctx->FindRequestHeader("Content-Encoding");
 
             if (encoding && strcmp(encoding, "gzip") == 0) {
-                const auto& body = ctx->body();
-                body_str = utils::compression::zlib::decompress(
-                    std::string(body.data(), body.size())
-                );
+                body_str = utils::compression::zlib::decompress(BodyInputStream(ctx).views());
             }
             else {
                 const auto& body = ctx->body();
@@ -355,16 +471,17 @@ namespace tsto {
         }
     }
 
-    void TSTOServer::handle_progreg_code(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx,
-        const evpp::http::HTTPSendResponseCallback& cb) {
+    server::async::task TSTOServer::handle_progreg_code(evpp::EventLoop* loop, evpp::http::ContextPtr ctx,
+        evpp::http::HTTPSendResponseCallback cb) {
         try {
             std::string body = ctx->body().ToString();
             if (body.empty()) {
                 throw std::runtime_error("Empty request body");
             }
 
-            rapidjson::Document doc;
-            doc.Parse(body.c_str());
+            const auto arena = server::memory::RequestArena::for_request();
+            server::memory::JsonDocument doc(*arena);
+            doc.Parse(body.data(), body.size());
             if (doc.HasParseError() || !doc.IsObject()) {
                 throw std::runtime_error("Invalid JSON in request body");
             }
@@ -393,8 +510,11 @@ namespace tsto {
 
             auto& db = tsto::database::Database::get_instance();
 
+            //a token from another node is looked up in the shared cache, which may wait on memcached
             std::string existing_email;
-            bool token_exists = db.get_email_by_token(access_token, existing_email);
+            bool token_exists = co_await server::async::io(loop, [&db, &access_token, &existing_email]() {
+                return db.get_email_by_token(access_token, existing_email);
+            });
             
             std::string user_id;
             int64_t mayhem_id = 0;
@@ -448,7 +568,7 @@ namespace tsto {
             
 
             std::string empty_token = ""; 
-            if (!db.update_access_token(existing_email, empty_token)) {
+            if (!tsto::auth::Auth::update_access_token(existing_email, empty_token)) {
                 logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_AUTH,
                     "[PROGREG CODE] Failed to clear access token for old email: %s", existing_email.c_str());
             }
@@ -459,7 +579,7 @@ namespace tsto {
             "[PROGREG CODE] Generated access code for %s: %s", 
             filename.c_str(), access_code.c_str());
 
-        if (!db.store_user_id(filename, user_id, access_token, mayhem_id, access_code)) {
+        if (!tsto::auth::Auth::store_user_id(filename, user_id, access_token, mayhem_id, access_code)) {
             throw std::runtime_error("Failed to store user data in database");
         }
 
@@ -505,59 +625,19 @@ namespace tsto {
             size_t land_end = uri.find("/", land_start);
             std::string land_id = uri.substr(land_start, land_end - land_start);
 
-            //grab current session to access the email-based filename
-            auto& session = tsto::Session::get();
-            std::string currency_path;
-            std::string user_identifier;
-
-            //check if we're using mytown.pb (non-logged in) or email-based town (logged in)
-            std::string current_town = session.town_filename.empty() ? "mytown.pb" : session.town_filename;
-            
-            if (current_town == "mytown.pb") {
-                //non logged in user - use currency.txt
-                currency_path = "towns/currency.txt";
-                user_identifier = "default";
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Using legacy currency file for non-logged in user");
-            } else {
-                //logged in user - use email-based currency file
-                std::string email_base = current_town;
-                size_t pb_pos = email_base.find(".pb");
-                if (pb_pos != std::string::npos) {
-                    email_base = email_base.substr(0, pb_pos);
-                }
-                size_t txt_pos = email_base.find(".txt");
-                if (txt_pos != std::string::npos) {
-                    email_base = email_base.substr(0, txt_pos);
-                }
-                currency_path = "towns/currency_" + email_base + ".txt";
-                user_identifier = email_base;
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Using email-based currency file for user: %s", email_base.c_str());
-            }
-            
-            std::filesystem::create_directories("towns");
-
-            int balance = std::stoi(utils::configuration::ReadString("Server", "InitialDonutAmount", "1000"));
-            if (std::filesystem::exists(currency_path)) {
-                std::ifstream input(currency_path);
-                if (input.good()) {
-                    input >> balance;
-                    logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                        "[CURRENCY] Loaded existing currency data for user: %s (Balance: %d)",
-                        user_identifier.c_str(), balance);
-                }
-                input.close();
+            //the email-based filename of the session, or of the player a forwarded request names
+            tsto::land::Land::player player;
+            if (!tsto::land::Land::resolve_player(ctx, player)) {
+                ctx->set_response_http_code(400);
+                cb("Invalid town");
+                return;
             }
-            else {
-                std::ofstream output(currency_path);
-                output << balance;
-                output.close();
+            const std::string user_identifier = tsto::currency::CurrencyLedger::user_from_town(player.town);
 
-                logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
-                    "[CURRENCY] Created new currency data for user: %s with initial balance: %d",
-                    user_identifier.c_str(), balance);
-            }
+            const int balance = static_cast<int>(tsto::currency::CurrencyLedger::get_instance().get_balance(user_identifier));
+            logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_GAME,
+                "[CURRENCY] Loaded currency data for user: %s (Balance: %d)",
+                user_identifier.c_str(), balance);
 
             Data::CurrencyData currency_data;
             currency_data.set_id(land_id);
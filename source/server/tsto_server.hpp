@@ -28,6 +28,7 @@
 #include "http.hpp"
 #include "string.hpp"
 #include <serialization.hpp>
+#include <json_writer.hpp>
 
 // Debugging includes
 #include "debugging/serverlog.hpp"
@@ -37,6 +38,7 @@
 
 #include "tsto/includes/session.hpp"
 #include "tsto/includes/helpers.hpp"
+#include "async/task.hpp"
 
 namespace server::dispatcher::http {
     class Dispatcher;
@@ -65,6 +67,13 @@ namespace tsto {
             return server_ip_ + ":" + std::to_string(server_port_);
         }
 
+        //the /director/api/<platform>/getDirectionByPackage body, also used by -bench-json
+        static void write_direction(utils::json::writer& writer, const std::string& platform,
+            const std::string& protocol, const std::string& server_address);
+
+        //times the writer against building and serializing a rapidjson DOM for the same responses
+        static void benchmark_json();
+
 
     private:
         // Server config
@@ -98,7 +107,7 @@ namespace tsto {
         void handle_pin_events(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
         void handle_plugin_event(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
         void handle_friend_data_origin(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
-        void handle_progreg_code(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
+        server::async::task handle_progreg_code(evpp::EventLoop* loop, evpp::http::ContextPtr ctx, evpp::http::HTTPSendResponseCallback cb);
         void handle_proto_currency(evpp::EventLoop* loop, const evpp::http::ContextPtr& ctx, const evpp::http::HTTPSendResponseCallback& cb);
         void handle_plugin_event_protoland(evpp::EventLoop*, const evpp::http::ContextPtr&, const evpp::http::HTTPSendResponseCallback&);
       
@@ -3,8 +3,10 @@
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
+#ifdef _WIN32
 #include <wininet.h>
 #include <shlobj.h>
+#endif
 #pragma comment(lib, "wininet.lib")
 #include "configuration.hpp"
 
@@ -14,6 +16,14 @@ namespace updater {
     const std::string GITHUB_API_URL = "https://api.github.com/repos/bodnjenie14/Tsto---Simpsons-Tapped-Out---Private-Server/releases/latest";
     const std::string DOWNLOAD_URL_BASE = "https://github.com/bodnjenie14/Tsto---Simpsons-Tapped-Out---Private-Server/releases/download/";
 
+#ifndef _WIN32
+    //the updater downloads the windows release zip and swaps it in with powershell
+    bool check_for_updates() {
+        logger::write(logger::LOG_LEVEL_INFO, logger::LOG_LABEL_INITIALIZER,
+            "Auto update is only available on Windows builds, skipping");
+        return false;
+    }
+#else
     bool check_for_updates() {
         logger::write(logger::LOG_LEVEL_DEBUG, logger::LOG_LABEL_INITIALIZER, "Checking GitHub API: %s", GITHUB_API_URL.c_str());
 
@@ -131,11 +141,16 @@ namespace updater {
         logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_INITIALIZER, "Failed to parse GitHub API response");
         return false;
     }
+#endif
 
     std::string get_server_version() {
         return SERVER_VERSION;
     }
 
+#ifndef _WIN32
+void download_and_update() {
+}
+#else
 void download_and_update() {
     std::string latestVersion = utils::configuration::ReadString("UpdateInfo", "LatestVersion", "alpha");
     std::string assetName = utils::configuration::ReadString("UpdateInfo", "AssetName", "Tsto_Server_Bodnjenie.V0.05.zip");
@@ -207,6 +222,6 @@ void download_and_update() {
         logger::write(logger::LOG_LEVEL_ERROR, logger::LOG_LABEL_UPDATE, "[ERROR] Unknown error during update process. Exit code: %d", result);
     }
 }
+#endif
 
-
-}
\ No newline at end of file
+}
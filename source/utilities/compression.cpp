@@ -1,6 +1,9 @@
 #include "memory.hpp"
 #include "compression.hpp"
 
+#include <cstring>
+#include <optional>
+
 #include <zlib.h>
 #include <zip.h>
 #include <unzip.h>
@@ -54,6 +57,11 @@ namespace utils::compression
 		}
 
 		std::string decompress(const std::string& data)
+		{
+			return decompress(std::vector<std::string_view>{data});
+		}
+
+		std::string decompress(const std::vector<std::string_view>& segments)
 		{
 			std::string buffer{};
 			zlib_stream stream_container{};
@@ -62,34 +70,42 @@ namespace utils::compression
 				return {};
 			}
 
-			int ret{};
-			size_t offset = 0;
+			int ret = Z_OK;
 			static thread_local uint8_t dest[CHUNK] = {0};
 			auto& stream = stream_container.get();
 
-			do
+			for (const auto& data : segments)
 			{
-				const auto input_size = std::min(sizeof(dest), data.size() - offset);
-				stream.avail_in = static_cast<uInt>(input_size);
-				stream.next_in = reinterpret_cast<const Bytef*>(data.data()) + offset;
-				offset += stream.avail_in;
-
-				do
+				size_t offset = 0;
+				while (offset < data.size() && ret != Z_STREAM_END)
 				{
-					stream.avail_out = sizeof(dest);
-					stream.next_out = dest;
+					const auto input_size = std::min(sizeof(dest), data.size() - offset);
+					stream.avail_in = static_cast<uInt>(input_size);
+					stream.next_in = reinterpret_cast<const Bytef*>(data.data()) + offset;
+					offset += stream.avail_in;
 
-					ret = inflate(&stream, Z_NO_FLUSH);
-					if (ret != Z_OK && ret != Z_STREAM_END)
+					do
 					{
-						return {};
-					}
+						stream.avail_out = sizeof(dest);
+						stream.next_out = dest;
 
-					buffer.insert(buffer.end(), dest, dest + sizeof(dest) - stream.avail_out);
+						ret = inflate(&stream, Z_NO_FLUSH);
+						if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+						{
+							return {};
+						}
+
+						buffer.insert(buffer.end(), dest, dest + sizeof(dest) - stream.avail_out);
+					}
+					while (stream.avail_out == 0 && ret != Z_STREAM_END);
 				}
-				while (stream.avail_out == 0);
 			}
-			while (ret != Z_STREAM_END);
+
+			// Truncated input never reaches the end of the stream
+			if (ret != Z_STREAM_END)
+			{
+				return {};
+			}
 
 			return buffer;
 		}
@@ -110,6 +126,37 @@ namespace utils::compression
 			result.resize(length);
 			return result;
 		}
+
+		std::string gzip(const std::string_view data, const int level)
+		{
+			z_stream stream{};
+			// windowBits +16 writes a gzip header and trailer instead of zlib's
+			if (deflateInit2(&stream, level, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			{
+				return {};
+			}
+
+			const auto _ = finally([&stream]
+			{
+				deflateEnd(&stream);
+			});
+
+			std::string result{};
+			result.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+
+			stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+			stream.avail_in = static_cast<uInt>(data.size());
+			stream.next_out = reinterpret_cast<Bytef*>(result.data());
+			stream.avail_out = static_cast<uInt>(result.size());
+
+			if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+			{
+				return {};
+			}
+
+			result.resize(stream.total_out);
+			return result;
+		}
 	}
 
 	namespace zip
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #define CHUNK 16384u
 
@@ -10,7 +12,11 @@ namespace utils::compression
 	namespace zlib
 	{
 		std::string compress(const std::string& data);
+		// Deflates data with a gzip header, for Content-Encoding: gzip
+		std::string gzip(std::string_view data, int level = 6);
 		std::string decompress(const std::string& data);
+		// Inflates data that arrived in several pieces without joining them first
+		std::string decompress(const std::vector<std::string_view>& segments);
 	}
 
 	namespace zip
@@ -1,8 +1,14 @@
 #include "string.hpp"
 #include "cryptography.hpp"
+#ifdef _WIN32
 #include "nt.hpp"
+#endif
 #include "finally.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
 #undef max
 using namespace std::string_literals;
 
@@ -24,6 +30,7 @@ namespace utils::cryptography
 				register_prng(&sprng_desc);
 				register_prng(&fortuna_desc);
 				register_prng(&yarrow_desc);
+				register_prng(&chacha20_prng_desc);
 
 				register_hash(&sha1_desc);
 				register_hash(&sha256_desc);
@@ -125,11 +132,70 @@ namespace utils::cryptography
 		};
 
 		const prng prng_(fortuna_desc);
+
+		// chacha20 keystream pulled in blocks so small reads don't pay for a prng call each
+		class thread_prng
+		{
+		public:
+			void read(void* data, size_t length)
+			{
+				auto* out = static_cast<uint8_t*>(data);
+				while (length > 0)
+				{
+					if (this->position_ == sizeof(this->buffer_))
+					{
+						this->prng_.read(this->buffer_, sizeof(this->buffer_));
+						this->position_ = 0;
+					}
+
+					const auto count = std::min(length, sizeof(this->buffer_) - this->position_);
+					std::memcpy(out, this->buffer_ + this->position_, count);
+					std::memset(this->buffer_ + this->position_, 0, count);
+
+					this->position_ += count;
+					out += count;
+					length -= count;
+				}
+			}
+
+		private:
+			prng prng_{chacha20_prng_desc};
+			uint8_t buffer_[4096]{};
+			size_t position_ = sizeof(buffer_);
+		};
+
+		thread_prng& get_thread_prng()
+		{
+			thread_local thread_prng instance;
+			return instance;
+		}
+
+		// rejection sampling keeps every symbol equally likely
+		void fill_from_alphabet(char* out, const size_t length, const char* alphabet, const uint32_t alphabet_size)
+		{
+			auto& generator = get_thread_prng();
+			const auto limit = 256 - (256 % alphabet_size);
+
+			uint8_t bytes[256];
+			for (size_t i = 0; i < length;)
+			{
+				const auto wanted = std::min(sizeof(bytes), (length - i) + (length - i) / 4 + 1);
+				generator.read(bytes, wanted);
+
+				for (size_t j = 0; j < wanted && i < length; ++j)
+				{
+					if (bytes[j] < limit)
+					{
+						out[i++] = alphabet[bytes[j] % alphabet_size];
+					}
+				}
+			}
+		}
 	}
 
 	ecc::key::key()
 	{
-		ZeroMemory(&this->key_storage_, sizeof(this->key_storage_));
+		std::memset(&this->key_storage_, 0, sizeof(this->key_storage_));
 	}
 
 	ecc::key::~key()
@@ -154,7 +220,7 @@ namespace utils::cryptography
 		if (this != &obj)
 		{
 			std::memmove(&this->key_storage_, &obj.key_storage_, sizeof(this->key_storage_));
-			ZeroMemory(&obj.key_storage_, sizeof(obj.key_storage_));
+			std::memset(&obj.key_storage_, 0, sizeof(obj.key_storage_));
 		}
 
 		return *this;
@@ -206,7 +272,7 @@ namespace utils::cryptography
 			ul(pub_key_buffer.size()),
 			&this->key_storage_) != CRYPT_OK)
 		{
-			ZeroMemory(&this->key_storage_, sizeof(this->key_storage_));
+			std::memset(&this->key_storage_, 0, sizeof(this->key_storage_));
 		}
 	}
 
@@ -218,7 +284,7 @@ namespace utils::cryptography
 			&this->key_storage_) != CRYPT_OK
 			)
 		{
-			ZeroMemory(&this->key_storage_, sizeof(this->key_storage_));
+			std::memset(&this->key_storage_, 0, sizeof(this->key_storage_));
 		}
 	}
 
@@ -242,7 +308,7 @@ namespace utils::cryptography
 			ecc_free(&this->key_storage_);
 		}
 
-		ZeroMemory(&this->key_storage_, sizeof(this->key_storage_));
+		std::memset(&this->key_storage_, 0, sizeof(this->key_storage_));
 	}
 
 	bool ecc::key::operator==(key& key) const
@@ -503,6 +569,22 @@ namespace utils::cryptography
 		return buffer;
 	}
 
+	std::string hmac_sha256::compute(const std::string& data, const std::string& key)
+	{
+		std::string buffer;
+		buffer.resize(32);
+
+		hmac_state state;
+		hmac_init(&state, find_hash("sha256"), cs(key.data()), ul(key.size()));
+		hmac_process(&state, cs(data.data()), static_cast<int>(data.size()));
+
+		auto out_len = ul(buffer.size());
+		hmac_done(&state, cs(buffer.data()), &out_len);
+
+		buffer.resize(out_len);
+		return buffer;
+	}
+
 	std::string sha1::compute(const std::string& data, const bool hex)
 	{
 		return compute(cs(data.data()), data.size(), hex);
@@ -675,13 +757,49 @@ namespace utils::cryptography
 	std::string random::get_challenge()
 	{
 		std::string result;
-		result.resize(sizeof(uint32_t));
-		random::get_data(result.data(), result.size());
-		return string::dump_hex(result, "");
+		result.resize(sizeof(uint32_t) * 2);
+		fill_from_alphabet(result.data(), result.size(), "0123456789ABCDEF", 16);
+		return result;
 	}
 
 	void random::get_data(void* data, const size_t size)
 	{
-		prng_.read(data, size);
+		get_thread_prng().read(data, size);
+	}
+
+	void random::fill_digits(char* out, const size_t length)
+	{
+		fill_from_alphabet(out, length, "0123456789", 10);
+	}
+
+	void random::fill_hex(char* out, const size_t length)
+	{
+		fill_from_alphabet(out, length, "0123456789abcdef", 16);
+	}
+
+	void random::fill_alnum(char* out, const size_t length)
+	{
+		fill_from_alphabet(out, length, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 62);
+	}
+
+	std::string random::get_digits(const size_t length)
+	{
+		std::string result(length, '\0');
+		fill_digits(result.data(), length);
+		return result;
+	}
+
+	std::string random::get_hex(const size_t length)
+	{
+		std::string result(length, '\0');
+		fill_hex(result.data(), length);
+		return result;
+	}
+
+	std::string random::get_alnum(const size_t length)
+	{
+		std::string result(length, '\0');
+		fill_alnum(result.data(), length);
+		return result;
 	}
 }
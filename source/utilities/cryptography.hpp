@@ -80,6 +80,11 @@ namespace utils::cryptography
 		std::string compute(const std::string& data, const std::string& key);
 	}
 
+	namespace hmac_sha256
+	{
+		std::string compute(const std::string& data, const std::string& key);
+	}
+
 	namespace sha1
 	{
 		std::string compute(const std::string& data, bool hex = false);
@@ -135,5 +140,14 @@ namespace utils::cryptography
 		uint64_t get_longlong();
 		std::string get_challenge();
 		void get_data(void* data, size_t size);
+
+		// per-thread chacha20, unbiased output over the given alphabet
+		void fill_digits(char* out, size_t length);
+		void fill_hex(char* out, size_t length);
+		void fill_alnum(char* out, size_t length);
+
+		std::string get_digits(size_t length);
+		std::string get_hex(size_t length);
+		std::string get_alnum(size_t length);
 	}
 }
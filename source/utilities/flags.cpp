@@ -1,11 +1,32 @@
 #include "flags.hpp"
 #include "string.hpp"
-#include "nt.hpp"
 
+#ifdef _WIN32
+#include "nt.hpp"
 #include <shellapi.h>
+#else
+#include <fstream>
+#endif
 
 namespace utils::flags
 {
+#ifndef _WIN32
+	void parse_flags(std::vector<std::string>& flags)
+	{
+		flags.clear();
+
+		//arguments are NUL separated
+		std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+		std::string arg;
+		while (std::getline(cmdline, arg, '\0'))
+		{
+			if (!arg.empty() && arg[0] == '-')
+			{
+				flags.emplace_back(arg.substr(1));
+			}
+		}
+	}
+#else
 	void parse_flags(std::vector<std::string>& flags)
 	{
 		int num_args;
@@ -28,6 +49,7 @@ namespace utils::flags
 			LocalFree(argv);
 		}
 	}
+#endif
 
 	bool has_flag(const std::string& flag)
 	{
@@ -190,7 +190,11 @@ namespace utils::http
 		char date[64];
 		const auto now = time(nullptr);
 		tm gmtm{};
+#ifdef _WIN32
 		gmtime_s(&gmtm, &now);
+#else
+		gmtime_r(&now, &gmtm);
+#endif
 		strftime(date, 64, "%a, %d %b %G %T", &gmtm);
 
 		return std::format("{} GMT", date);
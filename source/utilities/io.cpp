@@ -1,22 +1,37 @@
 #include "io.hpp"
+#ifdef _WIN32
 #include "nt.hpp"
+#endif
 #include <fstream>
+#include <filesystem>
 
 namespace utils::io
 {
 	bool remove_file(const std::string& file)
 	{
+#ifdef _WIN32
 		if (DeleteFileA(file.data()) != FALSE)
 		{
 			return true;
 		}
 
 		return GetLastError() == ERROR_FILE_NOT_FOUND;
+#else
+		std::error_code ec;
+		std::filesystem::remove(file, ec);
+		return !ec;
+#endif
 	}
 
 	bool move_file(const std::string& src, const std::string& target)
 	{
+#ifdef _WIN32
 		return MoveFileA(src.data(), target.data()) == TRUE;
+#else
+		std::error_code ec;
+		std::filesystem::rename(src, target, ec);
+		return !ec;
+#endif
 	}
 
 	bool file_exists(const std::string& file)
@@ -33,7 +48,7 @@ namespace utils::io
 		}
 
 		std::ofstream stream(
-			file, std::ios::binary | std::ofstream::out | (append ? std::ofstream::app : 0));
+			file, std::ios::binary | std::ofstream::out | (append ? std::ofstream::app : std::ios::openmode{}));
 
 		if (stream.is_open())
 		{
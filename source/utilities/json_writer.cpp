@@ -0,0 +1,129 @@
+#include "json_writer.hpp"
+
+#include <charconv>
+#include <cmath>
+
+namespace utils::json
+{
+	namespace
+	{
+		// 0 passes through, anything else is the character after the backslash ('u' for \u00XX)
+		constexpr char escape_table[256] = {
+			'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+			'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+			0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+		};
+
+		// Responses bigger than this give their memory back instead of keeping it for the thread
+		constexpr size_t max_kept_capacity = 256 * 1024;
+	}
+
+	void writer::write_escaped(std::string_view str)
+	{
+		static constexpr char hex[] = "0123456789ABCDEF";
+
+		// Nearly every string needs no escaping, those are copied in one go
+		size_t first_escape = 0;
+		while (first_escape < str.size() && !escape_table[static_cast<unsigned char>(str[first_escape])])
+		{
+			++first_escape;
+		}
+		if (first_escape == str.size())
+		{
+			char* dst = grow(str.size() + 2);
+			dst[0] = '"';
+			std::memcpy(dst + 1, str.data(), str.size());
+			dst[str.size() + 1] = '"';
+			return;
+		}
+
+		out_ += '"';
+		size_t run = 0;
+		for (size_t i = first_escape; i < str.size(); ++i)
+		{
+			const char escape = escape_table[static_cast<unsigned char>(str[i])];
+			if (!escape)
+			{
+				continue;
+			}
+
+			out_.append(str.data() + run, i - run);
+			run = i + 1;
+
+			out_ += '\\';
+			out_ += escape;
+			if (escape == 'u')
+			{
+				const auto c = static_cast<unsigned char>(str[i]);
+				out_ += "00";
+				out_ += hex[c >> 4];
+				out_ += hex[c & 0xF];
+			}
+		}
+		out_.append(str.data() + run, str.size() - run);
+		out_ += '"';
+	}
+
+	writer& writer::key(std::string_view name)
+	{
+		separate();
+		write_escaped(name);
+		out_ += ':';
+		first_ = true;
+		return *this;
+	}
+
+	writer& writer::value(std::string_view str)
+	{
+		separate();
+		write_escaped(str);
+		return *this;
+	}
+
+	writer& writer::write_int(int64_t n)
+	{
+		separate();
+		char buffer[24];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), n);
+		out_.append(buffer, result.ptr);
+		return *this;
+	}
+
+	writer& writer::write_uint(uint64_t n)
+	{
+		separate();
+		char buffer[24];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), n);
+		out_.append(buffer, result.ptr);
+		return *this;
+	}
+
+	writer& writer::value(double d)
+	{
+		// JSON has no NaN or infinity, rapidjson refuses them as well
+		if (!std::isfinite(d))
+		{
+			return null();
+		}
+
+		separate();
+		char buffer[32];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), d);
+		out_.append(buffer, result.ptr);
+		return *this;
+	}
+
+	std::string& thread_buffer()
+	{
+		thread_local std::string buffer;
+		if (buffer.capacity() > max_kept_capacity)
+		{
+			std::string().swap(buffer);
+		}
+		buffer.clear();
+		return buffer;
+	}
+}
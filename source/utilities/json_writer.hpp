@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace utils::json
+{
+	// Streaming JSON writer, appends straight to a string with no document in between. Strings
+	// and integers come out as rapidjson::Writer writes them: compact, only '"', '\\' and control
+	// characters escaped. Doubles use the shortest form that reads back the same.
+	// Keys given as string literals are copied as they are, their length known at compile
+	// time; they must not need escaping. Nesting is not checked, begin/end calls must pair up.
+	class writer final
+	{
+	public:
+		explicit writer(std::string& out) : out_(out) {}
+
+		writer& begin_object() { separate(); out_ += '{'; first_ = true; return *this; }
+		writer& end_object() { out_ += '}'; first_ = false; return *this; }
+		writer& begin_array() { separate(); out_ += '['; first_ = true; return *this; }
+		writer& end_array() { out_ += ']'; first_ = false; return *this; }
+
+		template <size_t N>
+		writer& key(const char (&name)[N])
+		{
+			separate();
+			char* dst = grow(N + 2);
+			dst[0] = '"';
+			std::memcpy(dst + 1, name, N - 1);
+			dst[N] = '"';
+			dst[N + 1] = ':';
+			first_ = true;
+			return *this;
+		}
+
+		// Keys only known at run time are escaped like values
+		writer& key(std::string_view name);
+
+		writer& value(std::string_view str);
+		writer& value(const std::string& str) { return value(std::string_view(str)); }
+		writer& value(const char* str) { return value(std::string_view(str)); }
+		writer& value(bool b) { separate(); out_ += b ? "true" : "false"; return *this; }
+		writer& value(double d);
+
+		template <typename T>
+			requires (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+		writer& value(T n)
+		{
+			if constexpr (std::is_signed_v<T>)
+			{
+				return write_int(static_cast<int64_t>(n));
+			}
+			else
+			{
+				return write_uint(static_cast<uint64_t>(n));
+			}
+		}
+
+		writer& null() { separate(); out_ += "null"; return *this; }
+
+		// An already serialized JSON value
+		writer& raw(std::string_view json) { separate(); out_.append(json); return *this; }
+
+		template <size_t N, typename T>
+		writer& member(const char (&name)[N], const T& v)
+		{
+			key(name);
+			return value(v);
+		}
+
+		std::string& str() { return out_; }
+
+	private:
+		void separate()
+		{
+			if (!first_)
+			{
+				out_ += ',';
+			}
+			first_ = false;
+		}
+
+		char* grow(size_t size)
+		{
+			const size_t at = out_.size();
+			out_.resize(at + size);
+			return out_.data() + at;
+		}
+
+		void write_escaped(std::string_view str);
+		writer& write_int(int64_t n);
+		writer& write_uint(uint64_t n);
+
+		std::string& out_;
+		bool first_ = true;	// nothing written yet at this level, or a key was just written
+	};
+
+	// A string kept per thread and reused between responses, so building one does not allocate
+	// once the thread has warmed up. It is cleared on every call: finish with it (hand it to the
+	// response callback, which copies it) before asking for it again on the same thread, and
+	// never hold it across a co_await.
+	std::string& thread_buffer();
+}
@@ -1,5 +1,9 @@
 #include "memory.hpp"
+#ifdef _WIN32
 #include "nt.hpp"
+#endif
+#include <cstring>
+#include <algorithm>
 
 namespace utils
 {
@@ -110,6 +114,7 @@ namespace utils
 		return true;
 	}
 
+#ifdef _WIN32
 	bool memory::is_bad_read_ptr(const void* ptr)
 	{
 		MEMORY_BASIC_INFORMATION mbi = {};
@@ -165,6 +170,23 @@ namespace utils
 
 		return false;
 	}
+#else
+	//no cheap page query without reading /proc/self/maps, only null is rejected
+	bool memory::is_bad_read_ptr(const void* ptr)
+	{
+		return ptr == nullptr;
+	}
+
+	bool memory::is_bad_code_ptr(const void* ptr)
+	{
+		return ptr == nullptr;
+	}
+
+	bool memory::is_rdata_ptr(void*)
+	{
+		return false;
+	}
+#endif
 
 	memory::allocator* memory::get_allocator()
 	{
@@ -0,0 +1,361 @@
+#include "multipart.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace utils::http
+{
+	namespace
+	{
+		constexpr size_t npos = std::string::npos;
+
+		// part headers are a few short lines, anything longer is not a form upload
+		constexpr size_t max_header_block = 16 * 1024;
+
+		bool equals_ignore_case(const std::string& a, const char* b)
+		{
+			const size_t length = std::strlen(b);
+			if (a.size() != length)
+			{
+				return false;
+			}
+
+			for (size_t i = 0; i < length; ++i)
+			{
+				if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		std::string trim(const std::string& s)
+		{
+			const size_t begin = s.find_first_not_of(" \t");
+			if (begin == npos)
+			{
+				return {};
+			}
+			const size_t end = s.find_last_not_of(" \t");
+			return s.substr(begin, end - begin + 1);
+		}
+
+		// key=value or key="value" out of a header value such as Content-Disposition
+		std::string header_param(const std::string& value, const char* key)
+		{
+			size_t pos = value.find(';');
+			while (pos != npos)
+			{
+				++pos;
+				const size_t equals = value.find('=', pos);
+				if (equals == npos)
+				{
+					return {};
+				}
+
+				const std::string name = trim(value.substr(pos, equals - pos));
+				std::string param;
+				size_t next;
+				size_t start = value.find_first_not_of(" \t", equals + 1);
+				if (start != npos && value[start] == '"')
+				{
+					const size_t close = value.find('"', start + 1);
+					param = value.substr(start + 1, close == npos ? npos : close - start - 1);
+					next = close == npos ? npos : value.find(';', close);
+				}
+				else
+				{
+					next = value.find(';', equals);
+					param = trim(value.substr(equals + 1, next == npos ? npos : next - equals - 1));
+				}
+
+				if (equals_ignore_case(name, key))
+				{
+					return param;
+				}
+				pos = next;
+			}
+			return {};
+		}
+	}
+
+	multipart_parser::multipart_parser(const std::string& boundary, const uint64_t max_body_size)
+		: delimiter_("\r\n--" + boundary), max_body_size_(max_body_size)
+	{
+		// Horspool shift table: how far the window may move when its last byte is c
+		const size_t m = this->delimiter_.size();
+		this->skip_.fill(m);
+		for (size_t i = 0; i + 1 < m; ++i)
+		{
+			this->skip_[static_cast<unsigned char>(this->delimiter_[i])] = m - 1 - i;
+		}
+
+		// the first boundary may open the body without a CRLF in front of it
+		this->tail_ = "\r\n";
+	}
+
+	std::string multipart_parser::boundary_from_content_type(const std::string& content_type)
+	{
+		std::string lower = content_type;
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (lower.find("multipart/") == npos)
+		{
+			return {};
+		}
+
+		std::string boundary = header_param(content_type, "boundary");
+		// RFC 2046 limits boundaries to 70 characters
+		if (boundary.size() > 70)
+		{
+			return {};
+		}
+		return boundary;
+	}
+
+	bool multipart_parser::feed(const char* data, const size_t size)
+	{
+		if (this->state_ == state::failed)
+		{
+			return false;
+		}
+
+		this->body_size_ += size;
+		if (this->max_body_size_ && this->body_size_ > this->max_body_size_)
+		{
+			return this->fail(error::too_large);
+		}
+
+		size_t pos = 0;
+		while (pos < size && this->state_ != state::failed)
+		{
+			switch (this->state_)
+			{
+			case state::preamble:
+				pos += this->scan(data + pos, size - pos, false);
+				break;
+			case state::after_boundary:
+				pos += this->parse_after_boundary(data + pos, size - pos);
+				break;
+			case state::headers:
+				pos += this->parse_headers(data + pos, size - pos);
+				break;
+			case state::data:
+				pos += this->scan(data + pos, size - pos, true);
+				break;
+			default:
+				pos = size;
+				break;
+			}
+		}
+
+		return this->state_ != state::failed;
+	}
+
+	size_t multipart_parser::find_delimiter(const char* data, const size_t size, const size_t from) const
+	{
+		const size_t m = this->delimiter_.size();
+		const char* pattern = this->delimiter_.data();
+		const char last = pattern[m - 1];
+
+		size_t i = from;
+		while (i + m <= size)
+		{
+			const char c = data[i + m - 1];
+			if (c == last && std::memcmp(data + i, pattern, m - 1) == 0)
+			{
+				return i;
+			}
+			i += this->skip_[static_cast<unsigned char>(c)];
+		}
+		return npos;
+	}
+
+	size_t multipart_parser::scan(const char* data, const size_t size, const bool emit_data)
+	{
+		const size_t m = this->delimiter_.size();
+		const size_t keep = m - 1;
+
+		auto matched = [this, emit_data]()
+		{
+			this->state_ = state::after_boundary;
+			this->after_boundary_.clear();
+			if (emit_data && this->on_part_end && !this->on_part_end())
+			{
+				this->fail(error::aborted);
+			}
+		};
+
+		// a delimiter can start in the bytes held back from the previous piece, only those and
+		// the first m - 1 new bytes are copied to look for it
+		if (!this->tail_.empty())
+		{
+			std::string joined = this->tail_;
+			joined.append(data, (std::min)(size, keep));
+
+			const size_t found = this->find_delimiter(joined.data(), joined.size(), 0);
+			if (found != npos)
+			{
+				const size_t consumed = found + m - this->tail_.size();
+				this->tail_.clear();
+				if (emit_data && !this->emit(joined.data(), found))
+				{
+					return size;
+				}
+				matched();
+				return consumed;
+			}
+
+			if (size < keep)
+			{
+				// still too short to rule a delimiter out, hold back the last m - 1 bytes
+				const size_t held = (std::min)(joined.size(), keep);
+				if (emit_data && !this->emit(joined.data(), joined.size() - held))
+				{
+					return size;
+				}
+				this->tail_ = joined.substr(joined.size() - held);
+				return size;
+			}
+
+			if (emit_data && !this->emit(this->tail_.data(), this->tail_.size()))
+			{
+				return size;
+			}
+			this->tail_.clear();
+		}
+
+		const size_t found = this->find_delimiter(data, size, 0);
+		if (found == npos)
+		{
+			const size_t held = (std::min)(size, keep);
+			if (emit_data && !this->emit(data, size - held))
+			{
+				return size;
+			}
+			this->tail_.assign(data + size - held, held);
+			return size;
+		}
+
+		if (emit_data && !this->emit(data, found))
+		{
+			return size;
+		}
+		matched();
+		return found + m;
+	}
+
+	size_t multipart_parser::parse_after_boundary(const char* data, const size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			// transport padding between the boundary and its CRLF
+			if (this->after_boundary_.empty() && (data[i] == ' ' || data[i] == '\t'))
+			{
+				continue;
+			}
+
+			this->after_boundary_.push_back(data[i]);
+			if (this->after_boundary_.size() < 2)
+			{
+				continue;
+			}
+
+			if (this->after_boundary_ == "--")
+			{
+				this->state_ = state::epilogue;
+			}
+			else if (this->after_boundary_ == "\r\n")
+			{
+				// keeping the CRLF lets a part without headers end at the first CRLF CRLF too
+				this->state_ = state::headers;
+				this->header_block_ = "\r\n";
+				this->part_ = {};
+			}
+			else
+			{
+				this->fail(error::malformed);
+			}
+			return i + 1;
+		}
+		return size;
+	}
+
+	size_t multipart_parser::parse_headers(const char* data, const size_t size)
+	{
+		const size_t before = this->header_block_.size();
+		const size_t take = (std::min)(size, max_header_block + 4 - (std::min)(before, max_header_block));
+		this->header_block_.append(data, take);
+
+		const size_t end = this->header_block_.find("\r\n\r\n", before >= 3 ? before - 3 : 0);
+		if (end == npos)
+		{
+			if (this->header_block_.size() > max_header_block)
+			{
+				this->fail(error::malformed);
+			}
+			return take;
+		}
+
+		const size_t consumed = end + 4 - before;
+		this->header_block_.resize(end);
+
+		size_t line_start = 2;
+		while (line_start < this->header_block_.size())
+		{
+			size_t line_end = this->header_block_.find("\r\n", line_start);
+			if (line_end == npos)
+			{
+				line_end = this->header_block_.size();
+			}
+
+			const std::string line = this->header_block_.substr(line_start, line_end - line_start);
+			const size_t colon = line.find(':');
+			if (colon != npos)
+			{
+				const std::string name = trim(line.substr(0, colon));
+				const std::string value = trim(line.substr(colon + 1));
+				if (equals_ignore_case(name, "Content-Disposition"))
+				{
+					this->part_.name = header_param(value, "name");
+					this->part_.filename = header_param(value, "filename");
+				}
+				else if (equals_ignore_case(name, "Content-Type"))
+				{
+					this->part_.content_type = value;
+				}
+			}
+			line_start = line_end + 2;
+		}
+
+		this->header_block_.clear();
+		this->state_ = state::data;
+		if (this->on_part_begin && !this->on_part_begin(this->part_))
+		{
+			this->fail(error::aborted);
+		}
+		return consumed;
+	}
+
+	bool multipart_parser::emit(const char* data, const size_t size)
+	{
+		if (size == 0 || !this->on_part_data)
+		{
+			return true;
+		}
+
+		if (!this->on_part_data(data, size))
+		{
+			return this->fail(error::aborted);
+		}
+		return true;
+	}
+
+	bool multipart_parser::fail(const error e)
+	{
+		this->state_ = state::failed;
+		this->error_ = e;
+		this->tail_.clear();
+		this->header_block_.clear();
+		return false;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace utils::http
+{
+	// Incremental multipart/form-data parser. The body can be fed in pieces of any size, part
+	// data is handed to the callbacks as it is found and never collected, so memory stays at
+	// the part headers plus one boundary length whatever the upload size.
+	// Boundaries are found with Boyer-Moore-Horspool.
+	class multipart_parser final
+	{
+	public:
+		enum class error
+		{
+			none,
+			malformed,
+			too_large,
+			aborted,	// a callback returned false
+		};
+
+		struct part
+		{
+			std::string name;
+			std::string filename;
+			std::string content_type;
+		};
+
+		// Returning false from a callback stops the parser with error::aborted
+		std::function<bool(const part&)> on_part_begin;
+		std::function<bool(const char* data, size_t size)> on_part_data;
+		std::function<bool()> on_part_end;
+
+		// max_body_size of 0 means no limit
+		multipart_parser(const std::string& boundary, uint64_t max_body_size);
+
+		// The boundary parameter of a multipart Content-Type, empty when there is none
+		static std::string boundary_from_content_type(const std::string& content_type);
+
+		// Returns false once the body is malformed, over the limit or a callback stopped it
+		bool feed(const char* data, size_t size);
+
+		// The closing boundary has been seen
+		bool done() const { return state_ == state::epilogue; }
+
+		error last_error() const { return error_; }
+		uint64_t body_size() const { return body_size_; }
+
+	private:
+		enum class state
+		{
+			preamble,		// before the first boundary, data is dropped
+			after_boundary,	// "--" closes the body, CRLF starts the next part's headers
+			headers,
+			data,
+			epilogue,
+			failed,
+		};
+
+		size_t find_delimiter(const char* data, size_t size, size_t from) const;
+		size_t scan(const char* data, size_t size, bool emit);
+		size_t parse_after_boundary(const char* data, size_t size);
+		size_t parse_headers(const char* data, size_t size);
+		bool emit(const char* data, size_t size);
+		bool fail(error e);
+
+		std::string delimiter_;		// CRLF "--" boundary
+		std::array<size_t, 256> skip_{};
+		uint64_t max_body_size_;
+		uint64_t body_size_ = 0;
+
+		state state_ = state::preamble;
+		error error_ = error::none;
+
+		// the end of the previous piece that could still be the start of a delimiter
+		std::string tail_;
+		std::string header_block_;
+		std::string after_boundary_;
+		part part_;
+	};
+}
@@ -3,7 +3,9 @@
 #include <cstdarg>
 #include <algorithm>
 
+#ifdef _WIN32
 #include "nt.hpp"
+#endif
 
 namespace utils::string
 {
@@ -101,6 +103,9 @@ namespace utils::string
 
 	std::string get_clipboard_data()
 	{
+#ifndef _WIN32
+		return {};
+#else
 		if (OpenClipboard(nullptr))
 		{
 			std::string data;
@@ -120,6 +125,7 @@ namespace utils::string
 			return data;
 		}
 		return {};
+#endif
 	}
 
 	void strip(const char* in, char* out, int max)
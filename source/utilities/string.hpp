@@ -1,6 +1,10 @@
 #pragma once
 #include "memory.hpp"
 #include <cstdint>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <stdexcept>
 
 #ifndef ARRAYSIZE
 template <class Type, size_t n>
@@ -19,7 +23,7 @@ namespace utils::string
 		{
 		}
 
-		char* get(const char* format, const va_list ap)
+		char* get(const char* format, va_list ap)
 		{
 			++this->current_buffer_ %= ARRAYSIZE(this->string_pool_);
 			auto entry = &this->string_pool_[this->current_buffer_];
@@ -31,7 +35,16 @@ namespace utils::string
 
 			while (true)
 			{
+#ifdef _WIN32
 				const int res = vsnprintf_s(entry->buffer, entry->size, _TRUNCATE, format, ap);
+#else
+				//vsnprintf reports the full length instead of failing on truncation
+				va_list copy;
+				va_copy(copy, ap);
+				int res = vsnprintf(entry->buffer, entry->size, format, copy);
+				va_end(copy);
+				if (res >= static_cast<int>(entry->size)) res = -1;
+#endif
 				if (res > 0) break; // Success
 				if (res == 0) return nullptr; // Error
 
@@ -0,0 +1,184 @@
+//build step: packs webpanel/ into a C++ table with gzip variants and content hashes
+//usage: webpanel_packer <webpanel dir> <output .cpp>
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include <zlib.h>
+#include <xxhash64.h>
+
+namespace {
+
+    struct asset {
+        std::string path;           //uri, e.g. "/images/donut.png"
+        std::string content_type;
+        std::string data;
+        std::string gzip;           //empty when compressing doesn't pay off
+        std::string etag;
+        std::string gzip_etag;      //the compressed bytes are another representation, so another tag
+    };
+
+    std::string content_type_for(const std::string& ext) {
+        if (ext == ".html" || ext == ".htm") return "text/html; charset=utf-8";
+        if (ext == ".js") return "application/javascript";
+        if (ext == ".css") return "text/css; charset=utf-8";
+        if (ext == ".png") return "image/png";
+        if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
+        if (ext == ".gif") return "image/gif";
+        if (ext == ".svg") return "image/svg+xml";
+        if (ext == ".json") return "application/json";
+        if (ext == ".ico") return "image/x-icon";
+        return "application/octet-stream";
+    }
+
+    bool is_precompressed(const std::string& ext) {
+        return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".gif" || ext == ".zip";
+    }
+
+    std::string gzip(const std::string& data) {
+        z_stream stream{};
+        //16 + window bits makes deflate write a gzip header
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return {};
+        }
+
+        std::string out(deflateBound(&stream, static_cast<uLong>(data.size())) + 32, '\0');
+        stream.next_in = reinterpret_cast<const Bytef*>(data.data());
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+
+        const int result = deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+
+        return result == Z_STREAM_END ? out : std::string{};
+    }
+
+    std::string hex64(uint64_t value) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    void write_bytes(std::ostream& out, const std::string& name, const std::string& data) {
+        out << "    alignas(16) const unsigned char " << name << "[] = {";
+        for (size_t i = 0; i < data.size(); ++i) {
+            if (i % 24 == 0) {
+                out << "\n        ";
+            }
+            out << static_cast<unsigned>(static_cast<unsigned char>(data[i])) << ",";
+        }
+        //never emit an empty array
+        out << (data.empty() ? "0" : "") << "\n    };\n";
+    }
+
+    std::string escape(const std::string& text) {
+        std::string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') out.push_back('\\');
+            out.push_back(c);
+        }
+        return out;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: webpanel_packer <webpanel dir> <output .cpp>" << std::endl;
+        return 1;
+    }
+
+    const std::filesystem::path root = argv[1];
+    const std::filesystem::path output = argv[2];
+
+    std::vector<asset> assets;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+
+        asset item;
+        item.path = "/" + std::filesystem::relative(entry.path(), root).generic_string();
+        const std::string ext = entry.path().extension().string();
+        item.content_type = content_type_for(ext);
+        item.data = buffer.str();
+
+        if (!is_precompressed(ext)) {
+            auto compressed = gzip(item.data);
+            if (!compressed.empty() && compressed.size() < item.data.size()) {
+                item.gzip = std::move(compressed);
+            }
+        }
+
+        const std::string hash = hex64(XXHash64::hash(item.data.data(), item.data.size(), 0));
+        item.etag = "\"" + hash + "\"";
+        if (!item.gzip.empty()) {
+            item.gzip_etag = "\"" + hash + "-gz\"";
+        }
+        assets.push_back(std::move(item));
+    }
+
+    //sorted so the generated file only changes when the panel does
+    std::sort(assets.begin(), assets.end(), [](const asset& a, const asset& b) { return a.path < b.path; });
+
+    std::filesystem::create_directories(output.parent_path());
+    std::stringstream out;
+    out << "//generated by webpanel_packer from " << root.generic_string() << ", do not edit\n";
+    out << "#include \"file_server/webpanel_assets.hpp\"\n\n";
+    out << "namespace file_server::webpanel {\n\n";
+    out << "namespace {\n";
+    for (size_t i = 0; i < assets.size(); ++i) {
+        write_bytes(out, "asset_" + std::to_string(i), assets[i].data);
+        if (!assets[i].gzip.empty()) {
+            write_bytes(out, "asset_" + std::to_string(i) + "_gz", assets[i].gzip);
+        }
+    }
+    out << "}\n\n";
+
+    out << "    const asset embedded_assets[] = {\n";
+    for (size_t i = 0; i < assets.size(); ++i) {
+        const auto& item = assets[i];
+        const std::string name = "asset_" + std::to_string(i);
+        out << "        { \"" << escape(item.path) << "\", \"" << item.content_type << "\", "
+            << "{ reinterpret_cast<const char*>(" << name << "), " << item.data.size() << " }, ";
+        if (item.gzip.empty()) {
+            out << "{}, ";
+        }
+        else {
+            out << "{ reinterpret_cast<const char*>(" << name << "_gz), " << item.gzip.size() << " }, ";
+        }
+        out << "\"" << escape(item.etag) << "\", \"" << escape(item.gzip_etag) << "\" },\n";
+    }
+    out << "    };\n\n";
+    out << "    const size_t embedded_asset_count = " << assets.size() << ";\n";
+    out << "}\n";
+
+    //leave the file alone when nothing changed so the server isn't rebuilt every time
+    const std::string generated = out.str();
+    {
+        std::ifstream existing(output, std::ios::binary);
+        std::stringstream current;
+        current << existing.rdbuf();
+        if (existing.is_open() && current.str() == generated) {
+            std::cout << "webpanel_packer: " << output.generic_string() << " is up to date" << std::endl;
+            return 0;
+        }
+    }
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    file << generated;
+    std::cout << "webpanel_packer: packed " << assets.size() << " files into " << output.generic_string() << std::endl;
+    return file.good() ? 0 : 1;
+}